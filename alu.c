@@ -1,177 +1,307 @@
-#include "alu.h"
-
-static void update_status_bits(const uint16_t result,
-                               const uint8_t op_code,
-                               const uint8_t a,
-                               const uint8_t b,
-                               uint8_t* sr);
-                                                            
-static uint8_t get_nzvc(const uint16_t result,
-                        const uint8_t op_code,
-                        const uint8_t a,
-                        const uint8_t b);
-
-static inline bool overflow_occured(const uint16_t result,
-                                    const uint8_t op_code, 
-                                    const uint8_t a, 
-                                    const uint8_t b);
-                                    
-static inline void check_for_two_complement(uint16_t* result);                                  
-static inline bool addition_performed(const uint8_t op_code);
-static inline bool subtraction_performed(const uint8_t op_code);
-
-/********************************************************************************
-* alu: Returns result after specified aritmetic or logic calculation with 
-*      operands a and b. The NZVC bits of referenced status register is 
-*      updated in accordance with the result.
-*
-*      - op_code: OP code, indicates what calculation to perform.
-*      - a      : First operand.
-*      - b      : Second operand.
-*      - sr     : Reference to the status register to be updated.
-********************************************************************************/
-uint8_t alu(const uint8_t op_code,
-            const uint8_t a,
-            const uint8_t b,
-            uint8_t* sr)
-{
-   uint16_t result = 0x00;
-
-   if (op_code == ORI || op_code == OR)        result = a | b;
-   else if (op_code == ANDI || op_code == AND) result = a & b;
-   else if (op_code == XORI || op_code == XOR) result = a ^ b;
-   else if (op_code == INC)                    result = a + 1;
-   else if (op_code == DEC)                    result = a - 1;
-   else if (op_code == ADDI || op_code == ADD) result = a + b;
-   else if (op_code == SUBI || op_code == SUB) result = a - b;
-   else if (op_code == LSL)                    result = a << 1;
-   else if (op_code == LSR)                    result = a >> 1;
-
-   check_for_two_complement(&result);
-   update_status_bits(result, op_code, a, b, sr);
-   return (uint8_t)result;
-}
-
-/********************************************************************************
-* alu_compare: Compares specified operands by subtraction and updates the NZVC
-*              bits of referenced status register in accordance with the result.
-*
-*              - a : First operand.
-*              - b : Second operand.
-*              - sr: Reference to the status register to be updated.
-********************************************************************************/
-void alu_compare(const uint8_t a,
-                 const uint8_t b,
-                 uint8_t* sr)
-{
-   uint16_t result;
-   result = a - b;
-   check_for_two_complement(&result);
-   update_status_bits(result, SUB, a, b, sr);
-   return;
-}
-
-static inline void update_status_bits(const uint16_t result,
-                                     const uint8_t op_code,
-                                     const uint8_t a,
-                                     const uint8_t b,
-                                     uint8_t* sr)
-{
-   *sr &= 0xF0;
-
-   if (op_code == INC || op_code == DEC)
-   {
-      *sr |= get_nzvc(result, op_code, a, 1);
-   }
-   else 
-   {
-      *sr |= get_nzvc(result, op_code, a, b);
-   }
-   return;
-}
-
-static uint8_t get_nzvc(const uint16_t result,
-                        const uint8_t op_code,
-                        const uint8_t a,
-                        const uint8_t b)
-{
-   uint8_t nzvc = 0x00;
-
-   if (read(result, 7))
-   {
-      set(nzvc, N);
-   }
-
-   if (result == 0)
-   {
-      set(nzvc, Z);
-   }
-
-   if (read(result, 9))
-   {
-      set(nzvc, C);
-   }
-
-   if (overflow_occured(result, op_code, a, b))
-   {
-      set(nzvc, V);
-   }
-
-   return nzvc;
-}
-
-static inline bool overflow_occured(const uint16_t result,
-                                    const uint8_t op_code,
-                                    const uint8_t a,
-                                    const uint8_t b)
-{
-   if (addition_performed(op_code) && read(a, 7) == read(b, 7))
-   {
-      if (read(a, 7) != read(result, 7))
-      {
-         return true;
-      }
-   }
-   else if (subtraction_performed(op_code) && read(a, 7) != read(b, 7))
-   {
-      if (read(b, 7) == read(result, 7))
-      {
-         return true;
-      }
-   }
-
-   return false;
-}
-
-static inline void check_for_two_complement(uint16_t* result)
-{
-   if (*result > 0xFF) 
-   {
-      *result += 0xFF;
-   }
-   return;
-}
-
-static inline bool addition_performed(const uint8_t op_code)
-{
-   if (op_code == ADD || op_code == ADDI || op_code == INC)
-   {
-      return true;
-   }
-   else
-   {
-      return false;
-   }
-}
-
-static inline bool subtraction_performed(const uint8_t op_code)
-{
-   if (op_code == SUB || op_code == SUBI || op_code == DEC)
-   {
-      return true;
-   }
-   else
-   {
-      return false;
-   }
-}
+
+#include "alu.h"
+
+static inline uint16_t calculate(const uint8_t op_code,
+                                 const uint8_t a,
+                                 const uint8_t b,
+                                 const uint8_t carry);
+
+static void update_status_bits(const uint16_t result,
+                               const uint8_t op_code,
+                               const uint8_t a,
+                               const uint8_t b,
+                               uint8_t* sr);
+                                                            
+static uint8_t get_nzvc(const uint16_t result,
+                        const uint8_t op_code,
+                        const uint8_t a,
+                        const uint8_t b);
+
+static inline bool overflow_occured(const uint16_t result,
+                                    const uint8_t op_code, 
+                                    const uint8_t a, 
+                                    const uint8_t b);
+                                    
+static inline bool carry_occured(const uint16_t result,
+                                 const uint8_t op_code,
+                                 const uint8_t a);
+static inline bool addition_performed(const uint8_t op_code);
+static inline bool logic_performed(const uint8_t op_code);
+static inline bool subtraction_performed(const uint8_t op_code);
+
+/********************************************************************************
+* alu: Returns result after specified aritmetic or logic calculation with 
+*      operands a and b. The NZVC bits of referenced status register is 
+*      updated in accordance with the result. ADC and SBC use the carry flag
+*      of referenced status register as carry in.
+*
+*      - op_code: OP code, indicates what calculation to perform.
+*      - a      : First operand.
+*      - b      : Second operand.
+*      - sr     : Reference to the status register to be updated.
+********************************************************************************/
+uint8_t alu(const uint8_t op_code,
+            const uint8_t a,
+            const uint8_t b,
+            uint8_t* sr)
+{
+   const uint16_t result = calculate(op_code, a, b, read(*sr, C) ? 1 : 0);
+   update_status_bits(result, op_code, a, b, sr);
+   return (uint8_t)result;
+}
+
+/********************************************************************************
+* alu_without_flags: Returns the same result as alu, but without updating the
+*                    status register. Used by the fast execution engine when
+*                    the flags written by the calculation are never read.
+*
+*                    - op_code: OP code, indicates what calculation to perform.
+*                    - a      : First operand.
+*                    - b      : Second operand.
+*                    - sr     : The status register, whose carry flag is used
+*                               as carry in by ADC and SBC.
+********************************************************************************/
+uint8_t alu_without_flags(const uint8_t op_code,
+                          const uint8_t a,
+                          const uint8_t b,
+                          const uint8_t sr)
+{
+   return (uint8_t)calculate(op_code, a, b, read(sr, C) ? 1 : 0);
+}
+
+/********************************************************************************
+* alu_compare: Compares specified operands by subtraction and updates the NZVC
+*              bits of referenced status register in accordance with the result.
+*
+*              - a : First operand.
+*              - b : Second operand.
+*              - sr: Reference to the status register to be updated.
+********************************************************************************/
+void alu_compare(const uint8_t a,
+                 const uint8_t b,
+                 uint8_t* sr)
+{
+   uint16_t result;
+   result = a - b;
+   update_status_bits(result, SUB, a, b, sr);
+   return;
+}
+
+/********************************************************************************
+* alu_word: Returns result after specified 16-bit calculation (ADIW or SBIW)
+*           of register pair a and constant b. The NZVC bits of referenced
+*           status register is updated in accordance with the result.
+*
+*           - op_code: OP code, indicates what calculation to perform.
+*           - a      : Content of the register pair.
+*           - b      : The constant to add or subtract.
+*           - sr     : Reference to the status register to be updated.
+********************************************************************************/
+uint16_t alu_word(const uint8_t op_code,
+                  const uint16_t a,
+                  const uint8_t b,
+                  uint8_t* sr)
+{
+   const uint16_t result = op_code == ADIW ? a + b : a - b;
+   uint8_t nzvc = 0x00;
+
+   if (read(result, 15)) set(nzvc, N);
+   if (result == 0) set(nzvc, Z);
+
+   if (op_code == ADIW)
+   {
+      if (!read(a, 15) && read(result, 15)) set(nzvc, V);
+      if (read(a, 15) && !read(result, 15)) set(nzvc, C);
+   }
+   else
+   {
+      if (read(a, 15) && !read(result, 15)) set(nzvc, V);
+      if (!read(a, 15) && read(result, 15)) set(nzvc, C);
+   }
+
+   *sr = (*sr & 0xF0) | nzvc;
+   return result;
+}
+
+/********************************************************************************
+* alu_multiply: Returns the 16-bit product of operands a and b, treated as
+*               unsigned (MUL), signed (MULS) or signed and unsigned (MULSU).
+*               The Z and C bits of referenced status register are updated
+*               in accordance with the result.
+*
+*               - op_code: OP code, indicates what multiplication to perform.
+*               - a      : First operand.
+*               - b      : Second operand.
+*               - sr     : Reference to the status register to be updated.
+********************************************************************************/
+uint16_t alu_multiply(const uint8_t op_code,
+                      const uint8_t a,
+                      const uint8_t b,
+                      uint8_t* sr)
+{
+   uint16_t result = 0x00;
+
+   if (op_code == MUL)        result = (uint16_t)(a * b);
+   else if (op_code == MULS)  result = (uint16_t)((int8_t)a * (int8_t)b);
+   else if (op_code == MULSU) result = (uint16_t)((int8_t)a * b);
+
+   clr(*sr, Z);
+   clr(*sr, C);
+   if (result == 0) set(*sr, Z);
+   if (read(result, 15)) set(*sr, C);
+   return result;
+}
+
+static inline uint16_t calculate(const uint8_t op_code,
+                                 const uint8_t a,
+                                 const uint8_t b,
+                                 const uint8_t carry)
+{
+   if (op_code == ORI || op_code == OR)        return a | b;
+   else if (op_code == ANDI || op_code == AND) return a & b;
+   else if (op_code == XORI || op_code == XOR) return a ^ b;
+   else if (op_code == INC)                    return a + 1;
+   else if (op_code == DEC)                    return a - 1;
+   else if (op_code == ADDI || op_code == ADD) return a + b;
+   else if (op_code == SUBI || op_code == SUB) return a - b;
+   else if (op_code == ADC)                    return a + b + carry;
+   else if (op_code == SBC)                    return a - b - carry;
+   else if (op_code == LSL)                    return a << 1;
+   else if (op_code == LSR)                    return a >> 1;
+   else                                        return 0x00;
+}
+
+static inline void update_status_bits(const uint16_t result,
+                                     const uint8_t op_code,
+                                     const uint8_t a,
+                                     const uint8_t b,
+                                     uint8_t* sr)
+{
+   const uint8_t last_sr = *sr;
+   *sr &= 0xF0;
+
+   if (op_code == INC || op_code == DEC)
+   {
+      *sr |= get_nzvc(result, op_code, a, 1);
+   }
+   else 
+   {
+      *sr |= get_nzvc(result, op_code, a, b);
+   }
+
+   if (op_code == INC || op_code == DEC || logic_performed(op_code))
+   {
+      *sr = (*sr & ~(1 << C)) | (last_sr & (1 << C)); /* Carry is not affected. */
+   }
+
+   if (op_code == SBC && !read(last_sr, Z))
+   {
+      clr(*sr, Z); /* Zero flag is only kept over multi-byte subtraction. */
+   }
+   return;
+}
+
+static uint8_t get_nzvc(const uint16_t result,
+                        const uint8_t op_code,
+                        const uint8_t a,
+                        const uint8_t b)
+{
+   uint8_t nzvc = 0x00;
+
+   if (read(result, 7))
+   {
+      set(nzvc, N);
+   }
+
+   if ((uint8_t)result == 0)
+   {
+      set(nzvc, Z);
+   }
+
+   if (carry_occured(result, op_code, a))
+   {
+      set(nzvc, C);
+   }
+
+   if (overflow_occured(result, op_code, a, b))
+   {
+      set(nzvc, V);
+   }
+
+   return nzvc;
+}
+
+static inline bool overflow_occured(const uint16_t result,
+                                    const uint8_t op_code,
+                                    const uint8_t a,
+                                    const uint8_t b)
+{
+   if (addition_performed(op_code) && read(a, 7) == read(b, 7))
+   {
+      if (read(a, 7) != read(result, 7))
+      {
+         return true;
+      }
+   }
+   else if (subtraction_performed(op_code) && read(a, 7) != read(b, 7))
+   {
+      if (read(b, 7) == read(result, 7))
+      {
+         return true;
+      }
+   }
+   else if (op_code == LSL || op_code == LSR)
+   {
+      return !read(result, 7) != !carry_occured(result, op_code, a);
+   }
+
+   return false;
+}
+
+static inline bool carry_occured(const uint16_t result,
+                                 const uint8_t op_code,
+                                 const uint8_t a)
+{
+   if (op_code == LSR)
+   {
+      return read(a, 0);
+   }
+   else if (addition_performed(op_code) || subtraction_performed(op_code) || op_code == LSL)
+   {
+      return read(result, 8); /* Carry out of, or borrow into, bit 7. */
+   }
+   else
+   {
+      return false;
+   }
+}
+
+static inline bool logic_performed(const uint8_t op_code)
+{
+   return op_code == ORI || op_code == ANDI || op_code == XORI ||
+          op_code == OR || op_code == AND || op_code == XOR;
+}
+
+static inline bool addition_performed(const uint8_t op_code)
+{
+   if (op_code == ADD || op_code == ADDI || op_code == INC || op_code == ADC)
+   {
+      return true;
+   }
+   else
+   {
+      return false;
+   }
+}
+
+static inline bool subtraction_performed(const uint8_t op_code)
+{
+   if (op_code == SUB || op_code == SUBI || op_code == DEC || op_code == SBC)
+   {
+      return true;
+   }
+   else
+   {
+      return false;
+   }
+}
@@ -1,34 +1,82 @@
-#ifndef ALU_H_
-#define ALU_H_
-
-#include "cpu.h"
-
-/********************************************************************************
-* alu: Returns result after specified aritmetic or logic calculation with
-*      operands a and b. The NZVC bits of referenced status register is
-*      updated in accordance with the result.
-*
-*      - op_code: OP code, indicates what calculation to perform.
-*      - a      : First operand.
-*      - b      : Second operand.
-*      - sr     : Reference to the status register to be updated.
-********************************************************************************/
-uint8_t alu(const uint8_t op_code,
-            const uint8_t a,
-            const uint8_t b,
-            uint8_t* sr);
-
-/********************************************************************************
-* alu_compare: Compares specified operands by subtraction and updates the NZVC
-*              bits of referenced status register in accordance with the result.
-*
-*              - a : First operand.
-*              - b : Second operand.
-*              - sr: Reference to the status register to be updated.
-********************************************************************************/
-void alu_compare(const uint8_t a,
-                 const uint8_t b, 
-                 uint8_t* sr);
-
-#endif /* ALU_H_ */
-
+#ifndef ALU_H_
+#define ALU_H_
+
+#include "cpu.h"
+
+/********************************************************************************
+* alu: Returns result after specified aritmetic or logic calculation with
+*      operands a and b. The NZVC bits of referenced status register is
+*      updated in accordance with the result. ADC and SBC use the carry flag
+*      of referenced status register as carry in.
+*
+*      - op_code: OP code, indicates what calculation to perform.
+*      - a      : First operand.
+*      - b      : Second operand.
+*      - sr     : Reference to the status register to be updated.
+********************************************************************************/
+uint8_t alu(const uint8_t op_code,
+            const uint8_t a,
+            const uint8_t b,
+            uint8_t* sr);
+
+/********************************************************************************
+* alu_without_flags: Returns the same result as alu, but without updating the
+*                    status register. Used by the fast execution engine when
+*                    the flags written by the calculation are never read.
+*
+*                    - op_code: OP code, indicates what calculation to perform.
+*                    - a      : First operand.
+*                    - b      : Second operand.
+*                    - sr     : The status register, whose carry flag is used
+*                               as carry in by ADC and SBC.
+********************************************************************************/
+uint8_t alu_without_flags(const uint8_t op_code,
+                          const uint8_t a,
+                          const uint8_t b,
+                          const uint8_t sr);
+
+/********************************************************************************
+* alu_compare: Compares specified operands by subtraction and updates the NZVC
+*              bits of referenced status register in accordance with the result.
+*
+*              - a : First operand.
+*              - b : Second operand.
+*              - sr: Reference to the status register to be updated.
+********************************************************************************/
+void alu_compare(const uint8_t a,
+                 const uint8_t b, 
+                 uint8_t* sr);
+
+/********************************************************************************
+* alu_word: Returns result after specified 16-bit calculation (ADIW or SBIW)
+*           of register pair a and constant b. The NZVC bits of referenced
+*           status register is updated in accordance with the result.
+*
+*           - op_code: OP code, indicates what calculation to perform.
+*           - a      : Content of the register pair.
+*           - b      : The constant to add or subtract.
+*           - sr     : Reference to the status register to be updated.
+********************************************************************************/
+uint16_t alu_word(const uint8_t op_code,
+                  const uint16_t a,
+                  const uint8_t b,
+                  uint8_t* sr);
+
+/********************************************************************************
+* alu_multiply: Returns the 16-bit product of operands a and b, treated as
+*               unsigned (MUL), signed (MULS) or signed and unsigned (MULSU).
+*               The Z and C bits of referenced status register are updated
+*               in accordance with the result.
+*
+*               - op_code: OP code, indicates what multiplication to perform.
+*               - a      : First operand.
+*               - b      : Second operand.
+*               - sr     : Reference to the status register to be updated.
+********************************************************************************/
+uint16_t alu_multiply(const uint8_t op_code,
+                      const uint8_t a,
+                      const uint8_t b,
+                      uint8_t* sr);
+
+#endif /* ALU_H_ */
+
@@ -0,0 +1,479 @@
+/********************************************************************************
+* avr_decoder.c: Contains functionality for decoding native AVR instruction
+*                words into the instruction format used by the program memory.
+********************************************************************************/
+#include "avr_decoder.h"
+#include "data_memory.h"
+#include <string.h>
+
+#define AVR_SRAM_START   0x100  /* Start address of SRAM in the ATmega328P memory map. */
+#define AVR_IO_OFFSET    0x20   /* Offset between I/O addresses and data addresses. */
+#define AVR_SPL          0x3D   /* I/O address of the stack pointer low byte. */
+#define AVR_SPH          0x3E   /* I/O address of the stack pointer high byte. */
+#define AVR_SREG         0x3F   /* I/O address of the status register. */
+#define AVR_NUM_VECTORS  26     /* Number of interrupt vectors of the ATmega328P. */
+#define UNMAPPED_ADDRESS 0xFFFF /* Returned for addresses without counterpart. */
+
+/********************************************************************************
+* vector_map: Simulator interrupt vector and the ATmega328P vector table slot
+*             whose content is moved to it.
+********************************************************************************/
+struct vector_map
+{
+   uint8_t vector; /* Interrupt vector in cpu.h. */
+   uint8_t slot;   /* Address of the vector in the ATmega328P vector table. */
+};
+
+static const struct vector_map vector_maps[] =
+{
+   { PCINT0_vect, 0x06 }, { PCINT1_vect, 0x08 }, { PCINT2_vect, 0x0A },
+   { USART_RX_vect, 0x24 }, { USART_UDRE_vect, 0x26 }
+};
+
+static uint32_t decode_table[AVR_DECODER_TABLE_SIZE];
+static bool decode_table_initialized = false;
+
+static uint32_t decode_word(const uint16_t word);
+static uint32_t resolve_second_word(const uint32_t entry,
+                                    const uint16_t word);
+static uint16_t map_data_address(const uint16_t address);
+static int remap_vectors(const uint16_t* words,
+                         const size_t num_words,
+                         uint32_t* instructions);
+static inline bool is_jmp(const uint16_t word);
+static inline uint8_t hex_value(const char* s);
+static inline uint32_t assemble(const uint8_t op_code,
+                                const uint8_t op1,
+                                const uint8_t op2);
+static inline uint32_t invalid(void);
+
+/********************************************************************************
+* avr_decoder_init: Precomputes the decode table. The table is only computed
+*                   once, succeeding calls have no effect.
+********************************************************************************/
+void avr_decoder_init(void)
+{
+   if (decode_table_initialized) return;
+
+   for (uint32_t i = 0; i < AVR_DECODER_TABLE_SIZE; ++i)
+   {
+      decode_table[i] = decode_word((uint16_t)i);
+   }
+
+   decode_table_initialized = true;
+   return;
+}
+
+/********************************************************************************
+* avr_decoder_decode: Returns the decode table entry for specified AVR
+*                     instruction word. Bit 23 downto 0 holds the instruction
+*                     in program memory format, bit 31 downto 24 holds the
+*                     decoder flags AVR_DECODER_RELATIVE, AVR_DECODER_TWO_WORDS
+*                     and AVR_DECODER_INVALID.
+*
+*                     - word: The AVR instruction word.
+********************************************************************************/
+uint32_t avr_decoder_decode(const uint16_t word)
+{
+   avr_decoder_init();
+   return decode_table[word];
+}
+
+/********************************************************************************
+* avr_decoder_load: Decodes specified AVR instruction words and loads the
+*                   result into program memory. Instructions occupying two
+*                   words are stored at the address of the first word, while
+*                   the second word is replaced by NOP, so that all branch
+*                   targets are preserved. The NOP is never executed, since
+*                   the instruction continues after the second word. If the
+*                   image starts with a JMP, it is assumed to start with the
+*                   ATmega328P vector table, whose pin change and USART
+*                   vectors are moved to the vectors in cpu.h. Returns 0
+*                   after successful load or error code 1 if the program
+*                   doesn't fit in the program memory or its vector table
+*                   is incomplete.
+*
+*                   - words    : Reference to the AVR instruction words.
+*                   - num_words: The number of instruction words.
+********************************************************************************/
+int avr_decoder_load(const uint16_t* words,
+                     const size_t num_words)
+{
+   uint32_t instructions[PROGRAM_MEMORY_ADDRESS_WIDTH] = { 0x00 };
+   if (num_words > PROGRAM_MEMORY_ADDRESS_WIDTH) return 1;
+   avr_decoder_init();
+
+   for (size_t i = 0; i < num_words; ++i)
+   {
+      uint32_t entry = decode_table[words[i]];
+
+      if (entry & AVR_DECODER_TWO_WORDS)
+      {
+         entry = resolve_second_word(entry, i + 1 < num_words ? words[i + 1] : 0xFFFF);
+         instructions[i] = entry & ~AVR_DECODER_FLAGS;
+         if (++i < num_words) instructions[i] = assemble(NOP, 0x00, 0x00);
+      }
+      else if (entry & AVR_DECODER_RELATIVE)
+      {
+         const uint8_t target = (uint8_t)(i + 1 + ((entry >> 8) & 0xFF));
+         instructions[i] = assemble((uint8_t)(entry >> 16), target, (uint8_t)entry);
+      }
+      else
+      {
+         instructions[i] = entry & ~AVR_DECODER_FLAGS;
+      }
+   }
+
+   if (num_words && is_jmp(words[0]) && remap_vectors(words, num_words, instructions)) return 1;
+   if (program_memory_load(instructions, num_words)) return 1;
+   return program_memory_load_raw(words, num_words);
+}
+
+/********************************************************************************
+* avr_decoder_load_hex: Reads the Intel HEX file at specified path, decodes
+*                       its content and loads the result into program memory.
+*                       Returns 0 after successful load or error code 1 if
+*                       the file couldn't be read, contains invalid records
+*                       or doesn't fit in the program memory.
+*
+*                       - filepath: Path to the Intel HEX file.
+********************************************************************************/
+int avr_decoder_load_hex(const char* filepath)
+{
+   uint8_t bytes[PROGRAM_MEMORY_ADDRESS_WIDTH * 2] = { 0x00 };
+   uint16_t words[PROGRAM_MEMORY_ADDRESS_WIDTH] = { 0x00 };
+   size_t num_bytes = 0;
+   char s[600] = { '\0' };
+   int error = 0;
+
+   FILE* fstream = fopen(filepath, "r");
+   if (!fstream) return 1;
+
+   while (!error && fgets(s, sizeof(s), fstream))
+   {
+      if (s[0] != ':') continue;
+      const uint8_t count = hex_value(s + 1);
+      const uint16_t address = (hex_value(s + 3) << 8) | hex_value(s + 5);
+      const uint8_t type = hex_value(s + 7);
+      uint8_t checksum = count + (address >> 8) + address + type;
+
+      if (strlen(s) < 11 + 2 * (size_t)count)
+      {
+         error = 1;
+         break;
+      }
+
+      for (uint8_t i = 0; i <= count; ++i)
+      {
+         checksum += hex_value(s + 9 + 2 * i);
+      }
+
+      if (checksum != 0)
+      {
+         error = 1;
+      }
+      else if (type == 0x00)
+      {
+         for (uint8_t i = 0; i < count; ++i)
+         {
+            const size_t byte_address = (size_t)address + i;
+
+            if (byte_address >= sizeof(bytes))
+            {
+               error = 1;
+               break;
+            }
+
+            bytes[byte_address] = hex_value(s + 9 + 2 * i);
+            if (byte_address + 1 > num_bytes) num_bytes = byte_address + 1;
+         }
+      }
+      else if (type == 0x01)
+      {
+         break;
+      }
+   }
+
+   fclose(fstream);
+   if (error) return 1;
+
+   for (size_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      words[i] = bytes[2 * i] | (bytes[2 * i + 1] << 8); /* Little endian. */
+   }
+
+   return avr_decoder_load(words, (num_bytes + 1) / 2);
+}
+
+/********************************************************************************
+* decode_word: Decodes specified AVR instruction word into a decode table
+*              entry. Instructions without counterpart in cpu.h are decoded
+*              as invalid.
+*
+*              - word: The AVR instruction word.
+********************************************************************************/
+static uint32_t decode_word(const uint16_t word)
+{
+   const uint8_t d = (word >> 4) & 0x1F;                     /* Rd, bit 8 downto 4. */
+   const uint8_t r = ((word >> 5) & 0x10) | (word & 0x0F);   /* Rr, bit 9 and 3 downto 0. */
+   const uint8_t d_high = R16 + ((word >> 4) & 0x0F);        /* Rd within R16 - R31. */
+   const uint8_t k = ((word >> 4) & 0xF0) | (word & 0x0F);   /* 8-bit constant K. */
+   const uint8_t io = ((word >> 5) & 0x30) | (word & 0x0F);  /* 6-bit I/O address A. */
+   uint8_t branch = (word >> 3) & 0x7F;                      /* 7-bit signed offset. */
+   if (branch & 0x40) branch |= 0x80;
+
+   if (word == 0x0000) return assemble(NOP, 0x00, 0x00);
+   else if (word == 0x9508) return assemble(RET, 0x00, 0x00);
+   else if (word == 0x9518) return assemble(RETI, 0x00, 0x00);
+   else if (word == 0x9478) return assemble(SEI, 0x00, 0x00);
+   else if (word == 0x94F8) return assemble(CLI, 0x00, 0x00);
+   else if (word == 0x9598) return assemble(NOP, 0x00, 0x00); /* BREAK without on-chip debugger. */
+
+   switch (word & 0xFC00)
+   {
+      case 0x2C00: return assemble(MOV, d, r);
+      case 0x0C00: return d == r ? assemble(LSL, d, 0x00) : assemble(ADD, d, r);
+      case 0x1800: return assemble(SUB, d, r);
+      case 0x1400: return assemble(CP, d, r);
+      case 0x2000: return assemble(AND, d, r);
+      case 0x2400: return assemble(XOR, d, r); /* CLR is EOR Rd,Rd, which updates the flags. */
+      case 0x2800: return assemble(OR, d, r);
+      case 0x1C00: return assemble(ADC, d, r);
+      case 0x0800: return assemble(SBC, d, r);
+      case 0x9C00: return assemble(MUL, d, r);
+      default: break;
+   }
+
+   switch (word & 0xFF00)
+   {
+      case 0x0100: return assemble(MOVW, 2 * ((word >> 4) & 0x0F), 2 * (word & 0x0F));
+      case 0x0200: return assemble(MULS, d_high, R16 + (word & 0x0F));
+      case 0x0300: return (word & 0x88) ? invalid() : assemble(MULSU, d_high, R16 + (word & 0x07));
+      case 0x9600: return assemble(ADIW, R24 + 2 * ((word >> 4) & 0x03), ((word >> 2) & 0x30) | (word & 0x0F));
+      case 0x9700: return assemble(SBIW, R24 + 2 * ((word >> 4) & 0x03), ((word >> 2) & 0x30) | (word & 0x0F));
+      default: break;
+   }
+
+   switch (word & 0xF000)
+   {
+      case 0xE000: return assemble(LDI, d_high, k);
+      case 0x6000: return assemble(ORI, d_high, k);
+      case 0x7000: return assemble(ANDI, d_high, k);
+      case 0x5000: return assemble(SUBI, d_high, k);
+      case 0x3000: return assemble(CPI, d_high, k);
+      case 0xC000: return assemble(JMP, (uint8_t)word, 0x00) | AVR_DECODER_RELATIVE;
+      case 0xD000: return assemble(CALL, (uint8_t)word, 0x00) | AVR_DECODER_RELATIVE;
+      default: break;
+   }
+
+   switch (word & 0xF800)
+   {
+      case 0xB000:
+      {
+         const uint16_t address = map_data_address(io + AVR_IO_OFFSET);
+         if (io == AVR_SREG) return assemble(INSR, d, 0x00);
+         else if (io == AVR_SPL || io == AVR_SPH) return assemble(INSP, d, io == AVR_SPH);
+         return address != UNMAPPED_ADDRESS ? assemble(IN, d, (uint8_t)address) : invalid();
+      }
+      case 0xB800:
+      {
+         const uint16_t address = map_data_address(io + AVR_IO_OFFSET);
+         if (io == AVR_SREG) return assemble(OUTSR, d, 0x00);
+         else if (io == AVR_SPL || io == AVR_SPH) return assemble(OUTSP, d, io == AVR_SPH);
+         return address != UNMAPPED_ADDRESS ? assemble(OUT, (uint8_t)address, d) : invalid();
+      }
+      default: break;
+   }
+
+   switch (word & 0xFE0F)
+   {
+      case 0x9000: return assemble(LDSX, d, 0x00) | AVR_DECODER_TWO_WORDS;
+      case 0x9200: return assemble(STSX, 0x00, d) | AVR_DECODER_TWO_WORDS;
+      case 0x900C: return assemble(LD, d, XL);
+      case 0x900D: return assemble(LDP, d, XL);
+      case 0x900E: return assemble(LDM, d, XL);
+      case 0x9009: return assemble(LDP, d, YL);
+      case 0x900A: return assemble(LDM, d, YL);
+      case 0x9001: return assemble(LDP, d, ZL);
+      case 0x9002: return assemble(LDM, d, ZL);
+      case 0x920C: return assemble(ST, XL, d);
+      case 0x920D: return assemble(STP, XL, d);
+      case 0x920E: return assemble(STM, XL, d);
+      case 0x9209: return assemble(STP, YL, d);
+      case 0x920A: return assemble(STM, YL, d);
+      case 0x9201: return assemble(STP, ZL, d);
+      case 0x9202: return assemble(STM, ZL, d);
+      case 0x9004: return assemble(LPM, d, 0x00);
+      case 0x9005: return assemble(LPMP, d, 0x00);
+      case 0x900F: return assemble(POP, d, 0x00);
+      case 0x920F: return assemble(PUSH, d, 0x00);
+      case 0x9403: return assemble(INC, d, 0x00);
+      case 0x940A: return assemble(DEC, d, 0x00);
+      case 0x9406: return assemble(LSR, d, 0x00);
+      default: break;
+   }
+
+   if ((word & 0xD000) == 0x8000)
+   {
+      const uint8_t q = ((word >> 8) & 0x20) | ((word >> 7) & 0x18) | (word & 0x07);
+      const bool y = read(word, 3);
+      const bool store = read(word, 9);
+
+      if (q == 0 && store) return assemble(ST, y ? YL : ZL, d);
+      else if (q == 0) return assemble(LD, d, y ? YL : ZL);
+      else if (store) return assemble(y ? STDY : STDZ, q, d);
+      else return assemble(y ? LDDY : LDDZ, d, q);
+   }
+
+   if (word == 0x95C8) return assemble(LPM, R0, 0x00);
+   else if ((word & 0xFFFE) == 0x940C) return assemble(JMP, 0x00, 0x00) | AVR_DECODER_TWO_WORDS;
+   else if ((word & 0xFFFE) == 0x940E) return assemble(CALL, 0x00, 0x00) | AVR_DECODER_TWO_WORDS;
+
+   switch (word & 0xFC07)
+   {
+      case 0xF001: return assemble(BREQ, branch, 0x00) | AVR_DECODER_RELATIVE;
+      case 0xF401: return assemble(BRNE, branch, 0x00) | AVR_DECODER_RELATIVE;
+      case 0xF404: return assemble(BRGES, branch, 0x00) | AVR_DECODER_RELATIVE;
+      case 0xF004: return assemble(BRLTS, branch, 0x00) | AVR_DECODER_RELATIVE;
+      default: break;
+   }
+
+   return invalid();
+}
+
+/********************************************************************************
+* resolve_second_word: Completes a decode table entry for an instruction that
+*                      occupies two words by inserting the address stored in
+*                      the second word. A CALL is marked by a nonzero second
+*                      operand, so that it returns past the second word. If
+*                      the address has no counterpart, an invalid entry is
+*                      returned.
+*
+*                      - entry: Decode table entry for the first word.
+*                      - word : The second instruction word.
+********************************************************************************/
+static uint32_t resolve_second_word(const uint32_t entry,
+                                    const uint16_t word)
+{
+   const uint8_t op_code = (uint8_t)(entry >> 16);
+   const uint8_t op1 = (uint8_t)(entry >> 8);
+   const uint8_t op2 = (uint8_t)entry;
+
+   if (op_code == JMP || op_code == CALL)
+   {
+      return word < PROGRAM_MEMORY_ADDRESS_WIDTH ? assemble(op_code, (uint8_t)word, op_code == CALL) : invalid();
+   }
+   else
+   {
+      const uint16_t address = map_data_address(word);
+      const uint8_t high = (uint8_t)((address >> 8) << 5); /* Stored above the register, see CPU_WIDE_ADDRESS. */
+      if (address == UNMAPPED_ADDRESS) return invalid();
+      return op_code == STSX ? assemble(STSX, (uint8_t)address, high | op2) : assemble(LDSX, high | op1, (uint8_t)address);
+   }
+}
+
+/********************************************************************************
+* map_data_address: Returns the data memory address corresponding to
+*                   specified address in the ATmega328P data memory map.
+*                   SRAM addresses are used as they are, like the addresses
+*                   stored in the pointer registers. UNMAPPED_ADDRESS is
+*                   returned if no such address exists.
+*
+*                   - address: Address in the ATmega328P data memory map.
+********************************************************************************/
+static uint16_t map_data_address(const uint16_t address)
+{
+   switch (address)
+   {
+      case 0x23: return PINB;
+      case 0x24: return DDRB;
+      case 0x25: return PORTB;
+      case 0x26: return PINC;
+      case 0x27: return DDRC;
+      case 0x28: return PORTC;
+      case 0x29: return PIND;
+      case 0x2A: return DDRD;
+      case 0x2B: return PORTD;
+      case 0x3B: return PCIFR;
+      case 0x68: return PCICR;
+      case 0x6B: return PCMSK0;
+      case 0x6C: return PCMSK1;
+      case 0x6D: return PCMSK2;
+      case 0xC0: return UCSR0A;
+      case 0xC1: return UCSR0B;
+      case 0xC2: return UCSR0C;
+      case 0xC4: return UBRR0L;
+      case 0xC5: return UBRR0H;
+      case 0xC6: return UDR0;
+      default: break;
+   }
+
+   if (address >= AVR_SRAM_START && address < DATA_MEMORY_ADDRESS_WIDTH)
+   {
+      return address;
+   }
+   else
+   {
+      return UNMAPPED_ADDRESS;
+   }
+}
+
+/********************************************************************************
+* remap_vectors: Moves the content of the ATmega328P vector table slots to
+*                the corresponding interrupt vectors in cpu.h. Returns 0
+*                after successful remap or error code 1 if any of the slots
+*                is missing or doesn't hold a JMP.
+*
+*                - words       : Reference to the AVR instruction words.
+*                - num_words   : The number of instruction words.
+*                - instructions: Reference to the decoded instructions.
+********************************************************************************/
+static int remap_vectors(const uint16_t* words,
+                         const size_t num_words,
+                         uint32_t* instructions)
+{
+   const size_t num_maps = sizeof(vector_maps) / sizeof(vector_maps[0]);
+   uint32_t slots[sizeof(vector_maps) / sizeof(vector_maps[0])][2];
+   if (num_words < 2 * AVR_NUM_VECTORS) return 1;
+
+   for (size_t i = 0; i < num_maps; ++i)
+   {
+      const uint8_t slot = vector_maps[i].slot;
+      if (!is_jmp(words[slot])) return 1;
+      slots[i][0] = instructions[slot];
+      slots[i][1] = instructions[slot + 1];
+   }
+
+   for (size_t i = 0; i < num_maps; ++i)
+   {
+      instructions[vector_maps[i].vector] = slots[i][0];
+      instructions[vector_maps[i].vector + 1] = slots[i][1];
+   }
+   return 0;
+}
+
+static inline bool is_jmp(const uint16_t word)
+{
+   return (word & 0xFE0E) == 0x940C;
+}
+
+static inline uint8_t hex_value(const char* s)
+{
+   const char digits[3] = { s[0], s[1], '\0' };
+   return (uint8_t)strtoul(digits, 0, 16);
+}
+
+static inline uint32_t assemble(const uint8_t op_code,
+                                const uint8_t op1,
+                                const uint8_t op2)
+{
+   uint32_t instruction = op_code << 16;
+   instruction |= op1 << 8;
+   instruction |= op2;
+   return instruction;
+}
+
+static inline uint32_t invalid(void)
+{
+   return assemble(AVR_DECODER_INVALID_OP_CODE, 0x00, 0x00) | AVR_DECODER_INVALID;
+}
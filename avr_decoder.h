@@ -0,0 +1,82 @@
+/********************************************************************************
+* avr_decoder.h: Contains functionality for decoding native AVR instruction
+*                words (as generated by avr-gcc) into the instruction format
+*                used by the program memory, so that real compiled firmware
+*                can be executed by the control unit.
+*
+*                Every 16-bit instruction word is decoded once into a 65536
+*                entry table. I/O addresses are mapped from the ATmega328P
+*                memory map to the addresses used in cpu.h, while SRAM
+*                addresses are used as they are, like the addresses stored
+*                in the pointer registers X, Y and Z. SREG and the stack
+*                pointer SPH:SPL are accessed through the status register
+*                and the stack of the control unit. Instructions that are
+*                not supported or whose operands have no counterpart are
+*                decoded as invalid, which causes a system reset if
+*                executed.
+********************************************************************************/
+#ifndef AVR_DECODER_H_
+#define AVR_DECODER_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "program_memory.h"
+
+#define AVR_DECODER_TABLE_SIZE 65536 /* One entry per 16-bit instruction word. */
+
+#define AVR_DECODER_RELATIVE  0x01000000 /* First operand is an offset relative to next instruction. */
+#define AVR_DECODER_TWO_WORDS 0x02000000 /* Address operand is stored in the following word. */
+#define AVR_DECODER_INVALID   0x80000000 /* Instruction word is not supported. */
+#define AVR_DECODER_FLAGS     0xFF000000 /* Mask for the decoder flags above. */
+
+#define AVR_DECODER_INVALID_OP_CODE 0xFF /* OP code stored for unsupported instructions. */
+
+/********************************************************************************
+* avr_decoder_init: Precomputes the decode table. The table is only computed
+*                   once, succeeding calls have no effect.
+********************************************************************************/
+void avr_decoder_init(void);
+
+/********************************************************************************
+* avr_decoder_decode: Returns the decode table entry for specified AVR
+*                     instruction word. Bit 23 downto 0 holds the instruction
+*                     in program memory format, bit 31 downto 24 holds the
+*                     decoder flags AVR_DECODER_RELATIVE, AVR_DECODER_TWO_WORDS
+*                     and AVR_DECODER_INVALID.
+*
+*                     - word: The AVR instruction word.
+********************************************************************************/
+uint32_t avr_decoder_decode(const uint16_t word);
+
+/********************************************************************************
+* avr_decoder_load: Decodes specified AVR instruction words and loads the
+*                   result into program memory. Instructions occupying two
+*                   words are stored at the address of the first word, while
+*                   the second word is replaced by NOP, so that all branch
+*                   targets are preserved. The NOP is never executed, since
+*                   the instruction continues after the second word. If the
+*                   image starts with a JMP, it is assumed to start with the
+*                   ATmega328P vector table, whose pin change and USART
+*                   vectors are moved to the vectors in cpu.h. Returns 0
+*                   after successful load or error code 1 if the program
+*                   doesn't fit in the program memory or its vector table
+*                   is incomplete.
+*
+*                   - words    : Reference to the AVR instruction words.
+*                   - num_words: The number of instruction words.
+********************************************************************************/
+int avr_decoder_load(const uint16_t* words,
+                     const size_t num_words);
+
+/********************************************************************************
+* avr_decoder_load_hex: Reads the Intel HEX file at specified path, decodes
+*                       its content and loads the result into program memory.
+*                       Returns 0 after successful load or error code 1 if
+*                       the file couldn't be read, contains invalid records
+*                       or doesn't fit in the program memory.
+*
+*                       - filepath: Path to the Intel HEX file.
+********************************************************************************/
+int avr_decoder_load_hex(const char* filepath);
+
+#endif /* AVR_DECODER_H_ */
@@ -0,0 +1,379 @@
+/********************************************************************************
+* breakpoint.c: Contains functionality for breakpoints on program memory
+*               addresses and watchpoints on data memory addresses.
+********************************************************************************/
+#include "breakpoint.h"
+#include "control_unit.h"
+
+/********************************************************************************
+* watchpoint: Watched data memory range with hit condition and hit counter.
+********************************************************************************/
+struct watchpoint
+{
+   bool active;                         /* Indicates if the watchpoint is used. */
+   uint16_t address;                    /* Start address of the watched range. */
+   uint16_t length;                     /* Number of watched bytes. */
+   enum watchpoint_access access;       /* The accesses that are watched. */
+   enum watchpoint_condition condition; /* The condition for a hit. */
+   uint8_t operand;                     /* Value or bit mask used by the condition. */
+   uint32_t ignore_count;               /* Number of hits to ignore before stopping. */
+   uint32_t hits;                       /* Number of hits. */
+};
+
+static CPU_THREAD_LOCAL uint8_t breakpoint_set[PROGRAM_MEMORY_ADDRESS_WIDTH / 8]; /* One bit per address. */
+static CPU_THREAD_LOCAL uint32_t original[PROGRAM_MEMORY_ADDRESS_WIDTH];          /* Replaced instructions. */
+static CPU_THREAD_LOCAL uint32_t ignore_counts[PROGRAM_MEMORY_ADDRESS_WIDTH];
+static CPU_THREAD_LOCAL uint32_t hits[PROGRAM_MEMORY_ADDRESS_WIDTH];
+static CPU_THREAD_LOCAL uint8_t step_over_address = 0x00;
+static CPU_THREAD_LOCAL bool step_over_enabled = false;
+
+static CPU_THREAD_LOCAL struct watchpoint watchpoints[BREAKPOINT_MAX_WATCHPOINTS];
+static CPU_THREAD_LOCAL struct breakpoint_stop last_stop;
+static CPU_THREAD_LOCAL bool stop_pending = false;
+
+static void on_data_memory_access(const uint16_t address,
+                                  const enum data_memory_access access,
+                                  const uint8_t old_value,
+                                  uint8_t* value);
+static bool watchpoint_condition_met(const struct watchpoint* self,
+                                     const enum data_memory_access access,
+                                     const uint8_t old_value,
+                                     const uint8_t value);
+static void update_monitoring(const uint16_t address,
+                              const uint16_t length);
+static void request_stop(const bool watchpoint,
+                         const enum watchpoint_access access,
+                         const uint16_t address);
+static inline bool breakpoint_exists(const uint8_t address);
+
+/********************************************************************************
+* breakpoint_insert: Inserts a breakpoint at specified program memory address.
+*                    Execution is stopped before the instruction at the
+*                    address once it has been reached more times than the
+*                    ignore count. Returns 0 after successful insertion or
+*                    error code 1 if a breakpoint already is set.
+*
+*                    - address     : Program memory address of the breakpoint.
+*                    - ignore_count: Number of hits to ignore before stopping.
+********************************************************************************/
+int breakpoint_insert(const uint8_t address,
+                      const uint32_t ignore_count)
+{
+   if (breakpoint_exists(address)) return 1;
+
+   original[address] = program_memory_replace(address, BREAK << 16);
+   ignore_counts[address] = ignore_count;
+   hits[address] = 0;
+   set(breakpoint_set[address / 8], address % 8);
+   return 0;
+}
+
+/********************************************************************************
+* breakpoint_remove: Removes the breakpoint at specified program memory
+*                    address. Returns 0 after successful removal or error
+*                    code 1 if no breakpoint is set at the address.
+*
+*                    - address: Program memory address of the breakpoint.
+********************************************************************************/
+int breakpoint_remove(const uint8_t address)
+{
+   if (!breakpoint_exists(address)) return 1;
+
+   if (program_memory_read(address) == (BREAK << 16))
+   {
+      program_memory_replace(address, original[address]);
+   }
+
+   clr(breakpoint_set[address / 8], address % 8);
+   return 0;
+}
+
+/********************************************************************************
+* breakpoint_hit_count: Returns the number of times the breakpoint at
+*                       specified address has been reached.
+*
+*                       - address: Program memory address of the breakpoint.
+********************************************************************************/
+uint32_t breakpoint_hit_count(const uint8_t address)
+{
+   return breakpoint_exists(address) ? hits[address] : 0;
+}
+
+/********************************************************************************
+* breakpoint_instruction: Returns the instruction at specified program memory
+*                         address as it was before any breakpoint was
+*                         inserted, i.e. the original instruction if a
+*                         breakpoint is set at the address.
+*
+*                         - address: Program memory address.
+********************************************************************************/
+uint32_t breakpoint_instruction(const uint8_t address)
+{
+   return breakpoint_exists(address) ? original[address] : program_memory_read(address);
+}
+
+/********************************************************************************
+* breakpoint_patch: Returns the instruction to store at specified program
+*                   memory address when it's patched with specified
+*                   instruction. If a breakpoint is set at the address, the
+*                   instruction replaces the original instruction, which is
+*                   run when the breakpoint is passed, and the breakpoint
+*                   itself is kept in program memory.
+*
+*                   - address    : Program memory address.
+*                   - instruction: The new instruction.
+********************************************************************************/
+uint32_t breakpoint_patch(const uint8_t address,
+                          const uint32_t instruction)
+{
+   if (!breakpoint_exists(address)) return instruction;
+   original[address] = instruction;
+   return BREAK << 16;
+}
+
+/********************************************************************************
+* breakpoint_step_over: Lets the breakpoint at specified address execute
+*                       the original instruction the next time it is
+*                       reached, without counting a hit. Used to resume
+*                       execution from a breakpoint.
+*
+*                       - address: Program memory address of the breakpoint.
+********************************************************************************/
+void breakpoint_step_over(const uint8_t address)
+{
+   step_over_address = address;
+   step_over_enabled = breakpoint_exists(address);
+   return;
+}
+
+/********************************************************************************
+* breakpoint_on_hit: Called by the control unit when a BREAK instruction is
+*                    executed. Returns true if execution should stop,
+*                    otherwise the original instruction at the address is
+*                    stored at referenced location to be executed instead.
+*
+*                    - address    : Program memory address of the breakpoint.
+*                    - instruction: Reference to the original instruction.
+********************************************************************************/
+bool breakpoint_on_hit(const uint8_t address,
+                       uint32_t* instruction)
+{
+   if (!breakpoint_exists(address))
+   {
+      *instruction = 0x00; /* Executed as NOP. */
+      return false;
+   }
+
+   *instruction = original[address];
+
+   if (step_over_enabled && step_over_address == address)
+   {
+      step_over_enabled = false;
+      return false;
+   }
+   else if (++hits[address] > ignore_counts[address])
+   {
+      request_stop(false, WATCHPOINT_ACCESS, address);
+      return true;
+   }
+   else
+   {
+      return false;
+   }
+}
+
+/********************************************************************************
+* watchpoint_insert: Inserts a watchpoint covering specified data memory
+*                    range. Execution is stopped after the instruction
+*                    performing a matching access, once the watchpoint has
+*                    been hit more times than the ignore count. Returns 0
+*                    after successful insertion or error code 1 if no more
+*                    watchpoints can be inserted or the range is invalid.
+*
+*                    - address     : Start address of the watched range.
+*                    - length      : Number of watched bytes.
+*                    - access      : The accesses that are watched.
+*                    - condition   : The condition for a hit.
+*                    - operand     : Value or bit mask used by the condition.
+*                    - ignore_count: Number of hits to ignore before stopping.
+********************************************************************************/
+int watchpoint_insert(const uint16_t address,
+                      const uint16_t length,
+                      const enum watchpoint_access access,
+                      const enum watchpoint_condition condition,
+                      const uint8_t operand,
+                      const uint32_t ignore_count)
+{
+   if (length == 0 || (uint32_t)address + length > DATA_MEMORY_ADDRESS_WIDTH) return 1;
+
+   for (struct watchpoint* i = watchpoints; i < watchpoints + BREAKPOINT_MAX_WATCHPOINTS; ++i)
+   {
+      if (!i->active)
+      {
+         i->active = true;
+         i->address = address;
+         i->length = length;
+         i->access = access;
+         i->condition = condition;
+         i->operand = operand;
+         i->ignore_count = ignore_count;
+         i->hits = 0;
+
+         data_memory_set_hook(DATA_MEMORY_HOOK_WATCH, on_data_memory_access);
+         update_monitoring(address, length);
+         return 0;
+      }
+   }
+   return 1;
+}
+
+/********************************************************************************
+* watchpoint_remove: Removes the watchpoint starting at specified data memory
+*                    address. Returns 0 after successful removal or error
+*                    code 1 if no such watchpoint exists.
+*
+*                    - address: Start address of the watched range.
+********************************************************************************/
+int watchpoint_remove(const uint16_t address)
+{
+   for (struct watchpoint* i = watchpoints; i < watchpoints + BREAKPOINT_MAX_WATCHPOINTS; ++i)
+   {
+      if (i->active && i->address == address)
+      {
+         i->active = false;
+         update_monitoring(i->address, i->length);
+         return 0;
+      }
+   }
+   return 1;
+}
+
+/********************************************************************************
+* watchpoint_hit_count: Returns the number of hits of the watchpoint starting
+*                       at specified data memory address.
+*
+*                       - address: Start address of the watched range.
+********************************************************************************/
+uint32_t watchpoint_hit_count(const uint16_t address)
+{
+   for (const struct watchpoint* i = watchpoints; i < watchpoints + BREAKPOINT_MAX_WATCHPOINTS; ++i)
+   {
+      if (i->active && i->address == address) return i->hits;
+   }
+   return 0;
+}
+
+/********************************************************************************
+* breakpoint_last_stop: Stores the reason for the last stop requested by
+*                       a breakpoint or watchpoint at referenced location.
+*                       Returns false if no stop has been requested since
+*                       the last call.
+*
+*                       - stop: Reference to the stop reason.
+********************************************************************************/
+bool breakpoint_last_stop(struct breakpoint_stop* stop)
+{
+   if (!stop_pending) return false;
+   *stop = last_stop;
+   stop_pending = false;
+   return true;
+}
+
+/********************************************************************************
+* breakpoint_clear_all: Removes all breakpoints and watchpoints.
+********************************************************************************/
+void breakpoint_clear_all(void)
+{
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      breakpoint_remove((uint8_t)i);
+   }
+
+   for (uint8_t i = 0; i < BREAKPOINT_MAX_WATCHPOINTS; ++i)
+   {
+      if (watchpoints[i].active) watchpoint_remove(watchpoints[i].address);
+   }
+
+   step_over_enabled = false;
+   stop_pending = false;
+   return;
+}
+
+static void on_data_memory_access(const uint16_t address,
+                                  const enum data_memory_access access,
+                                  const uint8_t old_value,
+                                  uint8_t* value)
+{
+   for (struct watchpoint* i = watchpoints; i < watchpoints + BREAKPOINT_MAX_WATCHPOINTS; ++i)
+   {
+      if (i->active && address >= i->address && address < i->address + i->length &&
+          watchpoint_condition_met(i, access, old_value, *value))
+      {
+         if (++i->hits > i->ignore_count)
+         {
+            request_stop(true, access == DATA_MEMORY_ACCESS_READ ? WATCHPOINT_READ : WATCHPOINT_WRITE, address);
+         }
+      }
+   }
+   return;
+}
+
+static bool watchpoint_condition_met(const struct watchpoint* self,
+                                     const enum data_memory_access access,
+                                     const uint8_t old_value,
+                                     const uint8_t value)
+{
+   if (self->access == WATCHPOINT_WRITE && access != DATA_MEMORY_ACCESS_WRITE) return false;
+   if (self->access == WATCHPOINT_READ && access != DATA_MEMORY_ACCESS_READ) return false;
+
+   if (self->condition == WATCHPOINT_VALUE_EQUALS)
+   {
+      return value == self->operand;
+   }
+   else if (self->condition == WATCHPOINT_BITS_CHANGE)
+   {
+      return access == DATA_MEMORY_ACCESS_WRITE && ((old_value ^ value) & self->operand);
+   }
+   else
+   {
+      return true;
+   }
+}
+
+static void update_monitoring(const uint16_t address,
+                              const uint16_t length)
+{
+   for (uint16_t i = address; i < address + length; ++i)
+   {
+      bool watched = false;
+
+      for (const struct watchpoint* j = watchpoints; j < watchpoints + BREAKPOINT_MAX_WATCHPOINTS; ++j)
+      {
+         if (j->active && i >= j->address && i < j->address + j->length)
+         {
+            watched = true;
+            break;
+         }
+      }
+
+      data_memory_monitor(DATA_MEMORY_HOOK_WATCH, i, watched);
+   }
+   return;
+}
+
+static void request_stop(const bool watchpoint,
+                         const enum watchpoint_access access,
+                         const uint16_t address)
+{
+   last_stop.watchpoint = watchpoint;
+   last_stop.access = access;
+   last_stop.address = address;
+   stop_pending = true;
+   control_unit_request_stop();
+   return;
+}
+
+static inline bool breakpoint_exists(const uint8_t address)
+{
+   return read(breakpoint_set[address / 8], address % 8);
+}
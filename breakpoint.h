@@ -0,0 +1,182 @@
+/********************************************************************************
+* breakpoint.h: Contains functionality for breakpoints on program memory
+*               addresses and watchpoints on data memory addresses.
+*
+*               Breakpoints are patched into program memory as BREAK
+*               instructions, while watchpoints are monitored through the
+*               page table of the data memory. Hence execution isn't slowed
+*               down at all when no breakpoints or watchpoints are set.
+*               Breakpoints and watchpoints are removed when a new program
+*               is loaded.
+********************************************************************************/
+#ifndef BREAKPOINT_H_
+#define BREAKPOINT_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "program_memory.h"
+#include "data_memory.h"
+
+#define BREAKPOINT_MAX_WATCHPOINTS 16 /* Maximum number of watchpoints. */
+
+/********************************************************************************
+* watchpoint_access: Enumeration for the accesses that trigger a watchpoint.
+********************************************************************************/
+enum watchpoint_access
+{
+   WATCHPOINT_WRITE, /* Triggered when the watched range is written. */
+   WATCHPOINT_READ,  /* Triggered when the watched range is read. */
+   WATCHPOINT_ACCESS /* Triggered when the watched range is read or written. */
+};
+
+/********************************************************************************
+* watchpoint_condition: Enumeration for conditions of watchpoint hits.
+********************************************************************************/
+enum watchpoint_condition
+{
+   WATCHPOINT_ANY,          /* Every access is a hit. */
+   WATCHPOINT_VALUE_EQUALS, /* Hit if the value read or written equals the operand. */
+   WATCHPOINT_BITS_CHANGE   /* Hit if a write changes any bit set in the operand. */
+};
+
+/********************************************************************************
+* breakpoint_stop: Reason for the last stop requested by the engine.
+********************************************************************************/
+struct breakpoint_stop
+{
+   bool watchpoint;                /* Indicates if a watchpoint caused the stop. */
+   enum watchpoint_access access;  /* Type of access, if a watchpoint caused the stop. */
+   uint16_t address;               /* Program or data memory address of the hit. */
+};
+
+/********************************************************************************
+* breakpoint_insert: Inserts a breakpoint at specified program memory address.
+*                    Execution is stopped before the instruction at the
+*                    address once it has been reached more times than the
+*                    ignore count. Returns 0 after successful insertion or
+*                    error code 1 if a breakpoint already is set.
+*
+*                    - address     : Program memory address of the breakpoint.
+*                    - ignore_count: Number of hits to ignore before stopping.
+********************************************************************************/
+int breakpoint_insert(const uint8_t address,
+                      const uint32_t ignore_count);
+
+/********************************************************************************
+* breakpoint_remove: Removes the breakpoint at specified program memory
+*                    address. Returns 0 after successful removal or error
+*                    code 1 if no breakpoint is set at the address.
+*
+*                    - address: Program memory address of the breakpoint.
+********************************************************************************/
+int breakpoint_remove(const uint8_t address);
+
+/********************************************************************************
+* breakpoint_hit_count: Returns the number of times the breakpoint at
+*                       specified address has been reached.
+*
+*                       - address: Program memory address of the breakpoint.
+********************************************************************************/
+uint32_t breakpoint_hit_count(const uint8_t address);
+
+/********************************************************************************
+* breakpoint_instruction: Returns the instruction at specified program memory
+*                         address as it was before any breakpoint was
+*                         inserted, i.e. the original instruction if a
+*                         breakpoint is set at the address.
+*
+*                         - address: Program memory address.
+********************************************************************************/
+uint32_t breakpoint_instruction(const uint8_t address);
+
+/********************************************************************************
+* breakpoint_patch: Returns the instruction to store at specified program
+*                   memory address when it's patched with specified
+*                   instruction. If a breakpoint is set at the address, the
+*                   instruction replaces the original instruction, which is
+*                   run when the breakpoint is passed, and the breakpoint
+*                   itself is kept in program memory.
+*
+*                   - address    : Program memory address.
+*                   - instruction: The new instruction.
+********************************************************************************/
+uint32_t breakpoint_patch(const uint8_t address,
+                          const uint32_t instruction);
+
+/********************************************************************************
+* breakpoint_step_over: Lets the breakpoint at specified address execute
+*                       the original instruction the next time it is
+*                       reached, without counting a hit. Used to resume
+*                       execution from a breakpoint.
+*
+*                       - address: Program memory address of the breakpoint.
+********************************************************************************/
+void breakpoint_step_over(const uint8_t address);
+
+/********************************************************************************
+* breakpoint_on_hit: Called by the control unit when a BREAK instruction is
+*                    executed. Returns true if execution should stop,
+*                    otherwise the original instruction at the address is
+*                    stored at referenced location to be executed instead.
+*
+*                    - address    : Program memory address of the breakpoint.
+*                    - instruction: Reference to the original instruction.
+********************************************************************************/
+bool breakpoint_on_hit(const uint8_t address,
+                       uint32_t* instruction);
+
+/********************************************************************************
+* watchpoint_insert: Inserts a watchpoint covering specified data memory
+*                    range. Execution is stopped after the instruction
+*                    performing a matching access, once the watchpoint has
+*                    been hit more times than the ignore count. Returns 0
+*                    after successful insertion or error code 1 if no more
+*                    watchpoints can be inserted or the range is invalid.
+*
+*                    - address     : Start address of the watched range.
+*                    - length      : Number of watched bytes.
+*                    - access      : The accesses that are watched.
+*                    - condition   : The condition for a hit.
+*                    - operand     : Value or bit mask used by the condition.
+*                    - ignore_count: Number of hits to ignore before stopping.
+********************************************************************************/
+int watchpoint_insert(const uint16_t address,
+                      const uint16_t length,
+                      const enum watchpoint_access access,
+                      const enum watchpoint_condition condition,
+                      const uint8_t operand,
+                      const uint32_t ignore_count);
+
+/********************************************************************************
+* watchpoint_remove: Removes the watchpoint starting at specified data memory
+*                    address. Returns 0 after successful removal or error
+*                    code 1 if no such watchpoint exists.
+*
+*                    - address: Start address of the watched range.
+********************************************************************************/
+int watchpoint_remove(const uint16_t address);
+
+/********************************************************************************
+* watchpoint_hit_count: Returns the number of hits of the watchpoint starting
+*                       at specified data memory address.
+*
+*                       - address: Start address of the watched range.
+********************************************************************************/
+uint32_t watchpoint_hit_count(const uint16_t address);
+
+/********************************************************************************
+* breakpoint_last_stop: Stores the reason for the last stop requested by
+*                       a breakpoint or watchpoint at referenced location.
+*                       Returns false if no stop has been requested since
+*                       the last call.
+*
+*                       - stop: Reference to the stop reason.
+********************************************************************************/
+bool breakpoint_last_stop(struct breakpoint_stop* stop);
+
+/********************************************************************************
+* breakpoint_clear_all: Removes all breakpoints and watchpoints.
+********************************************************************************/
+void breakpoint_clear_all(void);
+
+#endif /* BREAKPOINT_H_ */
\ No newline at end of file
@@ -0,0 +1,284 @@
+/********************************************************************************
+* context.c: Contains functionality for running many instances of the system
+*            on a few threads.
+********************************************************************************/
+#include <threads.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "context.h"
+
+#define CONTEXT_SIZE ((sizeof(struct context) + CONTEXT_ALIGNMENT - 1) / CONTEXT_ALIGNMENT * CONTEXT_ALIGNMENT)
+
+/********************************************************************************
+* slab: Header of a slab, followed by its contexts.
+********************************************************************************/
+struct slab
+{
+   struct slab* next; /* Next allocated slab. */
+   size_t size;       /* Size of the slab in bytes. */
+   bool huge_pages;   /* Indicates if the slab is backed by huge pages. */
+};
+
+/********************************************************************************
+* free_context: Free context, which stores the link to the next free context.
+********************************************************************************/
+struct free_context
+{
+   struct free_context* next; /* Next free context. */
+};
+
+#define SLAB_HEADER_SIZE ((sizeof(struct slab) + CONTEXT_ALIGNMENT - 1) / CONTEXT_ALIGNMENT * CONTEXT_ALIGNMENT)
+
+static struct slab* slabs = 0;
+static struct free_context* free_contexts = 0;
+static bool use_huge_pages = false;
+static uint32_t num_contexts = 0;
+static mtx_t lock;
+static once_flag lock_once = ONCE_FLAG_INIT;
+
+static void init_lock(void);
+static int add_slab(void);
+static void* map_slab(const size_t size,
+                      bool* huge_pages);
+static void unmap_slab(struct slab* self);
+
+/********************************************************************************
+* context_pool_open: Selects the pages backing slabs allocated from now on.
+*                    If huge pages are requested but not available, for
+*                    instance since none are reserved by the host, regular
+*                    pages are used instead and transparent huge pages are
+*                    requested where supported.
+*
+*                    - huge_pages: Indicates if slabs are backed by huge pages.
+********************************************************************************/
+void context_pool_open(const bool huge_pages)
+{
+   call_once(&lock_once, init_lock);
+   mtx_lock(&lock);
+   use_huge_pages = huge_pages;
+   mtx_unlock(&lock);
+   return;
+}
+
+/********************************************************************************
+* context_pool_close: Frees every slab of the pool. Every context must have
+*                     been destroyed before.
+********************************************************************************/
+void context_pool_close(void)
+{
+   call_once(&lock_once, init_lock);
+   mtx_lock(&lock);
+
+   while (slabs)
+   {
+      struct slab* next = slabs->next;
+      unmap_slab(slabs);
+      slabs = next;
+   }
+
+   free_contexts = 0;
+   num_contexts = 0;
+   mtx_unlock(&lock);
+   return;
+}
+
+/********************************************************************************
+* context_pool_stats: Stores the memory used by the pool at referenced
+*                     location.
+*
+*                     - stats: Reference to the statistics.
+********************************************************************************/
+void context_pool_stats(struct context_pool_stats* stats)
+{
+   call_once(&lock_once, init_lock);
+   mtx_lock(&lock);
+
+   stats->num_contexts = num_contexts;
+   stats->capacity = 0;
+   stats->num_slabs = 0;
+   stats->context_size = CONTEXT_SIZE;
+   stats->num_bytes = 0;
+   stats->huge_pages = slabs != 0;
+
+   for (const struct slab* i = slabs; i; i = i->next)
+   {
+      stats->capacity += (uint32_t)((i->size - SLAB_HEADER_SIZE) / CONTEXT_SIZE);
+      stats->num_slabs++;
+      stats->num_bytes += i->size;
+      if (!i->huge_pages) stats->huge_pages = false;
+   }
+
+   mtx_unlock(&lock);
+   return;
+}
+
+/********************************************************************************
+* context_create: Allocates a context from the pool, with the state of the
+*                 system after a reset and a reference to specified program
+*                 image. Returns a reference to the context or 0 if memory
+*                 ran out. Contexts can be created and destroyed by any
+*                 thread.
+*
+*                 - image: Reference to the program image of the instance.
+********************************************************************************/
+struct context* context_create(const struct program_image* image)
+{
+   struct context* self = 0;
+   call_once(&lock_once, init_lock);
+   mtx_lock(&lock);
+
+   if (free_contexts || !add_slab())
+   {
+      self = (struct context*)free_contexts;
+      free_contexts = free_contexts->next;
+      num_contexts++;
+   }
+
+   mtx_unlock(&lock);
+   if (!self) return 0;
+
+   control_unit_snapshot_reset(&self->state);
+   self->image = program_image_retain(image);
+   return self;
+}
+
+/********************************************************************************
+* context_destroy: Releases the program image of referenced context and
+*                  returns the context to the pool.
+*
+*                  - self: Reference to the context, or 0.
+********************************************************************************/
+void context_destroy(struct context* self)
+{
+   struct free_context* context = (struct free_context*)self;
+   if (!self) return;
+
+   program_image_release(self->image);
+   mtx_lock(&lock);
+   context->next = free_contexts;
+   free_contexts = context;
+   num_contexts--;
+   mtx_unlock(&lock);
+   return;
+}
+
+/********************************************************************************
+* context_enter: Restores referenced context to the instance of the system
+*                of the calling thread, which then runs it until the context
+*                is left. Hooks, breakpoints and coverage belong to the
+*                thread and aren't part of the context.
+*
+*                - self: Reference to the context.
+********************************************************************************/
+void context_enter(const struct context* self)
+{
+   if (program_memory_image() != self->image) program_memory_set_image(self->image);
+   control_unit_restore(&self->state);
+   return;
+}
+
+/********************************************************************************
+* context_leave: Stores the state of the instance of the system of the
+*                calling thread in referenced context, including the program
+*                image if it was changed while the context was entered.
+*
+*                - self: Reference to the context.
+********************************************************************************/
+void context_leave(struct context* self)
+{
+   const struct program_image* image = program_memory_image();
+
+   if (image != self->image)
+   {
+      program_image_release(self->image);
+      self->image = program_image_retain(image);
+   }
+
+   control_unit_snapshot(&self->state);
+   return;
+}
+
+static void init_lock(void)
+{
+   mtx_init(&lock, mtx_plain);
+   return;
+}
+
+/********************************************************************************
+* add_slab: Allocates a new slab and adds its contexts to the free contexts.
+*           Called with the lock held. Returns 0 after success or error
+*           code 1 if memory ran out.
+********************************************************************************/
+static int add_slab(void)
+{
+   bool huge_pages = use_huge_pages;
+   const size_t size = huge_pages ? CONTEXT_HUGE_SLAB_SIZE : CONTEXT_SLAB_SIZE;
+   struct slab* self = (struct slab*)map_slab(size, &huge_pages);
+   if (!self) return 1;
+
+   self->next = slabs;
+   self->size = size;
+   self->huge_pages = huge_pages;
+   slabs = self;
+
+   for (size_t i = (size - SLAB_HEADER_SIZE) / CONTEXT_SIZE; i > 0; --i)
+   {
+      struct free_context* context = (struct free_context*)((uint8_t*)self + SLAB_HEADER_SIZE + (i - 1) * CONTEXT_SIZE);
+      context->next = free_contexts;
+      free_contexts = context;
+   }
+   return 0;
+}
+
+static void* map_slab(const size_t size,
+                      bool* huge_pages)
+{
+   void* address = 0;
+#ifdef _WIN32
+   if (*huge_pages)
+   {
+      address = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+   }
+
+   if (!address)
+   {
+      *huge_pages = false;
+      address = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+   }
+#else
+#ifdef MAP_HUGETLB
+   if (*huge_pages)
+   {
+      address = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (address == MAP_FAILED) address = 0;
+   }
+#endif
+
+   if (!address)
+   {
+      address = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (address == MAP_FAILED) return 0;
+
+#ifdef MADV_HUGEPAGE
+      if (*huge_pages) madvise(address, size, MADV_HUGEPAGE); /* Transparent huge pages instead. */
+#endif
+      *huge_pages = false;
+   }
+#endif
+   return address;
+}
+
+static void unmap_slab(struct slab* self)
+{
+#ifdef _WIN32
+   VirtualFree(self, 0, MEM_RELEASE);
+#else
+   munmap(self, self->size);
+#endif
+   return;
+}
\ No newline at end of file
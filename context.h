@@ -0,0 +1,112 @@
+/********************************************************************************
+* context.h: Contains functionality for running many instances of the system
+*            on a few threads. Each instance is stored as a context holding
+*            only its mutable state, i.e. the registers, the data memory and
+*            the stack, together with a reference to its program image,
+*            which is shared by every instance running the same program.
+*
+*            Contexts are allocated from a pool of slabs, where every context
+*            is aligned to a cache line, so that contexts run on different
+*            threads never share a cache line. The slabs can be backed by
+*            huge pages, which saves TLB misses when hundreds of thousands of
+*            contexts are run. A context is run by entering it on a thread,
+*            which restores its state to the instance of the system of the
+*            thread, running the instance and leaving the context again.
+********************************************************************************/
+#ifndef CONTEXT_H_
+#define CONTEXT_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "control_unit.h"
+
+#define CONTEXT_ALIGNMENT      64                /* Alignment of contexts, the size of a cache line. */
+#define CONTEXT_SLAB_SIZE      (64 * 1024)       /* Bytes per slab of regular pages. */
+#define CONTEXT_HUGE_SLAB_SIZE (2 * 1024 * 1024) /* Bytes per slab of huge pages. */
+
+/********************************************************************************
+* context: Mutable state of an instance of the system.
+********************************************************************************/
+struct context
+{
+   struct control_unit_snapshot state; /* Registers, data memory, stack and the rest of the state. */
+   const struct program_image* image;  /* Shared program image. */
+};
+
+/********************************************************************************
+* context_pool_stats: Memory used by the pool of contexts.
+********************************************************************************/
+struct context_pool_stats
+{
+   uint32_t num_contexts; /* Number of contexts in use. */
+   uint32_t capacity;     /* Number of contexts that fit in the allocated slabs. */
+   uint32_t num_slabs;    /* Number of allocated slabs. */
+   size_t context_size;   /* Bytes per context, including the alignment. */
+   size_t num_bytes;      /* Bytes allocated for slabs. */
+   bool huge_pages;       /* Indicates if every slab is backed by huge pages. */
+};
+
+/********************************************************************************
+* context_pool_open: Selects the pages backing slabs allocated from now on.
+*                    If huge pages are requested but not available, for
+*                    instance since none are reserved by the host, regular
+*                    pages are used instead and transparent huge pages are
+*                    requested where supported.
+*
+*                    - huge_pages: Indicates if slabs are backed by huge pages.
+********************************************************************************/
+void context_pool_open(const bool huge_pages);
+
+/********************************************************************************
+* context_pool_close: Frees every slab of the pool. Every context must have
+*                     been destroyed before.
+********************************************************************************/
+void context_pool_close(void);
+
+/********************************************************************************
+* context_pool_stats: Stores the memory used by the pool at referenced
+*                     location.
+*
+*                     - stats: Reference to the statistics.
+********************************************************************************/
+void context_pool_stats(struct context_pool_stats* stats);
+
+/********************************************************************************
+* context_create: Allocates a context from the pool, with the state of the
+*                 system after a reset and a reference to specified program
+*                 image. Returns a reference to the context or 0 if memory
+*                 ran out. Contexts can be created and destroyed by any
+*                 thread.
+*
+*                 - image: Reference to the program image of the instance.
+********************************************************************************/
+struct context* context_create(const struct program_image* image);
+
+/********************************************************************************
+* context_destroy: Releases the program image of referenced context and
+*                  returns the context to the pool.
+*
+*                  - self: Reference to the context, or 0.
+********************************************************************************/
+void context_destroy(struct context* self);
+
+/********************************************************************************
+* context_enter: Restores referenced context to the instance of the system
+*                of the calling thread, which then runs it until the context
+*                is left. Hooks, breakpoints and coverage belong to the
+*                thread and aren't part of the context.
+*
+*                - self: Reference to the context.
+********************************************************************************/
+void context_enter(const struct context* self);
+
+/********************************************************************************
+* context_leave: Stores the state of the instance of the system of the
+*                calling thread in referenced context, including the program
+*                image if it was changed while the context was entered.
+*
+*                - self: Reference to the context.
+********************************************************************************/
+void context_leave(struct context* self);
+
+#endif /* CONTEXT_H_ */
\ No newline at end of file
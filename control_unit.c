@@ -1,507 +1,1916 @@
-#include "control_unit.h"
-#include "pci_regs.h"
-
-static inline void cpu_registers_reset(void);
-static inline bool equal(void);
-static inline bool greater(void);
-static inline bool lower(void);
-
-static inline bool interrupt_enabled(void);
-static inline void monitor_interrupts(void);
-static void generate_interrupt(const uint8_t interrupt_vector,
-                               const uint8_t flag_bit);
-static void return_from_interrupt(void);
-
-/* Static variables: */
-static uint32_t ir;    /* Instruction register, stores next instruction to execute. */
-static uint8_t pc;     /* Program counter, stores address to next instruction to fetch. */
-static uint8_t mar;    /* Memory address register, stores address for current instruction. */
-static uint8_t sr;     /* Status register, stores status bits INZVC. */
-
-static uint8_t op_code; /* Stores OP-code, for example LDI, OUT, JMP etc. */
-static uint8_t op1;     /* Stores first operand, most often a destination. */
-static uint8_t op2;     /* Stores second operand, most often a value or read address. */
-
-static uint8_t reg[CPU_REGISTER_ADDRESS_WIDTH]; /* CPU-registers R0 - R31. */
-static enum cpu_state state;                    /* Stores current state. */
-
-static uint8_t interrupt_source;                /* Vector fr interrupt source. */
-
-static struct pci_regs_vtable pci_regs_vtable =
-{
-   .interrupt_enabled = interrupt_enabled,
-   .generate_interrupt = generate_interrupt
-};
-
-static struct pci_regs pci_regs_b =
-{
-   .pin_reg = PINB,
-   .mask_reg = PCMSK0,
-   .flag_bit = PCIF0,
-   .interrupt_vector = PCINT0_vect,
-   .last_value = 0x00,
-   .vptr = &pci_regs_vtable
-};
-
-static struct pci_regs pci_regs_c =
-{
-   .pin_reg = PINC,
-   .mask_reg = PCMSK1,
-   .flag_bit = PCIF1,
-   .interrupt_vector = PCINT1_vect,
-   .last_value = 0x00,
-   .vptr = &pci_regs_vtable
-};
-
-static struct pci_regs pci_regs_d =
-{
-   .pin_reg = PIND,
-   .mask_reg = PCMSK2,
-   .flag_bit = PCIF2,
-   .interrupt_vector = PCINT2_vect,
-   .last_value = 0x00,
-   .vptr = &pci_regs_vtable
-};
-
-/********************************************************************************
-* control_unit_reset: Resets control unit and corresponding program.
-********************************************************************************/
-void control_unit_reset(void)
-{
-   ir = 0x00;
-   pc = 0x00;
-   mar = 0x00;
-   sr = 0x00;
-
-   op_code = 0x00;
-   op1 = 0x00;
-   op2 = 0x00;
-   state = CPU_STATE_FETCH;
-   interrupt_source = RESET_vect;
-
-   pci_regs_b.last_value = 0x00;
-   pci_regs_c.last_value = 0x00;
-   pci_regs_d.last_value = 0x00;
-
-   cpu_registers_reset();
-   program_memory_write();
-   data_memory_reset();
-   stack_reset();
-   return;
-}
-
-/********************************************************************************
-* control_unit_run_next_state: Runs next state in the CPU instruction cycle.
-********************************************************************************/
-void control_unit_run_next_state(void)
-{
-   switch (state)
-   {
-      case CPU_STATE_FETCH:
-      {
-         ir = program_memory_read(pc); /* Fetches next instruction. */
-         mar = pc;                     /* Stores address of current instruction. */
-         pc++;                         /* Program counter points to next instruction. */
-         state = CPU_STATE_DECODE;     /* Decodes the instruction during next clock cycle. */
-         break;
-      }
-      case CPU_STATE_DECODE:
-      {
-         op_code = ir >> 16;           /* Bit 23 downto 16 consist of the OP code. */
-         op1 = ir >> 8;                /* Bit 15 downto 8 consists of the first operand. */
-         op2 = ir;                     /* Bit 7 downto 0 constist of the second operand. */
-         state = CPU_STATE_EXECUTE;    /* Executes the instruction during next clock cycle. */
-         break;
-      }
-      case CPU_STATE_EXECUTE:
-      {
-         switch (op_code)              /* Executes specified operation. */
-         {
-            case NOP:
-            {
-               break;
-            }
-            case LDI:
-            {
-               reg[op1] = op2;
-               break;
-            }
-            case MOV:
-            {
-               reg[op1] = reg[op2];
-               break;
-            }
-            case OUT:
-            {
-               data_memory_write(op1, reg[op2]);
-               break;
-            }
-            case IN: 
-            {
-               reg[op1] = data_memory_read(op2);
-               break;
-            }
-            case STS:
-            {
-               data_memory_write(op1, reg[op2]);
-
-               if (op2 < DATA_MEMORY_DATA_WIDTH - 1)
-               {
-                  data_memory_write(op1 + 1, reg[op2 + 1]);
-               }
-               break;
-            }
-            case LDS:
-            {
-               reg[op1] = data_memory_read(op2);
-               
-               if (op1 < CPU_REGISTER_ADDRESS_WIDTH - 1)
-               {
-                  reg[op1 + 1] = data_memory_read(op2 + 1);
-               }
-
-               break;
-            }
-            case CLR:
-            {
-               reg[op1] = 0x00;
-               break;
-            }
-            case ORI:
-            {
-               reg[op1] = alu(op_code, reg[op1], op2, &sr);
-               break;
-            }
-            case ANDI:
-            {
-               reg[op1] = alu(op_code, reg[op1], op2, &sr);
-               break;
-            }
-            case XORI:
-            {
-               reg[op1] = alu(op_code, reg[op1], op2, &sr);
-               break;
-            }
-            case OR:
-            {
-               reg[op1] = alu(op_code, reg[op1], reg[op2], &sr);
-               break;
-            }
-            case AND:
-            {
-               reg[op1] = alu(op_code, reg[op1], reg[op2], &sr);
-               break;
-            }
-            case XOR:
-            {
-               reg[op1] = alu(op_code, reg[op1], reg[op2], &sr);
-               break;
-            }
-            case ADDI:
-            {
-               reg[op1] = alu(op_code, reg[op1], op2, &sr);
-               break;
-            }
-            case SUBI:
-            {
-               reg[op1] = alu(op_code, reg[op1], op2, &sr);
-               break;
-            }
-            case ADD:
-            {
-               reg[op1] = alu(op_code, reg[op1], reg[op2], &sr);
-               break;
-            }
-            case SUB:
-            {
-               reg[op1] = alu(op_code, reg[op1], reg[op2], &sr);
-               break;
-            }
-            case INC:
-            {
-               reg[op1] = alu(op_code, reg[op1], 0x00, &sr);
-               break;
-            }
-            case DEC:
-            {
-               reg[op1] = alu(op_code, reg[op1], 0x00, &sr);
-               break;
-            }
-            case LSL:
-            {
-               reg[op1] = alu(op_code, reg[op1], 0x00, &sr);
-               break;
-            }
-            case LSR:
-            {
-               reg[op1] = alu(op_code, reg[op1], 0x00, &sr);
-               break;
-            }
-            case CPI:
-            {
-               alu_compare(reg[op1], op2, &sr);
-               break;
-            }
-            case CP:
-            {
-               alu_compare(reg[op1], reg[op2], &sr);
-               break;
-            }
-            case JMP:
-            {
-               pc = op1;
-               break;
-            }
-            case BREQ:
-            {
-               if (equal()) 
-               {
-                  pc = op1;
-               }
-               break;
-            }
-            case BRNE:
-            {
-               if (!equal())
-               {
-                  pc = op1;
-               }
-               break;
-            }
-            case BRGE:
-            {
-               if (greater() || (equal()))
-               {
-                  pc = op1;
-               }
-               break;
-            }
-            case BRGT:
-            {
-               if (greater())
-               {
-                  pc = op1;
-               }
-               break;
-            }
-            case BRLE:
-            {
-               if (lower() || (equal()))
-               {
-                  pc = op1;
-               }
-               break;
-            }
-            case BRLT:
-            {
-               if (lower())
-               {
-                  pc = op1;
-               }
-               break;
-            }
-            case CALL:
-            {
-               stack_push(pc);
-               pc = op1;
-               break;
-            }
-            case RET:
-            {
-               stack_pop(&pc);
-               break;
-            }
-            case RETI:
-            {
-               return_from_interrupt();
-               break;
-            }
-            case PUSH:
-            {
-               stack_push(reg[op1]);
-               break;
-            }
-            case POP:
-            {
-               stack_pop(&reg[op1]);
-               break;
-            }
-            case SEI:
-            {
-               set(sr, I);
-               break;
-            }
-            case CLI:
-            {
-               clr(sr, 4);
-               break;
-            }
-            default:
-            {
-               control_unit_reset();
-               break;
-            }
-         }
-
-         state = CPU_STATE_FETCH;      /* Fetches next instruction during next clock cycle. */
-         break;
-      }
-      default:
-      {
-         control_unit_reset();         /* System reset if error occurs. */
-         break;
-      }
-   }
-
-   monitor_interrupts();               /* Monitors interrupts during every clock cycle. */
-   return;
-}
-
-/********************************************************************************
-* control_unit_run_next_state: Runs next CPU instruction cycle, i.e. fetches
-*                              a new instruction from program memory, decodes
-*                              and executes it.
-********************************************************************************/
-void control_unit_run_next_instruction_cycle(void)
-{
-   do
-   {
-      control_unit_run_next_state();
-   } while (state != CPU_STATE_EXECUTE);
-   return;
-}
-
-/********************************************************************************
-* control_unit_print: Prints information about the processor, for instance
-*                     current subroutine, instruction, state, content in
-*                     CPU-registers and I/O registers DDRB, PORTB and PINB.
-********************************************************************************/
-void control_unit_print(void)
-{
-   printf("--------------------------------------------------------------------------------\n");
-   printf("Current subroutine:\t\t\t\t%s\n", program_memory_subroutine_name(mar));
-   printf("Current instruction:\t\t\t\t%s\n", cpu_instruction_name(op_code));
-   printf("Current state:\t\t\t\t\t%s\n", cpu_state_name(state));
-   
-   printf("Program counter:\t\t\t\t%hu\n", pc);
-
-   printf("Instruction register:\t\t\t\t%s ", get_binary((ir >> 16) & 0xFF, 8));
-   printf("%s ", get_binary((ir >> 8) & (0xFF), 8));
-   printf("%s\n", get_binary(ir & 0xFF, 8));
-
-   printf("Status register (INZVC):\t\t\t%s\n\n", get_binary(sr, 5));
-
-   printf("Content in CPU register R16:\t\t\t%s\n", get_binary(reg[R16], 8));
-   printf("Content in CPU register R24:\t\t\t%s\n\n", get_binary(reg[R24], 8));
-
-   printf("Content in data direction register DDRB:\t%s\n", get_binary(data_memory_read(DDRB), 8));
-   printf("Content in data register PORTB:\t\t\t%s\n", get_binary(data_memory_read(PORTB), 8));
-   printf("Content in pin input register PINB:\t\t%s\n", get_binary(data_memory_read(PINB), 8));
-
-   printf("--------------------------------------------------------------------------------\n\n");
-   return;
-}
-
-static inline void cpu_registers_reset(void)
-{
-   for (uint8_t* i = reg; i < reg + CPU_REGISTER_ADDRESS_WIDTH; ++i)
-   {
-      *i = 0x00;
-   }
-   return;
-}
-
-static inline bool interrupt_enabled(void)
-{
-   return read(sr, I);
-}
-
-static inline bool equal(void)
-{
-   return read(sr, Z);
-}
-
-static inline bool greater(void)
-{
-   return (!equal() && !lower());
-}
-
-static inline bool lower(void)
-{
-   return read(sr, N);
-}
-
-static inline void monitor_interrupts(void)
-{
-   pci_regs_monitor_pci_interrupt_on_io_port(&pci_regs_b);
-   pci_regs_monitor_pci_interrupt_on_io_port(&pci_regs_c);
-   pci_regs_monitor_pci_interrupt_on_io_port(&pci_regs_d);
-   return;
-}
-
-static void generate_interrupt(const uint8_t interrupt_vector, 
-                               const uint8_t flag_bit)
-{
-   clr(sr, I);
-
-   stack_push(pc);
-   stack_push(mar);
-   stack_push(sr);
-
-   stack_push(ir << 16);
-   stack_push(ir << 8);
-   stack_push(ir);
-
-   stack_push(op_code);
-   stack_push(op1);
-   stack_push(op2);
-
-   stack_push(state);
-   stack_push(flag_bit);
-
-   for (uint8_t i = 0; i < CPU_REGISTER_DATA_WIDTH; ++i)
-   {
-      stack_push(reg[i]);
-   }
-
-   pc = interrupt_vector;
-   return;
-}
-
-static void return_from_interrupt(void)
-{
-   uint8_t flag_bit = 0x00;
-   uint8_t interrupt_vector = 0x00;
-   uint8_t temp = 0x00;
-
-   for (uint8_t i = CPU_REGISTER_DATA_WIDTH; i > 0; --i)
-   {
-      stack_pop(&reg[i - 1]);
-   }
-
-   stack_pop(&flag_bit);
-   stack_pop(&temp);
-   state = (enum cpu_state)(temp);
-
-   stack_pop(&op2);
-   stack_pop(&op1);
-   stack_pop(&op_code);
-
-   stack_pop(&temp);
-   ir = temp;
-   stack_pop(&temp);
-   ir |= temp << 8;
-   stack_pop(&temp);
-   ir |= temp << 16;
-
-   stack_pop(&sr);
-   stack_pop(&mar);
-   stack_pop(&pc);
-
-   temp = data_memory_read(PCIFR);
-   clr(temp, flag_bit);
-   data_memory_write(PCIFR, temp);
-
-   set(sr, I);
-   return;
-}
+#include <string.h>
+#include "control_unit.h"
+#include "pci_regs.h"
+
+struct decoded_instruction;
+
+static void execute(void);
+static inline void system_reset(void);
+static inline void decode(void);
+static inline void cpu_registers_reset(void);
+static inline bool equal(void);
+static inline bool greater(void);
+static inline bool lower(void);
+static inline bool signed_lower(void);
+static inline void branch(const bool taken);
+static inline uint16_t register_pair_read(const uint8_t low);
+static inline void register_pair_write(const uint8_t low,
+                                       const uint16_t value);
+
+static bool update_decoded_instructions(void);
+static void decode_image(const struct program_image* image,
+                         const uint8_t first,
+                         const uint16_t count);
+static uint8_t find_superinstruction(const uint8_t address);
+static void find_dead_flags(const uint8_t address,
+                            const struct program_analysis* analysis);
+static uint8_t flags_written(const uint8_t op_code);
+static void execute_without_flags(void);
+static inline bool writes_no_pin(const struct decoded_instruction* out);
+static uint32_t execute_superinstruction(const struct decoded_instruction* first);
+static inline void set_current_instruction(const struct decoded_instruction* self,
+                                           const uint8_t address);
+static inline bool pin_change_detected(void);
+static bool leave_translation(void);
+static void update_translated_blocks(const uint8_t first,
+                                     const uint16_t count);
+static void run_events(void);
+static void update_next_event(void);
+static bool switch_reached(const struct control_unit_switch* at);
+
+static inline bool interrupt_enabled(void);
+static inline void monitor_interrupts(void);
+static inline void monitor_port(struct pci_regs* port);
+static void generate_interrupt(const uint8_t interrupt_vector,
+                               const uint8_t flag_bit);
+static void return_from_interrupt(void);
+static CPU_COLD void notify_transfer(const enum control_unit_transfer transfer,
+                                     const uint8_t from,
+                                     const uint8_t to);
+
+/* Static variables: */
+static CPU_THREAD_LOCAL uint32_t ir;    /* Instruction register, stores next instruction to execute. */
+static CPU_THREAD_LOCAL uint8_t pc;     /* Program counter, stores address to next instruction to fetch. */
+static CPU_THREAD_LOCAL uint8_t mar;    /* Memory address register, stores address for current instruction. */
+static CPU_THREAD_LOCAL uint8_t sr;     /* Status register, stores status bits INZVC. */
+
+static CPU_THREAD_LOCAL uint8_t op_code; /* Stores OP-code, for example LDI, OUT, JMP etc. */
+static CPU_THREAD_LOCAL uint8_t op1;     /* Stores first operand, most often a destination. */
+static CPU_THREAD_LOCAL uint8_t op2;     /* Stores second operand, most often a value or read address. */
+
+static CPU_THREAD_LOCAL uint8_t reg[CPU_REGISTER_ADDRESS_WIDTH]; /* CPU-registers R0 - R31. */
+static CPU_THREAD_LOCAL enum cpu_state state;                    /* Stores current state. */
+
+static CPU_THREAD_LOCAL bool stop_requested;                     /* Stops instructions run in a batch. */
+static CPU_THREAD_LOCAL bool run_stopped;                        /* Stops control_unit_run_until. */
+static CPU_THREAD_LOCAL uint8_t interrupt_source;                /* Vector fr interrupt source. */
+static CPU_THREAD_LOCAL uint64_t cycles;                         /* Number of states run since reset. */
+static CPU_THREAD_LOCAL control_unit_hook periodic_hooks[CONTROL_UNIT_NUM_HOOKS]; /* Hooks called periodically. */
+static CPU_THREAD_LOCAL uint64_t periodic_intervals[CONTROL_UNIT_NUM_HOOKS];     /* Cycles between calls of each hook. */
+static CPU_THREAD_LOCAL uint64_t periodic_deadlines[CONTROL_UNIT_NUM_HOOKS];     /* Cycle of the next call of each hook. */
+static CPU_THREAD_LOCAL uint8_t requested_interrupts;            /* Bit n is set if vector 2n is requested. */
+static CPU_THREAD_LOCAL uint64_t next_event = UINT64_MAX;        /* Cycle of the next hook or request. */
+static CPU_THREAD_LOCAL struct coverage_map coverage;            /* Instructions run and branch directions. */
+static CPU_THREAD_LOCAL control_unit_transfer_hook transfer_hook = 0; /* Hook called at transfers of control. */
+static CPU_THREAD_LOCAL const struct translator_module* translation = 0; /* Translated program, see translator. */
+static CPU_THREAD_LOCAL struct translator_context translator_context;  /* State passed to translated code. */
+
+#define NO_FLAG_BIT 8 /* Flag bit outside PCIFR, for interrupts without a pin change flag. */
+
+/********************************************************************************
+* superinstruction: Enumeration for common instruction sequences, which the
+*                   fast execution engine runs as a single instruction.
+********************************************************************************/
+enum superinstruction
+{
+   SUPERINSTRUCTION_NONE,       /* No sequence starts at the address. */
+   SUPERINSTRUCTION_LDI_OUT,    /* LDI followed by OUT. */
+   SUPERINSTRUCTION_CPI_BREQ,   /* CPI followed by BREQ. */
+   SUPERINSTRUCTION_IN_ORI_OUT, /* IN followed by ORI and OUT. */
+   SUPERINSTRUCTION_LDS_CPI     /* LDS followed by CPI. */
+};
+
+/********************************************************************************
+* decoded_instruction: Instruction in program memory split into OP code and
+*                      operands, cached by the fast execution engine.
+********************************************************************************/
+struct decoded_instruction
+{
+   uint32_t ir;     /* The instruction as stored in program memory. */
+   uint8_t op_code; /* OP code of the instruction. */
+   uint8_t op1;     /* First operand of the instruction. */
+   uint8_t op2;     /* Second operand of the instruction. */
+   uint8_t fused;   /* Superinstruction starting at the instruction. */
+   uint8_t length;  /* Number of instructions in the superinstruction. */
+   bool dead_flags; /* Indicates if the flags written by the instruction are dead. */
+   uint8_t window;  /* Number of instructions run before the flags are overwritten. */
+};
+
+static CPU_THREAD_LOCAL struct decoded_instruction* decoded;          /* Attached to the program image. */
+static CPU_THREAD_LOCAL const struct program_image* decoded_image = 0; /* Image referenced by the cache. */
+static CPU_THREAD_LOCAL uint32_t decoded_generation; /* Program memory generation of the cache. */
+static CPU_THREAD_LOCAL bool decoded_valid = false;
+static CPU_THREAD_LOCAL bool translated[PROGRAM_MEMORY_ADDRESS_WIDTH]; /* Set where a matching block starts. */
+
+static CPU_THREAD_LOCAL struct pci_regs pci_regs_b =
+{
+   .pin_reg = PINB,
+   .mask_reg = PCMSK0,
+   .enable_bit = PCIE0,
+   .flag_bit = PCIF0,
+   .interrupt_vector = PCINT0_vect,
+   .last_value = 0x00
+};
+
+static CPU_THREAD_LOCAL struct pci_regs pci_regs_c =
+{
+   .pin_reg = PINC,
+   .mask_reg = PCMSK1,
+   .enable_bit = PCIE1,
+   .flag_bit = PCIF1,
+   .interrupt_vector = PCINT1_vect,
+   .last_value = 0x00
+};
+
+static CPU_THREAD_LOCAL struct pci_regs pci_regs_d =
+{
+   .pin_reg = PIND,
+   .mask_reg = PCMSK2,
+   .enable_bit = PCIE2,
+   .flag_bit = PCIF2,
+   .interrupt_vector = PCINT2_vect,
+   .last_value = 0x00
+};
+
+/********************************************************************************
+* control_unit_reset: Resets control unit and corresponding program.
+********************************************************************************/
+void control_unit_reset(void)
+{
+   ir = 0x00;
+   pc = 0x00;
+   mar = 0x00;
+   sr = 0x00;
+
+   op_code = 0x00;
+   op1 = 0x00;
+   op2 = 0x00;
+   state = CPU_STATE_FETCH;
+   stop_requested = false;
+   interrupt_source = RESET_vect;
+   cycles = 0;
+   requested_interrupts = 0x00;
+
+   pci_regs_b.last_value = 0x00;
+   pci_regs_c.last_value = 0x00;
+   pci_regs_d.last_value = 0x00;
+
+   cpu_registers_reset();
+   program_memory_write();
+   data_memory_reset();
+   stack_reset();
+
+   for (uint8_t i = 0; i < CONTROL_UNIT_NUM_HOOKS; ++i)
+   {
+      periodic_deadlines[i] = periodic_intervals[i];
+   }
+   update_next_event();
+   return;
+}
+
+/********************************************************************************
+* control_unit_release: Releases the program image stored in program memory
+*                       and the decoded instructions shared with it, which
+*                       the calling thread otherwise references until the
+*                       next program is stored. Called by threads running
+*                       their own instance of the system before they exit.
+********************************************************************************/
+void control_unit_release(void)
+{
+   program_image_release(decoded_image);
+   decoded_image = 0;
+   decoded = 0;
+   decoded_valid = false;
+   program_memory_release();
+   return;
+}
+
+/********************************************************************************
+* control_unit_run_next_state: Runs next state in the CPU instruction cycle.
+********************************************************************************/
+void control_unit_run_next_state(void)
+{
+   cycles++;
+
+   switch (state)
+   {
+      case CPU_STATE_FETCH:
+      {
+         ir = program_memory_read(pc); /* Fetches next instruction. */
+         mar = pc;                     /* Stores address of current instruction. */
+         coverage.executed[mar] = 1;
+         pc++;                         /* Program counter points to next instruction. */
+         state = CPU_STATE_DECODE;     /* Decodes the instruction during next clock cycle. */
+         break;
+      }
+      case CPU_STATE_DECODE:
+      {
+         decode();                     /* Splits the instruction into OP code and operands. */
+         state = CPU_STATE_EXECUTE;    /* Executes the instruction during next clock cycle. */
+         break;
+      }
+      case CPU_STATE_EXECUTE:
+      {
+         execute();                    /* Executes specified operation. */
+
+         state = CPU_STATE_FETCH;      /* Fetches next instruction during next clock cycle. */
+         break;
+      }
+      default:
+      {
+         system_reset();               /* System reset if error occurs. */
+         break;
+      }
+   }
+
+   monitor_interrupts();               /* Monitors interrupts during every clock cycle. */
+   if (cycles >= next_event) run_events();
+   return;
+}
+
+/********************************************************************************
+* control_unit_run_next_state: Runs next CPU instruction cycle, i.e. fetches
+*                              a new instruction from program memory, decodes
+*                              and executes it.
+********************************************************************************/
+void control_unit_run_next_instruction_cycle(void)
+{
+   do
+   {
+      control_unit_run_next_state();
+   } while (state != CPU_STATE_EXECUTE);
+   return;
+}
+
+/********************************************************************************
+* control_unit_run_next_instruction: Runs the remaining states of the current
+*                                    instruction, so that the control unit
+*                                    stops at an instruction boundary, where
+*                                    the next state fetches a new instruction.
+*                                    If the control unit already is at an
+*                                    instruction boundary, one whole
+*                                    instruction is executed.
+********************************************************************************/
+void control_unit_run_next_instruction(void)
+{
+   do
+   {
+      control_unit_run_next_state();
+   } while (state != CPU_STATE_FETCH);
+   return;
+}
+
+/********************************************************************************
+* control_unit_run: Runs specified number of instructions from the current
+*                   instruction boundary and returns the number of executed
+*                   instructions. The execution is stopped in advance if a
+*                   stop is requested, for instance by a breakpoint.
+*
+*                   - num_instructions: The number of instructions to run.
+********************************************************************************/
+uint32_t control_unit_run(const uint32_t num_instructions)
+{
+   uint32_t num_executed = 0;
+   stop_requested = false;
+
+   while (num_executed < num_instructions && !stop_requested)
+   {
+      control_unit_run_next_instruction();
+      num_executed++;
+   }
+   return num_executed;
+}
+
+/********************************************************************************
+* control_unit_run_fast: Runs specified number of instructions like
+*                        control_unit_run, but without stepping through the
+*                        states one by one. Instructions are decoded once
+*                        and cached until the program memory is changed,
+*                        and pin change interrupts are only monitored in
+*                        full when a pin input register differs from its
+*                        last value. The architectural state, including
+*                        the state stored on the stack at interrupts, is
+*                        the same as after control_unit_run.
+*
+*                        Common instruction sequences, such as LDI followed
+*                        by OUT, are run as superinstructions. Since no
+*                        instruction in a superinstruction writes a pin
+*                        input register, no interrupt can be accepted
+*                        inside it, so the sequences are only run as
+*                        superinstructions when no pin change is pending.
+*
+*                        ALU instructions whose flags are dead according to
+*                        program_analysis skip the flag update, but only if
+*                        the flags are overwritten by the next few register
+*                        instructions in the same batch, since the status
+*                        register is stored on the stack at interrupts and
+*                        may be read after a batch.
+*
+*                        If a translated program is set, blocks of it that
+*                        start at the program counter are run as native
+*                        code whenever no pin change is pending, see
+*                        translator.
+*
+*                        - num_instructions: The number of instructions to run.
+********************************************************************************/
+uint32_t control_unit_run_fast(const uint32_t num_instructions)
+{
+   uint32_t num_executed = 0;
+   stop_requested = false;
+
+   if (state != CPU_STATE_FETCH && num_instructions)
+   {
+      control_unit_run_next_instruction();
+      num_executed++;
+   }
+
+   if (!update_decoded_instructions())
+   {
+      return num_executed + control_unit_run(num_instructions - num_executed);
+   }
+
+   while (num_executed < num_instructions && !stop_requested)
+   {
+      const struct decoded_instruction* instruction = &decoded[pc];
+
+      if (translated[pc] && !pin_change_detected())
+      {
+         const uint32_t n = translation->run(&translator_context, num_instructions - num_executed);
+
+         if (n)
+         {
+            num_executed += n;
+            set_current_instruction(&decoded[mar], mar);
+            if (pin_change_detected()) monitor_interrupts();
+            if (cycles >= next_event) run_events();
+            continue;
+         }
+      }
+
+      if (instruction->fused && num_instructions - num_executed >= instruction->length &&
+          cycles + 3 * instruction->length < next_event && !pin_change_detected())
+      {
+         num_executed += execute_superinstruction(instruction);
+         if (cycles >= next_event) run_events();
+         continue;
+      }
+
+      ir = instruction->ir;
+      mar = pc++;
+      coverage.executed[mar] = 1;
+      state = CPU_STATE_DECODE;
+      if (pin_change_detected()) monitor_interrupts();
+
+      op_code = instruction->op_code;
+      op1 = instruction->op1;
+      op2 = instruction->op2;
+      state = CPU_STATE_EXECUTE;          /* No pin can change while decoding. */
+      cycles += 3;
+
+      if (instruction->dead_flags && num_instructions - num_executed > instruction->window &&
+          cycles + 3 * instruction->window < next_event) /* No interrupt can see the flags. */
+      {
+         execute_without_flags();
+      }
+      else
+      {
+         execute();
+      }
+      state = CPU_STATE_FETCH;
+      if (pin_change_detected()) monitor_interrupts();
+      if (cycles >= next_event) run_events(); /* Like the last state of control_unit_run. */
+      num_executed++;
+   }
+   return num_executed;
+}
+
+/********************************************************************************
+* control_unit_run_until: Runs until specified number of clock cycles have
+*                         been run since last reset. Whole instructions are
+*                         run in batches by the fast engine, while remaining
+*                         states of a started instruction are run one by one.
+*                         Returns true if the cycle was reached, or false if
+*                         the run was stopped in advance by a stop request,
+*                         for instance by a breakpoint, in which case the
+*                         caller must not run again as if nothing happened.
+*
+*                         - cycle: The clock cycle to stop at.
+********************************************************************************/
+bool control_unit_run_until(const uint64_t cycle)
+{
+   run_stopped = false;
+
+   while (cycles < cycle && state != CPU_STATE_FETCH && !run_stopped)
+   {
+      control_unit_run_next_state();
+   }
+
+   while (cycles + 3 <= cycle && !run_stopped)
+   {
+      const uint64_t num_instructions = (cycle - cycles) / 3;
+      control_unit_run_fast(num_instructions < CONTROL_UNIT_BATCH_SIZE ? (uint32_t)num_instructions : CONTROL_UNIT_BATCH_SIZE);
+   }
+
+   while (cycles < cycle && !run_stopped)
+   {
+      control_unit_run_next_state();
+   }
+   return !run_stopped;
+}
+
+/********************************************************************************
+* control_unit_run_functional: Runs whole instructions by the fast engine,
+*                              without stepping through the states, until
+*                              specified switch point is reached and returns
+*                              true, so that control_unit_run_next_state can
+*                              continue from the switch point.
+*                              At the switch point, the instruction register,
+*                              memory address register, OP code, operands
+*                              and state are the same as if every state had
+*                              been run one by one.
+*
+*                              An address or condition is checked before
+*                              every instruction, including the first, so
+*                              the run stops at an instruction boundary.
+*                              Instructions are then run one at a time by
+*                              the fast engine, while a run to a cycle only
+*                              is run in batches. A cycle within an
+*                              instruction is reached by running the states
+*                              of the instruction one by one up to it. A run
+*                              continues from the detailed mode at any
+*                              state, i.e. the mode can be switched back and
+*                              forth. Returns false if specified number of
+*                              instructions has been run without reaching
+*                              the switch point, or if a stop is requested,
+*                              for instance by a breakpoint.
+*
+*                              - at              : Reference to the switch point.
+*                              - num_instructions: The maximum number of instructions to run.
+********************************************************************************/
+bool control_unit_run_functional(const struct control_unit_switch* at,
+                                 const uint32_t num_instructions)
+{
+   uint32_t num_executed = 0;
+   bool reached = false;
+   stop_requested = false;
+
+   while (state != CPU_STATE_FETCH && cycles < at->cycle)
+   {
+      control_unit_run_next_state();
+   }
+
+   if (state != CPU_STATE_FETCH) return true;
+
+   while (!(reached = switch_reached(at)) && cycles + 3 <= at->cycle &&
+          num_executed < num_instructions && !stop_requested)
+   {
+      uint64_t batch = 1;
+
+      if (at->address < 0 && !at->condition) /* No instruction boundary has to be checked. */
+      {
+         batch = (at->cycle - cycles) / 3;
+         if (batch > num_instructions - num_executed) batch = num_instructions - num_executed;
+         if (batch > CONTROL_UNIT_BATCH_SIZE) batch = CONTROL_UNIT_BATCH_SIZE;
+      }
+
+      num_executed += control_unit_run_fast((uint32_t)batch);
+   }
+
+   if (reached || stop_requested || num_executed == num_instructions) return reached;
+
+   while (cycles < at->cycle) /* The cycle is reached within the next instruction. */
+   {
+      control_unit_run_next_state();
+   }
+   return true;
+}
+
+/********************************************************************************
+* control_unit_request_stop: Stops instructions run by control_unit_run after
+*                            the current instruction, and ends a run by
+*                            control_unit_run_until.
+********************************************************************************/
+void control_unit_request_stop(void)
+{
+   stop_requested = true;
+   run_stopped = true;
+   return;
+}
+
+/********************************************************************************
+* control_unit_set_periodic_hook: Sets specified hook, which is called every
+*                                 time specified number of clock cycles have
+*                                 been run, or removes the hook if 0 is
+*                                 passed. The hook is called after a state
+*                                 by the reference engine and at instruction
+*                                 boundaries by the fast engine, so the call
+*                                 may be a few cycles late. Hooks are set per
+*                                 thread, like the rest of the system.
+*
+*                                 - id      : The hook to set.
+*                                 - hook    : The hook to call, or 0.
+*                                 - interval: Number of clock cycles between
+*                                             the calls.
+********************************************************************************/
+void control_unit_set_periodic_hook(const enum control_unit_hook_id id,
+                                    const control_unit_hook hook,
+                                    const uint64_t interval)
+{
+   if (id >= CONTROL_UNIT_NUM_HOOKS) return;
+   periodic_hooks[id] = interval ? hook : 0;
+   periodic_intervals[id] = periodic_hooks[id] ? interval : 0;
+   periodic_deadlines[id] = cycles + interval;
+   update_next_event();
+   return;
+}
+
+/********************************************************************************
+* control_unit_set_transfer_hook: Sets a hook called at every CALL, RET and
+*                                 RETI and every generated interrupt, or
+*                                 removes the hook if 0 is passed. The hook
+*                                 is set per thread, like the periodic hooks.
+*
+*                                 - hook: The hook to call, or 0.
+********************************************************************************/
+void control_unit_set_transfer_hook(const control_unit_transfer_hook hook)
+{
+   transfer_hook = hook;
+   return;
+}
+
+/********************************************************************************
+* control_unit_set_translation: Lets the fast engine run blocks of specified
+*                               translated program, see translator_load, or
+*                               stops running translated code if 0 is
+*                               passed. Only blocks whose instructions match
+*                               program memory are run. The translation is
+*                               set per thread, like the hooks.
+*
+*                               - module: The translated program, or 0.
+********************************************************************************/
+void control_unit_set_translation(const struct translator_module* module)
+{
+   translation = module;
+   translator_context.reg = reg;
+   translator_context.sr = &sr;
+   translator_context.pc = &pc;
+   translator_context.mar = &mar;
+   translator_context.cycles = &cycles;
+   translator_context.next_event = &next_event;
+   translator_context.valid = translated;
+   translator_context.executed = coverage.executed;
+   translator_context.branches = coverage.branches;
+   translator_context.data_read = data_memory_read;
+   translator_context.data_write = data_memory_write;
+   translator_context.boundary = leave_translation;
+   decoded_valid = false;
+   return;
+}
+
+/********************************************************************************
+* control_unit_patch: Replaces specified number of instructions from
+*                     specified address and onwards without resetting the
+*                     system, for instance to replace an interrupt routine
+*                     of a program that has already run for a long time.
+*                     The patch can be applied at any time, also by hooks
+*                     while instructions are run. Instructions are fetched
+*                     from the patched program from the next instruction
+*                     boundary, while an instruction that has already been
+*                     fetched is completed as it was. Breakpoints at patched
+*                     addresses are kept and run the new instructions.
+*
+*                     The program memory generation is incremented once per
+*                     patch, and the fast engine notices it at the next
+*                     instruction boundary. Only the patched instructions
+*                     are decoded again and only translated blocks
+*                     containing them are checked against program memory.
+*                     Returns 0 after success or error code 1 if the
+*                     instructions don't fit in the program memory or
+*                     memory ran out.
+*
+*                     - address         : Address of the first instruction.
+*                     - instructions    : Reference to the new instructions.
+*                     - num_instructions: The number of instructions.
+********************************************************************************/
+int control_unit_patch(const uint8_t address,
+                       const uint32_t* instructions,
+                       const size_t num_instructions)
+{
+   uint32_t patched[PROGRAM_MEMORY_ADDRESS_WIDTH];
+   uint16_t raw[PROGRAM_MEMORY_ADDRESS_WIDTH];
+   if ((size_t)address + num_instructions > PROGRAM_MEMORY_ADDRESS_WIDTH) return 1;
+
+   for (size_t i = 0; i < num_instructions; ++i)
+   {
+      patched[i] = breakpoint_patch((uint8_t)(address + i), instructions[i]);
+      raw[i] = (uint16_t)instructions[i];
+   }
+
+   if (program_memory_patch(address, patched, raw, num_instructions)) return 1;
+   next_event = 0; /* The decoded instructions are updated at the next boundary. */
+   return 0;
+}
+
+/********************************************************************************
+* control_unit_request_interrupt: Sets or clears a request of the interrupt
+*                                 with specified vector, used by peripherals.
+*                                 A requested interrupt is generated at the
+*                                 next instruction boundary where interrupts
+*                                 are enabled, after which the request is
+*                                 cleared. Pending requests are served one
+*                                 per boundary, lowest vector first.
+*
+*                                 - interrupt_vector: The interrupt vector.
+*                                 - requested       : Indicates if the
+*                                                     interrupt is requested.
+********************************************************************************/
+void control_unit_request_interrupt(const uint8_t interrupt_vector,
+                                    const bool requested)
+{
+   if (interrupt_vector / 2 >= 8) return;
+
+   if (requested)
+   {
+      set(requested_interrupts, interrupt_vector / 2);
+   }
+   else
+   {
+      clr(requested_interrupts, interrupt_vector / 2);
+   }
+   update_next_event();
+   return;
+}
+
+/********************************************************************************
+* control_unit_read_register: Returns the content of specified CPU register.
+*                             If an invalid register is specified, 0x00 is
+*                             returned.
+*
+*                             - address: Address of the CPU register.
+********************************************************************************/
+uint8_t control_unit_read_register(const uint8_t address)
+{
+   return address < CPU_REGISTER_ADDRESS_WIDTH ? reg[address] : 0x00;
+}
+
+/********************************************************************************
+* control_unit_write_register: Writes specified value to specified CPU
+*                              register. Returns 0 after successful write or
+*                              error code 1 if an invalid register is
+*                              specified.
+*
+*                              - address: Address of the CPU register.
+*                              - value  : The value to write.
+********************************************************************************/
+int control_unit_write_register(const uint8_t address,
+                                const uint8_t value)
+{
+   if (address < CPU_REGISTER_ADDRESS_WIDTH)
+   {
+      reg[address] = value;
+      return 0;
+   }
+   else
+   {
+      return 1;
+   }
+}
+
+/********************************************************************************
+* control_unit_read_status_register: Returns the content of the status
+*                                    register (bits INZVC).
+********************************************************************************/
+uint8_t control_unit_read_status_register(void)
+{
+   return sr;
+}
+
+/********************************************************************************
+* control_unit_write_status_register: Writes specified value to the status
+*                                     register (bits INZVC).
+*
+*                                     - value: The value to write.
+********************************************************************************/
+void control_unit_write_status_register(const uint8_t value)
+{
+   sr = value;
+   update_next_event();
+   return;
+}
+
+/********************************************************************************
+* control_unit_read_program_counter: Returns the address of the next
+*                                    instruction to fetch.
+********************************************************************************/
+uint8_t control_unit_read_program_counter(void)
+{
+   return pc;
+}
+
+/********************************************************************************
+* control_unit_current_address: Returns the address of the instruction in
+*                               progress, or of the next instruction to fetch
+*                               at an instruction boundary.
+********************************************************************************/
+uint8_t control_unit_current_address(void)
+{
+   return state == CPU_STATE_FETCH ? pc : mar;
+}
+
+/********************************************************************************
+* control_unit_write_program_counter: Sets the address of the next instruction
+*                                     to fetch. Should only be called at an
+*                                     instruction boundary.
+*
+*                                     - address: The new program counter.
+********************************************************************************/
+void control_unit_write_program_counter(const uint8_t address)
+{
+   pc = address;
+   return;
+}
+
+/********************************************************************************
+* control_unit_state: Returns the next state in the CPU instruction cycle.
+********************************************************************************/
+enum cpu_state control_unit_state(void)
+{
+   return state;
+}
+
+/********************************************************************************
+* control_unit_cycles: Returns the number of clock cycles, i.e. states in the
+*                      CPU instruction cycle, run since the last external
+*                      reset by control_unit_reset.
+********************************************************************************/
+uint64_t control_unit_cycles(void)
+{
+   return cycles;
+}
+
+/********************************************************************************
+* control_unit_coverage: Returns a reference to the coverage map collected by
+*                        the calling thread, see coverage.h. The map isn't
+*                        cleared at system reset.
+********************************************************************************/
+struct coverage_map* control_unit_coverage(void)
+{
+   return &coverage;
+}
+
+/********************************************************************************
+* control_unit_snapshot: Stores the complete architectural state of the
+*                        system, i.e. the control unit, the data memory and
+*                        the stack, at referenced location. Snapshots of
+*                        equal states are equal byte by byte.
+*
+*                        - self: Reference to the snapshot.
+********************************************************************************/
+void control_unit_snapshot(struct control_unit_snapshot* self)
+{
+   memset(self, 0, sizeof(*self));
+
+   self->ir = ir;
+   self->pc = pc;
+   self->mar = mar;
+   self->sr = sr;
+   self->op_code = op_code;
+   self->op1 = op1;
+   self->op2 = op2;
+   self->state = state;
+   self->cycles = cycles;
+
+   memcpy(self->reg, reg, sizeof(reg));
+   self->pin_values[0] = pci_regs_b.last_value;
+   self->pin_values[1] = pci_regs_c.last_value;
+   self->pin_values[2] = pci_regs_d.last_value;
+   self->requested_interrupts = requested_interrupts;
+
+   for (uint16_t i = 0; i < DATA_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      self->data[i] = data_memory_peek(i);
+   }
+
+   for (uint16_t i = 0; i < STACK_ADDRESS_WIDTH; ++i)
+   {
+      self->stack[i] = stack_read((uint8_t)i);
+   }
+
+   self->stack_pointer = stack_pointer();
+   self->stack_empty = stack_is_empty();
+   return;
+}
+
+/********************************************************************************
+* control_unit_restore: Restores the complete architectural state of the
+*                       system from referenced snapshot, so that the system
+*                       continues as if it had never left the state. The
+*                       program memory isn't part of the snapshot.
+*
+*                       - self: Reference to the snapshot.
+********************************************************************************/
+void control_unit_restore(const struct control_unit_snapshot* self)
+{
+   ir = self->ir;
+   pc = self->pc;
+   mar = self->mar;
+   sr = self->sr;
+   op_code = self->op_code;
+   op1 = self->op1;
+   op2 = self->op2;
+   state = self->state;
+   cycles = self->cycles;
+   stop_requested = false;
+   requested_interrupts = self->requested_interrupts;
+
+   memcpy(reg, self->reg, sizeof(reg));
+   pci_regs_b.last_value = self->pin_values[0];
+   pci_regs_c.last_value = self->pin_values[1];
+   pci_regs_d.last_value = self->pin_values[2];
+
+   for (uint16_t i = 0; i < DATA_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      data_memory_poke(i, self->data[i]);
+   }
+
+   stack_restore(self->stack, self->stack_pointer, self->stack_empty);
+
+   for (uint8_t i = 0; i < CONTROL_UNIT_NUM_HOOKS; ++i)
+   {
+      periodic_deadlines[i] = cycles + periodic_intervals[i];
+   }
+   update_next_event();
+   return;
+}
+
+/********************************************************************************
+* control_unit_snapshot_reset: Stores the state of the system after a reset
+*                              at referenced location, without resetting
+*                              the system, for instance to start a new
+*                              instance that is later restored.
+*
+*                              - self: Reference to the snapshot.
+********************************************************************************/
+void control_unit_snapshot_reset(struct control_unit_snapshot* self)
+{
+   memset(self, 0, sizeof(*self));
+   self->state = CPU_STATE_FETCH;
+   self->stack_pointer = STACK_ADDRESS_WIDTH - 1;
+   self->stack_empty = true;
+   return;
+}
+
+/********************************************************************************
+* control_unit_snapshot_hash: Returns a 64-bit FNV-1a hash of referenced
+*                             snapshot. Equal snapshots have equal hashes.
+*
+*                             - self: Reference to the snapshot.
+********************************************************************************/
+uint64_t control_unit_snapshot_hash(const struct control_unit_snapshot* self)
+{
+   const uint8_t* bytes = (const uint8_t*)self;
+   uint64_t hash = 0xCBF29CE484222325ull;
+
+   for (size_t i = 0; i < sizeof(*self); ++i)
+   {
+      hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+   }
+   return hash;
+}
+
+/********************************************************************************
+* control_unit_print: Prints information about the processor, for instance
+*                     current subroutine, instruction, state, content in
+*                     CPU-registers and I/O registers DDRB, PORTB and PINB.
+********************************************************************************/
+void control_unit_print(void)
+{
+   printf("--------------------------------------------------------------------------------\n");
+   printf("Current subroutine:\t\t\t\t%s\n", program_memory_subroutine_name(mar));
+   printf("Current instruction:\t\t\t\t%s\n", cpu_instruction_name(op_code));
+   printf("Current state:\t\t\t\t\t%s\n", cpu_state_name(state));
+   
+   printf("Program counter:\t\t\t\t%hu\n", pc);
+
+   printf("Instruction register:\t\t\t\t%s ", get_binary((ir >> 16) & 0xFF, 8));
+   printf("%s ", get_binary((ir >> 8) & (0xFF), 8));
+   printf("%s\n", get_binary(ir & 0xFF, 8));
+
+   printf("Status register (INZVC):\t\t\t%s\n\n", get_binary(sr, 5));
+
+   printf("Content in CPU register R16:\t\t\t%s\n", get_binary(reg[R16], 8));
+   printf("Content in CPU register R24:\t\t\t%s\n\n", get_binary(reg[R24], 8));
+
+   printf("Content in data direction register DDRB:\t%s\n", get_binary(data_memory_read(DDRB), 8));
+   printf("Content in data register PORTB:\t\t\t%s\n", get_binary(data_memory_read(PORTB), 8));
+   printf("Content in pin input register PINB:\t\t%s\n", get_binary(data_memory_read(PINB), 8));
+
+   printf("--------------------------------------------------------------------------------\n\n");
+   return;
+}
+
+static void execute(void)
+{
+   switch (op_code)
+   {
+      case NOP:
+      {
+         break;
+      }
+      case LDI:
+      {
+         reg[op1] = op2;
+         break;
+      }
+      case MOV:
+      {
+         reg[op1] = reg[op2];
+         break;
+      }
+      case OUT:
+      {
+         data_memory_write(op1, reg[op2]);
+         break;
+      }
+      case IN: 
+      {
+         reg[op1] = data_memory_read(op2);
+         break;
+      }
+      case STS:
+      {
+         data_memory_write(op1, reg[op2]);
+
+         if (op2 < DATA_MEMORY_DATA_WIDTH - 1)
+         {
+            data_memory_write(op1 + 1, reg[op2 + 1]);
+         }
+         break;
+      }
+      case LDS:
+      {
+         reg[op1] = data_memory_read(op2);
+         
+         if (op1 < CPU_REGISTER_ADDRESS_WIDTH - 1)
+         {
+            reg[op1 + 1] = data_memory_read(op2 + 1);
+         }
+
+         break;
+      }
+      case CLR:
+      {
+         reg[op1] = 0x00;
+         break;
+      }
+      case ORI:
+      {
+         reg[op1] = alu(op_code, reg[op1], op2, &sr);
+         break;
+      }
+      case ANDI:
+      {
+         reg[op1] = alu(op_code, reg[op1], op2, &sr);
+         break;
+      }
+      case XORI:
+      {
+         reg[op1] = alu(op_code, reg[op1], op2, &sr);
+         break;
+      }
+      case OR:
+      {
+         reg[op1] = alu(op_code, reg[op1], reg[op2], &sr);
+         break;
+      }
+      case AND:
+      {
+         reg[op1] = alu(op_code, reg[op1], reg[op2], &sr);
+         break;
+      }
+      case XOR:
+      {
+         reg[op1] = alu(op_code, reg[op1], reg[op2], &sr);
+         break;
+      }
+      case ADDI:
+      {
+         reg[op1] = alu(op_code, reg[op1], op2, &sr);
+         break;
+      }
+      case SUBI:
+      {
+         reg[op1] = alu(op_code, reg[op1], op2, &sr);
+         break;
+      }
+      case ADD:
+      {
+         reg[op1] = alu(op_code, reg[op1], reg[op2], &sr);
+         break;
+      }
+      case SUB:
+      {
+         reg[op1] = alu(op_code, reg[op1], reg[op2], &sr);
+         break;
+      }
+      case INC:
+      {
+         reg[op1] = alu(op_code, reg[op1], 0x00, &sr);
+         break;
+      }
+      case DEC:
+      {
+         reg[op1] = alu(op_code, reg[op1], 0x00, &sr);
+         break;
+      }
+      case LSL:
+      {
+         reg[op1] = alu(op_code, reg[op1], 0x00, &sr);
+         break;
+      }
+      case LSR:
+      {
+         reg[op1] = alu(op_code, reg[op1], 0x00, &sr);
+         break;
+      }
+      case CPI:
+      {
+         alu_compare(reg[op1], op2, &sr);
+         break;
+      }
+      case CP:
+      {
+         alu_compare(reg[op1], reg[op2], &sr);
+         break;
+      }
+      case JMP:
+      {
+         pc = op1;
+         break;
+      }
+      case BREQ:
+      {
+         branch(equal());
+         break;
+      }
+      case BRNE:
+      {
+         branch(!equal());
+         break;
+      }
+      case BRGE:
+      {
+         branch(greater() || (equal()));
+         break;
+      }
+      case BRGT:
+      {
+         branch(greater());
+         break;
+      }
+      case BRLE:
+      {
+         branch(lower() || (equal()));
+         break;
+      }
+      case BRLT:
+      {
+         branch(lower());
+         break;
+      }
+      case BRGES:
+      {
+         branch(!signed_lower());
+         break;
+      }
+      case BRLTS:
+      {
+         branch(signed_lower());
+         break;
+      }
+      case CALL:
+      {
+         stack_push(op2 ? pc + 1 : pc); /* A call occupying two words returns past the second word. */
+         pc = op1;
+         if (transfer_hook) notify_transfer(CONTROL_UNIT_TRANSFER_CALL, mar, pc);
+         break;
+      }
+      case RET:
+      {
+         stack_pop(&pc);
+         if (transfer_hook) notify_transfer(CONTROL_UNIT_TRANSFER_RETURN, mar, pc);
+         break;
+      }
+      case RETI:
+      {
+         const uint8_t address = mar;
+         return_from_interrupt();
+         if (transfer_hook) notify_transfer(CONTROL_UNIT_TRANSFER_RETI, address, pc);
+         break;
+      }
+      case PUSH:
+      {
+         stack_push(reg[op1]);
+         break;
+      }
+      case POP:
+      {
+         stack_pop(&reg[op1]);
+         break;
+      }
+      case SEI:
+      {
+         set(sr, I);
+         if (requested_interrupts) next_event = 0;
+         break;
+      }
+      case CLI:
+      {
+         clr(sr, 4);
+         break;
+      }
+      case LD:
+      {
+         reg[op1] = data_memory_read(register_pair_read(op2));
+         break;
+      }
+      case LDP:
+      {
+         const uint16_t address = register_pair_read(op2);
+         register_pair_write(op2, address + 1);
+         reg[op1] = data_memory_read(address);
+         break;
+      }
+      case LDM:
+      {
+         const uint16_t address = register_pair_read(op2) - 1;
+         register_pair_write(op2, address);
+         reg[op1] = data_memory_read(address);
+         break;
+      }
+      case ST:
+      {
+         data_memory_write(register_pair_read(op1), reg[op2]);
+         break;
+      }
+      case STP:
+      {
+         const uint16_t address = register_pair_read(op1);
+         data_memory_write(address, reg[op2]);
+         register_pair_write(op1, address + 1);
+         break;
+      }
+      case STM:
+      {
+         const uint16_t address = register_pair_read(op1) - 1;
+         data_memory_write(address, reg[op2]);
+         register_pair_write(op1, address);
+         break;
+      }
+      case LDDY:
+      {
+         reg[op1] = data_memory_read(register_pair_read(YL) + op2);
+         break;
+      }
+      case LDDZ:
+      {
+         reg[op1] = data_memory_read(register_pair_read(ZL) + op2);
+         break;
+      }
+      case STDY:
+      {
+         data_memory_write(register_pair_read(YL) + op1, reg[op2]);
+         break;
+      }
+      case STDZ:
+      {
+         data_memory_write(register_pair_read(ZL) + op1, reg[op2]);
+         break;
+      }
+      case LPM:
+      {
+         reg[op1] = program_memory_read_byte(register_pair_read(ZL));
+         break;
+      }
+      case LPMP:
+      {
+         const uint16_t address = register_pair_read(ZL);
+         reg[op1] = program_memory_read_byte(address);
+         register_pair_write(ZL, address + 1);
+         break;
+      }
+      case ADC:
+      {
+         reg[op1] = alu(op_code, reg[op1], reg[op2], &sr);
+         break;
+      }
+      case SBC:
+      {
+         reg[op1] = alu(op_code, reg[op1], reg[op2], &sr);
+         break;
+      }
+      case MOVW:
+      {
+         register_pair_write(op1, register_pair_read(op2));
+         break;
+      }
+      case ADIW:
+      {
+         register_pair_write(op1, alu_word(op_code, register_pair_read(op1), op2, &sr));
+         break;
+      }
+      case SBIW:
+      {
+         register_pair_write(op1, alu_word(op_code, register_pair_read(op1), op2, &sr));
+         break;
+      }
+      case MUL:
+      {
+         register_pair_write(R0, alu_multiply(op_code, reg[op1], reg[op2], &sr));
+         break;
+      }
+      case MULS:
+      {
+         register_pair_write(R0, alu_multiply(op_code, reg[op1], reg[op2], &sr));
+         break;
+      }
+      case MULSU:
+      {
+         register_pair_write(R0, alu_multiply(op_code, reg[op1], reg[op2], &sr));
+         break;
+      }
+      case LDSX:
+      {
+         reg[CPU_WIDE_REGISTER(op1)] = data_memory_read(CPU_WIDE_ADDRESS(op1, op2));
+         pc++;
+         break;
+      }
+      case STSX:
+      {
+         data_memory_write(CPU_WIDE_ADDRESS(op2, op1), reg[CPU_WIDE_REGISTER(op2)]);
+         pc++;
+         break;
+      }
+      case INSR:
+      {
+         reg[op1] = cpu_sreg_from_sr(sr);
+         break;
+      }
+      case OUTSR:
+      {
+         sr = cpu_sr_from_sreg(reg[op1]);
+         if (read(sr, I) && requested_interrupts) next_event = 0;
+         break;
+      }
+      case INSP:
+      {
+         const uint16_t address = stack_address();
+         reg[op1] = op2 ? (uint8_t)(address >> 8) : (uint8_t)address;
+         break;
+      }
+      case OUTSP:
+      {
+         const uint16_t address = stack_address();
+         stack_set_address(op2 ? (uint16_t)((reg[op1] << 8) | (address & 0xFF)) : (uint16_t)((address & 0xFF00) | reg[op1]));
+         break;
+      }
+      case BREAK:
+      {
+         uint32_t instruction = 0x00;
+
+         if (breakpoint_on_hit(mar, &instruction))
+         {
+            pc = mar;                  /* The instruction is executed when resumed. */
+            cycles -= 3;               /* Hence the stop takes no time. */
+            control_unit_request_stop();
+         }
+         else
+         {
+            ir = instruction;          /* Executes the original instruction instead. */
+            decode();
+            execute();
+         }
+         break;
+      }
+      default:
+      {
+         system_reset();
+         break;
+      }
+   }
+   return;
+}
+
+/********************************************************************************
+* system_reset: Resets the system after an error, for instance an invalid
+*               instruction. Unlike at an external reset, the clock cycle
+*               counter keeps counting, so that the time of later inputs
+*               can be recorded.
+********************************************************************************/
+static inline void system_reset(void)
+{
+   const uint64_t cycles_run = cycles;
+   control_unit_reset();
+   cycles = cycles_run;
+   return;
+}
+
+static inline void decode(void)
+{
+   op_code = ir >> 16;                 /* Bit 23 downto 16 consist of the OP code. */
+   op1 = ir >> 8;                      /* Bit 15 downto 8 consists of the first operand. */
+   op2 = ir;                           /* Bit 7 downto 0 constist of the second operand. */
+   return;
+}
+
+/********************************************************************************
+* update_decoded_instructions: Shares the decoded instructions attached to the
+*                              program image, or decodes the image and
+*                              attaches them if it hasn't been run before.
+*                              A reference to the image is kept as long as
+*                              its decoded instructions are used. If the
+*                              image was patched from the cached one, only
+*                              the patched instructions are decoded again
+*                              and only translated blocks containing them
+*                              are checked. Returns false if memory ran out,
+*                              in which case the fast engine can't be used.
+********************************************************************************/
+static bool update_decoded_instructions(void)
+{
+   if (decoded_valid && decoded_generation == program_memory_generation()) return true;
+
+   const struct program_image* image = program_memory_image();
+   struct decoded_instruction* table = (struct decoded_instruction*)program_image_decoded(image);
+   uint8_t first = 0;
+   uint16_t count = PROGRAM_MEMORY_ADDRESS_WIDTH;
+
+   if (!decoded_valid || decoded_generation + 1 != program_memory_generation() ||
+       !program_memory_changed_range(&first, &count))
+   {
+      first = 0;
+      count = PROGRAM_MEMORY_ADDRESS_WIDTH;
+   }
+
+   if (!table)
+   {
+      table = (struct decoded_instruction*)malloc(sizeof(struct decoded_instruction) * PROGRAM_MEMORY_ADDRESS_WIDTH);
+      if (!table) return false;
+
+      if (count < PROGRAM_MEMORY_ADDRESS_WIDTH) memcpy(table, decoded, sizeof(struct decoded_instruction) * PROGRAM_MEMORY_ADDRESS_WIDTH);
+      decoded = table;
+      decode_image(image, first, count);
+      table = (struct decoded_instruction*)program_image_attach_decoded(image, table);
+   }
+
+   program_image_release(decoded_image);
+   decoded_image = program_image_retain(image);
+   decoded = table;
+
+   update_translated_blocks(first, count);
+   decoded_generation = program_memory_generation();
+   decoded_valid = true;
+   return true;
+}
+
+/********************************************************************************
+* decode_image: Decodes specified number of instructions of referenced image
+*               from specified address and onwards, together with the
+*               superinstructions containing them. The flag liveness of
+*               program_analysis depends on the whole program, so dead flags
+*               are found again at every address.
+*
+*               - image: Reference to the program image.
+*               - first: Address of the first instruction to decode.
+*               - count: The number of instructions to decode.
+********************************************************************************/
+static void decode_image(const struct program_image* image,
+                         const uint8_t first,
+                         const uint16_t count)
+{
+   for (uint16_t i = 0; i < count; ++i)
+   {
+      struct decoded_instruction* self = &decoded[(uint8_t)(first + i)];
+      self->ir = image->instructions[(uint8_t)(first + i)];
+      self->op_code = self->ir >> 16;
+      self->op1 = self->ir >> 8;
+      self->op2 = self->ir;
+   }
+
+   for (uint16_t i = 0; i < count + 2 && i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      const uint8_t address = (uint8_t)(first - 2 + i); /* Superinstructions are up to three long. */
+      decoded[address].fused = find_superinstruction(address);
+      decoded[address].length = decoded[address].fused == SUPERINSTRUCTION_IN_ORI_OUT ? 3 :
+                                decoded[address].fused != SUPERINSTRUCTION_NONE ? 2 : 1;
+   }
+
+   const struct program_analysis* analysis = program_analysis_get();
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      find_dead_flags((uint8_t)i, analysis);
+   }
+   return;
+}
+
+static uint8_t find_superinstruction(const uint8_t address)
+{
+   const struct decoded_instruction* first = &decoded[address];
+   const struct decoded_instruction* second = &decoded[(uint8_t)(address + 1)];
+   const struct decoded_instruction* third = &decoded[(uint8_t)(address + 2)];
+
+   if (first->op1 >= CPU_REGISTER_ADDRESS_WIDTH) return SUPERINSTRUCTION_NONE;
+
+   if (first->op_code == LDI && second->op_code == OUT && writes_no_pin(second))
+   {
+      return SUPERINSTRUCTION_LDI_OUT;
+   }
+   else if (first->op_code == CPI && second->op_code == BREQ)
+   {
+      return SUPERINSTRUCTION_CPI_BREQ;
+   }
+   else if (first->op_code == IN && second->op_code == ORI && second->op1 < CPU_REGISTER_ADDRESS_WIDTH &&
+            third->op_code == OUT && writes_no_pin(third))
+   {
+      return SUPERINSTRUCTION_IN_ORI_OUT;
+   }
+   else if (first->op_code == LDS && second->op_code == CPI && second->op1 < CPU_REGISTER_ADDRESS_WIDTH)
+   {
+      return SUPERINSTRUCTION_LDS_CPI;
+   }
+   return SUPERINSTRUCTION_NONE;
+}
+
+/********************************************************************************
+* writes_no_pin: OUT is only fused if it doesn't write a pin input register,
+*                since a pin change may cause an interrupt to be accepted.
+********************************************************************************/
+static inline bool writes_no_pin(const struct decoded_instruction* out)
+{
+   return out->op2 < CPU_REGISTER_ADDRESS_WIDTH && out->op1 != PINB &&
+          out->op1 != PINC && out->op1 != PIND;
+}
+
+/********************************************************************************
+* execute_superinstruction: Reads and writes that may hit a watchpoint are
+*                           followed by a check for a stop request, since
+*                           the run must stop after the instruction that
+*                           requested the stop, like control_unit_run.
+********************************************************************************/
+static uint32_t execute_superinstruction(const struct decoded_instruction* first)
+{
+   const uint8_t address = pc;
+   const struct decoded_instruction* second = &decoded[(uint8_t)(address + 1)];
+   const struct decoded_instruction* third = &decoded[(uint8_t)(address + 2)];
+   coverage.executed[address] = 1;
+
+   switch (first->fused)
+   {
+      case SUPERINSTRUCTION_LDI_OUT:
+      {
+         reg[first->op1] = first->op2;
+         coverage.executed[(uint8_t)(address + 1)] = 1;
+         data_memory_write(second->op1, reg[second->op2]);
+         pc = address + 2;
+         set_current_instruction(second, address + 1);
+         cycles += 6;
+         return 2;
+      }
+      case SUPERINSTRUCTION_CPI_BREQ:
+      {
+         alu_compare(reg[first->op1], first->op2, &sr);
+         coverage.executed[(uint8_t)(address + 1)] = 1;
+         coverage.branches[(uint8_t)(address + 1)][equal() != 0] = 1;
+         pc = equal() ? second->op1 : address + 2;
+         set_current_instruction(second, address + 1);
+         cycles += 6;
+         return 2;
+      }
+      case SUPERINSTRUCTION_IN_ORI_OUT:
+      {
+         reg[first->op1] = data_memory_read(first->op2);
+         cycles += 3;
+
+         if (stop_requested)
+         {
+            pc = address + 1;
+            set_current_instruction(first, address);
+            return 1;
+         }
+
+         reg[second->op1] = alu(ORI, reg[second->op1], second->op2, &sr);
+         coverage.executed[(uint8_t)(address + 1)] = 1;
+         coverage.executed[(uint8_t)(address + 2)] = 1;
+         data_memory_write(third->op1, reg[third->op2]);
+         pc = address + 3;
+         set_current_instruction(third, address + 2);
+         cycles += 6;
+         return 3;
+      }
+      case SUPERINSTRUCTION_LDS_CPI:
+      {
+         reg[first->op1] = data_memory_read(first->op2);
+
+         if (first->op1 < CPU_REGISTER_ADDRESS_WIDTH - 1)
+         {
+            reg[first->op1 + 1] = data_memory_read(first->op2 + 1);
+         }
+
+         cycles += 3;
+
+         if (stop_requested)
+         {
+            pc = address + 1;
+            set_current_instruction(first, address);
+            return 1;
+         }
+
+         alu_compare(reg[second->op1], second->op2, &sr);
+         coverage.executed[(uint8_t)(address + 1)] = 1;
+         pc = address + 2;
+         set_current_instruction(second, address + 1);
+         cycles += 3;
+         return 2;
+      }
+      default:
+      {
+         return 0;
+      }
+   }
+}
+
+/********************************************************************************
+* find_dead_flags: Flags are dead after an instruction if they are not live
+*                  according to the analysis, but the instructions up to the
+*                  one overwriting them must also be register instructions,
+*                  which can't cause an interrupt or hit a watchpoint. The
+*                  decoded instructions are used for the window, since they
+*                  include inserted breakpoints, and reads in the window are
+*                  checked again, since unreachable code may still be run
+*                  after a return to a manipulated address.
+********************************************************************************/
+static void find_dead_flags(const uint8_t address,
+                            const struct program_analysis* analysis)
+{
+   struct decoded_instruction* self = &decoded[address];
+   const uint8_t written = flags_written(self->op_code);
+   uint8_t overwritten = 0x00;
+
+   self->dead_flags = false;
+   self->window = 0;
+
+   if (!written || self->op1 >= CPU_REGISTER_ADDRESS_WIDTH ||
+       (analysis->flags_live_after[address] & written)) return;
+
+   for (uint8_t i = 1; i <= CONTROL_UNIT_DEAD_FLAG_WINDOW; ++i)
+   {
+      const struct decoded_instruction* next = &decoded[(uint8_t)(address + i)];
+      const uint8_t op_code = next->op_code;
+
+      if (op_code != NOP && op_code != LDI && op_code != MOV && op_code != CLR &&
+          op_code != MOVW && !flags_written(op_code)) return;
+      if ((op_code == ADC || op_code == SBC) && (written & ~overwritten & ((1 << C) | (1 << Z)))) return;
+
+      overwritten |= flags_written(op_code);
+
+      if ((overwritten & written) == written)
+      {
+         self->dead_flags = true;
+         self->window = i;
+         return;
+      }
+   }
+   return;
+}
+
+static uint8_t flags_written(const uint8_t op_code)
+{
+   switch (op_code)
+   {
+      case ADDI: case SUBI: case ADD: case SUB: case CPI: case CP: case LSL: case LSR:
+      case ADC: case SBC:
+      {
+         return PROGRAM_ANALYSIS_FLAGS;
+      }
+      case ORI: case ANDI: case XORI: case OR: case AND: case XOR: case INC: case DEC:
+      {
+         return PROGRAM_ANALYSIS_FLAGS & ~(1 << C);
+      }
+      default:
+      {
+         return 0x00;
+      }
+   }
+}
+
+static void execute_without_flags(void)
+{
+   if (op_code != CPI && op_code != CP)
+   {
+      const uint8_t b = op_code == OR || op_code == AND || op_code == XOR || op_code == ADD ||
+                        op_code == SUB || op_code == ADC || op_code == SBC ? reg[op2] : op2;
+      reg[op1] = alu_without_flags(op_code, reg[op1], b, sr);
+   }
+   return;
+}
+
+static inline void set_current_instruction(const struct decoded_instruction* self,
+                                           const uint8_t address)
+{
+   ir = self->ir;
+   mar = address;
+   op_code = self->op_code;
+   op1 = self->op1;
+   op2 = self->op2;
+   state = CPU_STATE_FETCH;
+   return;
+}
+
+/********************************************************************************
+* run_events: Calls every periodic hook whose deadline has passed and, at
+*             instruction boundaries with interrupts enabled, generates the
+*             pending interrupt with the lowest vector. At most one
+*             interrupt is generated per boundary.
+********************************************************************************/
+static void run_events(void)
+{
+   for (uint8_t i = 0; i < CONTROL_UNIT_NUM_HOOKS; ++i)
+   {
+      if (periodic_hooks[i] && cycles >= periodic_deadlines[i])
+      {
+         periodic_deadlines[i] = cycles + periodic_intervals[i];
+         periodic_hooks[i]();
+      }
+   }
+
+   if (decoded_valid && decoded_generation != program_memory_generation() && !update_decoded_instructions())
+   {
+      decoded_valid = false;
+      stop_requested = true; /* Memory ran out, the next batch runs on control_unit_run. */
+   }
+
+   if (requested_interrupts && state == CPU_STATE_FETCH && interrupt_enabled())
+   {
+      uint8_t source = 0;
+      while (!read(requested_interrupts, source)) source++; /* Fixed priority, lowest vector first. */
+      clr(requested_interrupts, source);
+
+      if (source * 2 >= PCINT0_vect && source * 2 <= PCINT2_vect)
+      {
+         generate_interrupt(source * 2, (source * 2 - PCINT0_vect) / 2);
+      }
+      else
+      {
+         generate_interrupt(source * 2, NO_FLAG_BIT);
+      }
+   }
+
+   update_next_event();
+   return;
+}
+
+/********************************************************************************
+* update_next_event: Updates the cycle at which run_events is called next.
+*                    Pending interrupt requests are checked at every
+*                    instruction boundary until they are served.
+********************************************************************************/
+static void update_next_event(void)
+{
+   next_event = UINT64_MAX;
+
+   for (uint8_t i = 0; i < CONTROL_UNIT_NUM_HOOKS; ++i)
+   {
+      if (periodic_hooks[i] && periodic_deadlines[i] < next_event)
+      {
+         next_event = periodic_deadlines[i];
+      }
+   }
+
+   if (requested_interrupts && interrupt_enabled()) next_event = 0;
+   return;
+}
+
+static inline bool pin_change_detected(void)
+{
+   return data_memory_peek(PINB) != pci_regs_b.last_value ||
+          data_memory_peek(PINC) != pci_regs_c.last_value ||
+          data_memory_peek(PIND) != pci_regs_d.last_value;
+}
+
+/********************************************************************************
+* leave_translation: Called by translated code after every access of data
+*                    memory. Latches pin changes like the fast engine does at
+*                    the end of an instruction and returns true if the
+*                    translated code must return, since an event is due or
+*                    a stop was requested.
+********************************************************************************/
+static bool leave_translation(void)
+{
+   if (pin_change_detected()) monitor_interrupts();
+   return stop_requested || cycles >= next_event;
+}
+
+static void update_translated_blocks(const uint8_t first,
+                                     const uint16_t count)
+{
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      const uint8_t length = translation ? translation->block_length[i] : 0;
+      bool changed = count == PROGRAM_MEMORY_ADDRESS_WIDTH;
+
+      for (uint16_t j = i; j < i + length && !changed; ++j)
+      {
+         changed = (uint8_t)(j - first) < count;
+      }
+
+      if (!changed) continue;
+      translated[i] = length > 0;
+
+      for (uint16_t j = i; j < i + length && translated[i]; ++j)
+      {
+         translated[i] = translation->program[(uint8_t)j] == decoded[(uint8_t)j].ir;
+      }
+   }
+   return;
+}
+
+static inline void cpu_registers_reset(void)
+{
+   for (uint8_t* i = reg; i < reg + CPU_REGISTER_ADDRESS_WIDTH; ++i)
+   {
+      *i = 0x00;
+   }
+   return;
+}
+
+static inline bool interrupt_enabled(void)
+{
+   return read(sr, I);
+}
+
+static inline bool equal(void)
+{
+   return read(sr, Z);
+}
+
+static inline bool greater(void)
+{
+   return (!equal() && !lower());
+}
+
+static inline bool lower(void)
+{
+   return read(sr, N);
+}
+
+static inline bool signed_lower(void)
+{
+   return !read(sr, N) != !read(sr, V);
+}
+
+/********************************************************************************
+* branch: Jumps to the address in the first operand if specified condition
+*         holds and stores the direction of the branch in the coverage map.
+********************************************************************************/
+static inline void branch(const bool taken)
+{
+   coverage.branches[mar][taken] = 1;
+   if (taken) pc = op1;
+   return;
+}
+
+static inline uint16_t register_pair_read(const uint8_t low)
+{
+   return reg[low] | (reg[low + 1] << 8);
+}
+
+static inline void register_pair_write(const uint8_t low,
+                                       const uint16_t value)
+{
+   reg[low] = (uint8_t)value;
+   reg[low + 1] = (uint8_t)(value >> 8);
+   return;
+}
+
+/********************************************************************************
+* monitor_interrupts: Latches the flags of pin changes on the I/O ports and
+*                     requests the enabled interrupts, which run_events
+*                     arbitrates at the next instruction boundary.
+********************************************************************************/
+static inline void monitor_interrupts(void)
+{
+   monitor_port(&pci_regs_b);
+   monitor_port(&pci_regs_c);
+   monitor_port(&pci_regs_d);
+   if (requested_interrupts && interrupt_enabled()) next_event = 0;
+   return;
+}
+
+static inline void monitor_port(struct pci_regs* port)
+{
+   if (pci_regs_monitor_pci_interrupt_on_io_port(port))
+   {
+      set(requested_interrupts, port->interrupt_vector / 2);
+   }
+   return;
+}
+
+/********************************************************************************
+* generate_interrupt: Saves the context of the interrupted program on the
+*                     stack and jumps to specified interrupt vector. The
+*                     flag bit in PCIFR of a pin change interrupt is cleared
+*                     on entry like in the hardware, so that a pin change
+*                     during the interrupt routine is latched again.
+********************************************************************************/
+static void generate_interrupt(const uint8_t interrupt_vector, 
+                               const uint8_t flag_bit)
+{
+   clr(sr, I);
+
+   if (flag_bit != NO_FLAG_BIT)
+   {
+      uint8_t flag_reg_content = data_memory_read(PCIFR);
+      clr(flag_reg_content, flag_bit);
+      data_memory_write(PCIFR, flag_reg_content);
+   }
+
+   stack_push(pc);
+   stack_push(mar);
+   stack_push(sr);
+
+   stack_push(ir << 16);
+   stack_push(ir << 8);
+   stack_push(ir);
+
+   stack_push(op_code);
+   stack_push(op1);
+   stack_push(op2);
+
+   stack_push(state);
+   stack_push(flag_bit);
+
+   for (uint8_t i = 0; i < CPU_REGISTER_DATA_WIDTH; ++i)
+   {
+      stack_push(reg[i]);
+   }
+
+   pc = interrupt_vector;
+   if (transfer_hook) notify_transfer(CONTROL_UNIT_TRANSFER_INTERRUPT, mar, pc);
+   return;
+}
+
+static void return_from_interrupt(void)
+{
+   uint8_t temp = 0x00;
+
+   for (uint8_t i = CPU_REGISTER_DATA_WIDTH; i > 0; --i)
+   {
+      stack_pop(&reg[i - 1]);
+   }
+
+   stack_pop(&temp);                   /* Flag bit, cleared on entry. */
+   stack_pop(&temp);
+   state = (enum cpu_state)(temp);
+
+   stack_pop(&op2);
+   stack_pop(&op1);
+   stack_pop(&op_code);
+
+   stack_pop(&temp);
+   ir = temp;
+   stack_pop(&temp);
+   ir |= temp << 8;
+   stack_pop(&temp);
+   ir |= temp << 16;
+
+   stack_pop(&sr);
+   stack_pop(&mar);
+   stack_pop(&pc);
+
+   set(sr, I);
+   if (requested_interrupts) next_event = 0;
+   return;
+}
+
+static void notify_transfer(const enum control_unit_transfer transfer,
+                            const uint8_t from,
+                            const uint8_t to)
+{
+   transfer_hook(transfer, from, to);
+   return;
+}
+
+static bool switch_reached(const struct control_unit_switch* at)
+{
+   return (at->address >= 0 && pc == at->address) || (at->condition && at->condition());
+}
\ No newline at end of file
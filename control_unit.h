@@ -1,39 +1,441 @@
-/********************************************************************************
-* cpu_controller.h: Contains functionality for control of the program flow
-*                   by input from the keyboard.
-********************************************************************************/
-#ifndef CONTROL_UNIT_H_
-#define CONTROL_UNIT_H_
-
-/* Include directives: */
-#include "cpu.h"
-#include "program_memory.h"
-#include "data_memory.h"
-#include "stack.h"
-#include "alu.h"
-
-/********************************************************************************
-* control_unit_reset: Resets control unit and corresponding program.
-********************************************************************************/
-void control_unit_reset(void);
-
-/********************************************************************************
-* control_unit_run_next_state: Runs next state in the CPU instruction cycle.
-********************************************************************************/
-void control_unit_run_next_state(void);
-
-/********************************************************************************
-* control_unit_run_next_state: Runs next CPU instruction cycle, i.e. fetches
-*                              a new instruction from program memory, decodes
-*                              and executes it.
-********************************************************************************/
-void control_unit_run_next_instruction_cycle(void);
-
-/********************************************************************************
-* control_unit_print: Prints information about the processor, for instance
-*                     current subroutine, instruction, state, content in
-*                     CPU-registers and I/O registers DDRB, PORTB and PINB.
-********************************************************************************/
-void control_unit_print(void);
-
+/********************************************************************************
+* cpu_controller.h: Contains functionality for control of the program flow
+*                   by input from the keyboard.
+********************************************************************************/
+#ifndef CONTROL_UNIT_H_
+#define CONTROL_UNIT_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "program_memory.h"
+#include "data_memory.h"
+#include "stack.h"
+#include "alu.h"
+#include "breakpoint.h"
+#include "program_analysis.h"
+#include "coverage.h"
+#include "translator.h"
+
+#define CONTROL_UNIT_DEAD_FLAG_WINDOW 4    /* Instructions searched for an overwrite of dead flags. */
+#define CONTROL_UNIT_BATCH_SIZE       4096 /* Instructions run per batch by control_unit_run_until. */
+
+/********************************************************************************
+* control_unit_hook: Function called by the control unit, for instance
+*                    periodically to publish the state of the system.
+********************************************************************************/
+typedef void (*control_unit_hook)(void);
+
+/********************************************************************************
+* control_unit_hook_id: Enumeration for the periodic hooks of the control unit.
+*                       Each hook has its own interval.
+********************************************************************************/
+enum control_unit_hook_id
+{
+   CONTROL_UNIT_HOOK_PUBLISH,    /* Publication of the state, see shared_state. */
+   CONTROL_UNIT_HOOK_PERIPHERAL, /* Update of peripherals, such as the USART. */
+   CONTROL_UNIT_HOOK_PROFILE,    /* Samples taken by the profiler. */
+   CONTROL_UNIT_HOOK_CLIENT,     /* Periodic hook of a library client, see simulator. */
+   CONTROL_UNIT_NUM_HOOKS        /* Number of hooks. */
+};
+
+/********************************************************************************
+* control_unit_transfer: Enumeration for transfers of control between
+*                        subroutines, passed to the transfer hook.
+********************************************************************************/
+enum control_unit_transfer
+{
+   CONTROL_UNIT_TRANSFER_CALL,      /* Subroutine called by CALL. */
+   CONTROL_UNIT_TRANSFER_RETURN,    /* Return from subroutine by RET. */
+   CONTROL_UNIT_TRANSFER_INTERRUPT, /* Interrupt generated. */
+   CONTROL_UNIT_TRANSFER_RETI       /* Return from interrupt by RETI. */
+};
+
+/********************************************************************************
+* control_unit_transfer_hook: Function called by the control unit at every
+*                             transfer of control between subroutines, with
+*                             the address of the current instruction and
+*                             the address control is transferred to.
+********************************************************************************/
+typedef void (*control_unit_transfer_hook)(const enum control_unit_transfer transfer,
+                                           const uint8_t from,
+                                           const uint8_t to);
+
+/********************************************************************************
+* control_unit_switch: Point where a run in functional mode, see
+*                      control_unit_run_functional, switches to the detailed
+*                      mode, where the states are run one by one. The run
+*                      switches at the first trigger reached.
+********************************************************************************/
+struct control_unit_switch
+{
+   uint64_t cycle;          /* Clock cycle to switch at, or UINT64_MAX. */
+   int16_t address;         /* Address of the next instruction to switch at, or -1. */
+   bool (*condition)(void); /* Condition checked at every instruction boundary, or 0. */
+};
+
+/********************************************************************************
+* control_unit_snapshot: Complete architectural state of the system, used to
+*                        compare the state between execution engines.
+********************************************************************************/
+struct control_unit_snapshot
+{
+   uint32_t ir;                             /* Instruction register. */
+   uint8_t pc;                              /* Program counter. */
+   uint8_t mar;                             /* Memory address register. */
+   uint8_t sr;                              /* Status register (bits INZVC). */
+   uint8_t op_code;                         /* Decoded OP code. */
+   uint8_t op1;                             /* Decoded first operand. */
+   uint8_t op2;                             /* Decoded second operand. */
+   enum cpu_state state;                    /* Next state in the instruction cycle. */
+   uint64_t cycles;                         /* Clock cycles run since reset. */
+   uint8_t reg[CPU_REGISTER_ADDRESS_WIDTH]; /* CPU registers R0 - R31. */
+   uint8_t pin_values[3];                   /* Last values of PINB, PINC and PIND. */
+   uint8_t requested_interrupts;            /* Interrupt requests, bit n for vector 2n. */
+   uint8_t data[DATA_MEMORY_ADDRESS_WIDTH]; /* Content of the data memory. */
+   uint8_t stack[STACK_ADDRESS_WIDTH];      /* Content of the stack. */
+   uint8_t stack_pointer;                   /* Stack pointer. */
+   bool stack_empty;                        /* Indicates if the stack is empty. */
+};
+
+/********************************************************************************
+* control_unit_reset: Resets control unit and corresponding program.
+********************************************************************************/
+void control_unit_reset(void);
+
+/********************************************************************************
+* control_unit_release: Releases the program image stored in program memory
+*                       and the decoded instructions shared with it, which
+*                       the calling thread otherwise references until the
+*                       next program is stored. Called by threads running
+*                       their own instance of the system before they exit.
+********************************************************************************/
+void control_unit_release(void);
+
+/********************************************************************************
+* control_unit_run_next_state: Runs next state in the CPU instruction cycle.
+********************************************************************************/
+void control_unit_run_next_state(void);
+
+/********************************************************************************
+* control_unit_run_next_state: Runs next CPU instruction cycle, i.e. fetches
+*                              a new instruction from program memory, decodes
+*                              and executes it.
+********************************************************************************/
+void control_unit_run_next_instruction_cycle(void);
+
+/********************************************************************************
+* control_unit_run_next_instruction: Runs the remaining states of the current
+*                                    instruction, so that the control unit
+*                                    stops at an instruction boundary, where
+*                                    the next state fetches a new instruction.
+*                                    If the control unit already is at an
+*                                    instruction boundary, one whole
+*                                    instruction is executed.
+********************************************************************************/
+void control_unit_run_next_instruction(void);
+
+/********************************************************************************
+* control_unit_run: Runs specified number of instructions from the current
+*                   instruction boundary and returns the number of executed
+*                   instructions. The execution is stopped in advance if a
+*                   stop is requested, for instance by a breakpoint.
+*
+*                   - num_instructions: The number of instructions to run.
+********************************************************************************/
+uint32_t control_unit_run(const uint32_t num_instructions);
+
+/********************************************************************************
+* control_unit_run_fast: Runs specified number of instructions like
+*                        control_unit_run, but without stepping through the
+*                        states one by one. Instructions are decoded once
+*                        and cached until the program memory is changed,
+*                        and pin change interrupts are only monitored in
+*                        full when a pin input register differs from its
+*                        last value. The architectural state, including
+*                        the state stored on the stack at interrupts, is
+*                        the same as after control_unit_run.
+*
+*                        Common instruction sequences, such as LDI followed
+*                        by OUT, are run as superinstructions. Since no
+*                        instruction in a superinstruction writes a pin
+*                        input register, no interrupt can be accepted
+*                        inside it, so the sequences are only run as
+*                        superinstructions when no pin change is pending.
+*
+*                        ALU instructions whose flags are dead according to
+*                        program_analysis skip the flag update, but only if
+*                        the flags are overwritten by the next few register
+*                        instructions in the same batch, since the status
+*                        register is stored on the stack at interrupts and
+*                        may be read after a batch.
+*
+*                        If a translated program is set, blocks of it that
+*                        start at the program counter are run as native
+*                        code whenever no pin change is pending, see
+*                        translator.
+*
+*                        - num_instructions: The number of instructions to run.
+********************************************************************************/
+uint32_t control_unit_run_fast(const uint32_t num_instructions);
+
+/********************************************************************************
+* control_unit_run_until: Runs until specified number of clock cycles have
+*                         been run since last reset. Whole instructions are
+*                         run in batches by the fast engine, while remaining
+*                         states of a started instruction are run one by one.
+*                         Returns true if the cycle was reached, or false if
+*                         the run was stopped in advance by a stop request,
+*                         for instance by a breakpoint, in which case the
+*                         caller must not run again as if nothing happened.
+*
+*                         - cycle: The clock cycle to stop at.
+********************************************************************************/
+bool control_unit_run_until(const uint64_t cycle);
+
+/********************************************************************************
+* control_unit_run_functional: Runs whole instructions by the fast engine,
+*                              without stepping through the states, until
+*                              specified switch point is reached and returns
+*                              true, so that control_unit_run_next_state can
+*                              continue from the switch point.
+*                              At the switch point, the instruction register,
+*                              memory address register, OP code, operands
+*                              and state are the same as if every state had
+*                              been run one by one.
+*
+*                              An address or condition is checked before
+*                              every instruction, including the first, so
+*                              the run stops at an instruction boundary.
+*                              Instructions are then run one at a time by
+*                              the fast engine, while a run to a cycle only
+*                              is run in batches. A cycle within an
+*                              instruction is reached by running the states
+*                              of the instruction one by one up to it. A run
+*                              continues from the detailed mode at any
+*                              state, i.e. the mode can be switched back and
+*                              forth. Returns false if specified number of
+*                              instructions has been run without reaching
+*                              the switch point, or if a stop is requested,
+*                              for instance by a breakpoint.
+*
+*                              - at              : Reference to the switch point.
+*                              - num_instructions: The maximum number of instructions to run.
+********************************************************************************/
+bool control_unit_run_functional(const struct control_unit_switch* at,
+                                 const uint32_t num_instructions);
+
+/********************************************************************************
+* control_unit_request_stop: Stops instructions run by control_unit_run after
+*                            the current instruction, and ends a run by
+*                            control_unit_run_until.
+********************************************************************************/
+void control_unit_request_stop(void);
+
+/********************************************************************************
+* control_unit_set_periodic_hook: Sets specified hook, which is called every
+*                                 time specified number of clock cycles have
+*                                 been run, or removes the hook if 0 is
+*                                 passed. The hook is called after a state
+*                                 by the reference engine and at instruction
+*                                 boundaries by the fast engine, so the call
+*                                 may be a few cycles late. Hooks are set per
+*                                 thread, like the rest of the system.
+*
+*                                 - id      : The hook to set.
+*                                 - hook    : The hook to call, or 0.
+*                                 - interval: Number of clock cycles between
+*                                             the calls.
+********************************************************************************/
+void control_unit_set_periodic_hook(const enum control_unit_hook_id id,
+                                    const control_unit_hook hook,
+                                    const uint64_t interval);
+
+/********************************************************************************
+* control_unit_set_transfer_hook: Sets a hook called at every CALL, RET and
+*                                 RETI and every generated interrupt, or
+*                                 removes the hook if 0 is passed. The hook
+*                                 is set per thread, like the periodic hooks.
+*
+*                                 - hook: The hook to call, or 0.
+********************************************************************************/
+void control_unit_set_transfer_hook(const control_unit_transfer_hook hook);
+
+/********************************************************************************
+* control_unit_set_translation: Lets the fast engine run blocks of specified
+*                               translated program, see translator_load, or
+*                               stops running translated code if 0 is
+*                               passed. Only blocks whose instructions match
+*                               program memory are run. The translation is
+*                               set per thread, like the hooks.
+*
+*                               - module: The translated program, or 0.
+********************************************************************************/
+void control_unit_set_translation(const struct translator_module* module);
+
+/********************************************************************************
+* control_unit_patch: Replaces specified number of instructions from
+*                     specified address and onwards without resetting the
+*                     system, for instance to replace an interrupt routine
+*                     of a program that has already run for a long time.
+*                     The patch can be applied at any time, also by hooks
+*                     while instructions are run. Instructions are fetched
+*                     from the patched program from the next instruction
+*                     boundary, while an instruction that has already been
+*                     fetched is completed as it was. Breakpoints at patched
+*                     addresses are kept and run the new instructions.
+*
+*                     The program memory generation is incremented once per
+*                     patch, and the fast engine notices it at the next
+*                     instruction boundary. Only the patched instructions
+*                     are decoded again and only translated blocks
+*                     containing them are checked against program memory.
+*                     Returns 0 after success or error code 1 if the
+*                     instructions don't fit in the program memory or
+*                     memory ran out.
+*
+*                     - address         : Address of the first instruction.
+*                     - instructions    : Reference to the new instructions.
+*                     - num_instructions: The number of instructions.
+********************************************************************************/
+int control_unit_patch(const uint8_t address,
+                       const uint32_t* instructions,
+                       const size_t num_instructions);
+
+/********************************************************************************
+* control_unit_request_interrupt: Sets or clears a request of the interrupt
+*                                 with specified vector, used by peripherals.
+*                                 A requested interrupt is generated at the
+*                                 next instruction boundary where interrupts
+*                                 are enabled, after which the request is
+*                                 cleared. Pending requests are served one
+*                                 per boundary, lowest vector first.
+*
+*                                 - interrupt_vector: The interrupt vector.
+*                                 - requested       : Indicates if the
+*                                                     interrupt is requested.
+********************************************************************************/
+void control_unit_request_interrupt(const uint8_t interrupt_vector,
+                                    const bool requested);
+
+/********************************************************************************
+* control_unit_read_register: Returns the content of specified CPU register.
+*                             If an invalid register is specified, 0x00 is
+*                             returned.
+*
+*                             - address: Address of the CPU register.
+********************************************************************************/
+uint8_t control_unit_read_register(const uint8_t address);
+
+/********************************************************************************
+* control_unit_write_register: Writes specified value to specified CPU
+*                              register. Returns 0 after successful write or
+*                              error code 1 if an invalid register is
+*                              specified.
+*
+*                              - address: Address of the CPU register.
+*                              - value  : The value to write.
+********************************************************************************/
+int control_unit_write_register(const uint8_t address,
+                                const uint8_t value);
+
+/********************************************************************************
+* control_unit_read_status_register: Returns the content of the status
+*                                    register (bits INZVC).
+********************************************************************************/
+uint8_t control_unit_read_status_register(void);
+
+/********************************************************************************
+* control_unit_write_status_register: Writes specified value to the status
+*                                     register (bits INZVC).
+*
+*                                     - value: The value to write.
+********************************************************************************/
+void control_unit_write_status_register(const uint8_t value);
+
+/********************************************************************************
+* control_unit_read_program_counter: Returns the address of the next
+*                                    instruction to fetch.
+********************************************************************************/
+uint8_t control_unit_read_program_counter(void);
+
+/********************************************************************************
+* control_unit_current_address: Returns the address of the instruction in
+*                               progress, or of the next instruction to fetch
+*                               at an instruction boundary.
+********************************************************************************/
+uint8_t control_unit_current_address(void);
+
+/********************************************************************************
+* control_unit_write_program_counter: Sets the address of the next instruction
+*                                     to fetch. Should only be called at an
+*                                     instruction boundary.
+*
+*                                     - address: The new program counter.
+********************************************************************************/
+void control_unit_write_program_counter(const uint8_t address);
+
+/********************************************************************************
+* control_unit_state: Returns the next state in the CPU instruction cycle.
+********************************************************************************/
+enum cpu_state control_unit_state(void);
+
+/********************************************************************************
+* control_unit_cycles: Returns the number of clock cycles, i.e. states in the
+*                      CPU instruction cycle, run since the last external
+*                      reset by control_unit_reset.
+********************************************************************************/
+uint64_t control_unit_cycles(void);
+
+/********************************************************************************
+* control_unit_coverage: Returns a reference to the coverage map collected by
+*                        the calling thread, see coverage.h. The map isn't
+*                        cleared at system reset.
+********************************************************************************/
+struct coverage_map* control_unit_coverage(void);
+
+/********************************************************************************
+* control_unit_snapshot: Stores the complete architectural state of the
+*                        system, i.e. the control unit, the data memory and
+*                        the stack, at referenced location. Snapshots of
+*                        equal states are equal byte by byte.
+*
+*                        - self: Reference to the snapshot.
+********************************************************************************/
+void control_unit_snapshot(struct control_unit_snapshot* self);
+
+/********************************************************************************
+* control_unit_restore: Restores the complete architectural state of the
+*                       system from referenced snapshot, so that the system
+*                       continues as if it had never left the state. The
+*                       program memory isn't part of the snapshot.
+*
+*                       - self: Reference to the snapshot.
+********************************************************************************/
+void control_unit_restore(const struct control_unit_snapshot* self);
+
+/********************************************************************************
+* control_unit_snapshot_reset: Stores the state of the system after a reset
+*                              at referenced location, without resetting
+*                              the system, for instance to start a new
+*                              instance that is later restored.
+*
+*                              - self: Reference to the snapshot.
+********************************************************************************/
+void control_unit_snapshot_reset(struct control_unit_snapshot* self);
+
+/********************************************************************************
+* control_unit_snapshot_hash: Returns a 64-bit FNV-1a hash of referenced
+*                             snapshot. Equal snapshots have equal hashes.
+*
+*                             - self: Reference to the snapshot.
+********************************************************************************/
+uint64_t control_unit_snapshot_hash(const struct control_unit_snapshot* self);
+
+/********************************************************************************
+* control_unit_print: Prints information about the processor, for instance
+*                     current subroutine, instruction, state, content in
+*                     CPU-registers and I/O registers DDRB, PORTB and PINB.
+********************************************************************************/
+void control_unit_print(void);
+
 #endif /* CONTROL_UNIT_H_ */
\ No newline at end of file
@@ -0,0 +1,289 @@
+/********************************************************************************
+* coverage.c: Contains functionality for instruction and branch coverage of
+*             the program in program memory.
+********************************************************************************/
+#include <string.h>
+#include "coverage.h"
+#include "control_unit.h"
+
+#define MAGIC_SIZE   6                                    /* Number of bytes in the magic of the header. */
+#define BITMAP_SIZE  (PROGRAM_MEMORY_ADDRESS_WIDTH / 8)   /* Bytes per bit array in the bitmap file. */
+
+static const char magic[MAGIC_SIZE] = { 'C', 'P', 'U', 'C', 'O', 'V' };
+
+static uint16_t program_length(void);
+static inline bool is_branch(const uint8_t address);
+static const char* branch_text(const struct coverage_map* self,
+                               const uint8_t address);
+
+/********************************************************************************
+* coverage_reset: Clears the coverage collected by the calling thread.
+********************************************************************************/
+void coverage_reset(void)
+{
+   memset(control_unit_coverage(), 0, sizeof(struct coverage_map));
+   return;
+}
+
+/********************************************************************************
+* coverage_collect: Merges the coverage collected by the calling thread into
+*                   referenced map. Maps of several threads can be merged
+*                   into a common map, as long as the merges don't overlap.
+*
+*                   - self: Reference to the map.
+********************************************************************************/
+void coverage_collect(struct coverage_map* self)
+{
+   coverage_merge(self, control_unit_coverage());
+   return;
+}
+
+/********************************************************************************
+* coverage_merge: Merges the coverage of specified map into referenced map.
+*
+*                 - self : Reference to the map to merge into.
+*                 - other: Reference to the map to merge.
+********************************************************************************/
+void coverage_merge(struct coverage_map* self,
+                    const struct coverage_map* other)
+{
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      self->executed[i] |= other->executed[i];
+      self->branches[i][0] |= other->branches[i][0];
+      self->branches[i][1] |= other->branches[i][1];
+   }
+   return;
+}
+
+/********************************************************************************
+* coverage_save: Saves referenced map to a bitmap file with specified path,
+*                which is replaced if it exists. Returns 0 after success or
+*                error code 1 if the file couldn't be written.
+*
+*                - self    : Reference to the map.
+*                - filepath: Path to the bitmap file.
+********************************************************************************/
+int coverage_save(const struct coverage_map* self,
+                  const char* filepath)
+{
+   uint8_t executed[BITMAP_SIZE] = { 0 };
+   uint8_t branches[2 * BITMAP_SIZE] = { 0 };
+   const uint32_t hash = program_memory_hash();
+   const uint8_t header[5] = { COVERAGE_VERSION, (uint8_t)hash, (uint8_t)(hash >> 8),
+                               (uint8_t)(hash >> 16), (uint8_t)(hash >> 24) };
+   FILE* file = fopen(filepath, "wb");
+   if (!file) return 1;
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      if (self->executed[i]) set(executed[i / 8], i % 8);
+      if (self->branches[i][0]) set(branches[i / 4], (i % 4) * 2);
+      if (self->branches[i][1]) set(branches[i / 4], ((i % 4) * 2 + 1));
+   }
+
+   const bool written = fwrite(magic, 1, MAGIC_SIZE, file) == MAGIC_SIZE &&
+                        fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+                        fwrite(executed, 1, sizeof(executed), file) == sizeof(executed) &&
+                        fwrite(branches, 1, sizeof(branches), file) == sizeof(branches);
+   return fclose(file) || !written;
+}
+
+/********************************************************************************
+* coverage_load: Merges the bitmap file with specified path into referenced
+*                map. Returns 0 after success or error code 1 if the file
+*                couldn't be read or was saved for another program.
+*
+*                - self    : Reference to the map.
+*                - filepath: Path to the bitmap file.
+********************************************************************************/
+int coverage_load(struct coverage_map* self,
+                  const char* filepath)
+{
+   char file_magic[MAGIC_SIZE];
+   uint8_t header[5];
+   uint8_t executed[BITMAP_SIZE];
+   uint8_t branches[2 * BITMAP_SIZE];
+   FILE* file = fopen(filepath, "rb");
+   if (!file) return 1;
+
+   const bool valid = fread(file_magic, 1, MAGIC_SIZE, file) == MAGIC_SIZE &&
+                      fread(header, 1, sizeof(header), file) == sizeof(header) &&
+                      fread(executed, 1, sizeof(executed), file) == sizeof(executed) &&
+                      fread(branches, 1, sizeof(branches), file) == sizeof(branches) &&
+                      !memcmp(file_magic, magic, MAGIC_SIZE) && header[0] == COVERAGE_VERSION;
+   fclose(file);
+
+   if (!valid)
+   {
+      fprintf(stderr, "%s is not a coverage bitmap!\n", filepath);
+      return 1;
+   }
+
+   const uint32_t hash = header[1] | (header[2] << 8) | (header[3] << 16) | ((uint32_t)header[4] << 24);
+
+   if (hash != program_memory_hash())
+   {
+      fprintf(stderr, "%s was saved for another program (hash 0x%08X, loaded 0x%08X)!\n",
+              filepath, hash, program_memory_hash());
+      return 1;
+   }
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      if (read(executed[i / 8], i % 8)) self->executed[i] = 1;
+      if (read(branches[i / 4], (i % 4) * 2)) self->branches[i][0] = 1;
+      if (read(branches[i / 4], (i % 4) * 2 + 1)) self->branches[i][1] = 1;
+   }
+   return 0;
+}
+
+/********************************************************************************
+* coverage_print: Prints an annotated listing of the program to specified
+*                 stream, with the subroutine names of program_memory. Every
+*                 instruction that was run is marked with +, every other
+*                 instruction with -, and conditional branches show which
+*                 ways they went. The listing ends with a summary.
+*
+*                 - self   : Reference to the map.
+*                 - ostream: Reference to the stream, for instance stdout.
+********************************************************************************/
+void coverage_print(const struct coverage_map* self,
+                    FILE* ostream)
+{
+   const uint16_t length = program_length();
+   const char* subroutine = 0;
+   uint16_t num_executed = 0, num_branches = 0, num_directions = 0;
+
+   for (uint16_t i = 0; i < length; ++i)
+   {
+      const uint32_t instruction = breakpoint_instruction((uint8_t)i);
+      const char* name = program_memory_subroutine_name((uint8_t)i);
+
+      if (!subroutine || strcmp(name, subroutine))
+      {
+         fprintf(ostream, "%s%s:\n", subroutine ? "\n" : "", name);
+         subroutine = name;
+      }
+
+      fprintf(ostream, "%c 0x%02X  %-5s 0x%02X, 0x%02X", self->executed[i] ? '+' : '-', i,
+              cpu_instruction_name((uint8_t)(instruction >> 16)), (instruction >> 8) & 0xFF, instruction & 0xFF);
+
+      if (is_branch((uint8_t)i))
+      {
+         fprintf(ostream, "  [%s]", branch_text(self, (uint8_t)i));
+         num_branches++;
+         num_directions += (self->branches[i][0] != 0) + (self->branches[i][1] != 0);
+      }
+
+      fprintf(ostream, "\n");
+      if (self->executed[i]) num_executed++;
+   }
+
+   fprintf(ostream, "\nInstructions run: %hu of %hu (%.1f %%)\n", num_executed, length,
+           length ? 100.0 * num_executed / length : 0.0);
+   fprintf(ostream, "Branch directions taken: %hu of %hu (%.1f %%)\n\n", num_directions, 2 * num_branches,
+           num_branches ? 50.0 * num_directions / num_branches : 0.0);
+   return;
+}
+
+/********************************************************************************
+* coverage_write_lcov: Writes referenced map as an lcov tracefile with
+*                      specified path, which is replaced if it exists. Every
+*                      program memory address is a line of specified source
+*                      file and every subroutine is a function. Returns 0
+*                      after success or error code 1 if the file couldn't be
+*                      written.
+*
+*                      - self    : Reference to the map.
+*                      - source  : Name of the source file in the tracefile.
+*                      - filepath: Path to the tracefile.
+********************************************************************************/
+int coverage_write_lcov(const struct coverage_map* self,
+                        const char* source,
+                        const char* filepath)
+{
+   const uint16_t length = program_length();
+   uint16_t num_functions = 0, num_functions_hit = 0;
+   uint16_t num_lines_hit = 0, num_branches = 0, num_branches_hit = 0;
+   FILE* file = fopen(filepath, "w");
+   if (!file) return 1;
+
+   fprintf(file, "TN:\nSF:%s\n", source);
+
+   for (uint16_t start = 0; start < length;)
+   {
+      const char* name = program_memory_subroutine_name((uint8_t)start);
+      uint16_t end = start;
+      bool hit = false;
+
+      while (end < length && !strcmp(program_memory_subroutine_name((uint8_t)end), name))
+      {
+         hit = hit || self->executed[end];
+         end++;
+      }
+
+      fprintf(file, "FN:%hu,%s\nFNDA:%d,%s\n", start + 1, name, hit, name);
+      num_functions++;
+      num_functions_hit += hit;
+      start = end;
+   }
+
+   fprintf(file, "FNF:%hu\nFNH:%hu\n", num_functions, num_functions_hit);
+
+   for (uint16_t i = 0; i < length; ++i)
+   {
+      if (!is_branch((uint8_t)i)) continue;
+
+      for (uint8_t taken = 0; taken < 2; ++taken)
+      {
+         if (self->executed[i])
+         {
+            fprintf(file, "BRDA:%hu,0,%hu,%d\n", i + 1, taken, self->branches[i][taken] != 0);
+         }
+         else
+         {
+            fprintf(file, "BRDA:%hu,0,%hu,-\n", i + 1, taken);
+         }
+         num_branches++;
+         num_branches_hit += self->branches[i][taken] != 0;
+      }
+   }
+
+   fprintf(file, "BRF:%hu\nBRH:%hu\n", num_branches, num_branches_hit);
+
+   for (uint16_t i = 0; i < length; ++i)
+   {
+      fprintf(file, "DA:%hu,%d\n", i + 1, self->executed[i] != 0);
+      num_lines_hit += self->executed[i] != 0;
+   }
+
+   fprintf(file, "LF:%hu\nLH:%hu\nend_of_record\n", length, num_lines_hit);
+   return fclose(file);
+}
+
+/********************************************************************************
+* program_length: Returns the number of addresses up to and including the
+*                 last instruction other than NOP in program memory.
+********************************************************************************/
+static uint16_t program_length(void)
+{
+   uint16_t length = PROGRAM_MEMORY_ADDRESS_WIDTH;
+   while (length > 0 && !breakpoint_instruction((uint8_t)(length - 1))) length--;
+   return length;
+}
+
+static inline bool is_branch(const uint8_t address)
+{
+   const uint8_t op_code = (uint8_t)(breakpoint_instruction(address) >> 16);
+   return (op_code >= BREQ && op_code <= BRLT) || op_code == BRGES || op_code == BRLTS;
+}
+
+static const char* branch_text(const struct coverage_map* self,
+                               const uint8_t address)
+{
+   if (self->branches[address][0] && self->branches[address][1]) return "taken and not taken";
+   else if (self->branches[address][1]) return "only taken";
+   else if (self->branches[address][0]) return "only not taken";
+   else return "never run";
+}
\ No newline at end of file
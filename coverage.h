@@ -0,0 +1,115 @@
+/********************************************************************************
+* coverage.h: Contains functionality for instruction and branch coverage of
+*             the program in program memory, for instance to show that every
+*             instruction has been run and every conditional branch has gone
+*             both ways during qualification of a program.
+*
+*             The control unit collects coverage for each thread in a
+*             coverage map, with one byte per program memory address that
+*             is set when the instruction at the address is run, and two
+*             bytes per address that are set when a conditional branch at
+*             the address is taken or not taken. The bytes are only ever
+*             set by plain stores, so collecting coverage costs next to
+*             nothing and is always enabled.
+*
+*             Maps of several runs or threads are merged by a bitwise OR.
+*             A map can be saved to and merged from a bitmap file, which
+*             holds a hash of the program so that maps of other programs
+*             are rejected, and it can be exported as an annotated listing
+*             or as an lcov tracefile, where every program memory address
+*             is a line.
+********************************************************************************/
+#ifndef COVERAGE_H_
+#define COVERAGE_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "program_memory.h"
+#include "breakpoint.h"
+
+#define COVERAGE_VERSION 2 /* Version of the bitmap file format. */
+
+/********************************************************************************
+* coverage_map: Instruction and branch coverage of the program memory.
+********************************************************************************/
+struct coverage_map
+{
+   uint8_t executed[PROGRAM_MEMORY_ADDRESS_WIDTH];    /* Set if the instruction was run. */
+   uint8_t branches[PROGRAM_MEMORY_ADDRESS_WIDTH][2]; /* Set if the branch wasn't taken [0] or taken [1]. */
+};
+
+/********************************************************************************
+* coverage_reset: Clears the coverage collected by the calling thread.
+********************************************************************************/
+void coverage_reset(void);
+
+/********************************************************************************
+* coverage_collect: Merges the coverage collected by the calling thread into
+*                   referenced map. Maps of several threads can be merged
+*                   into a common map, as long as the merges don't overlap.
+*
+*                   - self: Reference to the map.
+********************************************************************************/
+void coverage_collect(struct coverage_map* self);
+
+/********************************************************************************
+* coverage_merge: Merges the coverage of specified map into referenced map.
+*
+*                 - self : Reference to the map to merge into.
+*                 - other: Reference to the map to merge.
+********************************************************************************/
+void coverage_merge(struct coverage_map* self,
+                    const struct coverage_map* other);
+
+/********************************************************************************
+* coverage_save: Saves referenced map to a bitmap file with specified path,
+*                which is replaced if it exists. Returns 0 after success or
+*                error code 1 if the file couldn't be written.
+*
+*                - self    : Reference to the map.
+*                - filepath: Path to the bitmap file.
+********************************************************************************/
+int coverage_save(const struct coverage_map* self,
+                  const char* filepath);
+
+/********************************************************************************
+* coverage_load: Merges the bitmap file with specified path into referenced
+*                map. Returns 0 after success or error code 1 if the file
+*                couldn't be read or was saved for another program.
+*
+*                - self    : Reference to the map.
+*                - filepath: Path to the bitmap file.
+********************************************************************************/
+int coverage_load(struct coverage_map* self,
+                  const char* filepath);
+
+/********************************************************************************
+* coverage_print: Prints an annotated listing of the program to specified
+*                 stream, with the subroutine names of program_memory. Every
+*                 instruction that was run is marked with +, every other
+*                 instruction with -, and conditional branches show which
+*                 ways they went. The listing ends with a summary.
+*
+*                 - self   : Reference to the map.
+*                 - ostream: Reference to the stream, for instance stdout.
+********************************************************************************/
+void coverage_print(const struct coverage_map* self,
+                    FILE* ostream);
+
+/********************************************************************************
+* coverage_write_lcov: Writes referenced map as an lcov tracefile with
+*                      specified path, which is replaced if it exists. Every
+*                      program memory address is a line of specified source
+*                      file and every subroutine is a function. Returns 0
+*                      after success or error code 1 if the file couldn't be
+*                      written.
+*
+*                      - self    : Reference to the map.
+*                      - source  : Name of the source file in the tracefile.
+*                      - filepath: Path to the tracefile.
+********************************************************************************/
+int coverage_write_lcov(const struct coverage_map* self,
+                        const char* source,
+                        const char* filepath);
+
+#endif /* COVERAGE_H_ */
\ No newline at end of file
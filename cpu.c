@@ -1,119 +1,281 @@
-/********************************************************************************
-* cpu.c: Contains function definitions for getting names of CPU instructions,
-*        CPU registers and number of binary digits in unsigned numbers as text.
-********************************************************************************/
-#include "cpu.h"
-
-/* Static functions: */
-static inline size_t num_binary_digits(uint32_t num);
-static inline char integer_to_char(const int num);
-
-/********************************************************************************
-* cpu_instruction_name: Returns the name of specified instruction.
-*
-*                       - instruction: The specified CPU instruction.
-********************************************************************************/
-const char* cpu_instruction_name(const uint8_t instruction)
-{
-   if (instruction == NOP)       return "NOP";
-   else if (instruction == LDI)  return "LDI";
-   else if (instruction == MOV)  return "MOV";
-   else if (instruction == IN)   return "IN";
-   else if (instruction == OUT)  return "OUT";
-   else if (instruction == STS)  return "STS";
-   else if (instruction == LDS)  return "LDS";
-   else if (instruction == ORI)  return "ORI";
-   else if (instruction == ANDI) return "ANDI";
-   else if (instruction == XORI) return "XORI";
-   else if (instruction == OR)   return "OR";
-   else if (instruction == AND)  return "AND";
-   else if (instruction == XOR)  return "XOR";
-   else if (instruction == CLR)  return "CLR";
-   else if (instruction == INC)  return "INC";
-   else if (instruction == DEC)  return "DEC";
-   else if (instruction == ADDI) return "ADDI";
-   else if (instruction == SUBI) return "SUBI";
-   else if (instruction == ADDI) return "ADD";
-   else if (instruction == SUBI) return "SUB";
-   else if (instruction == LSL)  return "LSL";
-   else if (instruction == LSR)  return "LSR";
-   else if (instruction == BREQ) return "BREQ";
-   else if (instruction == BRNE) return "BRNE";
-   else if (instruction == BRGE) return "BRGE";
-   else if (instruction == BRGT) return "BRGT";
-   else if (instruction == BRLE) return "BRLE";
-   else if (instruction == BRLT) return "BRLT";
-   else if (instruction == JMP)  return "JMP";
-   else if (instruction == CPI)  return "CPI";
-   else if (instruction == CP)   return "CP";
-   else if (instruction == CALL) return "CALL";
-   else if (instruction == RET)  return "RET";
-   else if (instruction == PUSH) return "PUSH";
-   else if (instruction == POP)  return "POP";
-   else if (instruction == SEI)  return "SEI";
-   else if (instruction == CLI)  return "CLI";
-   else if (instruction == RETI) return "RETI";
-   else return "Unknown";
-}
-
-/********************************************************************************
-* cpu_state_name: Returns the name of specified CPU state.
-*
-*                 - state: The specified CPU state.
-********************************************************************************/
-const char* cpu_state_name(const enum cpu_state state)
-{
-   if (state == CPU_STATE_FETCH)        return "Fetch";
-   else if (state == CPU_STATE_DECODE)  return "Decode";
-   else if (state == CPU_STATE_EXECUTE) return "Execute";
-   else return "Unknown";
-}
-
-/********************************************************************************
-* get_binary: Returns specified number as a binary string with specified
-*             minimum number of characters.
-*
-*             - num      : The specified number.
-*             - min_chars: Minimum number of characters in the returned string.
-********************************************************************************/
-const char* get_binary(uint32_t num,
-                       const uint8_t min_chars)
-{
-   static char s[33] = { '\0' };
-
-   size_t size = num_binary_digits(num);
-   if (size < min_chars) size = min_chars;
-   s[size] = '\0';
-
-   for (size_t i = 0; i < size; ++i)
-   {
-      s[size - 1 - i] = integer_to_char(num % 2);
-      num /= 2;
-   }
-
-   s[size] = '\0';
-   return s;
-}
-
-/********************************************************************************
-* get_binary_digits: Returns the number of binary digits in specified number.
-* 
-*                    - num: The number in unsigned integer form.
-********************************************************************************/
-static inline size_t num_binary_digits(uint32_t num)
-{
-   size_t num_digits = 1;
-   while (num /= 2) num_digits++;
-   return num_digits;
-}
-
-/********************************************************************************
-* integer_to_char: Converts specified number from integer to corresponding 
-*                  character in the ASCII-table.
-*
-*                    - num: The number in integer form.
-********************************************************************************/
-static inline char integer_to_char(const int num)
-{
-   return num + 48;
-}
+/********************************************************************************
+* cpu.c: Contains function definitions for getting names of CPU instructions,
+*        CPU registers and number of binary digits in unsigned numbers as text,
+*        and for reading the clock and the number of cores of the host.
+********************************************************************************/
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "cpu.h"
+
+/* Static functions: */
+static inline size_t num_binary_digits(uint32_t num);
+static inline char integer_to_char(const int num);
+
+/********************************************************************************
+* cpu_instruction_name: Returns the name of specified instruction.
+*
+*                       - instruction: The specified CPU instruction.
+********************************************************************************/
+const char* cpu_instruction_name(const uint8_t instruction)
+{
+   if (instruction == NOP)       return "NOP";
+   else if (instruction == LDI)  return "LDI";
+   else if (instruction == MOV)  return "MOV";
+   else if (instruction == IN)   return "IN";
+   else if (instruction == OUT)  return "OUT";
+   else if (instruction == STS)  return "STS";
+   else if (instruction == LDS)  return "LDS";
+   else if (instruction == ORI)  return "ORI";
+   else if (instruction == ANDI) return "ANDI";
+   else if (instruction == XORI) return "XORI";
+   else if (instruction == OR)   return "OR";
+   else if (instruction == AND)  return "AND";
+   else if (instruction == XOR)  return "XOR";
+   else if (instruction == CLR)  return "CLR";
+   else if (instruction == INC)  return "INC";
+   else if (instruction == DEC)  return "DEC";
+   else if (instruction == ADDI) return "ADDI";
+   else if (instruction == SUBI) return "SUBI";
+   else if (instruction == ADDI) return "ADD";
+   else if (instruction == SUBI) return "SUB";
+   else if (instruction == LSL)  return "LSL";
+   else if (instruction == LSR)  return "LSR";
+   else if (instruction == BREQ) return "BREQ";
+   else if (instruction == BRNE) return "BRNE";
+   else if (instruction == BRGE) return "BRGE";
+   else if (instruction == BRGT) return "BRGT";
+   else if (instruction == BRLE) return "BRLE";
+   else if (instruction == BRLT) return "BRLT";
+   else if (instruction == JMP)  return "JMP";
+   else if (instruction == CPI)  return "CPI";
+   else if (instruction == CP)   return "CP";
+   else if (instruction == CALL) return "CALL";
+   else if (instruction == RET)  return "RET";
+   else if (instruction == PUSH) return "PUSH";
+   else if (instruction == POP)  return "POP";
+   else if (instruction == SEI)  return "SEI";
+   else if (instruction == CLI)  return "CLI";
+   else if (instruction == RETI) return "RETI";
+   else if (instruction == LD)   return "LD";
+   else if (instruction == LDP)  return "LD+";
+   else if (instruction == LDM)  return "-LD";
+   else if (instruction == ST)   return "ST";
+   else if (instruction == STP)  return "ST+";
+   else if (instruction == STM)  return "-ST";
+   else if (instruction == LDDY) return "LDD Y";
+   else if (instruction == LDDZ) return "LDD Z";
+   else if (instruction == STDY) return "STD Y";
+   else if (instruction == STDZ) return "STD Z";
+   else if (instruction == LPM)  return "LPM";
+   else if (instruction == LPMP) return "LPM+";
+   else if (instruction == ADC)  return "ADC";
+   else if (instruction == SBC)  return "SBC";
+   else if (instruction == MOVW) return "MOVW";
+   else if (instruction == ADIW) return "ADIW";
+   else if (instruction == SBIW) return "SBIW";
+   else if (instruction == MUL)  return "MUL";
+   else if (instruction == MULS) return "MULS";
+   else if (instruction == MULSU) return "MULSU";
+   else if (instruction == BREAK) return "BREAK";
+   else if (instruction == LDSX) return "LDSX";
+   else if (instruction == STSX) return "STSX";
+   else if (instruction == INSR) return "INSR";
+   else if (instruction == OUTSR) return "OUTSR";
+   else if (instruction == INSP) return "INSP";
+   else if (instruction == OUTSP) return "OUTSP";
+   else if (instruction == BRGES) return "BRGES";
+   else if (instruction == BRLTS) return "BRLTS";
+   else return "Unknown";
+}
+
+/********************************************************************************
+* cpu_sreg_from_sr: Returns specified status register (bits INZVC) in the
+*                   format of the AVR SREG (bits ITHSVNZC), where S = N ^ V.
+*
+*                   - sr: The content of the status register.
+********************************************************************************/
+uint8_t cpu_sreg_from_sr(const uint8_t sr)
+{
+   uint8_t sreg = 0x00;
+   if (read(sr, I)) set(sreg, 7);
+   if (read(sr, N)) set(sreg, 2);
+   if (read(sr, Z)) set(sreg, 1);
+   if (read(sr, V)) set(sreg, 3);
+   if (read(sr, C)) set(sreg, 0);
+   if (!read(sr, N) != !read(sr, V)) set(sreg, 4); /* S = N ^ V. */
+   return sreg;
+}
+
+/********************************************************************************
+* cpu_sr_from_sreg: Returns the status register (bits INZVC) corresponding to
+*                   specified AVR SREG. The T, H and S bits are dropped.
+*
+*                   - sreg: The content of the AVR SREG.
+********************************************************************************/
+uint8_t cpu_sr_from_sreg(const uint8_t sreg)
+{
+   uint8_t sr = 0x00;
+   if (read(sreg, 7)) set(sr, I);
+   if (read(sreg, 2)) set(sr, N);
+   if (read(sreg, 1)) set(sr, Z);
+   if (read(sreg, 3)) set(sr, V);
+   if (read(sreg, 0)) set(sr, C);
+   return sr;
+}
+
+/********************************************************************************
+* cpu_state_name: Returns the name of specified CPU state.
+*
+*                 - state: The specified CPU state.
+********************************************************************************/
+const char* cpu_state_name(const enum cpu_state state)
+{
+   if (state == CPU_STATE_FETCH)        return "Fetch";
+   else if (state == CPU_STATE_DECODE)  return "Decode";
+   else if (state == CPU_STATE_EXECUTE) return "Execute";
+   else return "Unknown";
+}
+
+/********************************************************************************
+* cpu_format_register_name: Writes the name of specified CPU register to
+*                           referenced buffer, which must hold at least
+*                           CPU_NAME_BUFFER_SIZE characters, and returns
+*                           the buffer. Unlike cpu_register_name, the
+*                           function can be called from several threads.
+*
+*                           - reg   : The specified CPU register.
+*                           - buffer: Reference to the buffer.
+********************************************************************************/
+char* cpu_format_register_name(const uint8_t reg,
+                               char* buffer)
+{
+   if (reg < CPU_REGISTER_ADDRESS_WIDTH)
+   {
+      sprintf(buffer, "R%hu", reg);
+   }
+   else
+   {
+      sprintf(buffer, "Unknown");
+   }
+   return buffer;
+}
+
+/********************************************************************************
+* cpu_register_name: Returns the name of specified CPU register.
+*
+*                    - reg: The specified CPU register.
+********************************************************************************/
+const char* cpu_register_name(const uint8_t reg)
+{
+   static char s[CPU_NAME_BUFFER_SIZE] = { '\0' };
+   return cpu_format_register_name(reg, s);
+}
+
+/********************************************************************************
+* cpu_format_binary: Writes specified number as a binary string with specified
+*                    minimum number of characters to referenced buffer, which
+*                    must hold at least CPU_BINARY_BUFFER_SIZE characters, and
+*                    returns the buffer. Unlike get_binary, the function can
+*                    be called from several threads.
+*
+*                    - num      : The specified number.
+*                    - min_chars: Minimum number of characters in the string.
+*                    - buffer   : Reference to the buffer.
+********************************************************************************/
+char* cpu_format_binary(uint32_t num,
+                        const uint8_t min_chars,
+                        char* buffer)
+{
+   size_t size = num_binary_digits(num);
+   if (size < min_chars) size = min_chars;
+   if (size > CPU_BINARY_BUFFER_SIZE - 1) size = CPU_BINARY_BUFFER_SIZE - 1;
+
+   for (size_t i = 0; i < size; ++i)
+   {
+      buffer[size - 1 - i] = integer_to_char(num % 2);
+      num /= 2;
+   }
+
+   buffer[size] = '\0';
+   return buffer;
+}
+
+/********************************************************************************
+* get_binary: Returns specified number as a binary string with specified
+*             minimum number of characters.
+*
+*             - num      : The specified number.
+*             - min_chars: Minimum number of characters in the returned string.
+********************************************************************************/
+const char* get_binary(uint32_t num,
+                       const uint8_t min_chars)
+{
+   static char s[CPU_BINARY_BUFFER_SIZE] = { '\0' };
+   return cpu_format_binary(num, min_chars, s);
+}
+
+/********************************************************************************
+* cpu_seconds_now: Returns the time in seconds of a monotonic clock of the
+*                  host, for measuring durations.
+********************************************************************************/
+double cpu_seconds_now(void)
+{
+#ifdef _WIN32
+   LARGE_INTEGER counter, frequency;
+   QueryPerformanceCounter(&counter);
+   QueryPerformanceFrequency(&frequency);
+   return (double)counter.QuadPart / frequency.QuadPart;
+#else
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec + now.tv_nsec / 1e9;
+#endif
+}
+
+/********************************************************************************
+* cpu_num_host_cores: Returns the number of cores of the host, limited to
+*                     specified maximum and at least 1.
+*
+*                     - max_cores: The maximum number of cores to return.
+********************************************************************************/
+uint8_t cpu_num_host_cores(const uint8_t max_cores)
+{
+#ifdef _WIN32
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   const long num_cores = (long)info.dwNumberOfProcessors;
+#else
+   const long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+   if (num_cores < 1) return 1;
+   return num_cores > max_cores ? max_cores : (uint8_t)num_cores;
+}
+
+/********************************************************************************
+* get_binary_digits: Returns the number of binary digits in specified number.
+* 
+*                    - num: The number in unsigned integer form.
+********************************************************************************/
+static inline size_t num_binary_digits(uint32_t num)
+{
+   size_t num_digits = 1;
+   while (num /= 2) num_digits++;
+   return num_digits;
+}
+
+/********************************************************************************
+* integer_to_char: Converts specified number from integer to corresponding 
+*                  character in the ASCII-table.
+*
+*                    - num: The number in integer form.
+********************************************************************************/
+static inline char integer_to_char(const int num)
+{
+   return num + 48;
+}
@@ -1,209 +1,355 @@
-/********************************************************************************
-* cpu.h: Contains miscellaneous definitions and declarations for implementation
-*        of an 8-bit processor based on AVR:s instruction list.
-********************************************************************************/
-#ifndef CPU_H_
-#define CPU_H_
-
-/* Include directives: */
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdint.h>
-#include <stdbool.h>
-
-#define NOP  0x00 /* No operation. */
-#define LDI  0x01 /* Loads constant into CPU register. */
-#define MOV  0x02 /* Copies content of a CPU-register to another CPU register. */
-#define OUT  0x03 /* Writes to I/O location. */
-#define IN   0x04 /* Reads from I/O location. */
-#define STS  0x05 /* Stores data to address in data memory. */
-#define LDS  0x06 /* Loads data from address in data memory. */
-#define CLR  0x07 /* Clears CPU register. */
-#define ORI  0x08 /* Performs bitwise OR with constant. */
-#define ANDI 0x09 /* Performs bitwise AND with constant. */
-#define XORI 0x0A /* Performs bitwise XOR with constant. */
-#define OR   0x0B /* Performs bitwise OR with content in a CPU register. */
-#define AND  0x0C /* Performs bitwise AND with content in a CPU register. */
-#define XOR  0x0D /* Performs bitwise XOR with content in a CPU register. */
-#define ADDI 0x0E /* Performs addition with a constant. */
-#define SUBI 0x0F /* Performs subtraction with a constant. */
-
-#define ADD  0x10 /* Performs addition with content in a CPU register. */
-#define SUB  0x11 /* Performs subtraction with content in a CPU register. */
-#define INC  0x12 /* Increments content of a CPU register. */
-#define DEC  0x13 /* Decrements content of a CPU register. */
-#define CPI  0x14 /* Compares content of a CPU register with a constant. */
-#define CP   0x15 /* Compares content between CPU registers. */
-#define JMP  0x16 /* Jumps to specified address. */
-#define BREQ 0x17 /* Jumps to specified address if result of last calculation is zero. */
-#define BRNE 0x18 /* Jumps to specified address if result of last calculation is not equal to zero. */
-#define BRGE 0x19 /* Jumps to specified address if result of last calculation is greater or equal to zero. */
-#define BRGT 0x1A /* Jumps to specified address if result of last calculation is greater than zero. */
-#define BRLE 0x1B /* Jumps to specified address if result of last calculation is lower or equal to zero. */
-#define BRLT 0x1C /* Jumps to specified address if result of last calculation is lower than zero. */
-#define CALL 0x1D /* Calls subroutine at specified address and stores the return address on the stack. */
-#define RET  0x1E /* Returns from subroutine by jumping to the return address popped from the stack. */
-#define RETI 0x1F /* Returns from interrupt by restoring program as it was before the interrupt occured. */
-
-#define PUSH 0x20 /* Pushes value stored in a CPU register to the stack. */
-#define POP  0x21 /* Pops value from the stack and loads it into a CPU register. */
-#define LSL  0x22 /* Shifts content of a CPU register one step to the left. */
-#define LSR  0x23 /* Shifts content of a CPU register one step to the right. */
-#define SEI  0x24 /* Enables interrupts globally by setting the I-flag of the status register. */
-#define CLI  0x25 /* Disables interrupts globally by clearning the I-flag of the status register. */
-
-#define DDRB  0x00 /* Data direction register for I/O-port B. */
-#define PORTB 0x01 /* Data register for I/O-port B. */
-#define PINB  0x02 /* Pin input register for I/O-port B. */
-
-#define DDRC  0x03 /* Data direction register for I/O-port C. */
-#define PORTC 0x04 /* Data register for I/O-port C. */
-#define PINC  0x05 /* Pin input register for I/O-port C. */
-
-#define DDRD  0x06 /* Data direction register for I/O-port D. */
-#define PORTD 0x07 /* Data register for I/O-port D. */
-#define PIND  0x08 /* Pin input register for I/O-port D. */
-
-#define PCICR 0x09 /* Pin change interrupt control register for all I/O-ports. */
-#define PCIFR 0x0A /* Pin change interrupt flag register for all I/O-ports. */
-
-#define PCMSK0 0x10 /* Pin change interrupt mask register for I/O-port B. */
-#define PCMSK1 0x11 /* Pin change interrupt mask register for I/O-port C. */
-#define PCMSK2 0x12 /* Pin change interrupt mask register for I/O-port D. */
-
-#define PCIE0 0 /* Pin change interrupt enable bit for I/O-port B. */
-#define PCIE1 1 /* Pin change interrupt enable bit for I/O-port C. */
-#define PCIE2 2 /* Pin change interrupt enable bit for I/O-port D. */
-
-#define PCIF0 0 /* Pin change interrupt flag bit for I/O-port B. */
-#define PCIF1 1 /* Pin change interrupt flag bit for I/O-port C. */
-#define PCIF2 2 /* Pin change interrupt flag bit for I/O-port D. */
-
-#define RESET_vect  0x00 /* Reset vector. */
-#define PCINT0_vect 0x02 /* Pin change interrupt vector 0 (for I/O-port B). */
-#define PCINT1_vect 0x04 /* Pin change interrupt vector 0 (for I/O-port C). */
-#define PCINT2_vect 0x06 /* Pin change interrupt vector 0 (for I/O-port D). */
-
-#define R0  0x00 /* Address for CPU register R0. */
-#define R1  0x01 /* Address for CPU register R1. */
-#define R2  0x02 /* Address for CPU register R2. */
-#define R3  0x03 /* Address for CPU register R3. */
-#define R4  0x04 /* Address for CPU register R4. */
-#define R5  0x05 /* Address for CPU register R5. */
-#define R6  0x06 /* Address for CPU register R6. */
-#define R7  0x07 /* Address for CPU register R7. */
-#define R8  0x08 /* Address for CPU register R8. */
-#define R9  0x09 /* Address for CPU register R9. */
-#define R10 0x0A /* Address for CPU register R10. */
-#define R11 0x0B /* Address for CPU register R11. */
-#define R12 0x0C /* Address for CPU register R12. */
-#define R13 0x0D /* Address for CPU register R13. */
-#define R14 0x0E /* Address for CPU register R14. */
-#define R15 0x0F /* Address for CPU register R15. */
-
-#define R16 0x10 /* Address for CPU register R16. */
-#define R17 0x11 /* Address for CPU register R17. */
-#define R18 0x12 /* Address for CPU register R18. */
-#define R19 0x13 /* Address for CPU register R19. */
-#define R20 0x14 /* Address for CPU register R20. */
-#define R21 0x15 /* Address for CPU register R21. */
-#define R22 0x16 /* Address for CPU register R22. */
-#define R23 0x17 /* Address for CPU register R23. */
-#define R24 0x18 /* Address for CPU register R24. */
-#define R25 0x19 /* Address for CPU register R25. */
-#define R26 0x1A /* Address for CPU register R26. */
-#define R27 0x1B /* Address for CPU register R27. */
-#define R28 0x1C /* Address for CPU register R28. */
-#define R29 0x1D /* Address for CPU register R29. */
-#define R30 0x1E /* Address for CPU register R30. */
-#define R31 0x1F /* Address for CPU register R31. */
-
-#define CPU_REGISTER_ADDRESS_WIDTH 32 /* 32 CPU registers in control unit. */
-#define CPU_REGISTER_DATA_WIDTH    8  /* 8 bit data width per CPU register. */
-#define IO_REGISTER_DATA_WIDTH     8  /* 8 bit data width per I/O location. */
-
-#define I 4 /* Interrupt flag in status register. */
-#define N 3 /* Negative flag in status register. */
-#define Z 2 /* Zero flag in status register. */
-#define V 1 /* Overflow flag in status register. */
-#define C 0 /* Carry flag in status register. */
-
-/********************************************************************************
-* set: Sets bit in specified register without affecting other bits.
-* 
-*      - reg: Reference to the register.
-*      - bit: The bit to be set in the referenced register.
-********************************************************************************/
-#define set(reg, bit)  reg |= (1 << bit)
-
-/********************************************************************************
-* clr: Clears bit in specified register without affecting other bits.
-*
-*      - reg: Reference to the register.
-*      - bit: The bit to be cleared in the referenced register.
-********************************************************************************/
-#define clr(reg, bit)  reg &= ~(1 << (bit))
-
-/********************************************************************************
-* read: Reads bit from specified register. The return value is not equal to
-*       zero if the bit is high. If the bit is low the return value is zero.
-*
-*       - reg: Reference to the register.
-*       - bit: The bit to be read in the referenced register.
-********************************************************************************/
-#define read(reg, bit) (reg & (1 << (bit)))
-
-/********************************************************************************
-* cpu_state: Enumeration for the different states of the CPU instructio cycle.
-********************************************************************************/
-enum cpu_state
-{
-   CPU_STATE_FETCH,  /* Fetches next instruction from program memory. */
-   CPU_STATE_DECODE, /* Decodes the fetched instruction. */
-   CPU_STATE_EXECUTE /* Executes the decoded instruction. */
-};
-
-/********************************************************************************
-* cpu_instruction_name: Returns the name of specified instruction.
-*
-*                       - instruction: The specified CPU instruction.
-********************************************************************************/
-const char* cpu_instruction_name(const uint8_t instruction);
-
-/********************************************************************************
-* cpu_state_name: Returns the name of specified CPU state.
-*
-*                 - state: The specified CPU state.
-********************************************************************************/
-const char* cpu_state_name(const enum cpu_state state);
-
-/********************************************************************************
-* cpu_register_name: Returns the name of specified CPU register.
-*
-*                    - reg: The specified CPU register.
-********************************************************************************/
-static const char* cpu_register_name(const uint8_t reg)
-{
-   if (reg < CPU_REGISTER_ADDRESS_WIDTH)
-   {
-      static char s[10] = { '\0' };
-      sprintf(s, "R%hu", reg);
-      return s;
-   }
-   else
-   {
-      return "Unknown";
-   }
-}
-
-/********************************************************************************
-* get_binary: Returns specified number as a binary string with specified
-*             minimum number of characters.
-*
-*             - num      : The specified number.
-*             - min_chars: Minimum number of characters in the returned string.
-********************************************************************************/
-const char* get_binary(uint32_t num,
-                       const uint8_t min_chars);
-
+/********************************************************************************
+* cpu.h: Contains miscellaneous definitions and declarations for implementation
+*        of an 8-bit processor based on AVR:s instruction list.
+********************************************************************************/
+#ifndef CPU_H_
+#define CPU_H_
+
+/* Include directives: */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************************************************************
+* CPU_THREAD_LOCAL: Storage class for the state of the emulated system. Every
+*                   thread runs its own instance of the system, so that
+*                   several instances can run in parallel on all host cores.
+********************************************************************************/
+#ifdef _MSC_VER
+#define CPU_THREAD_LOCAL __declspec(thread)
+#else
+#define CPU_THREAD_LOCAL _Thread_local
+#endif
+
+/********************************************************************************
+* CPU_COLD: Attribute for rarely called functions, such as calls of optional
+*           hooks, which are kept out of line so that they don't slow down
+*           the functions of the hot path that call them.
+********************************************************************************/
+#ifdef _MSC_VER
+#define CPU_COLD __declspec(noinline)
+#else
+#define CPU_COLD __attribute__((noinline, cold))
+#endif
+
+#define NOP  0x00 /* No operation. */
+#define LDI  0x01 /* Loads constant into CPU register. */
+#define MOV  0x02 /* Copies content of a CPU-register to another CPU register. */
+#define OUT  0x03 /* Writes to I/O location. */
+#define IN   0x04 /* Reads from I/O location. */
+#define STS  0x05 /* Stores data to address in data memory. */
+#define LDS  0x06 /* Loads data from address in data memory. */
+#define CLR  0x07 /* Clears CPU register. */
+#define ORI  0x08 /* Performs bitwise OR with constant. */
+#define ANDI 0x09 /* Performs bitwise AND with constant. */
+#define XORI 0x0A /* Performs bitwise XOR with constant. */
+#define OR   0x0B /* Performs bitwise OR with content in a CPU register. */
+#define AND  0x0C /* Performs bitwise AND with content in a CPU register. */
+#define XOR  0x0D /* Performs bitwise XOR with content in a CPU register. */
+#define ADDI 0x0E /* Performs addition with a constant. */
+#define SUBI 0x0F /* Performs subtraction with a constant. */
+
+#define ADD  0x10 /* Performs addition with content in a CPU register. */
+#define SUB  0x11 /* Performs subtraction with content in a CPU register. */
+#define INC  0x12 /* Increments content of a CPU register. */
+#define DEC  0x13 /* Decrements content of a CPU register. */
+#define CPI  0x14 /* Compares content of a CPU register with a constant. */
+#define CP   0x15 /* Compares content between CPU registers. */
+#define JMP  0x16 /* Jumps to specified address. */
+#define BREQ 0x17 /* Jumps to specified address if result of last calculation is zero. */
+#define BRNE 0x18 /* Jumps to specified address if result of last calculation is not equal to zero. */
+#define BRGE 0x19 /* Jumps to specified address if result of last calculation is greater or equal to zero. */
+#define BRGT 0x1A /* Jumps to specified address if result of last calculation is greater than zero. */
+#define BRLE 0x1B /* Jumps to specified address if result of last calculation is lower or equal to zero. */
+#define BRLT 0x1C /* Jumps to specified address if result of last calculation is lower than zero. */
+#define CALL 0x1D /* Calls subroutine at specified address and stores the return address on the stack. */
+#define RET  0x1E /* Returns from subroutine by jumping to the return address popped from the stack. */
+#define RETI 0x1F /* Returns from interrupt by restoring program as it was before the interrupt occured. */
+
+#define PUSH 0x20 /* Pushes value stored in a CPU register to the stack. */
+#define POP  0x21 /* Pops value from the stack and loads it into a CPU register. */
+#define LSL  0x22 /* Shifts content of a CPU register one step to the left. */
+#define LSR  0x23 /* Shifts content of a CPU register one step to the right. */
+#define SEI  0x24 /* Enables interrupts globally by setting the I-flag of the status register. */
+#define CLI  0x25 /* Disables interrupts globally by clearning the I-flag of the status register. */
+#define LD   0x26 /* Loads data from address stored in pointer register X, Y or Z. */
+#define LDP  0x27 /* Loads data from address stored in pointer register, then increments the pointer. */
+#define LDM  0x28 /* Decrements pointer register, then loads data from address stored in the pointer. */
+#define ST   0x29 /* Stores data to address stored in pointer register X, Y or Z. */
+#define STP  0x2A /* Stores data to address stored in pointer register, then increments the pointer. */
+#define STM  0x2B /* Decrements pointer register, then stores data to address stored in the pointer. */
+#define LDDY 0x2C /* Loads data from address stored in pointer register Y plus displacement. */
+#define LDDZ 0x2D /* Loads data from address stored in pointer register Z plus displacement. */
+#define STDY 0x2E /* Stores data to address stored in pointer register Y plus displacement. */
+#define STDZ 0x2F /* Stores data to address stored in pointer register Z plus displacement. */
+
+#define LPM  0x30 /* Loads byte from program memory address stored in pointer register Z. */
+#define LPMP 0x31 /* Loads byte from program memory address stored in Z, then increments Z. */
+#define ADC  0x32 /* Performs addition with content in a CPU register and the carry flag. */
+#define SBC  0x33 /* Performs subtraction with content in a CPU register and the carry flag. */
+#define MOVW 0x34 /* Copies content of a CPU register pair to another CPU register pair. */
+#define ADIW 0x35 /* Adds a constant to a CPU register pair (R24, R26, R28 or R30). */
+#define SBIW 0x36 /* Subtracts a constant from a CPU register pair (R24, R26, R28 or R30). */
+#define MUL  0x37 /* Multiplies unsigned CPU registers, the product is stored in R1:R0. */
+#define MULS 0x38 /* Multiplies signed CPU registers, the product is stored in R1:R0. */
+#define MULSU 0x39 /* Multiplies signed with unsigned CPU register, the product is stored in R1:R0. */
+#define BREAK 0x3A /* Breakpoint inserted into program memory by the breakpoint engine. */
+#define LDSX  0x3B /* Loads byte from 11-bit data memory address, the address word is skipped. */
+#define STSX  0x3C /* Stores byte to 11-bit data memory address, the address word is skipped. */
+#define INSR  0x3D /* Reads the status register in the AVR SREG format. */
+#define OUTSR 0x3E /* Writes the status register from the AVR SREG format. */
+#define INSP  0x3F /* Reads the low (second operand 0) or high byte of the stack pointer. */
+#define OUTSP 0x40 /* Writes the low (second operand 0) or high byte of the stack pointer. */
+#define BRGES 0x41 /* Jumps to specified address if signed result of last comparison is greater or equal. */
+#define BRLTS 0x42 /* Jumps to specified address if signed result of last comparison is lower. */
+
+#define DDRB  0x00 /* Data direction register for I/O-port B. */
+#define PORTB 0x01 /* Data register for I/O-port B. */
+#define PINB  0x02 /* Pin input register for I/O-port B. */
+
+#define DDRC  0x03 /* Data direction register for I/O-port C. */
+#define PORTC 0x04 /* Data register for I/O-port C. */
+#define PINC  0x05 /* Pin input register for I/O-port C. */
+
+#define DDRD  0x06 /* Data direction register for I/O-port D. */
+#define PORTD 0x07 /* Data register for I/O-port D. */
+#define PIND  0x08 /* Pin input register for I/O-port D. */
+
+#define PCICR 0x09 /* Pin change interrupt control register for all I/O-ports. */
+#define PCIFR 0x0A /* Pin change interrupt flag register for all I/O-ports. */
+
+#define PCMSK0 0x10 /* Pin change interrupt mask register for I/O-port B. */
+#define PCMSK1 0x11 /* Pin change interrupt mask register for I/O-port C. */
+#define PCMSK2 0x12 /* Pin change interrupt mask register for I/O-port D. */
+
+#define UCSR0A 0x13 /* USART control and status register A. */
+#define UCSR0B 0x14 /* USART control and status register B. */
+#define UCSR0C 0x15 /* USART control and status register C. */
+#define UBRR0L 0x16 /* USART baud rate register, low byte. */
+#define UBRR0H 0x17 /* USART baud rate register, high byte. */
+#define UDR0   0x18 /* USART data register, received and transmitted data. */
+
+#define PCIE0 0 /* Pin change interrupt enable bit for I/O-port B. */
+#define PCIE1 1 /* Pin change interrupt enable bit for I/O-port C. */
+#define PCIE2 2 /* Pin change interrupt enable bit for I/O-port D. */
+
+#define PCIF0 0 /* Pin change interrupt flag bit for I/O-port B. */
+#define PCIF1 1 /* Pin change interrupt flag bit for I/O-port C. */
+#define PCIF2 2 /* Pin change interrupt flag bit for I/O-port D. */
+
+#define RXC0   7 /* USART receive complete bit in UCSR0A. */
+#define TXC0   6 /* USART transmit complete bit in UCSR0A. */
+#define UDRE0  5 /* USART data register empty bit in UCSR0A. */
+
+#define RXCIE0 7 /* USART receive complete interrupt enable bit in UCSR0B. */
+#define TXCIE0 6 /* USART transmit complete interrupt enable bit in UCSR0B. */
+#define UDRIE0 5 /* USART data register empty interrupt enable bit in UCSR0B. */
+#define RXEN0  4 /* USART receiver enable bit in UCSR0B. */
+#define TXEN0  3 /* USART transmitter enable bit in UCSR0B. */
+
+#define RESET_vect  0x00 /* Reset vector. */
+#define PCINT0_vect 0x02 /* Pin change interrupt vector 0 (for I/O-port B). */
+#define PCINT1_vect 0x04 /* Pin change interrupt vector 0 (for I/O-port C). */
+#define PCINT2_vect 0x06 /* Pin change interrupt vector 0 (for I/O-port D). */
+#define USART_RX_vect   0x08 /* USART receive complete interrupt vector. */
+#define USART_UDRE_vect 0x0A /* USART data register empty interrupt vector. */
+
+#define R0  0x00 /* Address for CPU register R0. */
+#define R1  0x01 /* Address for CPU register R1. */
+#define R2  0x02 /* Address for CPU register R2. */
+#define R3  0x03 /* Address for CPU register R3. */
+#define R4  0x04 /* Address for CPU register R4. */
+#define R5  0x05 /* Address for CPU register R5. */
+#define R6  0x06 /* Address for CPU register R6. */
+#define R7  0x07 /* Address for CPU register R7. */
+#define R8  0x08 /* Address for CPU register R8. */
+#define R9  0x09 /* Address for CPU register R9. */
+#define R10 0x0A /* Address for CPU register R10. */
+#define R11 0x0B /* Address for CPU register R11. */
+#define R12 0x0C /* Address for CPU register R12. */
+#define R13 0x0D /* Address for CPU register R13. */
+#define R14 0x0E /* Address for CPU register R14. */
+#define R15 0x0F /* Address for CPU register R15. */
+
+#define R16 0x10 /* Address for CPU register R16. */
+#define R17 0x11 /* Address for CPU register R17. */
+#define R18 0x12 /* Address for CPU register R18. */
+#define R19 0x13 /* Address for CPU register R19. */
+#define R20 0x14 /* Address for CPU register R20. */
+#define R21 0x15 /* Address for CPU register R21. */
+#define R22 0x16 /* Address for CPU register R22. */
+#define R23 0x17 /* Address for CPU register R23. */
+#define R24 0x18 /* Address for CPU register R24. */
+#define R25 0x19 /* Address for CPU register R25. */
+#define R26 0x1A /* Address for CPU register R26. */
+#define R27 0x1B /* Address for CPU register R27. */
+#define R28 0x1C /* Address for CPU register R28. */
+#define R29 0x1D /* Address for CPU register R29. */
+#define R30 0x1E /* Address for CPU register R30. */
+#define R31 0x1F /* Address for CPU register R31. */
+
+#define XL R26 /* Low byte of pointer register X. */
+#define XH R27 /* High byte of pointer register X. */
+#define YL R28 /* Low byte of pointer register Y. */
+#define YH R29 /* High byte of pointer register Y. */
+#define ZL R30 /* Low byte of pointer register Z. */
+#define ZH R31 /* High byte of pointer register Z. */
+
+#define CPU_REGISTER_ADDRESS_WIDTH 32 /* 32 CPU registers in control unit. */
+#define CPU_REGISTER_DATA_WIDTH    8  /* 8 bit data width per CPU register. */
+#define IO_REGISTER_DATA_WIDTH     8  /* 8 bit data width per I/O location. */
+
+#define I 4 /* Interrupt flag in status register. */
+#define N 3 /* Negative flag in status register. */
+#define Z 2 /* Zero flag in status register. */
+#define V 1 /* Overflow flag in status register. */
+#define C 0 /* Carry flag in status register. */
+
+/********************************************************************************
+* set: Sets bit in specified register without affecting other bits.
+* 
+*      - reg: Reference to the register.
+*      - bit: The bit to be set in the referenced register.
+********************************************************************************/
+#define set(reg, bit)  reg |= (1 << bit)
+
+/********************************************************************************
+* clr: Clears bit in specified register without affecting other bits.
+*
+*      - reg: Reference to the register.
+*      - bit: The bit to be cleared in the referenced register.
+********************************************************************************/
+#define clr(reg, bit)  reg &= ~(1 << (bit))
+
+/********************************************************************************
+* read: Reads bit from specified register. The return value is not equal to
+*       zero if the bit is high. If the bit is low the return value is zero.
+*
+*       - reg: Reference to the register.
+*       - bit: The bit to be read in the referenced register.
+********************************************************************************/
+#define read(reg, bit) (reg & (1 << (bit)))
+
+/********************************************************************************
+* CPU_WIDE_REGISTER: Returns the CPU register of LDSX or STSX from the operand
+*                    holding it, whose bit 7 downto 5 hold bit 10 downto 8 of
+*                    the data memory address.
+*
+*                    - operand: The operand holding the register.
+********************************************************************************/
+#define CPU_WIDE_REGISTER(operand) ((operand) & 0x1F)
+
+/********************************************************************************
+* CPU_WIDE_ADDRESS: Returns the 11-bit data memory address of LDSX or STSX.
+*
+*                   - reg_operand    : The operand holding the register.
+*                   - address_operand: The operand holding bit 7 downto 0 of
+*                                      the address.
+********************************************************************************/
+#define CPU_WIDE_ADDRESS(reg_operand, address_operand) \
+   ((uint16_t)((((reg_operand) >> 5) << 8) | (address_operand)))
+
+#define CPU_NAME_BUFFER_SIZE   10 /* Capacity needed by cpu_format_register_name. */
+#define CPU_BINARY_BUFFER_SIZE 33 /* Capacity needed by cpu_format_binary. */
+
+/********************************************************************************
+* cpu_state: Enumeration for the different states of the CPU instructio cycle.
+********************************************************************************/
+enum cpu_state
+{
+   CPU_STATE_FETCH,  /* Fetches next instruction from program memory. */
+   CPU_STATE_DECODE, /* Decodes the fetched instruction. */
+   CPU_STATE_EXECUTE /* Executes the decoded instruction. */
+};
+
+/********************************************************************************
+* cpu_instruction_name: Returns the name of specified instruction.
+*
+*                       - instruction: The specified CPU instruction.
+********************************************************************************/
+const char* cpu_instruction_name(const uint8_t instruction);
+
+/********************************************************************************
+* cpu_sreg_from_sr: Returns specified status register (bits INZVC) in the
+*                   format of the AVR SREG (bits ITHSVNZC), where S = N ^ V.
+*
+*                   - sr: The content of the status register.
+********************************************************************************/
+uint8_t cpu_sreg_from_sr(const uint8_t sr);
+
+/********************************************************************************
+* cpu_sr_from_sreg: Returns the status register (bits INZVC) corresponding to
+*                   specified AVR SREG. The T, H and S bits are dropped.
+*
+*                   - sreg: The content of the AVR SREG.
+********************************************************************************/
+uint8_t cpu_sr_from_sreg(const uint8_t sreg);
+
+/********************************************************************************
+* cpu_state_name: Returns the name of specified CPU state.
+*
+*                 - state: The specified CPU state.
+********************************************************************************/
+const char* cpu_state_name(const enum cpu_state state);
+
+/********************************************************************************
+* cpu_format_register_name: Writes the name of specified CPU register to
+*                           referenced buffer, which must hold at least
+*                           CPU_NAME_BUFFER_SIZE characters, and returns
+*                           the buffer. Unlike cpu_register_name, the
+*                           function can be called from several threads.
+*
+*                           - reg   : The specified CPU register.
+*                           - buffer: Reference to the buffer.
+********************************************************************************/
+char* cpu_format_register_name(const uint8_t reg,
+                               char* buffer);
+
+/********************************************************************************
+* cpu_register_name: Returns the name of specified CPU register.
+*
+*                    - reg: The specified CPU register.
+********************************************************************************/
+const char* cpu_register_name(const uint8_t reg);
+
+/********************************************************************************
+* cpu_format_binary: Writes specified number as a binary string with specified
+*                    minimum number of characters to referenced buffer, which
+*                    must hold at least CPU_BINARY_BUFFER_SIZE characters, and
+*                    returns the buffer. Unlike get_binary, the function can
+*                    be called from several threads.
+*
+*                    - num      : The specified number.
+*                    - min_chars: Minimum number of characters in the string.
+*                    - buffer   : Reference to the buffer.
+********************************************************************************/
+char* cpu_format_binary(uint32_t num,
+                        const uint8_t min_chars,
+                        char* buffer);
+
+/********************************************************************************
+* get_binary: Returns specified number as a binary string with specified
+*             minimum number of characters.
+*
+*             - num      : The specified number.
+*             - min_chars: Minimum number of characters in the returned string.
+********************************************************************************/
+const char* get_binary(uint32_t num,
+                       const uint8_t min_chars);
+
+/********************************************************************************
+* cpu_seconds_now: Returns the time in seconds of a monotonic clock of the
+*                  host, for measuring durations.
+********************************************************************************/
+double cpu_seconds_now(void);
+
+/********************************************************************************
+* cpu_num_host_cores: Returns the number of cores of the host, limited to
+*                     specified maximum and at least 1.
+*
+*                     - max_cores: The maximum number of cores to return.
+********************************************************************************/
+uint8_t cpu_num_host_cores(const uint8_t max_cores);
+
 #endif /* CPU_H_ */
\ No newline at end of file
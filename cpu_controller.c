@@ -1,145 +1,429 @@
-/********************************************************************************
-* cpu_controller.c: Contains functionality for control of the program flow
-*                   by input from the keyboard.
-********************************************************************************/
-#include "cpu_controller.h"
-
-/* Static functions: */
-static inline void print_information_at_start(void);
-static inline void print_menu(void);
-static int execute_selection(void);
-static uint8_t get_selection(void);
-static void readline(char* s,
-                     const int size);
-static inline uint8_t get_byte(void);
-
-/********************************************************************************
-* cpu_controller_run_by_input: Controls the program flow and input to the PINB
-*                              register by input from the keyboard.
-********************************************************************************/
-void cpu_controller_run_by_input(void)
-{
-   control_unit_reset();
-   print_information_at_start();
-
-   while (1)
-   {
-      control_unit_print();
-      print_menu();
-      if (execute_selection()) return;
-   }
-}
-
-/********************************************************************************
-* print_information_at_start: Prints information about connected devices.
-********************************************************************************/
-static inline void print_information_at_start(void)
-{
-   printf("A led is connected to pin 8 (PORTB0).\n");
-   printf("Press the button connected to pin 13 (PORTB5) to toggle the led.\n");
-   printf("To press the button, set the fifth bit of the PINB register, ");
-   printf("for instance by entering the value 32!\n\n");
-   return;
-}
-
-/********************************************************************************
-* print_menu: Prints menu for user control of program flow and input.
-********************************************************************************/
-static inline void print_menu(void)
-{
-   printf("Please select between the following alternatives:\n");
-   printf("1. Execute next instruction cycle\n");
-   printf("2. Run next clock cycle\n");
-   printf("3. Reset system\n");
-   printf("4. Enter new input for pin input register PINB\n");
-   printf("5. Finish execution\n\n");
-   return;
-}
-
-/********************************************************************************
-* execute_selection: Reads and executes user selection entered from keyboard.
-********************************************************************************/
-static int execute_selection(void)
-{
-   const uint8_t selection = get_selection();
-
-   if (selection == 1)
-   {
-      control_unit_run_next_instruction_cycle();
-   }
-   else if (selection == 2)
-   {
-      control_unit_run_next_state();
-   }
-   else if (selection == 3)
-   {
-      control_unit_reset();
-      printf("System reset!\n");
-   }
-   else if (selection == 4)
-   {
-      printf("Enter new data for pin input register PINB:\n");
-      const uint8_t input = get_byte();
-      data_memory_write(PINB, input); 
-      printf("Wrote %s to pin input register PINB!\n\n", get_binary(input, 8));
-   }
-   else if (selection == 5)
-   {
-      printf("System exit!\n\n");
-      return 1;
-   }
-   return 0;
-}
-
-/********************************************************************************
-* get_selection: Retunrs user selection from keyboard after correct input.
-********************************************************************************/
-static uint8_t get_selection(void)
-{
-   while (1)
-   {
-      const uint8_t selection = get_byte();
-
-      if (selection >= 0 && selection <= 5)
-      {
-         return selection;
-      }
-      else
-      {
-         printf("Invalid input, try again!\n\n");
-      }
-   }
-}
-
-/********************************************************************************
-* readline: Reads text entered from keyboard into referenced string. 
-* 
-*           - s   : Reference to the string which stores entered content.
-*           - size: The capacity of the string.
-********************************************************************************/
-static void readline(char* s,
-                     const int size)
-{
-   fgets(s, size, stdin);
-   printf("\n");
-
-   for (char* i = s; *i; ++i)
-   {
-      if (*i == '\n')
-      {
-         *i = '\0';
-      }
-   }
-   return;
-}
-
-/********************************************************************************
-* get_byte: Returns an unsigned integer entered from the terminal.
-********************************************************************************/
-static inline uint8_t get_byte(void)
-{
-   char s[20] = { '\0' };
-   readline(s, sizeof(s));
-   return (uint8_t)atoi(s);
-}
-
+/********************************************************************************
+* cpu_controller.c: Contains functionality for control of the program flow
+*                   by input from the keyboard.
+********************************************************************************/
+#include <time.h>
+#include <threads.h>
+#include <stdatomic.h>
+#include "cpu_controller.h"
+
+/* Static functions: */
+static inline void print_information_at_start(void);
+static inline void print_menu(void);
+static int execute_selection(struct simulator* sim);
+static uint8_t get_selection(void);
+static void readline(char* s,
+                     const int size);
+static inline uint8_t get_byte(void);
+static void run_continuously(struct simulator* sim);
+static int wait_for_enter(void* arg);
+static void run_in_real_time(void);
+static int read_pin_inputs(void* arg);
+static void run_on_cores(void);
+static void run_to_address(struct simulator* sim);
+
+static atomic_bool stop_running;
+
+/********************************************************************************
+* cpu_controller_run_by_input: Controls the program flow and input to the PINB
+*                              register of referenced simulator by input from
+*                              the keyboard. The simulator is entered on the
+*                              calling thread, so the debugger and the other
+*                              tools of the menu work on it.
+*
+*                              - sim: Reference to the simulator.
+********************************************************************************/
+void cpu_controller_run_by_input(struct simulator* sim)
+{
+   simulator_reset(sim);
+   print_information_at_start();
+
+   while (1)
+   {
+      control_unit_print();
+      print_menu();
+      if (execute_selection(sim)) return;
+   }
+}
+
+/********************************************************************************
+* print_information_at_start: Prints information about connected devices.
+********************************************************************************/
+static inline void print_information_at_start(void)
+{
+   printf("A led is connected to pin 8 (PORTB0).\n");
+   printf("Press the button connected to pin 13 (PORTB5) to toggle the led.\n");
+   printf("To press the button, set the fifth bit of the PINB register, ");
+   printf("for instance by entering the value 32!\n\n");
+   return;
+}
+
+/********************************************************************************
+* print_menu: Prints menu for user control of program flow and input.
+********************************************************************************/
+static inline void print_menu(void)
+{
+   printf("Please select between the following alternatives:\n");
+   printf("1. Execute next instruction cycle\n");
+   printf("2. Run next clock cycle\n");
+   printf("3. Reset system\n");
+   printf("4. Enter new input for pin input register PINB\n");
+   printf("5. Finish execution\n");
+   printf("6. Debug with GDB on localhost:%d\n", GDB_SERVER_DEFAULT_PORT);
+   printf("7. Compare execution engines with %d random programs\n", FUZZER_DEFAULT_CASES);
+   printf("8. Export control flow graph to %s\n", CPU_CONTROLLER_DOT_FILE);
+   printf("9. Explore pressing the button at every cycle of the next %d cycles\n", EXPLORER_DEFAULT_WINDOW);
+   printf("10. Run continuously with live display until Enter is pressed\n");
+   printf("11. Run in real time at %d MHz with input for PINB\n", REALTIME_DEFAULT_RATE / 1000000);
+   printf("12. Print instruction and branch coverage\n");
+   printf("13. Profile the next %d instructions to %s\n", CPU_CONTROLLER_PROFILE_INSTRUCTIONS,
+          CPU_CONTROLLER_PROFILE_FILE);
+   printf("14. Run %d cores with the led of each wired to the button of the next\n",
+          MULTICORE_DEFAULT_CORES);
+   printf("15. Run at full speed to an address, then continue state by state\n\n");
+   return;
+}
+
+/********************************************************************************
+* execute_selection: Reads and executes user selection entered from keyboard.
+*
+*                    - sim: Reference to the simulator.
+********************************************************************************/
+static int execute_selection(struct simulator* sim)
+{
+   const uint8_t selection = get_selection();
+
+   if (selection == 1)
+   {
+      simulator_step_instruction_cycle(sim);
+   }
+   else if (selection == 2)
+   {
+      simulator_step_state(sim);
+   }
+   else if (selection == 3)
+   {
+      input_log_reset();
+      printf("System reset!\n");
+   }
+   else if (selection == 4)
+   {
+      printf("Enter new data for pin input register PINB:\n");
+      const uint8_t input = get_byte();
+      input_log_write_pin(PINB, input);
+      printf("Wrote %s to pin input register PINB!\n\n", get_binary(input, 8));
+   }
+   else if (selection == 5)
+   {
+      printf("System exit!\n\n");
+      return 1;
+   }
+   else if (selection == 6)
+   {
+      if (gdb_server_run(GDB_SERVER_DEFAULT_PORT))
+      {
+         printf("Could not start GDB server!\n\n");
+      }
+   }
+   else if (selection == 7)
+   {
+      struct fuzzer_report* report = (struct fuzzer_report*)malloc(sizeof(struct fuzzer_report));
+      if (!report) return 0;
+
+      printf("Comparing control_unit_run_fast with control_unit_run...\n");
+      fuzzer_run(control_unit_run_fast, FUZZER_DEFAULT_CASES, (uint64_t)time(0), report);
+      fuzzer_print_report(report);
+      free(report);
+   }
+   else if (selection == 8)
+   {
+      const struct program_analysis* analysis = program_analysis_get();
+      printf("Found %u blocks, %u routines and %u unreachable instructions.\n",
+             analysis->num_blocks, analysis->num_functions, analysis->num_unreachable);
+
+      if (program_analysis_write_dot(analysis, CPU_CONTROLLER_DOT_FILE))
+      {
+         printf("Could not write %s!\n\n", CPU_CONTROLLER_DOT_FILE);
+      }
+      else
+      {
+         printf("Wrote control flow graph to %s!\n\n", CPU_CONTROLLER_DOT_FILE);
+      }
+   }
+   else if (selection == 9)
+   {
+      const struct explorer_config config = { EXPLORER_DEFAULT_WINDOW, EXPLORER_DEFAULT_HORIZON, PINB, (1 << BUTTON1) };
+      struct explorer_report* report = (struct explorer_report*)malloc(sizeof(struct explorer_report));
+      if (!report) return 0;
+
+      printf("Exploring the end state %d cycles after every press...\n", EXPLORER_DEFAULT_HORIZON);
+      explorer_run(&config, report);
+      explorer_print_report(report);
+      free(report);
+   }
+   else if (selection == 10)
+   {
+      run_continuously(sim);
+   }
+   else if (selection == 11)
+   {
+      run_in_real_time();
+   }
+   else if (selection == 12)
+   {
+      coverage_print(control_unit_coverage(), stdout);
+   }
+   else if (selection == 13)
+   {
+      if (profiler_start(PROFILER_DEFAULT_INTERVAL)) return 0;
+      simulator_run_instructions(sim, CPU_CONTROLLER_PROFILE_INSTRUCTIONS);
+      profiler_stop();
+      profiler_print(stdout);
+
+      if (profiler_write_folded(CPU_CONTROLLER_PROFILE_FILE))
+      {
+         printf("Could not write %s!\n\n", CPU_CONTROLLER_PROFILE_FILE);
+      }
+      else
+      {
+         printf("Wrote folded stacks to %s!\n\n", CPU_CONTROLLER_PROFILE_FILE);
+      }
+   }
+   else if (selection == 14)
+   {
+      run_on_cores();
+   }
+   else if (selection == 15)
+   {
+      run_to_address(sim);
+   }
+   return 0;
+}
+
+/********************************************************************************
+* get_selection: Retunrs user selection from keyboard after correct input.
+********************************************************************************/
+static uint8_t get_selection(void)
+{
+   while (1)
+   {
+      const uint8_t selection = get_byte();
+
+      if (selection >= 0 && selection <= 15)
+      {
+         return selection;
+      }
+      else
+      {
+         printf("Invalid input, try again!\n\n");
+      }
+   }
+}
+
+/********************************************************************************
+* run_continuously: Runs the program at full speed while the terminal UI
+*                   displays the published state on its own thread, until
+*                   Enter is pressed. If the state isn't already published
+*                   by --publish, it is published to a block only shared
+*                   with the terminal UI while running.
+*
+*                   - sim: Reference to the simulator.
+********************************************************************************/
+static void run_continuously(struct simulator* sim)
+{
+   const bool private_block = !shared_state_current();
+   thrd_t input_thread;
+
+   if (private_block && shared_state_open(0, TERMINAL_UI_PUBLISH_INTERVAL)) return;
+   atomic_store(&stop_running, false);
+
+   if (terminal_ui_start(shared_state_current(), TERMINAL_UI_FRAME_RATE) ||
+       thrd_create(&input_thread, wait_for_enter, 0) != thrd_success)
+   {
+      terminal_ui_stop();
+      if (private_block) shared_state_close();
+      printf("Could not start the terminal UI!\n\n");
+      return;
+   }
+
+   while (!atomic_load(&stop_running))
+   {
+      simulator_run_instructions(sim, CONTROL_UNIT_BATCH_SIZE);
+   }
+
+   thrd_join(input_thread, 0);
+   shared_state_publish();
+   terminal_ui_stop();
+   if (private_block) shared_state_close();
+   return;
+}
+
+static int wait_for_enter(void* arg)
+{
+   char s[20] = { '\0' };
+   (void)arg;
+   fgets(s, sizeof(s), stdin);
+   atomic_store(&stop_running, true);
+   return 0;
+}
+
+/********************************************************************************
+* run_in_real_time: Runs the program paced to REALTIME_DEFAULT_RATE while new
+*                   input for PINB is read from the keyboard on another
+*                   thread, until an empty line is entered.
+********************************************************************************/
+static void run_in_real_time(void)
+{
+   const struct realtime_config config = { REALTIME_DEFAULT_RATE, REALTIME_DEFAULT_BATCH, 0.0 };
+   struct realtime_report report;
+   thrd_t input_thread;
+
+   printf("Running in real time, enter new data for pin input register PINB ");
+   printf("or an empty line to stop:\n");
+
+   if (thrd_create(&input_thread, read_pin_inputs, 0) != thrd_success)
+   {
+      printf("Could not start the input thread!\n\n");
+      return;
+   }
+
+   realtime_run(&config, &report);
+   thrd_join(input_thread, 0);
+   realtime_print_report(&report);
+   return;
+}
+
+static int read_pin_inputs(void* arg)
+{
+   char s[20] = { '\0' };
+   (void)arg;
+
+   while (fgets(s, sizeof(s), stdin) && s[0] != '\n')
+   {
+      const uint8_t input = (uint8_t)atoi(s);
+      char binary[CPU_BINARY_BUFFER_SIZE];
+
+      if (realtime_queue_push(PINB, input))
+      {
+         printf("The input queue is full, try again!\n");
+      }
+      else
+      {
+         printf("Wrote %s to pin input register PINB (lag %.3f ms)!\n",
+                cpu_format_binary(input, 8, binary), realtime_lag() * 1e3);
+      }
+   }
+
+   realtime_request_stop();
+   return 0;
+}
+
+/********************************************************************************
+* run_on_cores: Runs MULTICORE_DEFAULT_CORES cores for MULTICORE_DEFAULT_CYCLES
+*               cycles each, with the led of every core wired to the button
+*               of the next core in a ring, and prints the end state of
+*               every core. The first core starts from the current state,
+*               for instance with the button pressed, and the others from
+*               reset. The state of the system is left unchanged.
+********************************************************************************/
+static void run_on_cores(void)
+{
+   struct multicore_link links[MULTICORE_DEFAULT_CORES];
+   struct context* cores[MULTICORE_DEFAULT_CORES] = { 0 };
+   const struct multicore_config config = { MULTICORE_DEFAULT_CORES, MULTICORE_DEFAULT_QUANTUM, 0, 0,
+                                            links, MULTICORE_DEFAULT_CORES, 0 };
+   struct multicore_report report;
+   bool created = true;
+
+   for (uint8_t i = 0; i < MULTICORE_DEFAULT_CORES; ++i)
+   {
+      const struct multicore_link link = { i, PORTB, LED1, (i + 1) % MULTICORE_DEFAULT_CORES, PINB, BUTTON1 };
+      links[i] = link;
+      cores[i] = context_create(program_memory_image());
+      if (!cores[i]) created = false;
+   }
+
+   if (created)
+   {
+      control_unit_snapshot(&cores[0]->state);
+      printf("Running %d cores with a quantum of %d cycles...\n", MULTICORE_DEFAULT_CORES, MULTICORE_DEFAULT_QUANTUM);
+
+      if (multicore_run(&config, cores, MULTICORE_DEFAULT_CYCLES, &report))
+      {
+         printf("Could not run the cores!\n\n");
+      }
+      else
+      {
+         multicore_print_report(&report);
+      }
+   }
+
+   for (uint8_t i = 0; i < MULTICORE_DEFAULT_CORES; ++i)
+   {
+      context_destroy(cores[i]);
+   }
+   return;
+}
+
+/********************************************************************************
+* readline: Reads text entered from keyboard into referenced string. 
+* 
+*           - s   : Reference to the string which stores entered content.
+*           - size: The capacity of the string.
+********************************************************************************/
+static void readline(char* s,
+                     const int size)
+{
+   fgets(s, size, stdin);
+   printf("\n");
+
+   for (char* i = s; *i; ++i)
+   {
+      if (*i == '\n')
+      {
+         *i = '\0';
+      }
+   }
+   return;
+}
+
+/********************************************************************************
+* get_byte: Returns an unsigned integer entered from the terminal.
+********************************************************************************/
+static inline uint8_t get_byte(void)
+{
+   char s[20] = { '\0' };
+   readline(s, sizeof(s));
+   return (uint8_t)atoi(s);
+}
+
+/********************************************************************************
+* run_to_address: Reads an address from the keyboard and runs whole
+*                 instructions at full speed until the next instruction to run
+*                 is at the address, after which the program can be stepped
+*                 state by state from the menu. If the program already is at
+*                 the address, the run continues to the next time it gets
+*                 there.
+*
+*                 - sim: Reference to the simulator.
+********************************************************************************/
+static void run_to_address(struct simulator* sim)
+{
+   printf("Enter the address to run to:\n");
+   const uint8_t address = get_byte();
+
+   if (control_unit_state() == CPU_STATE_FETCH && simulator_program_counter(sim) == address)
+   {
+      simulator_step_instruction_cycle(sim);
+   }
+
+   if (simulator_run_to_address(sim, address, CPU_CONTROLLER_RUN_TO_INSTRUCTIONS))
+   {
+      printf("Reached address %d at cycle %llu!\n\n", address, (unsigned long long)simulator_cycles(sim));
+   }
+   else
+   {
+      printf("Address %d wasn't reached within %d instructions!\n\n", address, CPU_CONTROLLER_RUN_TO_INSTRUCTIONS);
+   }
+   return;
+}
\ No newline at end of file
@@ -1,18 +1,38 @@
-/********************************************************************************
-* cpu_controller.h: Contains functionality for control of the program flow 
-*                   by input from the keyboard.
-********************************************************************************/
-#ifndef CPU_CONTROLLER_H_
-#define CPU_CONTROLLER_H_
-
-/* Include directives: */
-#include "cpu.h"
-#include "control_unit.h"
-
-/********************************************************************************
-* cpu_controller_run_by_input: Controls the program flow and input to the PINB
-*                              register by input from the keyboard.
-********************************************************************************/
-void cpu_controller_run_by_input(void);
-
+/********************************************************************************
+* cpu_controller.h: Contains functionality for control of the program flow 
+*                   by input from the keyboard.
+********************************************************************************/
+#ifndef CPU_CONTROLLER_H_
+#define CPU_CONTROLLER_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "control_unit.h"
+#include "gdb_server.h"
+#include "fuzzer.h"
+#include "explorer.h"
+#include "terminal_ui.h"
+#include "realtime.h"
+#include "program_analysis.h"
+#include "input_log.h"
+#include "profiler.h"
+#include "simulator.h"
+#include "multicore.h"
+
+#define CPU_CONTROLLER_DOT_FILE             "program.dot"    /* File for the exported control flow graph. */
+#define CPU_CONTROLLER_PROFILE_FILE         "profile.folded" /* File for the folded stacks of the profiler. */
+#define CPU_CONTROLLER_PROFILE_INSTRUCTIONS 1000000          /* Instructions run by the profiler. */
+#define CPU_CONTROLLER_RUN_TO_INSTRUCTIONS  100000000        /* Instructions run at most to an address. */
+
+/********************************************************************************
+* cpu_controller_run_by_input: Controls the program flow and input to the PINB
+*                              register of referenced simulator by input from
+*                              the keyboard. The simulator is entered on the
+*                              calling thread, so the debugger and the other
+*                              tools of the menu work on it.
+*
+*                              - sim: Reference to the simulator.
+********************************************************************************/
+void cpu_controller_run_by_input(struct simulator* sim);
+
 #endif /* CPU_CONTROLLER_H_ */
\ No newline at end of file
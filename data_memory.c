@@ -1,53 +1,176 @@
-#include "data_memory.h"
-
-static uint8_t data[DATA_MEMORY_ADDRESS_WIDTH];
-
-/********************************************************************************
-* data_memory_reset: Clears content of the data memory.
-********************************************************************************/
-void data_memory_reset(void)
-{
-   for (uint8_t* i = data; i < data + DATA_MEMORY_ADDRESS_WIDTH; ++i)
-   {
-      *i = 0x00;
-   }
-   return;
-}
-
-/********************************************************************************
-* data_memory_write: Writes 8-bit value to specified address in data memory.
-*
-*                    - address: Data memory address to write to.
-*                    - value  : Data to write to specified address.
-********************************************************************************/
-int data_memory_write(const uint16_t address, 
-                      const uint8_t value)
-{
-   if (address < DATA_MEMORY_ADDRESS_WIDTH)
-   {
-      data[address] = value;
-      return 0;
-   }
-   else
-   {
-      return 1;
-   }
-}
-
-/********************************************************************************
-* data_memory_read: Reads 8-bit value from specified address in data memory.
-*                   If an invalid address is specified, 0x00 is returned.
-*
-*                   - address: Data memory address to read from.
-********************************************************************************/
-uint8_t data_memory_read(const uint16_t address)
-{
-   if (address < DATA_MEMORY_ADDRESS_WIDTH)
-   {
-      return data[address];
-   }
-   else
-   {
-      return 0;
-   }
+#include "data_memory.h"
+
+static CPU_THREAD_LOCAL uint8_t data[DATA_MEMORY_ADDRESS_WIDTH];
+
+static CPU_THREAD_LOCAL uint8_t page_table[DATA_MEMORY_NUM_PAGES]; /* Bit n is set if hook n monitors the page. */
+static CPU_THREAD_LOCAL uint8_t monitored[DATA_MEMORY_NUM_HOOKS][(DATA_MEMORY_ADDRESS_WIDTH + 7) / 8];
+static CPU_THREAD_LOCAL uint8_t monitored_per_page[DATA_MEMORY_NUM_HOOKS][DATA_MEMORY_NUM_PAGES];
+static CPU_THREAD_LOCAL data_memory_hook hooks[DATA_MEMORY_NUM_HOOKS];
+
+static void run_hooks(const uint16_t address,
+                      const enum data_memory_access access,
+                      uint8_t* value);
+
+/********************************************************************************
+* data_memory_reset: Clears content of the data memory.
+********************************************************************************/
+void data_memory_reset(void)
+{
+   for (uint8_t* i = data; i < data + DATA_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      *i = 0x00;
+   }
+   return;
+}
+
+/********************************************************************************
+* data_memory_write: Writes 8-bit value to specified address in data memory.
+*
+*                    - address: Data memory address to write to.
+*                    - value  : Data to write to specified address.
+********************************************************************************/
+int data_memory_write(const uint16_t address, 
+                      const uint8_t value)
+{
+   if (address < DATA_MEMORY_ADDRESS_WIDTH)
+   {
+      if (page_table[address / DATA_MEMORY_PAGE_SIZE])
+      {
+         uint8_t hooked_value = value;
+         run_hooks(address, DATA_MEMORY_ACCESS_WRITE, &hooked_value);
+         data[address] = hooked_value;
+      }
+      else
+      {
+         data[address] = value;
+      }
+      return 0;
+   }
+   else
+   {
+      return 1;
+   }
+}
+
+/********************************************************************************
+* data_memory_read: Reads 8-bit value from specified address in data memory.
+*                   If an invalid address is specified, 0x00 is returned.
+*
+*                   - address: Data memory address to read from.
+********************************************************************************/
+uint8_t data_memory_read(const uint16_t address)
+{
+   if (address < DATA_MEMORY_ADDRESS_WIDTH)
+   {
+      if (page_table[address / DATA_MEMORY_PAGE_SIZE])
+      {
+         uint8_t value = data[address];
+         run_hooks(address, DATA_MEMORY_ACCESS_READ, &value);
+         return value;
+      }
+      return data[address];
+   }
+   else
+   {
+      return 0;
+   }
+}
+
+/********************************************************************************
+* data_memory_peek: Reads 8-bit value from specified address in data memory
+*                   without passing the access to any hooks. Used by debuggers,
+*                   whose accesses shouldn't trigger watchpoints. If an invalid
+*                   address is specified, 0x00 is returned.
+*
+*                   - address: Data memory address to read from.
+********************************************************************************/
+uint8_t data_memory_peek(const uint16_t address)
+{
+   return address < DATA_MEMORY_ADDRESS_WIDTH ? data[address] : 0;
+}
+
+/********************************************************************************
+* data_memory_poke: Writes 8-bit value to specified address in data memory
+*                   without passing the access to any hooks. Returns 0 after
+*                   successful write or error code 1 if an invalid address
+*                   is specified.
+*
+*                   - address: Data memory address to write to.
+*                   - value  : Data to write to specified address.
+********************************************************************************/
+int data_memory_poke(const uint16_t address,
+                     const uint8_t value)
+{
+   if (address >= DATA_MEMORY_ADDRESS_WIDTH) return 1;
+   data[address] = value;
+   return 0;
+}
+
+/********************************************************************************
+* data_memory_set_hook: Sets the callback of specified hook. Accesses to
+*                       addresses monitored by the hook are passed to the
+*                       callback, other accesses only cost a lookup in the
+*                       page table.
+*
+*                       - id  : The hook to set.
+*                       - hook: The callback, or 0 to remove the callback.
+********************************************************************************/
+void data_memory_set_hook(const enum data_memory_hook_id id,
+                          const data_memory_hook hook)
+{
+   if (id < DATA_MEMORY_NUM_HOOKS)
+   {
+      hooks[id] = hook;
+   }
+   return;
+}
+
+/********************************************************************************
+* data_memory_monitor: Enables or disables monitoring of specified address
+*                      by specified hook. Returns 0 after successful update
+*                      or error code 1 if an invalid address is specified.
+*
+*                      - id     : The hook monitoring the address.
+*                      - address: The data memory address to monitor.
+*                      - enabled: Indicates if the address is monitored.
+********************************************************************************/
+int data_memory_monitor(const enum data_memory_hook_id id,
+                        const uint16_t address,
+                        const bool enabled)
+{
+   if (id >= DATA_MEMORY_NUM_HOOKS || address >= DATA_MEMORY_ADDRESS_WIDTH) return 1;
+
+   const uint16_t page = address / DATA_MEMORY_PAGE_SIZE;
+   uint8_t* byte = &monitored[id][address / 8];
+   const bool was_enabled = read(*byte, address % 8);
+
+   if (enabled && !was_enabled)
+   {
+      set(*byte, address % 8);
+      monitored_per_page[id][page]++;
+      set(page_table[page], id);
+   }
+   else if (!enabled && was_enabled)
+   {
+      clr(*byte, address % 8);
+      if (--monitored_per_page[id][page] == 0) clr(page_table[page], id);
+   }
+   return 0;
+}
+
+static void run_hooks(const uint16_t address,
+                      const enum data_memory_access access,
+                      uint8_t* value)
+{
+   const uint8_t old_value = data[address];
+
+   for (uint8_t id = 0; id < DATA_MEMORY_NUM_HOOKS; ++id)
+   {
+      if (read(page_table[address / DATA_MEMORY_PAGE_SIZE], id) && 
+          read(monitored[id][address / 8], address % 8) && hooks[id])
+      {
+         hooks[id](address, access, old_value, value);
+      }
+   }
+   return;
 }
\ No newline at end of file
@@ -1,30 +1,118 @@
-#ifndef DATA_MEMORY_H_
-#define DATA_MEMORY_H_
-
-#include "cpu.h"
-
-#define DATA_MEMORY_ADDRESS_WIDTH 2000
-#define DATA_MEMORY_DATA_WIDTH    8
-
-/********************************************************************************
-* data_memory_reset: Clears content of the data memory.
-********************************************************************************/
-void data_memory_reset(void);
-
-/********************************************************************************
-* data_memory_write: Writes 8-bit value to specified address in data memory.
-* 
-*                    - address: Data memory address to write to.
-*                    - value  : Data to write to specified address.
-********************************************************************************/
-int data_memory_write(const uint16_t address, const uint8_t value);
-
-/********************************************************************************
-* data_memory_read: Reads 8-bit value from specified address in data memory.
-*                   If an invalid address is specified, 0x00 is returned.
-*
-*                   - address: Data memory address to read from.
-********************************************************************************/
-uint8_t data_memory_read(const uint16_t address);
-
+#ifndef DATA_MEMORY_H_
+#define DATA_MEMORY_H_
+
+#include "cpu.h"
+
+#define DATA_MEMORY_ADDRESS_WIDTH 2000
+#define DATA_MEMORY_DATA_WIDTH    8
+
+#define DATA_MEMORY_PAGE_SIZE 64 /* Number of addresses per page in the page table. */
+#define DATA_MEMORY_NUM_PAGES ((DATA_MEMORY_ADDRESS_WIDTH + DATA_MEMORY_PAGE_SIZE - 1) / DATA_MEMORY_PAGE_SIZE)
+
+/********************************************************************************
+* data_memory_hook_id: Enumeration for the hooks that can monitor accesses to
+*                      data memory. Each hook has a bit in the page table.
+********************************************************************************/
+enum data_memory_hook_id
+{
+   DATA_MEMORY_HOOK_WATCH,      /* Watchpoints set by the breakpoint engine. */
+   DATA_MEMORY_HOOK_PERIPHERAL, /* Registers of peripherals, such as the USART. */
+   DATA_MEMORY_HOOK_TRACE,      /* Port registers dumped by the VCD writer. */
+   DATA_MEMORY_HOOK_CLIENT,     /* Port hook of a library client, see simulator. */
+   DATA_MEMORY_HOOK_SHARED,     /* Shared SRAM of the cores of a board, see multicore. */
+   DATA_MEMORY_NUM_HOOKS        /* Number of hooks. */
+};
+
+/********************************************************************************
+* data_memory_access: Enumeration for the type of data memory access.
+********************************************************************************/
+enum data_memory_access
+{
+   DATA_MEMORY_ACCESS_READ, /* Value is read from data memory. */
+   DATA_MEMORY_ACCESS_WRITE /* Value is written to data memory. */
+};
+
+/********************************************************************************
+* data_memory_hook: Callback for accesses to monitored addresses. The value
+*                   read or written is passed by reference and may be
+*                   modified by the hook.
+*
+*                   - address  : The accessed data memory address.
+*                   - access   : The type of access.
+*                   - old_value: Content of the address before the access.
+*                   - value    : Reference to the value read or written.
+********************************************************************************/
+typedef void (*data_memory_hook)(const uint16_t address,
+                                 const enum data_memory_access access,
+                                 const uint8_t old_value,
+                                 uint8_t* value);
+
+/********************************************************************************
+* data_memory_reset: Clears content of the data memory.
+********************************************************************************/
+void data_memory_reset(void);
+
+/********************************************************************************
+* data_memory_write: Writes 8-bit value to specified address in data memory.
+* 
+*                    - address: Data memory address to write to.
+*                    - value  : Data to write to specified address.
+********************************************************************************/
+int data_memory_write(const uint16_t address, const uint8_t value);
+
+/********************************************************************************
+* data_memory_read: Reads 8-bit value from specified address in data memory.
+*                   If an invalid address is specified, 0x00 is returned.
+*
+*                   - address: Data memory address to read from.
+********************************************************************************/
+uint8_t data_memory_read(const uint16_t address);
+
+/********************************************************************************
+* data_memory_peek: Reads 8-bit value from specified address in data memory
+*                   without passing the access to any hooks. Used by debuggers,
+*                   whose accesses shouldn't trigger watchpoints. If an invalid
+*                   address is specified, 0x00 is returned.
+*
+*                   - address: Data memory address to read from.
+********************************************************************************/
+uint8_t data_memory_peek(const uint16_t address);
+
+/********************************************************************************
+* data_memory_poke: Writes 8-bit value to specified address in data memory
+*                   without passing the access to any hooks. Returns 0 after
+*                   successful write or error code 1 if an invalid address
+*                   is specified.
+*
+*                   - address: Data memory address to write to.
+*                   - value  : Data to write to specified address.
+********************************************************************************/
+int data_memory_poke(const uint16_t address,
+                     const uint8_t value);
+
+/********************************************************************************
+* data_memory_set_hook: Sets the callback of specified hook. Accesses to
+*                       addresses monitored by the hook are passed to the
+*                       callback, other accesses only cost a lookup in the
+*                       page table.
+*
+*                       - id  : The hook to set.
+*                       - hook: The callback, or 0 to remove the callback.
+********************************************************************************/
+void data_memory_set_hook(const enum data_memory_hook_id id,
+                          const data_memory_hook hook);
+
+/********************************************************************************
+* data_memory_monitor: Enables or disables monitoring of specified address
+*                      by specified hook. Returns 0 after successful update
+*                      or error code 1 if an invalid address is specified.
+*
+*                      - id     : The hook monitoring the address.
+*                      - address: The data memory address to monitor.
+*                      - enabled: Indicates if the address is monitored.
+********************************************************************************/
+int data_memory_monitor(const enum data_memory_hook_id id,
+                        const uint16_t address,
+                        const bool enabled);
+
 #endif /* DATA_MEMORY_H_ */
\ No newline at end of file
@@ -0,0 +1,485 @@
+/********************************************************************************
+* explorer.c: Contains functionality for exploring how the timing of a pin
+*             change affects the program.
+********************************************************************************/
+#include <string.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+#include "explorer.h"
+
+#define PAGE_SIZE       DATA_MEMORY_PAGE_SIZE /* Number of bytes per page of a fork. */
+#define NUM_PAGES       ((sizeof(struct control_unit_snapshot) + PAGE_SIZE - 1) / PAGE_SIZE)
+#define PAGES_PER_CHUNK 1024                  /* Number of pages allocated at once. */
+
+/********************************************************************************
+* fork: State of the system at a cycle of the window, stored as pages of the
+*       snapshot. Pages equal to those of the previous fork are shared.
+********************************************************************************/
+struct fork
+{
+   const uint8_t* pages[NUM_PAGES]; /* The pages of the snapshot. */
+   uint32_t cycle;                  /* First cycle in the window with the state. */
+   uint32_t weight;                 /* Number of cycles in the window with the state. */
+};
+
+/********************************************************************************
+* end_state: State reached by a branch, measured by a worker.
+********************************************************************************/
+struct end_state
+{
+   uint64_t hash;       /* Hash of the state, except for the cycle counter. */
+   uint8_t portb;       /* Content of PORTB. */
+   uint8_t led_state;   /* Content of led_enabled in data memory. */
+};
+
+/********************************************************************************
+* chunk: Pages allocated at once for the forks.
+********************************************************************************/
+struct chunk
+{
+   struct chunk* next;                       /* Previously allocated chunk. */
+   uint8_t pages[PAGES_PER_CHUNK][PAGE_SIZE]; /* The pages. */
+};
+
+/********************************************************************************
+* visited: Open addressing set of the visited states, mapping the hash of a
+*          state to the fork storing it.
+********************************************************************************/
+struct visited
+{
+   uint64_t* hashes;  /* Hash of each entry. */
+   uint32_t* forks;   /* Index of the fork plus one of each entry, 0 if unused. */
+   uint32_t capacity; /* Number of entries, a power of two. */
+};
+
+static const struct explorer_config* parameters = 0;
+static const struct program_image* image = 0; /* Program shared by the trunk and the workers. */
+static struct control_unit_snapshot base;
+static struct fork* forks = 0;
+static uint32_t num_forks = 0;
+static struct end_state* end_states = 0;
+static struct chunk* chunks = 0;
+static uint32_t chunk_used = PAGES_PER_CHUNK;
+static uint32_t pages_copied = 0;
+static struct visited visited = { 0 };
+static atomic_uint_fast32_t next_fork;
+
+static int run_trunk(void* arg);
+static int run_worker(void* arg);
+static int store_fork(const struct control_unit_snapshot* snapshot,
+                      const uint8_t* previous,
+                      const uint32_t cycle);
+static void build_snapshot(const struct fork* self,
+                           struct control_unit_snapshot* snapshot);
+static uint32_t find_visited(const uint64_t hash);
+static void add_visited(const uint64_t hash,
+                        const uint32_t fork);
+static uint64_t injected_hash(struct control_unit_snapshot* snapshot);
+static int load_program(void);
+static void add_end_state(struct explorer_report* report,
+                          const struct end_state* end,
+                          const uint32_t fork,
+                          const bool inconsistent);
+static void free_all(void);
+
+/********************************************************************************
+* explorer_run: Explores the current state with specified parameters and
+*               stores the result at referenced location. The state of the
+*               system is left unchanged. Returns 0 if all branches reached
+*               the same consistent end state, otherwise error code 1, which
+*               is also returned if the exploration couldn't be run.
+*
+*               - config: Reference to the parameters.
+*               - report: Reference to the report of the exploration.
+********************************************************************************/
+int explorer_run(const struct explorer_config* config,
+                 struct explorer_report* report)
+{
+   thrd_t threads[EXPLORER_MAX_THREADS];
+   uint8_t num_threads = 0;
+   int trunk_error = 1;
+   const double start = cpu_seconds_now();
+   const bool builtin = program_memory_builtin();
+
+   memset(report, 0, sizeof(*report));
+   if (config->window == 0 || config->window > EXPLORER_MAX_WINDOW) return 1;
+
+   parameters = config;
+   num_forks = 0;
+   pages_copied = 0;
+   visited.capacity = 1;
+   while (visited.capacity < 2 * config->window) visited.capacity <<= 1;
+
+   forks = (struct fork*)malloc(sizeof(struct fork) * config->window);
+   visited.hashes = (uint64_t*)malloc(sizeof(uint64_t) * visited.capacity);
+   visited.forks = (uint32_t*)calloc(visited.capacity, sizeof(uint32_t));
+
+   if (forks && visited.hashes && visited.forks && !load_program())
+   {
+      control_unit_snapshot(&base);
+
+      if (thrd_create(&threads[0], run_trunk, 0) == thrd_success)
+      {
+         thrd_join(threads[0], &trunk_error);
+      }
+   }
+
+   end_states = !trunk_error ? (struct end_state*)malloc(sizeof(struct end_state) * num_forks) : 0;
+   if (!end_states)
+   {
+      free_all();
+      return 1;
+   }
+
+   atomic_store(&next_fork, 0);
+
+   for (uint8_t i = 0; i < cpu_num_host_cores(EXPLORER_MAX_THREADS); ++i)
+   {
+      if (thrd_create(&threads[num_threads], run_worker, 0) != thrd_success) break;
+      num_threads++;
+   }
+
+   for (uint8_t i = 0; i < num_threads; ++i)
+   {
+      thrd_join(threads[i], 0);
+   }
+
+   memset(visited.forks, 0, sizeof(uint32_t) * visited.capacity); /* Reused for the end states. */
+
+   for (uint32_t i = 0; num_threads && i < num_forks; ++i)
+   {
+      const struct end_state* end = &end_states[i];
+      const bool inconsistent = builtin && (end->led_state != 0) != (read(end->portb, LED1) != 0);
+      add_end_state(report, end, i, inconsistent);
+      if (inconsistent) report->num_inconsistent += forks[i].weight;
+   }
+
+   report->num_branches = config->window;
+   report->num_unique = num_forks;
+   report->num_pages = pages_copied;
+   report->num_threads = num_threads;
+   report->seconds = cpu_seconds_now() - start;
+   free_all();
+   return num_threads == 0 || report->num_end_states > 1 || report->num_inconsistent > 0;
+}
+
+/********************************************************************************
+* explorer_print_report: Prints specified report.
+*
+*                        - report: Reference to the report.
+********************************************************************************/
+void explorer_print_report(const struct explorer_report* report)
+{
+   const uint32_t num_stored = report->num_end_states < EXPLORER_MAX_END_STATES ?
+      report->num_end_states : EXPLORER_MAX_END_STATES;
+
+   printf("Explored %u cycles on %hu threads in %.2f seconds.\n",
+          report->num_branches, report->num_threads, report->seconds);
+   printf("Ran %u branches, the others reached an already visited state.\n", report->num_unique);
+   printf("The forks copied %u of %llu pages, the others were shared.\n", report->num_pages,
+          (unsigned long long)report->num_unique * NUM_PAGES);
+   printf("Found %u distinct end states:\n", report->num_end_states);
+
+   for (uint32_t i = 0; i < num_stored; ++i)
+   {
+      const struct explorer_end_state* end = &report->end_states[i];
+      char binary[CPU_BINARY_BUFFER_SIZE];
+      printf("   0x%016llX: %u cycles, first at cycle %u, PORTB %s, led_enabled %hu%s\n",
+             (unsigned long long)end->hash, end->count, end->first, cpu_format_binary(end->portb, 8, binary),
+             end->led_state, end->inconsistent ? " (inconsistent!)" : "");
+   }
+
+   if (report->num_end_states > num_stored)
+   {
+      printf("   ... and %u more.\n", report->num_end_states - num_stored);
+   }
+
+   if (report->num_inconsistent)
+   {
+      printf("LED1 at PORTB differs from led_enabled after %u cycles!\n", report->num_inconsistent);
+   }
+
+   printf("\n");
+   return;
+}
+
+/********************************************************************************
+* run_trunk: Runs the window from the base state on its own instance of the
+*            system and stores a fork of every state not visited before.
+*            Returns 0 after success or error code 1 if memory ran out.
+********************************************************************************/
+static int run_trunk(void* arg)
+{
+   static CPU_THREAD_LOCAL struct control_unit_snapshot current;
+   static CPU_THREAD_LOCAL struct control_unit_snapshot previous;
+   (void)arg;
+
+   program_memory_set_image(image);
+   control_unit_restore(&base);
+
+   for (uint32_t i = 0; i < parameters->window; ++i)
+   {
+      control_unit_snapshot(&current);
+      const uint64_t hash = injected_hash(&current);
+      const uint32_t found = find_visited(hash);
+
+      if (found)
+      {
+         forks[found - 1].weight++;
+      }
+      else
+      {
+         if (store_fork(&current, num_forks ? (const uint8_t*)&previous : 0, i))
+         {
+            control_unit_release();
+            return 1;
+         }
+
+         add_visited(hash, num_forks - 1);
+         previous = current;
+      }
+      control_unit_run_next_state();
+   }
+
+   control_unit_release();
+   return 0;
+}
+
+/********************************************************************************
+* run_worker: Runs the branches of the forks on its own instance of the system
+*             until all forks have been taken.
+********************************************************************************/
+static int run_worker(void* arg)
+{
+   static CPU_THREAD_LOCAL struct control_unit_snapshot snapshot;
+   (void)arg;
+
+   program_memory_set_image(image);
+
+   while (1)
+   {
+      const uint32_t index = (uint32_t)atomic_fetch_add(&next_fork, 1);
+      if (index >= num_forks) break;
+
+      build_snapshot(&forks[index], &snapshot);
+      control_unit_restore(&snapshot);
+      data_memory_poke(parameters->pin_reg, snapshot.data[parameters->pin_reg] ^ parameters->mask);
+
+      const uint64_t end = snapshot.cycles + parameters->horizon;
+      const bool reached = control_unit_run_until(end);
+
+      while (reached && (control_unit_state() != CPU_STATE_FETCH || !stack_is_empty()) &&
+             control_unit_cycles() < end + parameters->horizon)
+      {
+         control_unit_run_next_state(); /* Settles outside subroutines and interrupts. */
+      }
+
+      control_unit_snapshot(&snapshot);
+      snapshot.cycles = 0;
+      end_states[index].hash = control_unit_snapshot_hash(&snapshot);
+      end_states[index].portb = snapshot.data[PORTB];
+      end_states[index].led_state = snapshot.data[led_enabled];
+   }
+
+   control_unit_release();
+   return 0;
+}
+
+/********************************************************************************
+* store_fork: Stores referenced snapshot as a new fork, sharing every page
+*             equal to the corresponding page of the previous snapshot with
+*             the previous fork. Returns 0 after success or error code 1 if
+*             memory ran out.
+*
+*             - snapshot: Reference to the snapshot to store.
+*             - previous: Reference to the snapshot of the previous fork, or
+*                         0 if there is none.
+*             - cycle   : The cycle in the window of the snapshot.
+********************************************************************************/
+static int store_fork(const struct control_unit_snapshot* snapshot,
+                      const uint8_t* previous,
+                      const uint32_t cycle)
+{
+   const uint8_t* bytes = (const uint8_t*)snapshot;
+   struct fork* self = &forks[num_forks];
+
+   for (size_t i = 0; i < NUM_PAGES; ++i)
+   {
+      const size_t offset = i * PAGE_SIZE;
+      const size_t size = sizeof(*snapshot) - offset < PAGE_SIZE ? sizeof(*snapshot) - offset : PAGE_SIZE;
+
+      if (previous && !memcmp(bytes + offset, previous + offset, size))
+      {
+         self->pages[i] = forks[num_forks - 1].pages[i];
+         continue;
+      }
+
+      if (chunk_used == PAGES_PER_CHUNK)
+      {
+         struct chunk* chunk = (struct chunk*)malloc(sizeof(struct chunk));
+         if (!chunk) return 1;
+         chunk->next = chunks;
+         chunks = chunk;
+         chunk_used = 0;
+      }
+
+      memcpy(chunks->pages[chunk_used], bytes + offset, size);
+      self->pages[i] = chunks->pages[chunk_used++];
+      pages_copied++;
+   }
+
+   self->cycle = cycle;
+   self->weight = 1;
+   num_forks++;
+   return 0;
+}
+
+static void build_snapshot(const struct fork* self,
+                           struct control_unit_snapshot* snapshot)
+{
+   uint8_t* bytes = (uint8_t*)snapshot;
+
+   for (size_t i = 0; i < NUM_PAGES; ++i)
+   {
+      const size_t offset = i * PAGE_SIZE;
+      const size_t size = sizeof(*snapshot) - offset < PAGE_SIZE ? sizeof(*snapshot) - offset : PAGE_SIZE;
+      memcpy(bytes + offset, self->pages[i], size);
+   }
+   return;
+}
+
+static uint32_t find_visited(const uint64_t hash)
+{
+   for (uint32_t i = (uint32_t)hash & (visited.capacity - 1); visited.forks[i];
+        i = (i + 1) & (visited.capacity - 1))
+   {
+      if (visited.hashes[i] == hash) return visited.forks[i];
+   }
+   return 0;
+}
+
+static void add_visited(const uint64_t hash,
+                        const uint32_t fork)
+{
+   uint32_t i = (uint32_t)hash & (visited.capacity - 1);
+   while (visited.forks[i]) i = (i + 1) & (visited.capacity - 1);
+   visited.hashes[i] = hash;
+   visited.forks[i] = fork + 1;
+   return;
+}
+
+/********************************************************************************
+* injected_hash: Returns the hash of referenced snapshot after the pin change,
+*                except for the cycle counter, which doesn't affect how the
+*                branch continues. The snapshot is left unchanged.
+*
+*                - snapshot: Reference to the snapshot.
+********************************************************************************/
+static uint64_t injected_hash(struct control_unit_snapshot* snapshot)
+{
+   const uint64_t cycles = snapshot->cycles;
+   uint64_t hash;
+
+   snapshot->cycles = 0;
+   snapshot->data[parameters->pin_reg] ^= parameters->mask;
+   hash = control_unit_snapshot_hash(snapshot);
+   snapshot->data[parameters->pin_reg] ^= parameters->mask;
+   snapshot->cycles = cycles;
+   return hash;
+}
+
+/********************************************************************************
+* load_program: Shares the program image of the calling thread with the trunk
+*               and the workers, or a copy without breakpoints if any are
+*               inserted. Returns 0 after success or error code 1 if memory
+*               ran out.
+********************************************************************************/
+static int load_program(void)
+{
+   const struct program_image* current = program_memory_image();
+   uint32_t instructions[PROGRAM_MEMORY_ADDRESS_WIDTH];
+   bool breakpoints_inserted = false;
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      instructions[i] = breakpoint_instruction((uint8_t)i);
+      if (instructions[i] != current->instructions[i]) breakpoints_inserted = true;
+   }
+
+   if (!breakpoints_inserted)
+   {
+      image = program_image_retain(current);
+      return 0;
+   }
+
+   struct program_image* copy = program_image_create(instructions, current->raw);
+   if (copy) copy->builtin = current->builtin;
+   image = copy;
+   return !image;
+}
+
+/********************************************************************************
+* add_end_state: Adds the end state of specified fork to referenced report.
+*                Distinct end states are counted by the set of visited
+*                states, while the first of them are stored in the report.
+*
+*                - report      : Reference to the report.
+*                - end         : Reference to the end state.
+*                - fork        : Index of the fork reaching the end state.
+*                - inconsistent: Indicates if the end state is inconsistent.
+********************************************************************************/
+static void add_end_state(struct explorer_report* report,
+                          const struct end_state* end,
+                          const uint32_t fork,
+                          const bool inconsistent)
+{
+   const struct fork* source = &forks[fork];
+
+   if (find_visited(end->hash))
+   {
+      for (uint32_t i = 0; i < report->num_end_states && i < EXPLORER_MAX_END_STATES; ++i)
+      {
+         if (report->end_states[i].hash == end->hash) report->end_states[i].count += source->weight;
+      }
+      return;
+   }
+
+   add_visited(end->hash, fork);
+
+   if (report->num_end_states < EXPLORER_MAX_END_STATES)
+   {
+      struct explorer_end_state* self = &report->end_states[report->num_end_states];
+      self->hash = end->hash;
+      self->count = source->weight;
+      self->first = source->cycle;
+      self->portb = end->portb;
+      self->led_state = end->led_state;
+      self->inconsistent = inconsistent;
+   }
+   report->num_end_states++;
+   return;
+}
+
+static void free_all(void)
+{
+   while (chunks)
+   {
+      struct chunk* next = chunks->next;
+      free(chunks);
+      chunks = next;
+   }
+
+   program_image_release(image);
+   image = 0;
+   free(forks);
+   free(end_states);
+   free(visited.hashes);
+   free(visited.forks);
+   forks = 0;
+   end_states = 0;
+   visited.hashes = 0;
+   visited.forks = 0;
+   chunk_used = PAGES_PER_CHUNK;
+   return;
+}
\ No newline at end of file
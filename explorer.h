@@ -0,0 +1,93 @@
+/********************************************************************************
+* explorer.h: Contains functionality for exploring how the timing of a pin
+*             change affects the program. Starting from the current state,
+*             the simulation is branched at every clock cycle in a window,
+*             with the pin change injected in the branch at that cycle. Each
+*             branch is then run for a fixed number of cycles, after which
+*             the end states of all branches are compared.
+*
+*             The state at every cycle of the window is stored as a fork,
+*             which shares the pages of the data memory and the stack with
+*             the previous fork until they change (copy-on-write). Branches
+*             whose state after the injection equals an already visited
+*             state, except for the cycle counter, are skipped, since they
+*             end in the same state. The remaining branches are run in
+*             parallel on all host cores, like the fuzzer.
+*
+*             For the built-in program, every end state is also checked for
+*             consistency between led_enabled in data memory and the led at
+*             PORTB.
+********************************************************************************/
+#ifndef EXPLORER_H_
+#define EXPLORER_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "control_unit.h"
+
+#define EXPLORER_DEFAULT_WINDOW  3000   /* Cycles explored from the menu. */
+#define EXPLORER_DEFAULT_HORIZON 3000   /* Cycles run after the injection from the menu. */
+#define EXPLORER_MAX_WINDOW      100000 /* Maximum number of cycles explored. */
+#define EXPLORER_MAX_END_STATES  16     /* Number of distinct end states reported. */
+#define EXPLORER_MAX_THREADS     64     /* Maximum number of threads. */
+
+/********************************************************************************
+* explorer_config: Parameters of an exploration.
+********************************************************************************/
+struct explorer_config
+{
+   uint32_t window;  /* Number of cycles where the pin change is injected. */
+   uint32_t horizon; /* Number of cycles run after the injection. */
+   uint8_t pin_reg;  /* Pin input register to change (PINB, PINC or PIND). */
+   uint8_t mask;     /* Bits toggled by the pin change. */
+};
+
+/********************************************************************************
+* explorer_end_state: Distinct end state reached by one or several branches.
+********************************************************************************/
+struct explorer_end_state
+{
+   uint64_t hash;       /* Hash of the state, except for the cycle counter. */
+   uint32_t count;      /* Number of branches ending in the state. */
+   uint32_t first;      /* First cycle in the window leading to the state. */
+   uint8_t portb;       /* Content of PORTB. */
+   uint8_t led_state;   /* Content of led_enabled in data memory. */
+   bool inconsistent;   /* Indicates if the led differs from led_enabled. */
+};
+
+/********************************************************************************
+* explorer_report: Result of an exploration.
+********************************************************************************/
+struct explorer_report
+{
+   uint32_t num_branches;                                     /* Number of cycles in the window. */
+   uint32_t num_unique;                                       /* Number of branches run after deduplication. */
+   uint32_t num_pages;                                        /* Number of pages copied by the forks. */
+   uint32_t num_end_states;                                   /* Number of distinct end states. */
+   uint32_t num_inconsistent;                                 /* Number of branches with inconsistent end state. */
+   struct explorer_end_state end_states[EXPLORER_MAX_END_STATES]; /* The first distinct end states. */
+   uint8_t num_threads;                                       /* Number of threads used. */
+   double seconds;                                            /* Duration of the exploration. */
+};
+
+/********************************************************************************
+* explorer_run: Explores the current state with specified parameters and
+*               stores the result at referenced location. The state of the
+*               system is left unchanged. Returns 0 if all branches reached
+*               the same consistent end state, otherwise error code 1, which
+*               is also returned if the exploration couldn't be run.
+*
+*               - config: Reference to the parameters.
+*               - report: Reference to the report of the exploration.
+********************************************************************************/
+int explorer_run(const struct explorer_config* config,
+                 struct explorer_report* report);
+
+/********************************************************************************
+* explorer_print_report: Prints specified report.
+*
+*                        - report: Reference to the report.
+********************************************************************************/
+void explorer_print_report(const struct explorer_report* report);
+
+#endif /* EXPLORER_H_ */
\ No newline at end of file
@@ -0,0 +1,542 @@
+/********************************************************************************
+* fuzzer.c: Contains functionality for differential fuzzing of execution
+*           engines.
+********************************************************************************/
+#include <string.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+#include "fuzzer.h"
+
+#define IO_ADDRESSES (PCMSK2 + 1) /* I/O addresses used by generated programs. */
+
+/********************************************************************************
+* operands: Enumeration for the operand formats of generated instructions.
+********************************************************************************/
+enum operands
+{
+   OPERANDS_NONE,         /* No operands. */
+   OPERANDS_REG,          /* Destination register. */
+   OPERANDS_REG_REG,      /* Destination and source register. */
+   OPERANDS_REG_CONSTANT, /* Destination register and constant. */
+   OPERANDS_IO_REG,       /* I/O address and source register. */
+   OPERANDS_REG_IO,       /* Destination register and I/O address. */
+   OPERANDS_DATA_REG,     /* Data address and source register. */
+   OPERANDS_REG_DATA,     /* Destination register and data address. */
+   OPERANDS_TARGET,       /* Program memory address. */
+   OPERANDS_REG_POINTER,  /* Destination register and pointer register. */
+   OPERANDS_POINTER_REG,  /* Pointer register and source register. */
+   OPERANDS_REG_OFFSET,   /* Destination register and displacement. */
+   OPERANDS_OFFSET_REG,   /* Displacement and source register. */
+   OPERANDS_PAIR_PAIR,    /* Destination and source register pair. */
+   OPERANDS_PAIR_CONSTANT, /* Upper register pair and 6-bit constant. */
+   OPERANDS_WIDE_REG,      /* Data address and source register holding its high bits. */
+   OPERANDS_REG_WIDE       /* Destination register holding the high address bits and data address. */
+};
+
+/********************************************************************************
+* instruction_format: OP code of a generated instruction and its operands.
+********************************************************************************/
+struct instruction_format
+{
+   uint8_t op_code;        /* The OP code. */
+   enum operands operands; /* The operand format. */
+};
+
+/********************************************************************************
+* worker: Thread running cases on its own instance of the system.
+********************************************************************************/
+struct worker
+{
+   thrd_t thread;                           /* The thread. */
+   struct control_unit_snapshot* snapshots; /* States after each block. */
+};
+
+static const struct instruction_format formats[] =
+{
+   { NOP, OPERANDS_NONE }, { LDI, OPERANDS_REG_CONSTANT }, { MOV, OPERANDS_REG_REG },
+   { OUT, OPERANDS_IO_REG }, { IN, OPERANDS_REG_IO }, { STS, OPERANDS_DATA_REG },
+   { LDS, OPERANDS_REG_DATA }, { CLR, OPERANDS_REG }, { ORI, OPERANDS_REG_CONSTANT },
+   { ANDI, OPERANDS_REG_CONSTANT }, { XORI, OPERANDS_REG_CONSTANT }, { OR, OPERANDS_REG_REG },
+   { AND, OPERANDS_REG_REG }, { XOR, OPERANDS_REG_REG }, { ADDI, OPERANDS_REG_CONSTANT },
+   { SUBI, OPERANDS_REG_CONSTANT }, { ADD, OPERANDS_REG_REG }, { SUB, OPERANDS_REG_REG },
+   { INC, OPERANDS_REG }, { DEC, OPERANDS_REG }, { CPI, OPERANDS_REG_CONSTANT },
+   { CP, OPERANDS_REG_REG }, { JMP, OPERANDS_TARGET }, { BREQ, OPERANDS_TARGET },
+   { BRNE, OPERANDS_TARGET }, { BRGE, OPERANDS_TARGET }, { BRGT, OPERANDS_TARGET },
+   { BRLE, OPERANDS_TARGET }, { BRLT, OPERANDS_TARGET }, { CALL, OPERANDS_TARGET },
+   { RET, OPERANDS_NONE }, { RETI, OPERANDS_NONE }, { PUSH, OPERANDS_REG },
+   { POP, OPERANDS_REG }, { LSL, OPERANDS_REG }, { LSR, OPERANDS_REG },
+   { SEI, OPERANDS_NONE }, { CLI, OPERANDS_NONE }, { LD, OPERANDS_REG_POINTER },
+   { LDP, OPERANDS_REG_POINTER }, { LDM, OPERANDS_REG_POINTER }, { ST, OPERANDS_POINTER_REG },
+   { STP, OPERANDS_POINTER_REG }, { STM, OPERANDS_POINTER_REG }, { LDDY, OPERANDS_REG_OFFSET },
+   { LDDZ, OPERANDS_REG_OFFSET }, { STDY, OPERANDS_OFFSET_REG }, { STDZ, OPERANDS_OFFSET_REG },
+   { LPM, OPERANDS_REG }, { LPMP, OPERANDS_REG }, { ADC, OPERANDS_REG_REG },
+   { SBC, OPERANDS_REG_REG }, { MOVW, OPERANDS_PAIR_PAIR }, { ADIW, OPERANDS_PAIR_CONSTANT },
+   { SBIW, OPERANDS_PAIR_CONSTANT }, { MUL, OPERANDS_REG_REG }, { MULS, OPERANDS_REG_REG },
+   { MULSU, OPERANDS_REG_REG }, { LDSX, OPERANDS_REG_WIDE }, { STSX, OPERANDS_WIDE_REG },
+   { INSR, OPERANDS_REG }, { OUTSR, OPERANDS_REG }, { INSP, OPERANDS_REG_CONSTANT },
+   { OUTSP, OPERANDS_REG_CONSTANT }, { BRGES, OPERANDS_TARGET }, { BRLTS, OPERANDS_TARGET }
+};
+
+static fuzzer_engine alternate_engine = 0;
+static uint64_t total_cases = 0;
+static uint64_t case_seed = 0;
+static atomic_uint_fast64_t next_case;
+static atomic_uint_fast64_t cases_run;
+static atomic_bool mismatch_found;
+static struct fuzzer_report* result = 0;
+
+static int run_worker(void* arg);
+static void generate_case(struct fuzzer_case* self,
+                          const uint64_t number);
+static uint32_t generate_instruction(uint64_t* state);
+static uint8_t generate_idiom(uint32_t* program,
+                              const uint8_t num_free,
+                              uint64_t* state);
+static bool engines_differ(const struct fuzzer_case* self,
+                           struct control_unit_snapshot* snapshots,
+                           uint16_t* block,
+                           struct control_unit_snapshot* actual);
+static void run_block(const struct fuzzer_case* self,
+                      const fuzzer_engine engine,
+                      const uint16_t block,
+                      uint8_t* next_stimulus);
+static void minimize(struct fuzzer_case* self,
+                     struct control_unit_snapshot* snapshots,
+                     uint16_t* block,
+                     struct control_unit_snapshot* actual);
+static void remove_stimulus(struct fuzzer_case* self,
+                            const uint8_t index);
+static void print_case(const struct fuzzer_case* self);
+static void print_difference(const struct control_unit_snapshot* expected,
+                             const struct control_unit_snapshot* actual);
+static inline uint64_t random_next(uint64_t* state);
+static inline uint32_t assemble(const uint8_t op_code,
+                                const uint8_t op1,
+                                const uint8_t op2);
+
+/********************************************************************************
+* fuzzer_run: Runs specified number of cases on the reference engine and
+*             specified alternate engine, using all host cores, and stores
+*             the result at referenced location. Cases are generated from
+*             the seed and the case number, so a run can be repeated.
+*             Returns 0 if the engines matched in every case, otherwise
+*             error code 1.
+*
+*             - alternate: The engine to compare with the reference engine.
+*             - num_cases: The number of cases to run.
+*             - seed     : Seed for the generated cases.
+*             - report   : Reference to the report of the run.
+********************************************************************************/
+int fuzzer_run(const fuzzer_engine alternate,
+               const uint64_t num_cases,
+               const uint64_t seed,
+               struct fuzzer_report* report)
+{
+   struct worker workers[FUZZER_MAX_THREADS];
+   uint8_t num_threads = 0;
+   const double start = cpu_seconds_now();
+
+   memset(report, 0, sizeof(*report));
+   alternate_engine = alternate;
+   total_cases = num_cases;
+   case_seed = seed;
+   result = report;
+   atomic_store(&next_case, 0);
+   atomic_store(&cases_run, 0);
+   atomic_store(&mismatch_found, false);
+
+   for (uint8_t i = 0; i < cpu_num_host_cores(FUZZER_MAX_THREADS); ++i)
+   {
+      struct worker* self = &workers[num_threads];
+      self->snapshots = (struct control_unit_snapshot*)malloc(sizeof(struct control_unit_snapshot) * FUZZER_NUM_BLOCKS);
+      if (!self->snapshots) break;
+
+      if (thrd_create(&self->thread, run_worker, self) != thrd_success)
+      {
+         free(self->snapshots);
+         break;
+      }
+      num_threads++;
+   }
+
+   for (uint8_t i = 0; i < num_threads; ++i)
+   {
+      thrd_join(workers[i].thread, 0);
+      free(workers[i].snapshots);
+   }
+
+   report->num_cases = atomic_load(&cases_run);
+   report->num_threads = num_threads;
+   report->seconds = cpu_seconds_now() - start;
+   return num_threads == 0 || report->mismatch_found;
+}
+
+/********************************************************************************
+* fuzzer_print_report: Prints specified report, including the minimized case
+*                      and the differing state if the engines differ.
+*
+*                      - report: Reference to the report.
+********************************************************************************/
+void fuzzer_print_report(const struct fuzzer_report* report)
+{
+   printf("Ran %llu cases on %hu threads in %.2f seconds (%.0f cases per second).\n",
+          (unsigned long long)report->num_cases, report->num_threads, report->seconds,
+          report->seconds > 0 ? report->num_cases / report->seconds : 0.0);
+
+   if (!report->mismatch_found)
+   {
+      printf("No differences found between the execution engines!\n\n");
+      return;
+   }
+
+   printf("Engines differ in case %llu, minimized to (remaining instructions are NOP):\n",
+          (unsigned long long)report->case_number);
+   print_case(&report->minimized);
+   printf("State after block %hu (instruction %u):\n", report->block,
+          (report->block + 1) * FUZZER_BLOCK_SIZE);
+   print_difference(&report->expected, &report->actual);
+   printf("\n");
+   return;
+}
+
+static int run_worker(void* arg)
+{
+   struct worker* self = (struct worker*)arg;
+   struct fuzzer_case test;
+   struct control_unit_snapshot actual;
+   uint16_t block = 0;
+
+   while (!atomic_load(&mismatch_found))
+   {
+      const uint64_t number = atomic_fetch_add(&next_case, 1);
+      if (number >= total_cases) break;
+
+      generate_case(&test, number);
+
+      if (engines_differ(&test, self->snapshots, &block, &actual))
+      {
+         if (!atomic_exchange(&mismatch_found, true))
+         {
+            minimize(&test, self->snapshots, &block, &actual);
+            result->mismatch_found = true;
+            result->case_number = number;
+            result->minimized = test;
+            result->block = block;
+            result->expected = self->snapshots[block];
+            result->actual = actual;
+         }
+      }
+
+      atomic_fetch_add(&cases_run, 1);
+   }
+
+   control_unit_release();
+   return 0;
+}
+
+static void generate_case(struct fuzzer_case* self,
+                          const uint64_t number)
+{
+   uint64_t state = case_seed ^ (number * 0x9E3779B97F4A7C15ull);
+   const uint16_t num_instructions = FUZZER_BLOCK_SIZE * FUZZER_NUM_BLOCKS;
+
+   for (uint8_t i = 0; i < FUZZER_PROGRAM_SIZE; ++i)
+   {
+      if (random_next(&state) % FUZZER_IDIOM_RATIO == 0)
+      {
+         i += generate_idiom(&self->program[i], FUZZER_PROGRAM_SIZE - i, &state) - 1;
+      }
+      else
+      {
+         self->program[i] = generate_instruction(&state);
+      }
+   }
+
+   self->num_stimuli = (uint8_t)(random_next(&state) % (FUZZER_MAX_STIMULI + 1));
+   self->num_blocks = FUZZER_NUM_BLOCKS;
+
+   for (uint8_t i = 0; i < self->num_stimuli; ++i)
+   {
+      struct fuzzer_stimulus stimulus;
+      uint8_t j = i;
+
+      stimulus.instruction = (uint16_t)(random_next(&state) % num_instructions);
+      stimulus.value = (uint8_t)random_next(&state);
+
+      while (j > 0 && self->stimuli[j - 1].instruction > stimulus.instruction)
+      {
+         self->stimuli[j] = self->stimuli[j - 1];
+         j--;
+      }
+      self->stimuli[j] = stimulus;
+   }
+   return;
+}
+
+static uint32_t generate_instruction(uint64_t* state)
+{
+   const uint64_t r = random_next(state);
+   const struct instruction_format* format = &formats[r % (sizeof(formats) / sizeof(formats[0]))];
+   const uint8_t reg1 = (uint8_t)((r >> 8) % CPU_REGISTER_ADDRESS_WIDTH);
+   const uint8_t reg2 = (uint8_t)((r >> 16) % CPU_REGISTER_ADDRESS_WIDTH);
+   const uint8_t byte = (uint8_t)(r >> 24);
+   const uint8_t pointer = XL + 2 * (uint8_t)((r >> 32) % 3);
+   const uint8_t pair1 = 2 * (uint8_t)((r >> 40) % (CPU_REGISTER_ADDRESS_WIDTH / 2));
+   const uint8_t pair2 = 2 * (uint8_t)((r >> 48) % (CPU_REGISTER_ADDRESS_WIDTH / 2));
+   const uint8_t high = (uint8_t)(((r >> 56) % ((DATA_MEMORY_ADDRESS_WIDTH >> 8) + 1)) << 5);
+
+   switch (format->operands)
+   {
+      case OPERANDS_REG:           return assemble(format->op_code, reg1, 0x00);
+      case OPERANDS_REG_REG:       return assemble(format->op_code, reg1, reg2);
+      case OPERANDS_REG_CONSTANT:  return assemble(format->op_code, reg1, byte);
+      case OPERANDS_IO_REG:        return assemble(format->op_code, byte % IO_ADDRESSES, reg2);
+      case OPERANDS_REG_IO:        return assemble(format->op_code, reg1, byte % IO_ADDRESSES);
+      case OPERANDS_DATA_REG:      return assemble(format->op_code, byte, reg2);
+      case OPERANDS_REG_DATA:      return assemble(format->op_code, reg1, byte);
+      case OPERANDS_TARGET:        return assemble(format->op_code, byte % FUZZER_PROGRAM_SIZE, reg2 & 0x01);
+      case OPERANDS_REG_POINTER:   return assemble(format->op_code, reg1, pointer);
+      case OPERANDS_POINTER_REG:   return assemble(format->op_code, pointer, reg2);
+      case OPERANDS_REG_OFFSET:    return assemble(format->op_code, reg1, byte % 64);
+      case OPERANDS_OFFSET_REG:    return assemble(format->op_code, byte % 64, reg2);
+      case OPERANDS_PAIR_PAIR:     return assemble(format->op_code, pair1, pair2);
+      case OPERANDS_PAIR_CONSTANT: return assemble(format->op_code, R24 + 2 * (reg1 % 4), byte % 64);
+      case OPERANDS_WIDE_REG:      return assemble(format->op_code, byte, high | reg2);
+      case OPERANDS_REG_WIDE:      return assemble(format->op_code, high | reg1, byte);
+      default:                     return assemble(format->op_code, 0x00, 0x00);
+   }
+}
+
+static uint8_t generate_idiom(uint32_t* program,
+                              const uint8_t num_free,
+                              uint64_t* state)
+{
+   const uint64_t r = random_next(state);
+   const uint8_t reg = (uint8_t)((r >> 8) % CPU_REGISTER_ADDRESS_WIDTH);
+   const uint8_t byte = (uint8_t)(r >> 16);
+   const uint8_t io = (uint8_t)((r >> 24) % IO_ADDRESSES);
+   const uint8_t target = (uint8_t)((r >> 32) % FUZZER_PROGRAM_SIZE);
+
+   if (num_free >= 3 && r % 4 == 0)
+   {
+      program[0] = assemble(IN, reg, io);
+      program[1] = assemble(ORI, reg, byte);
+      program[2] = assemble(OUT, (uint8_t)((r >> 40) % IO_ADDRESSES), reg);
+      return 3;
+   }
+   else if (num_free >= 2 && r % 4 == 1)
+   {
+      program[0] = assemble(LDI, reg, byte);
+      program[1] = assemble(OUT, io, reg);
+      return 2;
+   }
+   else if (num_free >= 2 && r % 4 == 2)
+   {
+      program[0] = assemble(CPI, reg, byte);
+      program[1] = assemble(BREQ, target, 0x00);
+      return 2;
+   }
+   else if (num_free >= 2)
+   {
+      program[0] = assemble(LDS, reg, byte);
+      program[1] = assemble(CPI, reg, (uint8_t)(r >> 40));
+      return 2;
+   }
+   program[0] = generate_instruction(state);
+   return 1;
+}
+
+static bool engines_differ(const struct fuzzer_case* self,
+                           struct control_unit_snapshot* snapshots,
+                           uint16_t* block,
+                           struct control_unit_snapshot* actual)
+{
+   uint8_t next_stimulus = 0;
+
+   program_memory_load(self->program, FUZZER_PROGRAM_SIZE);
+   control_unit_reset();
+
+   for (uint16_t i = 0; i < self->num_blocks; ++i)
+   {
+      run_block(self, control_unit_run, i, &next_stimulus);
+      control_unit_snapshot(&snapshots[i]);
+   }
+
+   next_stimulus = 0;
+   control_unit_reset();
+
+   for (uint16_t i = 0; i < self->num_blocks; ++i)
+   {
+      run_block(self, alternate_engine, i, &next_stimulus);
+      control_unit_snapshot(actual);
+
+      if (memcmp(actual, &snapshots[i], sizeof(*actual)))
+      {
+         *block = i;
+         return true;
+      }
+   }
+   return false;
+}
+
+static void run_block(const struct fuzzer_case* self,
+                      const fuzzer_engine engine,
+                      const uint16_t block,
+                      uint8_t* next_stimulus)
+{
+   uint32_t executed = block * FUZZER_BLOCK_SIZE;
+   const uint32_t end = executed + FUZZER_BLOCK_SIZE;
+
+   while (executed < end)
+   {
+      uint32_t stop = end;
+
+      while (*next_stimulus < self->num_stimuli && self->stimuli[*next_stimulus].instruction <= executed)
+      {
+         data_memory_write(PINB, self->stimuli[(*next_stimulus)++].value);
+      }
+
+      if (*next_stimulus < self->num_stimuli && self->stimuli[*next_stimulus].instruction < stop)
+      {
+         stop = self->stimuli[*next_stimulus].instruction;
+      }
+
+      const uint32_t num_executed = engine(stop - executed);
+      if (!num_executed) break;
+      executed += num_executed;
+   }
+   return;
+}
+
+static void minimize(struct fuzzer_case* self,
+                     struct control_unit_snapshot* snapshots,
+                     uint16_t* block,
+                     struct control_unit_snapshot* actual)
+{
+   bool reduced = true;
+   self->num_blocks = *block + 1;
+
+   while (reduced)
+   {
+      reduced = false;
+
+      for (uint8_t i = self->num_stimuli; i > 0; --i)
+      {
+         struct fuzzer_case candidate = *self;
+         remove_stimulus(&candidate, i - 1);
+
+         if (engines_differ(&candidate, snapshots, block, actual))
+         {
+            *self = candidate;
+            self->num_blocks = *block + 1;
+            reduced = true;
+         }
+      }
+
+      for (uint8_t i = FUZZER_PROGRAM_SIZE; i > 0; --i)
+      {
+         struct fuzzer_case candidate = *self;
+         if (candidate.program[i - 1] == assemble(NOP, 0x00, 0x00)) continue;
+         candidate.program[i - 1] = assemble(NOP, 0x00, 0x00);
+
+         if (engines_differ(&candidate, snapshots, block, actual))
+         {
+            *self = candidate;
+            self->num_blocks = *block + 1;
+            reduced = true;
+         }
+      }
+   }
+
+   engines_differ(self, snapshots, block, actual); /* Restores the states of the minimized case. */
+   return;
+}
+
+static void remove_stimulus(struct fuzzer_case* self,
+                            const uint8_t index)
+{
+   for (uint8_t i = index; i + 1 < self->num_stimuli; ++i)
+   {
+      self->stimuli[i] = self->stimuli[i + 1];
+   }
+   self->num_stimuli--;
+   return;
+}
+
+static void print_case(const struct fuzzer_case* self)
+{
+   uint8_t num_instructions = FUZZER_PROGRAM_SIZE;
+
+   while (num_instructions > 0 && self->program[num_instructions - 1] == assemble(NOP, 0x00, 0x00))
+   {
+      num_instructions--;
+   }
+
+   for (uint8_t i = 0; i < num_instructions; ++i)
+   {
+      const uint32_t instruction = self->program[i];
+      if (instruction == assemble(NOP, 0x00, 0x00)) continue;
+      printf("   %3hu: %-6s 0x%02X, 0x%02X\n", i, cpu_instruction_name((uint8_t)(instruction >> 16)),
+             (instruction >> 8) & 0xFF, instruction & 0xFF);
+   }
+
+   for (uint8_t i = 0; i < self->num_stimuli; ++i)
+   {
+      printf("   PINB = 0x%02X before instruction %hu\n", self->stimuli[i].value,
+             self->stimuli[i].instruction);
+   }
+   return;
+}
+
+static void print_difference(const struct control_unit_snapshot* expected,
+                             const struct control_unit_snapshot* actual)
+{
+   printf("   %-20s%-12s%s\n", "", "Expected", "Actual");
+   if (expected->pc != actual->pc) printf("   %-20s0x%02X        0x%02X\n", "Program counter", expected->pc, actual->pc);
+   if (expected->mar != actual->mar) printf("   %-20s0x%02X        0x%02X\n", "MAR", expected->mar, actual->mar);
+   if (expected->ir != actual->ir) printf("   %-20s0x%06X    0x%06X\n", "IR", expected->ir, actual->ir);
+   if (expected->sr != actual->sr) printf("   %-20s0x%02X        0x%02X\n", "SR", expected->sr, actual->sr);
+   if (expected->cycles != actual->cycles) printf("   %-20s%-12llu%llu\n", "Cycles", (unsigned long long)expected->cycles, (unsigned long long)actual->cycles);
+   if (expected->state != actual->state) printf("   %-20s%-12s%s\n", "State", cpu_state_name(expected->state), cpu_state_name(actual->state));
+
+   for (uint8_t i = 0; i < CPU_REGISTER_ADDRESS_WIDTH; ++i)
+   {
+      if (expected->reg[i] != actual->reg[i])
+      {
+         printf("   R%-19hu0x%02X        0x%02X\n", i, expected->reg[i], actual->reg[i]);
+      }
+   }
+
+   for (uint16_t i = 0; i < DATA_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      if (expected->data[i] != actual->data[i])
+      {
+         printf("   Data[%4hu]%-10s0x%02X        0x%02X\n", i, "", expected->data[i], actual->data[i]);
+      }
+   }
+
+   if (memcmp(expected->stack, actual->stack, sizeof(expected->stack)) ||
+       expected->stack_pointer != actual->stack_pointer || expected->stack_empty != actual->stack_empty)
+   {
+      printf("   %-20s0x%02X        0x%02X (content differs)\n", "Stack pointer", 
+             expected->stack_pointer, actual->stack_pointer);
+   }
+   return;
+}
+
+static inline uint64_t random_next(uint64_t* state)
+{
+   uint64_t z = (*state += 0x9E3779B97F4A7C15ull); /* Splitmix64. */
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+   return z ^ (z >> 31);
+}
+
+static inline uint32_t assemble(const uint8_t op_code,
+                                const uint8_t op1,
+                                const uint8_t op2)
+{
+   const uint32_t instruction = (op_code << 16) | (op1 << 8) | op2;
+   return instruction;
+}
@@ -0,0 +1,101 @@
+/********************************************************************************
+* fuzzer.h: Contains functionality for differential fuzzing of execution
+*           engines. Random programs over the instruction set in cpu.h are
+*           run together with random input to PINB, first by the reference
+*           engine control_unit_run and then by an alternate engine, for
+*           instance control_unit_run_fast. The complete architectural
+*           state is compared after every block of instructions.
+*
+*           Cases are run in parallel on all host cores, where every thread
+*           runs its own instance of the system (see CPU_THREAD_LOCAL). The
+*           first case found where the engines differ is minimized by
+*           removing stimuli and replacing instructions with NOP for as
+*           long as the engines still differ.
+********************************************************************************/
+#ifndef FUZZER_H_
+#define FUZZER_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "control_unit.h"
+
+#define FUZZER_PROGRAM_SIZE  32     /* Number of instructions per generated program. */
+#define FUZZER_BLOCK_SIZE    8      /* Number of instructions run between comparisons. */
+#define FUZZER_NUM_BLOCKS    32     /* Number of blocks run per case. */
+#define FUZZER_MAX_STIMULI   8      /* Maximum number of PINB inputs per case. */
+#define FUZZER_MAX_THREADS   64     /* Maximum number of threads. */
+#define FUZZER_DEFAULT_CASES 100000 /* Number of cases run from the menu. */
+#define FUZZER_IDIOM_RATIO   8      /* One in eight instructions starts a fused sequence. */
+
+/********************************************************************************
+* fuzzer_engine: Execution engine under test. Runs specified number of
+*                instructions from an instruction boundary and returns the
+*                number of executed instructions, like control_unit_run.
+********************************************************************************/
+typedef uint32_t (*fuzzer_engine)(const uint32_t num_instructions);
+
+/********************************************************************************
+* fuzzer_stimulus: Input written to PINB before specified instruction.
+********************************************************************************/
+struct fuzzer_stimulus
+{
+   uint16_t instruction; /* Number of instructions executed before the input. */
+   uint8_t value;        /* The value written to PINB. */
+};
+
+/********************************************************************************
+* fuzzer_case: Generated program with stimuli, run by both engines.
+********************************************************************************/
+struct fuzzer_case
+{
+   uint32_t program[FUZZER_PROGRAM_SIZE];              /* Instructions stored from address 0. */
+   struct fuzzer_stimulus stimuli[FUZZER_MAX_STIMULI]; /* Inputs sorted by instruction. */
+   uint8_t num_stimuli;                                /* Number of inputs. */
+   uint16_t num_blocks;                                /* Number of blocks to run. */
+};
+
+/********************************************************************************
+* fuzzer_report: Result of a fuzzing run. If the engines differ, the
+*                minimized case is stored together with the expected and
+*                actual state after the first block where they differ.
+********************************************************************************/
+struct fuzzer_report
+{
+   uint64_t num_cases;                     /* Number of cases run. */
+   uint8_t num_threads;                    /* Number of threads used. */
+   double seconds;                         /* Duration of the run. */
+   bool mismatch_found;                    /* Indicates if the engines differ. */
+   uint64_t case_number;                   /* Number of the failing case. */
+   struct fuzzer_case minimized;           /* The minimized failing case. */
+   uint16_t block;                         /* First block where the engines differ. */
+   struct control_unit_snapshot expected;  /* State after the reference engine. */
+   struct control_unit_snapshot actual;    /* State after the alternate engine. */
+};
+
+/********************************************************************************
+* fuzzer_run: Runs specified number of cases on the reference engine and
+*             specified alternate engine, using all host cores, and stores
+*             the result at referenced location. Cases are generated from
+*             the seed and the case number, so a run can be repeated.
+*             Returns 0 if the engines matched in every case, otherwise
+*             error code 1.
+*
+*             - alternate: The engine to compare with the reference engine.
+*             - num_cases: The number of cases to run.
+*             - seed     : Seed for the generated cases.
+*             - report   : Reference to the report of the run.
+********************************************************************************/
+int fuzzer_run(const fuzzer_engine alternate,
+               const uint64_t num_cases,
+               const uint64_t seed,
+               struct fuzzer_report* report);
+
+/********************************************************************************
+* fuzzer_print_report: Prints specified report, including the minimized case
+*                      and the differing state if the engines differ.
+*
+*                      - report: Reference to the report.
+********************************************************************************/
+void fuzzer_print_report(const struct fuzzer_report* report);
+
+#endif /* FUZZER_H_ */
\ No newline at end of file
@@ -0,0 +1,740 @@
+/********************************************************************************
+* gdb_server.c: Contains functionality for debugging the program running on
+*               the control unit with GDB over a local TCP socket.
+********************************************************************************/
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET socket_t;
+#define close_socket closesocket
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define close_socket close
+#endif
+
+#include "gdb_server.h"
+
+#define PACKET_SIZE      1024     /* Maximum size of a packet, including framing. */
+#define DATA_ADDRESS     0x800000 /* Offset for data memory addresses in GDB. */
+#define SREG_REGISTER    32       /* GDB register number for the status register. */
+#define SP_REGISTER      33       /* GDB register number for the stack pointer. */
+#define PC_REGISTER      34       /* GDB register number for the program counter. */
+
+static socket_t client = INVALID_SOCKET;
+static bool session_finished = false;
+static char received[PACKET_SIZE];  /* Bytes received while polling for interrupt. */
+static size_t num_received = 0;
+
+static void serve(void);
+static int receive_packet(char* s,
+                          const size_t size);
+static int send_packet(const char* s);
+static void handle_packet(char* packet,
+                          char* reply);
+static void read_registers(char* reply);
+static void write_registers(const char* s);
+static void read_register(const uint8_t number,
+                          char* reply);
+static void write_register(const uint8_t number,
+                           const char* s);
+static void read_memory(const uint32_t address,
+                        const uint16_t length,
+                        char* reply);
+static int write_memory(const uint32_t address,
+                        const uint16_t length,
+                        const char* s);
+static void step(char* reply);
+static void resume(char* reply);
+static void stop_reason(char* reply);
+static int insert_point(const char type,
+                        const uint32_t address,
+                        const uint16_t length);
+static int remove_point(const char type,
+                        const uint32_t address);
+static bool interrupt_requested(void);
+static int receive_byte(char* c);
+static inline void to_hex(const uint8_t value,
+                          char* s);
+static inline uint8_t from_hex(const char* s);
+
+/********************************************************************************
+* gdb_server_run: Listens for a GDB connection on specified TCP port at the
+*                 local host and serves the connected debugger until it
+*                 detaches, kills the target or closes the connection.
+*                 Returns 0 after a finished debug session or error code 1
+*                 if no connection could be established.
+*
+*                 - port: The TCP port to listen on.
+********************************************************************************/
+int gdb_server_run(const uint16_t port)
+{
+   struct sockaddr_in address = { 0 };
+   const int reuse = 1;
+
+#ifdef _WIN32
+   WSADATA wsa_data;
+   if (WSAStartup(MAKEWORD(2, 2), &wsa_data)) return 1;
+#endif
+
+   const socket_t listener = socket(AF_INET, SOCK_STREAM, 0);
+   if (listener == INVALID_SOCKET) return 1;
+   setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+   address.sin_family = AF_INET;
+   address.sin_port = htons(port);
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   if (bind(listener, (struct sockaddr*)&address, sizeof(address)) || listen(listener, 1))
+   {
+      close_socket(listener);
+      return 1;
+   }
+
+   printf("Waiting for GDB to connect on localhost:%hu...\n", port);
+   client = accept(listener, 0, 0);
+   close_socket(listener);
+   if (client == INVALID_SOCKET) return 1;
+
+   printf("GDB connected!\n\n");
+   serve();
+
+   close_socket(client);
+   client = INVALID_SOCKET;
+   num_received = 0;
+   printf("GDB disconnected!\n\n");
+   return 0;
+}
+
+/********************************************************************************
+* serve: Handles packets from the connected debugger until the session is
+*        finished. The control unit is first brought to an instruction
+*        boundary, since the debugger only sees whole instructions.
+********************************************************************************/
+static void serve(void)
+{
+   char packet[PACKET_SIZE] = { '\0' };
+   char reply[PACKET_SIZE] = { '\0' };
+
+   if (control_unit_state() != CPU_STATE_FETCH)
+   {
+      control_unit_run_next_instruction();
+   }
+
+   session_finished = false;
+
+   while (!session_finished && !receive_packet(packet, sizeof(packet)))
+   {
+      reply[0] = '\0';
+      handle_packet(packet, reply);
+      if (packet[0] != 'k' && send_packet(reply)) break;
+   }
+   return;
+}
+
+/********************************************************************************
+* receive_packet: Receives next packet from the debugger into referenced
+*                 string and acknowledges it. Escaped characters ('}'
+*                 followed by the character XOR 0x20) and run-length
+*                 encoded characters ('*' followed by the repeat count
+*                 plus 29) are decoded. Returns 0 after successful
+*                 reception or error code 1 if the connection is closed.
+*
+*                 - s   : Reference to the string which stores the packet.
+*                 - size: The capacity of the string.
+********************************************************************************/
+static int receive_packet(char* s,
+                          const size_t size)
+{
+   char c = '\0';
+
+   while (1)
+   {
+      size_t length = 0;
+      uint8_t checksum = 0;
+      char digits[2] = { '\0' };
+
+      bool escaped = false;
+      bool repeated = false;
+
+      do
+      {
+         if (receive_byte(&c)) return 1;
+      } while (c != '$');
+
+      while (1)
+      {
+         if (receive_byte(&c)) return 1;
+         if (c == '#') break;
+         checksum += (uint8_t)c;
+
+         if (escaped)
+         {
+            if (length < size - 1) s[length++] = c ^ 0x20;
+            escaped = false;
+         }
+         else if (repeated)
+         {
+            for (int i = 0; i < c - 29 && length > 0 && length < size - 1; ++i)
+            {
+               s[length] = s[length - 1];
+               length++;
+            }
+            repeated = false;
+         }
+         else if (c == '}')
+         {
+            escaped = true;
+         }
+         else if (c == '*')
+         {
+            repeated = true;
+         }
+         else if (length < size - 1)
+         {
+            s[length++] = c;
+         }
+      }
+
+      s[length] = '\0';
+      if (receive_byte(&digits[0]) || receive_byte(&digits[1])) return 1;
+
+      if (from_hex(digits) == checksum)
+      {
+         send(client, "+", 1, 0);
+         return 0;
+      }
+      else
+      {
+         send(client, "-", 1, 0);
+      }
+   }
+}
+
+/********************************************************************************
+* send_packet: Sends specified packet to the debugger and waits for the
+*              acknowledgement. Returns 0 after successful transmission or
+*              error code 1 if the connection is closed.
+*
+*              - s: The packet content.
+********************************************************************************/
+static int send_packet(const char* s)
+{
+   char frame[PACKET_SIZE + 4] = { '\0' };
+   uint8_t checksum = 0;
+   size_t length = 0;
+   char c = '\0';
+
+   frame[length++] = '$';
+
+   for (const char* i = s; *i && length < PACKET_SIZE; ++i)
+   {
+      frame[length++] = *i;
+      checksum += (uint8_t)*i;
+   }
+
+   frame[length++] = '#';
+   to_hex(checksum, frame + length);
+   length += 2;
+
+   do
+   {
+      if (send(client, frame, (int)length, 0) != (int)length) return 1;
+      if (receive_byte(&c)) return 1;
+   } while (c == '-');
+   return 0;
+}
+
+/********************************************************************************
+* handle_packet: Executes the command in specified packet and stores the
+*                reply to send in referenced string. Unsupported commands
+*                are answered with an empty reply.
+*
+*                - packet: The received packet.
+*                - reply : Reference to the string which stores the reply.
+********************************************************************************/
+static void handle_packet(char* packet,
+                          char* reply)
+{
+   const char command = packet[0];
+   char* args = packet + 1;
+
+   if (command == '?')
+   {
+      strcpy(reply, "S05");
+   }
+   else if (command == 'g')
+   {
+      read_registers(reply);
+   }
+   else if (command == 'G')
+   {
+      if (input_log_recording()) strcpy(reply, "E01"); /* Register writes can't be recorded. */
+      else
+      {
+         write_registers(args);
+         strcpy(reply, "OK");
+      }
+   }
+   else if (command == 'p')
+   {
+      read_register((uint8_t)strtoul(args, 0, 16), reply);
+   }
+   else if (command == 'P')
+   {
+      char* value = strchr(args, '=');
+      if (!value || input_log_recording()) strcpy(reply, "E01");
+      else
+      {
+         write_register((uint8_t)strtoul(args, 0, 16), value + 1);
+         strcpy(reply, "OK");
+      }
+   }
+   else if (command == 'm' || command == 'M')
+   {
+      char* end = 0;
+      const uint32_t address = strtoul(args, &end, 16);
+      const uint16_t length = (uint16_t)strtoul(end + 1, &end, 16);
+
+      if (command == 'm')
+      {
+         read_memory(address, length, reply);
+      }
+      else
+      {
+         strcpy(reply, *end == ':' && !write_memory(address, length, end + 1) ? "OK" : "E01");
+      }
+   }
+   else if (command == 's')
+   {
+      step(reply);
+   }
+   else if (command == 'c')
+   {
+      resume(reply);
+   }
+   else if (command == 'Z' || command == 'z')
+   {
+      char* end = 0;
+      const char type = args[0];
+      const uint32_t address = strtoul(args + 2, &end, 16);
+      const uint16_t length = (uint16_t)strtoul(end + 1, 0, 16);
+
+      if (type < '0' || type > '4')
+      {
+         reply[0] = '\0';
+      }
+      else if (command == 'Z')
+      {
+         strcpy(reply, insert_point(type, address, length) ? "E01" : "OK");
+      }
+      else
+      {
+         strcpy(reply, remove_point(type, address) ? "E01" : "OK");
+      }
+   }
+   else if (command == 'k')
+   {
+      session_finished = true;
+   }
+   else if (command == 'D')
+   {
+      breakpoint_clear_all();
+      session_finished = true;
+      strcpy(reply, "OK");
+   }
+   else if (command == 'H')
+   {
+      strcpy(reply, "OK");
+   }
+   else if (!strncmp(packet, "qSupported", 10))
+   {
+      sprintf(reply, "PacketSize=%x;swbreak+", PACKET_SIZE - 4);
+   }
+   else if (!strcmp(packet, "qAttached"))
+   {
+      strcpy(reply, "1");
+   }
+   else if (!strcmp(packet, "qC"))
+   {
+      strcpy(reply, "QC1");
+   }
+   else if (!strcmp(packet, "qfThreadInfo"))
+   {
+      strcpy(reply, "m1");
+   }
+   else if (!strcmp(packet, "qsThreadInfo"))
+   {
+      strcpy(reply, "l");
+   }
+   return;
+}
+
+/********************************************************************************
+* read_registers: Stores R0 - R31, SREG, SP and PC as hexadecimal digits in
+*                 referenced string.
+*
+*                 - reply: Reference to the string which stores the content.
+********************************************************************************/
+static void read_registers(char* reply)
+{
+   for (uint8_t i = 0; i <= PC_REGISTER; ++i)
+   {
+      read_register(i, reply);
+      reply += strlen(reply);
+   }
+   return;
+}
+
+/********************************************************************************
+* write_registers: Writes R0 - R31, SREG, SP and PC from specified string
+*                  of hexadecimal digits.
+*
+*                  - s: The hexadecimal digits.
+********************************************************************************/
+static void write_registers(const char* s)
+{
+   for (uint8_t i = 0; i <= PC_REGISTER && strlen(s) >= 2; ++i)
+   {
+      write_register(i, s);
+      s += i == SP_REGISTER ? 4 : i == PC_REGISTER ? 8 : 2;
+   }
+   return;
+}
+
+/********************************************************************************
+* read_register: Stores specified register as hexadecimal digits (least
+*                significant byte first) in referenced string.
+*
+*                - number: GDB register number.
+*                - reply : Reference to the string which stores the content.
+********************************************************************************/
+static void read_register(const uint8_t number,
+                          char* reply)
+{
+   if (number < CPU_REGISTER_ADDRESS_WIDTH)
+   {
+      to_hex(control_unit_read_register(number), reply);
+   }
+   else if (number == SREG_REGISTER)
+   {
+      to_hex(cpu_sreg_from_sr(control_unit_read_status_register()), reply);
+   }
+   else if (number == SP_REGISTER)
+   {
+      const uint16_t address = stack_address(); /* As read by the program through SPL and SPH. */
+      to_hex((uint8_t)address, reply);
+      to_hex((uint8_t)(address >> 8), reply + 2);
+   }
+   else if (number == PC_REGISTER)
+   {
+      const uint16_t address = control_unit_read_program_counter() * 2;
+      to_hex((uint8_t)address, reply);
+      to_hex((uint8_t)(address >> 8), reply + 2);
+      to_hex(0x00, reply + 4);
+      to_hex(0x00, reply + 6);
+   }
+   else
+   {
+      strcpy(reply, "E01");
+   }
+   return;
+}
+
+/********************************************************************************
+* write_register: Writes specified register from specified hexadecimal
+*                 digits (least significant byte first). The stack pointer
+*                 is read only.
+*
+*                 - number: GDB register number.
+*                 - s     : The hexadecimal digits.
+********************************************************************************/
+static void write_register(const uint8_t number,
+                           const char* s)
+{
+   if (number < CPU_REGISTER_ADDRESS_WIDTH)
+   {
+      control_unit_write_register(number, from_hex(s));
+   }
+   else if (number == SREG_REGISTER)
+   {
+      control_unit_write_status_register(cpu_sr_from_sreg(from_hex(s)));
+   }
+   else if (number == PC_REGISTER && strlen(s) >= 4)
+   {
+      const uint16_t address = from_hex(s) | (from_hex(s + 2) << 8);
+      control_unit_write_program_counter((uint8_t)(address / 2));
+   }
+   return;
+}
+
+/********************************************************************************
+* read_memory: Stores specified memory range as hexadecimal digits in
+*              referenced string.
+*
+*              - address: GDB start address.
+*              - length : The number of bytes to read.
+*              - reply  : Reference to the string which stores the content.
+********************************************************************************/
+static void read_memory(const uint32_t address,
+                        const uint16_t length,
+                        char* reply)
+{
+   const uint32_t end = address + (length < PACKET_SIZE / 2 - 4 ? length : PACKET_SIZE / 2 - 4);
+
+   for (uint32_t i = address; i < end; ++i)
+   {
+      if (i >= DATA_ADDRESS)
+      {
+         to_hex(data_memory_peek((uint16_t)(i - DATA_ADDRESS)), reply);
+      }
+      else
+      {
+         to_hex(program_memory_read_byte((uint16_t)i), reply);
+      }
+      reply += 2;
+   }
+
+   *reply = '\0';
+   return;
+}
+
+/********************************************************************************
+* write_memory: Writes specified data memory range from specified hexadecimal
+*               digits. Writes are passed through the input log, so that
+*               they are recorded while recording. Returns 0 after
+*               successful write or error code 1 if the range isn't located
+*               in data memory.
+*
+*               - address: GDB start address.
+*               - length : The number of bytes to write.
+*               - s      : The hexadecimal digits.
+********************************************************************************/
+static int write_memory(const uint32_t address,
+                        const uint16_t length,
+                        const char* s)
+{
+   if (address < DATA_ADDRESS || strlen(s) < (size_t)length * 2) return 1;
+
+   for (uint16_t i = 0; i < length; ++i)
+   {
+      const uint16_t target = (uint16_t)(address - DATA_ADDRESS + i);
+      const uint8_t value = from_hex(s + 2 * i);
+
+      if (target == PINB || target == PINC || target == PIND)
+      {
+         input_log_write_pin((uint8_t)target, value); /* Recorded as external input. */
+      }
+      else if (input_log_write_data(target, value))
+      {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+/********************************************************************************
+* step: Runs the next instruction, also if a breakpoint is set at the current
+*       address. The stop reason is stored in referenced string.
+*
+*       - reply: Reference to the string which stores the stop reason.
+********************************************************************************/
+static void step(char* reply)
+{
+   breakpoint_step_over(control_unit_read_program_counter());
+   control_unit_run(1);
+   stop_reason(reply);
+   return;
+}
+
+/********************************************************************************
+* resume: Runs the program in batches of whole instructions by the fast
+*         engine until a breakpoint or watchpoint is hit, or the debugger
+*         requests an interrupt. Breakpoints and watchpoints are handled by
+*         the engine in breakpoint.h, which stops the batch at the hit, and
+*         the stop is checked after every batch. The stop reason is stored
+*         in referenced string.
+*
+*         - reply: Reference to the string which stores the stop reason.
+********************************************************************************/
+static void resume(char* reply)
+{
+   breakpoint_step_over(control_unit_read_program_counter());
+
+   while (1)
+   {
+      control_unit_run_fast(GDB_SERVER_BATCH_SIZE);
+      stop_reason(reply);
+      if (strcmp(reply, "S05")) return;
+
+      if (interrupt_requested())
+      {
+         strcpy(reply, "S02");
+         return;
+      }
+   }
+}
+
+/********************************************************************************
+* stop_reason: Stores the stop reply for the last stop requested by a
+*              breakpoint or watchpoint in referenced string. If no stop has
+*              been requested, "S05" is stored.
+*
+*              - reply: Reference to the string which stores the stop reply.
+********************************************************************************/
+static void stop_reason(char* reply)
+{
+   struct breakpoint_stop stop;
+
+   if (!breakpoint_last_stop(&stop))
+   {
+      strcpy(reply, "S05");
+   }
+   else if (!stop.watchpoint)
+   {
+      strcpy(reply, "T05swbreak:;");
+   }
+   else
+   {
+      const char* kind = stop.access == WATCHPOINT_READ ? "rwatch" : 
+                         stop.access == WATCHPOINT_ACCESS ? "awatch" : "watch";
+      sprintf(reply, "T05%s:%lx;", kind, (unsigned long)(DATA_ADDRESS + stop.address));
+   }
+   return;
+}
+
+/********************************************************************************
+* insert_point: Inserts a breakpoint (type '0' or '1'), write watchpoint
+*               (type '2'), read watchpoint (type '3') or access watchpoint
+*               (type '4') at specified address. Returns 0 after successful
+*               insertion or error code 1 if the point couldn't be inserted.
+*
+*               - type   : The type of breakpoint or watchpoint.
+*               - address: GDB address.
+*               - length : Number of watched bytes for watchpoints.
+********************************************************************************/
+static int insert_point(const char type,
+                        const uint32_t address,
+                        const uint16_t length)
+{
+   if (type == '0' || type == '1')
+   {
+      return breakpoint_insert((uint8_t)(address / 2), 0);
+   }
+   else if (address < DATA_ADDRESS)
+   {
+      return 1;
+   }
+   else
+   {
+      const enum watchpoint_access access = type == '3' ? WATCHPOINT_READ : 
+                                            type == '4' ? WATCHPOINT_ACCESS : WATCHPOINT_WRITE;
+      return watchpoint_insert((uint16_t)(address - DATA_ADDRESS), length, access, WATCHPOINT_ANY, 0, 0);
+   }
+}
+
+/********************************************************************************
+* remove_point: Removes the breakpoint or watchpoint at specified address.
+*               Returns 0 after successful removal or error code 1 if no
+*               such point exists.
+*
+*               - type   : The type of breakpoint or watchpoint.
+*               - address: GDB address.
+********************************************************************************/
+static int remove_point(const char type,
+                        const uint32_t address)
+{
+   if (type == '0' || type == '1')
+   {
+      return breakpoint_remove((uint8_t)(address / 2));
+   }
+   else if (address < DATA_ADDRESS)
+   {
+      return 1;
+   }
+   else
+   {
+      return watchpoint_remove((uint16_t)(address - DATA_ADDRESS));
+   }
+}
+
+/********************************************************************************
+* interrupt_requested: Returns true if the debugger has sent an interrupt
+*                      (0x03) or closed the connection. Other bytes
+*                      received while polling are kept for receive_byte.
+********************************************************************************/
+static bool interrupt_requested(void)
+{
+   fd_set fds;
+   struct timeval timeout = { 0, 0 };
+
+   FD_ZERO(&fds);
+   FD_SET(client, &fds);
+
+   if (num_received < sizeof(received) && select((int)client + 1, &fds, 0, 0, &timeout) > 0)
+   {
+      const int n = recv(client, received + num_received, (int)(sizeof(received) - num_received), 0);
+
+      if (n <= 0)
+      {
+         session_finished = true;
+         return true;
+      }
+      num_received += (size_t)n;
+   }
+
+   for (size_t i = 0; i < num_received; ++i)
+   {
+      if (received[i] == 0x03)
+      {
+         memmove(received + i, received + i + 1, num_received - i - 1);
+         num_received--;
+         return true;
+      }
+   }
+   return false;
+}
+
+/********************************************************************************
+* receive_byte: Receives the next byte from the debugger, starting with the
+*               bytes kept while polling for interrupt. Returns 0 after
+*               successful reception or error code 1 if the connection is
+*               closed.
+*
+*               - c: Reference to the character which stores the byte.
+********************************************************************************/
+static int receive_byte(char* c)
+{
+   if (num_received)
+   {
+      *c = received[0];
+      memmove(received, received + 1, --num_received);
+      return 0;
+   }
+   return recv(client, c, 1, 0) != 1;
+}
+
+static inline void to_hex(const uint8_t value,
+                          char* s)
+{
+   const char* digits = "0123456789abcdef";
+   s[0] = digits[value >> 4];
+   s[1] = digits[value & 0x0F];
+   s[2] = '\0';
+   return;
+}
+
+static inline uint8_t from_hex(const char* s)
+{
+   const char digits[3] = { s[0], s[1], '\0' };
+   return (uint8_t)strtoul(digits, 0, 16);
+}
@@ -0,0 +1,39 @@
+/********************************************************************************
+* gdb_server.h: Contains functionality for debugging the program running on
+*               the control unit with GDB, by implementing the GDB remote
+*               serial protocol over a local TCP socket. Connect from GDB
+*               (for instance avr-gdb) with "target remote localhost:<port>".
+*
+*               Registers are mapped as R0 - R31, SREG, SP and PC, memory
+*               addresses from 0x800000 and upwards are mapped onto the data
+*               memory, while lower addresses are mapped onto the bytes of
+*               the program memory, as read by the LPM instruction.
+*
+*               Memory writes are external input and are recorded if the
+*               input log is recording, while register writes are refused
+*               during a recording, since they can't be replayed.
+********************************************************************************/
+#ifndef GDB_SERVER_H_
+#define GDB_SERVER_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "control_unit.h"
+#include "breakpoint.h"
+#include "input_log.h"
+
+#define GDB_SERVER_DEFAULT_PORT 1234 /* Default TCP port to listen on. */
+#define GDB_SERVER_BATCH_SIZE   4096 /* Instructions run between polls for interrupt. */
+
+/********************************************************************************
+* gdb_server_run: Listens for a GDB connection on specified TCP port at the
+*                 local host and serves the connected debugger until it
+*                 detaches, kills the target or closes the connection.
+*                 Returns 0 after a finished debug session or error code 1
+*                 if no connection could be established.
+*
+*                 - port: The TCP port to listen on.
+********************************************************************************/
+int gdb_server_run(const uint16_t port);
+
+#endif /* GDB_SERVER_H_ */
\ No newline at end of file
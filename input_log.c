@@ -0,0 +1,444 @@
+/********************************************************************************
+* input_log.c: Contains functionality for deterministic record and replay of
+*              external input.
+********************************************************************************/
+#include <string.h>
+#include "input_log.h"
+#include "vcd.h"
+
+#define MAGIC_SIZE 6 /* Number of bytes in the magic of the header. */
+
+/********************************************************************************
+* record_kind: Enumeration for the kinds of records in the log.
+********************************************************************************/
+enum record_kind
+{
+   RECORD_PIN,   /* External write to a pin input register. */
+   RECORD_RESET, /* External system reset. */
+   RECORD_END,   /* End of the recorded run. */
+   RECORD_DATA,  /* External write to data memory. */
+   RECORD_USART  /* Byte received by the USART from the host. */
+};
+
+static const char magic[MAGIC_SIZE] = { 'C', 'P', 'U', 'L', 'O', 'G' };
+
+static CPU_THREAD_LOCAL FILE* log_file = 0;
+static CPU_THREAD_LOCAL uint64_t last_cycle = 0; /* Cycle of the last record since last reset. */
+static CPU_THREAD_LOCAL bool replaying = false;
+static CPU_THREAD_LOCAL bool byte_pending = false; /* Set while a replayed byte isn't received. */
+static CPU_THREAD_LOCAL uint64_t byte_cycle = 0;   /* Cycle the replayed byte is received at. */
+static CPU_THREAD_LOCAL uint8_t byte_value = 0x00;
+
+static void append_record(const enum record_kind kind,
+                          const uint16_t address,
+                          const uint8_t value);
+static int replay(FILE* file);
+static inline bool is_pin(const uint8_t address);
+static void write_number(FILE* file,
+                         uint64_t number);
+static int read_number(FILE* file,
+                       uint64_t* number);
+static void write_u32(FILE* file,
+                      const uint32_t number);
+static int read_u32(FILE* file,
+                    uint32_t* number);
+
+/********************************************************************************
+* input_log_record: Starts recording to specified file, which is replaced if
+*                   it exists. Records are flushed to the file as they are
+*                   appended, so the log is complete up to the last input if
+*                   the program is terminated. Returns 0 if recording was
+*                   started or error code 1 if the file couldn't be created.
+*
+*                   - filepath: Path to the log.
+********************************************************************************/
+int input_log_record(const char* filepath)
+{
+   input_log_stop();
+   log_file = fopen(filepath, "wb");
+   if (!log_file) return 1;
+
+   fwrite(magic, 1, MAGIC_SIZE, log_file);
+   fputc(INPUT_LOG_VERSION, log_file);
+   fputc(0x00, log_file);
+   write_u32(log_file, program_memory_hash());
+   fflush(log_file);
+   last_cycle = control_unit_cycles();
+   return 0;
+}
+
+/********************************************************************************
+* input_log_stop: Stops recording by appending the current cycle and a hash
+*                 of the current state to the log and closing it.
+********************************************************************************/
+void input_log_stop(void)
+{
+   if (!log_file) return;
+   append_record(RECORD_END, 0x00, 0x00);
+   fclose(log_file);
+   log_file = 0;
+   return;
+}
+
+/********************************************************************************
+* input_log_write_pin: Writes specified value to specified pin input register
+*                      as external input and records the write if recording.
+*                      The write isn't passed to data memory hooks, since it
+*                      isn't made by the program, but it's dumped if a VCD
+*                      dump is open. Returns 0 after successful write or
+*                      error code 1 if the address doesn't belong to a pin
+*                      input register.
+*
+*                      - address: Address of PINB, PINC or PIND.
+*                      - value  : The value to write.
+********************************************************************************/
+int input_log_write_pin(const uint8_t address,
+                        const uint8_t value)
+{
+   if (!is_pin(address)) return 1;
+   data_memory_poke(address, value);
+   vcd_update();
+   if (log_file) append_record(RECORD_PIN, address, value);
+   return 0;
+}
+
+/********************************************************************************
+* input_log_write_data: Writes specified value to specified data memory
+*                       address as external input, for instance a write to
+*                       shared SRAM made by another core, and records the
+*                       write if recording. Like for pin writes, the write
+*                       isn't passed to data memory hooks. Returns 0 after
+*                       successful write or error code 1 if the address is
+*                       outside data memory, in which case nothing is
+*                       recorded.
+*
+*                       - address: The data memory address.
+*                       - value  : The value to write.
+********************************************************************************/
+int input_log_write_data(const uint16_t address,
+                         const uint8_t value)
+{
+   if (data_memory_poke(address, value)) return 1;
+   if (log_file) append_record(RECORD_DATA, address, value);
+   return 0;
+}
+
+/********************************************************************************
+* input_log_receive: Passes a byte received by the USART from the host
+*                    through the log. While recording, the byte is recorded
+*                    with the current cycle. While replaying, the byte is
+*                    instead replaced by the byte recorded at the current
+*                    cycle. Returns true if a byte is received, else false.
+*
+*                    - value: Reference to the received byte.
+********************************************************************************/
+bool input_log_receive(uint8_t* value)
+{
+   if (replaying)
+   {
+      if (!byte_pending || byte_cycle != control_unit_cycles()) return false;
+      *value = byte_value;
+      byte_pending = false;
+      return true;
+   }
+
+   if (log_file) append_record(RECORD_USART, 0x00, *value);
+   return true;
+}
+
+/********************************************************************************
+* input_log_recording: Returns true while recording, in which case external
+*                      changes of the state that can't be recorded, such as
+*                      writes to the CPU registers, must be refused.
+********************************************************************************/
+bool input_log_recording(void)
+{
+   return log_file != 0;
+}
+
+/********************************************************************************
+* input_log_replaying: Returns true while a log is replayed, in which case
+*                      bytes from the host must not be received by the USART.
+********************************************************************************/
+bool input_log_replaying(void)
+{
+   return replaying;
+}
+
+/********************************************************************************
+* input_log_reset: Resets the system as external input and records the reset
+*                  if recording.
+********************************************************************************/
+void input_log_reset(void)
+{
+   if (log_file) append_record(RECORD_RESET, 0x00, 0x00);
+   control_unit_reset();
+   vcd_update();
+   last_cycle = 0;
+   return;
+}
+
+/********************************************************************************
+* input_log_replay: Replays the log in specified file on the program currently
+*                   stored in program memory, starting from system reset, and
+*                   prints the result. Returns 0 if the recorded run was
+*                   reproduced bit for bit, otherwise error code 1.
+*
+*                   - filepath: Path to the log.
+********************************************************************************/
+int input_log_replay(const char* filepath)
+{
+   FILE* file = fopen(filepath, "rb");
+   char header[MAGIC_SIZE + 2] = { 0 };
+   uint32_t hash = 0;
+   int result = 0;
+
+   if (!file)
+   {
+      fprintf(stderr, "Could not open log %s!\n", filepath);
+      return 1;
+   }
+
+   if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, magic, MAGIC_SIZE) ||
+       header[MAGIC_SIZE] != INPUT_LOG_VERSION || read_u32(file, &hash))
+   {
+      fprintf(stderr, "%s is not a log of version %d!\n", filepath, INPUT_LOG_VERSION);
+      fclose(file);
+      return 1;
+   }
+
+   if (hash != program_memory_hash())
+   {
+      fprintf(stderr, "The log was recorded with another program (hash 0x%08X, loaded 0x%08X)!\n",
+              hash, program_memory_hash());
+      fclose(file);
+      return 1;
+   }
+
+   replaying = true;
+   result = replay(file);
+   replaying = false;
+   byte_pending = false;
+   fclose(file);
+   return result;
+}
+
+/********************************************************************************
+* input_log_state_hash: Returns a 64-bit hash of the complete architectural
+*                       state of the system, see control_unit_snapshot.
+********************************************************************************/
+uint64_t input_log_state_hash(void)
+{
+   static struct control_unit_snapshot snapshot;
+   control_unit_snapshot(&snapshot);
+   return control_unit_snapshot_hash(&snapshot);
+}
+
+/********************************************************************************
+* replay: Replays the records of specified log, whose header has been read,
+*         from system reset and prints the result. A received byte is
+*         handed to the USART by input_log_receive when the USART loads
+*         UDR0 at the recorded cycle. Returns 0 if the recorded run was
+*         reproduced bit for bit, otherwise error code 1.
+*
+*         - file: The log.
+********************************************************************************/
+static int replay(FILE* file)
+{
+   uint64_t cycle = 0;
+   uint32_t num_inputs = 0;
+
+   control_unit_reset();
+   vcd_update();
+
+   while (1)
+   {
+      const int kind = fgetc(file);
+      uint64_t delta = 0;
+
+      if (kind == EOF || read_number(file, &delta))
+      {
+         fprintf(stderr, "The log ends without end record after %u inputs!\n", num_inputs);
+         return 1;
+      }
+
+      cycle += delta;
+
+      if (kind == RECORD_USART)
+      {
+         const int value = fgetc(file);
+
+         if (value == EOF)
+         {
+            fprintf(stderr, "Invalid USART input in record %u!\n", num_inputs);
+            return 1;
+         }
+
+         byte_pending = true;
+         byte_cycle = cycle;
+         byte_value = (uint8_t)value;
+      }
+
+      if (!control_unit_run_until(cycle))
+      {
+         fprintf(stderr, "The replay was stopped at cycle %llu before record %u!\n",
+                 (unsigned long long)control_unit_cycles(), num_inputs);
+         return 1;
+      }
+
+      if (kind == RECORD_PIN)
+      {
+         const int address = fgetc(file);
+         const int value = fgetc(file);
+
+         if (address == EOF || value == EOF || input_log_write_pin((uint8_t)address, (uint8_t)value))
+         {
+            fprintf(stderr, "Invalid pin input in record %u!\n", num_inputs);
+            return 1;
+         }
+         num_inputs++;
+      }
+      else if (kind == RECORD_DATA)
+      {
+         const int low = fgetc(file);
+         const int high = fgetc(file);
+         const int value = fgetc(file);
+
+         if (low == EOF || high == EOF || value == EOF)
+         {
+            fprintf(stderr, "Invalid data input in record %u!\n", num_inputs);
+            return 1;
+         }
+         input_log_write_data((uint16_t)(low | (high << 8)), (uint8_t)value);
+         num_inputs++;
+      }
+      else if (kind == RECORD_USART)
+      {
+         if (byte_pending)
+         {
+            fprintf(stderr, "The USART didn't receive the byte in record %u, replay with the USART open!\n",
+                    num_inputs);
+            return 1;
+         }
+         num_inputs++;
+      }
+      else if (kind == RECORD_RESET)
+      {
+         control_unit_reset();
+         vcd_update();
+         cycle = 0;
+         num_inputs++;
+      }
+      else
+      {
+         uint32_t state_hash[2] = { 0 };
+         const int error = read_u32(file, &state_hash[0]) || read_u32(file, &state_hash[1]);
+         const uint64_t expected = ((uint64_t)state_hash[1] << 32) | state_hash[0];
+         const uint64_t actual = input_log_state_hash();
+
+         printf("Replayed %u inputs in %llu cycles.\n", num_inputs, (unsigned long long)cycle);
+
+         if (error || kind != RECORD_END || expected != actual)
+         {
+            printf("The end state differs from the recorded run (hash 0x%016llX, recorded 0x%016llX)!\n",
+                   (unsigned long long)actual, (unsigned long long)expected);
+            return 1;
+         }
+
+         printf("The end state matches the recorded run (hash 0x%016llX).\n", (unsigned long long)actual);
+         return 0;
+      }
+   }
+}
+
+static void append_record(const enum record_kind kind,
+                          const uint16_t address,
+                          const uint8_t value)
+{
+   const uint64_t cycle = control_unit_cycles();
+
+   fputc(kind, log_file);
+   write_number(log_file, cycle - last_cycle);
+   last_cycle = cycle;
+
+   if (kind == RECORD_PIN)
+   {
+      fputc(address, log_file);
+      fputc(value, log_file);
+   }
+   else if (kind == RECORD_DATA)
+   {
+      fputc(address & 0xFF, log_file);
+      fputc(address >> 8, log_file);
+      fputc(value, log_file);
+   }
+   else if (kind == RECORD_USART)
+   {
+      fputc(value, log_file);
+   }
+   else if (kind == RECORD_END)
+   {
+      const uint64_t hash = input_log_state_hash();
+      write_u32(log_file, (uint32_t)hash);
+      write_u32(log_file, (uint32_t)(hash >> 32));
+   }
+
+   fflush(log_file);
+   return;
+}
+
+static inline bool is_pin(const uint8_t address)
+{
+   return address == PINB || address == PINC || address == PIND;
+}
+
+static void write_number(FILE* file,
+                         uint64_t number)
+{
+   while (number >= 0x80)
+   {
+      fputc((int)(number & 0x7F) | 0x80, file);
+      number >>= 7;
+   }
+   fputc((int)number, file);
+   return;
+}
+
+static int read_number(FILE* file,
+                       uint64_t* number)
+{
+   *number = 0;
+
+   for (uint8_t shift = 0; shift < 64; shift += 7)
+   {
+      const int byte = fgetc(file);
+      if (byte == EOF) return 1;
+      *number |= (uint64_t)(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) return 0;
+   }
+   return 1;
+}
+
+static void write_u32(FILE* file,
+                      const uint32_t number)
+{
+   for (uint8_t i = 0; i < 4; ++i)
+   {
+      fputc((int)((number >> (8 * i)) & 0xFF), file);
+   }
+   return;
+}
+
+static int read_u32(FILE* file,
+                    uint32_t* number)
+{
+   *number = 0;
+
+   for (uint8_t i = 0; i < 4; ++i)
+   {
+      const int byte = fgetc(file);
+      if (byte == EOF) return 1;
+      *number |= (uint32_t)byte << (8 * i);
+   }
+   return 0;
+}
@@ -0,0 +1,123 @@
+/********************************************************************************
+* input_log.h: Contains functionality for deterministic record and replay of
+*              external input. While recording, every external write to the
+*              pin input registers PINB, PINC and PIND or to data memory,
+*              every byte received by the USART from the host and every
+*              external system reset is appended to a binary log together
+*              with the clock cycle it occured at. Since the system is deterministic
+*              otherwise, a replay reproduces the recorded run exactly,
+*              without the interactive controller and at full speed.
+*
+*              The log starts with a header holding the magic "CPULOG", the
+*              format version and a hash of the program image, followed by
+*              one record per input. Each record holds its kind, the number
+*              of cycles since the previous record as a variable length
+*              quantity, for pin and data writes the address and the value
+*              and for received bytes the byte. The
+*              last record holds a hash of the complete end state, so that
+*              a replay can verify that the run was reproduced bit for bit.
+********************************************************************************/
+#ifndef INPUT_LOG_H_
+#define INPUT_LOG_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "control_unit.h"
+
+#define INPUT_LOG_VERSION 2 /* Version of the log format. */
+
+/********************************************************************************
+* input_log_record: Starts recording to specified file, which is replaced if
+*                   it exists. Records are flushed to the file as they are
+*                   appended, so the log is complete up to the last input if
+*                   the program is terminated. Returns 0 if recording was
+*                   started or error code 1 if the file couldn't be created.
+*
+*                   - filepath: Path to the log.
+********************************************************************************/
+int input_log_record(const char* filepath);
+
+/********************************************************************************
+* input_log_stop: Stops recording by appending the current cycle and a hash
+*                 of the current state to the log and closing it.
+********************************************************************************/
+void input_log_stop(void);
+
+/********************************************************************************
+* input_log_write_pin: Writes specified value to specified pin input register
+*                      as external input and records the write if recording.
+*                      The write isn't passed to data memory hooks, since it
+*                      isn't made by the program, but it's dumped if a VCD
+*                      dump is open. Returns 0 after successful write or
+*                      error code 1 if the address doesn't belong to a pin
+*                      input register.
+*
+*                      - address: Address of PINB, PINC or PIND.
+*                      - value  : The value to write.
+********************************************************************************/
+int input_log_write_pin(const uint8_t address,
+                        const uint8_t value);
+
+/********************************************************************************
+* input_log_write_data: Writes specified value to specified data memory
+*                       address as external input, for instance a write to
+*                       shared SRAM made by another core, and records the
+*                       write if recording. Like for pin writes, the write
+*                       isn't passed to data memory hooks. Returns 0 after
+*                       successful write or error code 1 if the address is
+*                       outside data memory, in which case nothing is
+*                       recorded.
+*
+*                       - address: The data memory address.
+*                       - value  : The value to write.
+********************************************************************************/
+int input_log_write_data(const uint16_t address,
+                         const uint8_t value);
+
+/********************************************************************************
+* input_log_receive: Passes a byte received by the USART from the host
+*                    through the log. While recording, the byte is recorded
+*                    with the current cycle. While replaying, the byte is
+*                    instead replaced by the byte recorded at the current
+*                    cycle. Returns true if a byte is received, else false.
+*
+*                    - value: Reference to the received byte.
+********************************************************************************/
+bool input_log_receive(uint8_t* value);
+
+/********************************************************************************
+* input_log_recording: Returns true while recording, in which case external
+*                      changes of the state that can't be recorded, such as
+*                      writes to the CPU registers, must be refused.
+********************************************************************************/
+bool input_log_recording(void);
+
+/********************************************************************************
+* input_log_replaying: Returns true while a log is replayed, in which case
+*                      bytes from the host must not be received by the USART.
+********************************************************************************/
+bool input_log_replaying(void);
+
+/********************************************************************************
+* input_log_reset: Resets the system as external input and records the reset
+*                  if recording.
+********************************************************************************/
+void input_log_reset(void);
+
+/********************************************************************************
+* input_log_replay: Replays the log in specified file on the program currently
+*                   stored in program memory, starting from system reset, and
+*                   prints the result. Returns 0 if the recorded run was
+*                   reproduced bit for bit, otherwise error code 1.
+*
+*                   - filepath: Path to the log.
+********************************************************************************/
+int input_log_replay(const char* filepath);
+
+/********************************************************************************
+* input_log_state_hash: Returns a 64-bit hash of the complete architectural
+*                       state of the system, see control_unit_snapshot.
+********************************************************************************/
+uint64_t input_log_state_hash(void);
+
+#endif /* INPUT_LOG_H_ */
\ No newline at end of file
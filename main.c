@@ -1,10 +1,235 @@
-#include "cpu_controller.h"
-
-/********************************************************************************
-* main: Controls the program flow of an 8-bit processor by keyboard input.
-********************************************************************************/
-int main(void)
-{
-   cpu_controller_run_by_input();
-   return 0;
+#include <string.h>
+#include "cpu_controller.h"
+#include "shared_state.h"
+#include "usart.h"
+#include "vcd.h"
+#include "coverage.h"
+#include "profiler.h"
+#include "translator.h"
+#include "simulator.h"
+
+static void save_coverage(const char* coverage_path,
+                          const char* lcov_path,
+                          const char* source);
+static void save_profile(const char* profile_path);
+
+/********************************************************************************
+* main: Controls the program flow of an 8-bit processor by keyboard input.
+*       If the path to an Intel HEX file is passed as argument, the file is
+*       decoded and loaded into program memory instead of the built-in program.
+*
+*       With the option --record <log>, external input entered from the
+*       keyboard is recorded to specified log. With the option --replay <log>,
+*       the recorded run is instead replayed without keyboard input.
+*
+*       With the option --publish <name>, the state of the system is published
+*       to specified shared memory segment every --interval <cycles> clock
+*       cycles. With the option --monitor <name>, the state published by
+*       another process is instead printed until that process finishes.
+*
+*       With the option --usart <path>, USART0 is bridged to specified pipe,
+*       serial port or file, or to a new pseudo terminal if the path is pty.
+*       The options --usart-rx <path> and --usart-tx <path> instead bridge
+*       received and transmitted bytes to separate endpoints.
+*
+*       With the option --vcd <path>, every change of the I/O port registers
+*       is dumped to specified Value Change Dump file, for viewing in GTKWave.
+*
+*       With the option --coverage <path>, the instruction and branch coverage
+*       of the run is merged into specified bitmap file at exit, so coverage
+*       accumulates over several runs. With the option --lcov <path>, the
+*       (accumulated) coverage is also written as an lcov tracefile.
+*
+*       With the option --profile <path>, the run is profiled with a sample
+*       every --profile-interval <cycles> clock cycles, and the folded stacks
+*       are written to specified file at exit, for instance for flamegraph.pl.
+*
+*       The system is run as a simulator of the simulator library, which the
+*       keyboard controller is a client of.
+*
+*       With the option --translate <path>, the program is translated to
+*       specified C source file and the program exits. With the option
+*       --native <path>, the shared object compiled from such a file is
+*       loaded and its translated blocks are run by the fast engine.
+********************************************************************************/
+int main(int argc, char** argv)
+{
+   const char* record_path = 0;
+   const char* replay_path = 0;
+   const char* hex_path = 0;
+   const char* publish_name = 0;
+   const char* monitor_name = 0;
+   const char* usart_rx_path = 0;
+   const char* usart_tx_path = 0;
+   const char* vcd_path = 0;
+   const char* coverage_path = 0;
+   const char* lcov_path = 0;
+   const char* profile_path = 0;
+   const char* translate_path = 0;
+   const char* native_path = 0;
+   uint64_t interval = SHARED_STATE_DEFAULT_INTERVAL;
+   uint64_t profile_interval = PROFILER_DEFAULT_INTERVAL;
+   struct simulator* sim = 0;
+   int result = 0;
+
+   for (int i = 1; i < argc; ++i)
+   {
+      if (!strcmp(argv[i], "--record") && i + 1 < argc)        record_path = argv[++i];
+      else if (!strcmp(argv[i], "--replay") && i + 1 < argc)   replay_path = argv[++i];
+      else if (!strcmp(argv[i], "--publish") && i + 1 < argc)  publish_name = argv[++i];
+      else if (!strcmp(argv[i], "--monitor") && i + 1 < argc)  monitor_name = argv[++i];
+      else if (!strcmp(argv[i], "--interval") && i + 1 < argc) interval = strtoull(argv[++i], 0, 10);
+      else if (!strcmp(argv[i], "--usart") && i + 1 < argc)    usart_rx_path = usart_tx_path = argv[++i];
+      else if (!strcmp(argv[i], "--usart-rx") && i + 1 < argc) usart_rx_path = argv[++i];
+      else if (!strcmp(argv[i], "--usart-tx") && i + 1 < argc) usart_tx_path = argv[++i];
+      else if (!strcmp(argv[i], "--vcd") && i + 1 < argc)      vcd_path = argv[++i];
+      else if (!strcmp(argv[i], "--coverage") && i + 1 < argc) coverage_path = argv[++i];
+      else if (!strcmp(argv[i], "--lcov") && i + 1 < argc)     lcov_path = argv[++i];
+      else if (!strcmp(argv[i], "--profile") && i + 1 < argc)  profile_path = argv[++i];
+      else if (!strcmp(argv[i], "--profile-interval") && i + 1 < argc) profile_interval = strtoull(argv[++i], 0, 10);
+      else if (!strcmp(argv[i], "--translate") && i + 1 < argc) translate_path = argv[++i];
+      else if (!strcmp(argv[i], "--native") && i + 1 < argc)   native_path = argv[++i];
+      else                                                     hex_path = argv[i];
+   }
+
+   if (monitor_name)
+   {
+      return shared_state_monitor(monitor_name);
+   }
+
+   sim = simulator_create();
+
+   if (!sim)
+   {
+      fprintf(stderr, "Could not create the simulator!\n");
+      return 1;
+   }
+
+   simulator_enter(sim);
+
+   if (hex_path && simulator_load_hex(sim, hex_path))
+   {
+      fprintf(stderr, "Could not load Intel HEX file %s!\n", hex_path);
+      result = 1;
+   }
+   else if (translate_path)
+   {
+      result = translator_write(translate_path);
+      if (result) fprintf(stderr, "Could not write translation %s!\n", translate_path);
+   }
+   else if (native_path && translator_load(native_path))
+   {
+      fprintf(stderr, "Could not load translation %s!\n", native_path);
+      result = 1;
+   }
+   else if (publish_name && shared_state_open(publish_name, interval))
+   {
+      fprintf(stderr, "Could not create shared state %s!\n", publish_name);
+      result = 1;
+   }
+   else if ((usart_rx_path || usart_tx_path) && usart_open(usart_rx_path, usart_tx_path))
+   {
+      fprintf(stderr, "Could not open USART endpoint!\n");
+      result = 1;
+   }
+   else if (vcd_path && vcd_open(vcd_path))
+   {
+      fprintf(stderr, "Could not create VCD dump %s!\n", vcd_path);
+      result = 1;
+   }
+   else if (profile_path && profiler_start(profile_interval))
+   {
+      fprintf(stderr, "Could not start profiling with an interval of %llu cycles!\n",
+              (unsigned long long)profile_interval);
+      result = 1;
+   }
+   else if (replay_path)
+   {
+      result = input_log_replay(replay_path);
+      save_coverage(coverage_path, lcov_path, hex_path);
+      save_profile(profile_path);
+   }
+   else if (record_path && input_log_record(record_path))
+   {
+      fprintf(stderr, "Could not create log %s!\n", record_path);
+      result = 1;
+   }
+   else
+   {
+      cpu_controller_run_by_input(sim);
+      input_log_stop();
+      save_coverage(coverage_path, lcov_path, hex_path);
+      save_profile(profile_path);
+   }
+
+   profiler_stop(); /* Everything opened above is closed on every path. */
+   vcd_close();
+   usart_close();
+   shared_state_close();
+   simulator_destroy(sim);
+   return result;
+}
+
+/********************************************************************************
+* save_coverage: Merges the coverage of the run into the bitmap file at
+*                specified path, if any, and writes the merged coverage as
+*                an lcov tracefile at specified path, if any. If the
+*                existing bitmap file can't be merged, for instance since
+*                it was saved for another program, it's left unchanged.
+*
+*                - coverage_path: Path to the bitmap file, or 0.
+*                - lcov_path    : Path to the lcov tracefile, or 0.
+*                - source       : Path to the Intel HEX file, or 0 if the
+*                                 built-in program is run.
+********************************************************************************/
+static void save_coverage(const char* coverage_path,
+                          const char* lcov_path,
+                          const char* source)
+{
+   static struct coverage_map map;
+   coverage_collect(&map);
+
+   if (coverage_path)
+   {
+      FILE* existing = fopen(coverage_path, "rb");
+      int error = 0;
+
+      if (existing)
+      {
+         fclose(existing);
+         error = coverage_load(&map, coverage_path);
+      }
+
+      if (error)
+      {
+         fprintf(stderr, "Could not merge coverage from %s, the file is left unchanged!\n", coverage_path);
+      }
+      else if (coverage_save(&map, coverage_path))
+      {
+         fprintf(stderr, "Could not save coverage to %s!\n", coverage_path);
+      }
+   }
+
+   if (lcov_path && coverage_write_lcov(&map, source ? source : "program_memory.c", lcov_path))
+   {
+      fprintf(stderr, "Could not write lcov tracefile %s!\n", lcov_path);
+   }
+   return;
+}
+
+/********************************************************************************
+* save_profile: Stops profiling and writes the folded stacks to the file at
+*               specified path, if any.
+*
+*               - profile_path: Path to the file, or 0.
+********************************************************************************/
+static void save_profile(const char* profile_path)
+{
+   profiler_stop();
+
+   if (profile_path && profiler_write_folded(profile_path))
+   {
+      fprintf(stderr, "Could not write profile %s!\n", profile_path);
+   }
+   return;
 }
\ No newline at end of file
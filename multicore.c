@@ -0,0 +1,348 @@
+/********************************************************************************
+* multicore.c: Contains functionality for running several instances of the
+*              system as the cores of a board.
+********************************************************************************/
+#include <string.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+#include "multicore.h"
+#include "input_log.h"
+
+/********************************************************************************
+* shared_write: Write to shared SRAM made by a core during a quantum.
+********************************************************************************/
+struct shared_write
+{
+   uint64_t cycle;   /* Cycle of the write, counted from the start of the run. */
+   uint16_t address; /* The written address. */
+   uint8_t value;    /* The written value. */
+};
+
+/********************************************************************************
+* core: Core run on its own thread. Everything exchanged at the barriers is
+*       double buffered by the parity of the quantum, so a core can write
+*       the next quantum while other cores still read the previous one.
+********************************************************************************/
+struct core
+{
+   struct context* context;                   /* State of the core between runs. */
+   uint32_t index;                            /* Index of the core. */
+   struct shared_write* log[2];               /* Writes to shared SRAM during the quantum. */
+   size_t log_size[2];                        /* Number of writes in each log. */
+   size_t log_capacity[2];                    /* Capacity of each log. */
+   uint8_t ports[2][MULTICORE_NUM_PORTS];     /* I/O port registers at the end of the quantum. */
+   uint64_t start;                            /* Cycle the core started at. */
+   uint64_t shared_writes;                    /* Writes of other cores applied to the core. */
+   uint64_t pin_changes;                      /* Input pins changed by GPIO lines. */
+   bool error;                                /* Set if memory ran out. */
+   bool stopped;                              /* Set if a breakpoint stopped the core. */
+   thrd_t thread;                             /* The thread running the core. */
+};
+
+static const struct multicore_config* run_config = 0;
+static struct core* cores_run = 0;
+static uint64_t run_cycles = 0;
+static atomic_int start_signal;  /* 1 when every thread is started, -1 if a thread couldn't be started. */
+static atomic_uint barrier_waiting;
+static atomic_uint barrier_phase;
+
+static CPU_THREAD_LOCAL struct core* current = 0; /* Core run by the thread. */
+static CPU_THREAD_LOCAL uint8_t current_parity = 0; /* Parity of the current quantum. */
+
+static int run_core(void* arg);
+static void exchange(struct core* self,
+                     const uint8_t parity);
+static void barrier_wait(void);
+static void log_shared_write(const uint16_t address,
+                             const enum data_memory_access access,
+                             const uint8_t old_value,
+                             uint8_t* value);
+
+/********************************************************************************
+* multicore_run: Runs referenced contexts as the cores of a board for
+*                specified number of clock cycles each, counted from the
+*                cycle every core starts at, and stores the end state of
+*                every core in its context. A context must not be entered
+*                elsewhere during the run. Returns 0 after success or error
+*                code 1 if the parameters are invalid, a thread couldn't be
+*                started, memory ran out or a core was stopped in advance,
+*                for instance by a breakpoint, after which it's halted.
+*
+*                - config    : Reference to the parameters.
+*                - cores     : Reference to the contexts, one per core.
+*                - num_cycles: The number of clock cycles to run.
+*                - report    : Reference to the report of the run.
+********************************************************************************/
+int multicore_run(const struct multicore_config* config,
+                  struct context* const* cores,
+                  const uint64_t num_cycles,
+                  struct multicore_report* report)
+{
+   const double start = cpu_seconds_now();
+   uint32_t num_started = 0;
+   int error = 0;
+
+   memset(report, 0, sizeof(*report));
+   if (!config->num_cores || config->num_cores > MULTICORE_MAX_CORES || !config->quantum ||
+       (uint32_t)config->shared_address + config->shared_size > DATA_MEMORY_ADDRESS_WIDTH) return 1;
+
+   for (uint32_t i = 0; i < config->num_links; ++i)
+   {
+      const struct multicore_link* link = &config->links[i];
+      if (link->source_core >= config->num_cores || link->target_core >= config->num_cores ||
+          link->source_port >= MULTICORE_NUM_PORTS || link->target_port >= MULTICORE_NUM_PORTS ||
+          link->source_pin > 7 || link->target_pin > 7) return 1;
+   }
+
+   cores_run = (struct core*)calloc(config->num_cores, sizeof(struct core));
+   if (!cores_run) return 1;
+
+   run_config = config;
+   run_cycles = num_cycles;
+   atomic_store(&start_signal, 0);
+   atomic_store(&barrier_waiting, 0);
+   atomic_store(&barrier_phase, 0);
+
+   for (uint32_t i = 0; i < config->num_cores; ++i)
+   {
+      cores_run[i].context = cores[i];
+      cores_run[i].index = i;
+      if (thrd_create(&cores_run[i].thread, run_core, &cores_run[i]) != thrd_success) break;
+      num_started++;
+   }
+
+   atomic_store(&start_signal, num_started == config->num_cores ? 1 : -1);
+
+   for (uint32_t i = 0; i < num_started; ++i)
+   {
+      thrd_join(cores_run[i].thread, 0);
+   }
+
+   report->num_cores = config->num_cores;
+   report->num_quanta = (num_cycles + config->quantum - 1) / config->quantum;
+   report->num_cycles = num_cycles;
+   error = num_started != config->num_cores;
+
+   for (uint32_t i = 0; i < config->num_cores; ++i)
+   {
+      struct core* core = &cores_run[i];
+      report->shared_writes += core->shared_writes;
+      report->pin_changes += core->pin_changes;
+      report->hashes[i] = control_unit_snapshot_hash(&core->context->state);
+      report->portb[i] = core->context->state.data[PORTB];
+      if (core->error || core->stopped) error = 1;
+      free(core->log[0]);
+      free(core->log[1]);
+   }
+
+   free(cores_run);
+   cores_run = 0;
+   report->seconds = cpu_seconds_now() - start;
+   return error;
+}
+
+/********************************************************************************
+* multicore_print_report: Prints specified report.
+*
+*                         - report: Reference to the report.
+********************************************************************************/
+void multicore_print_report(const struct multicore_report* report)
+{
+   const double rate = report->seconds > 0.0 ?
+      report->num_cores * (double)report->num_cycles / report->seconds / 1e6 : 0.0;
+
+   printf("Ran %u cores for %llu cycles in %llu quanta in %.2f seconds (%.1f MHz in total).\n",
+          report->num_cores, (unsigned long long)report->num_cycles,
+          (unsigned long long)report->num_quanta, report->seconds, rate);
+   printf("Exchanged %llu writes to shared SRAM and %llu pin changes.\n",
+          (unsigned long long)report->shared_writes, (unsigned long long)report->pin_changes);
+
+   for (uint32_t i = 0; i < report->num_cores; ++i)
+   {
+      char binary[CPU_BINARY_BUFFER_SIZE];
+      printf("   Core %u: 0x%016llX, PORTB %s\n", i, (unsigned long long)report->hashes[i],
+             cpu_format_binary(report->portb[i], 8, binary));
+   }
+
+   printf("\n");
+   return;
+}
+
+/********************************************************************************
+* run_core: Runs a core on the instance of the system of the thread, one
+*           quantum at a time with a barrier and an exchange after each.
+*
+*           - arg: Reference to the core.
+********************************************************************************/
+static int run_core(void* arg)
+{
+   struct core* self = (struct core*)arg;
+   const uint64_t quantum = run_config->quantum;
+   const uint64_t num_quanta = (run_cycles + quantum - 1) / quantum;
+   int signal = 0;
+
+   while (!(signal = atomic_load(&start_signal))) thrd_yield();
+   if (signal < 0) return 1;
+
+   context_enter(self->context);
+   current = self;
+   self->start = control_unit_cycles();
+   data_memory_set_hook(DATA_MEMORY_HOOK_SHARED, log_shared_write);
+
+   if (run_config->record_prefix)
+   {
+      char path[FILENAME_MAX];
+      snprintf(path, sizeof(path), "%s%u.log", run_config->record_prefix, self->index);
+      if (input_log_record(path)) self->error = true;
+   }
+
+   for (uint16_t i = 0; i < run_config->shared_size; ++i)
+   {
+      data_memory_monitor(DATA_MEMORY_HOOK_SHARED, run_config->shared_address + i, true);
+   }
+
+   for (uint64_t i = 0; i < num_quanta; ++i)
+   {
+      const uint64_t end = (i + 1) * quantum < run_cycles ? (i + 1) * quantum : run_cycles;
+      current_parity = (uint8_t)(i & 1);
+      self->log_size[current_parity] = 0;
+
+      if (!self->stopped && !control_unit_run_until(self->start + end))
+      {
+         self->stopped = true; /* Halted for the rest of the run, but still meets the others. */
+      }
+
+      for (uint8_t j = 0; j < MULTICORE_NUM_PORTS; ++j)
+      {
+         self->ports[current_parity][j] = data_memory_peek(j);
+      }
+
+      barrier_wait();
+      exchange(self, current_parity);
+   }
+
+   for (uint16_t i = 0; i < run_config->shared_size; ++i)
+   {
+      data_memory_monitor(DATA_MEMORY_HOOK_SHARED, run_config->shared_address + i, false);
+   }
+
+   input_log_stop();
+   data_memory_set_hook(DATA_MEMORY_HOOK_SHARED, 0);
+   context_leave(self->context);
+   control_unit_release();
+   current = 0;
+   return 0;
+}
+
+/********************************************************************************
+* exchange: Applies the writes to shared SRAM made by every core during the
+*           quantum with specified parity to the core of the thread, merged
+*           in order of cycle and core index, so that the last write to an
+*           address wins on every core, followed by the GPIO lines driven by
+*           other cores.
+*
+*           - self  : Reference to the core.
+*           - parity: Parity of the quantum.
+********************************************************************************/
+static void exchange(struct core* self,
+                     const uint8_t parity)
+{
+   size_t next[MULTICORE_MAX_CORES] = { 0 };
+
+   while (1)
+   {
+      const struct shared_write* first = 0;
+      uint32_t source = 0;
+
+      for (uint32_t i = 0; i < run_config->num_cores; ++i)
+      {
+         const struct core* core = &cores_run[i];
+
+         if (next[i] < core->log_size[parity] && (!first || core->log[parity][next[i]].cycle < first->cycle))
+         {
+            first = &core->log[parity][next[i]];
+            source = i;
+         }
+      }
+
+      if (!first) break;
+      input_log_write_data(first->address, first->value);
+      if (source != self->index) self->shared_writes++;
+      next[source]++;
+   }
+
+   for (uint32_t i = 0; i < run_config->num_links; ++i)
+   {
+      const struct multicore_link* link = &run_config->links[i];
+      if (link->target_core != self->index) continue;
+
+      const uint8_t source = cores_run[link->source_core].ports[parity][link->source_port];
+      const uint8_t pins = data_memory_peek(link->target_port);
+      const uint8_t level = read(source, link->source_pin) ? 1 : 0;
+      const uint8_t value = (uint8_t)((pins & ~(1 << link->target_pin)) | (level << link->target_pin));
+
+      if (value != pins)
+      {
+         input_log_write_data(link->target_port, value); /* Detected as a pin change when run. */
+         self->pin_changes++;
+      }
+   }
+   return;
+}
+
+/********************************************************************************
+* barrier_wait: Waits until every core has reached the barrier. The waiting
+*               threads spin for a while, since the other cores usually
+*               arrive within a fraction of a quantum, and then yield their
+*               host core, in case there are more cores than host cores.
+********************************************************************************/
+static void barrier_wait(void)
+{
+   const uint32_t phase = atomic_load_explicit(&barrier_phase, memory_order_acquire);
+
+   if (atomic_fetch_add_explicit(&barrier_waiting, 1, memory_order_acq_rel) + 1 == run_config->num_cores)
+   {
+      atomic_store_explicit(&barrier_waiting, 0, memory_order_relaxed);
+      atomic_fetch_add_explicit(&barrier_phase, 1, memory_order_release);
+      return;
+   }
+
+   for (uint32_t spins = 0; atomic_load_explicit(&barrier_phase, memory_order_acquire) == phase; ++spins)
+   {
+      if (spins >= MULTICORE_SPIN_LIMIT) thrd_yield();
+   }
+   return;
+}
+
+static void log_shared_write(const uint16_t address,
+                             const enum data_memory_access access,
+                             const uint8_t old_value,
+                             uint8_t* value)
+{
+   struct core* self = current;
+   const uint8_t parity = current_parity;
+   (void)old_value;
+   if (access != DATA_MEMORY_ACCESS_WRITE) return;
+
+   if (self->log_size[parity] == self->log_capacity[parity])
+   {
+      const size_t capacity = self->log_capacity[parity] ? 2 * self->log_capacity[parity] : 64;
+      struct shared_write* log = (struct shared_write*)realloc(self->log[parity], capacity * sizeof(struct shared_write));
+
+      if (!log)
+      {
+         self->error = true;
+         return;
+      }
+
+      self->log[parity] = log;
+      self->log_capacity[parity] = capacity;
+   }
+
+   struct shared_write* write = &self->log[parity][self->log_size[parity]++];
+   write->cycle = control_unit_cycles() - self->start;
+   write->address = address;
+   write->value = *value;
+   return;
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+/********************************************************************************
+* multicore.h: Contains functionality for running several instances of the
+*              system as the cores of a board, where the cores share a range
+*              of SRAM and are connected by GPIO lines from an output pin of
+*              one core to an input pin of another.
+*
+*              Every core is a context, which is run on its own host thread.
+*              The cores run a quantum of clock cycles independently of each
+*              other and then synchronise at a barrier, where every core
+*              applies the writes to shared SRAM made by all cores during
+*              the quantum, in order of the cycle of the write and the index
+*              of the core, and the pins connected to the outputs of other
+*              cores. A core thus sees the writes and pin changes of the
+*              other cores at the start of the next quantum, which bounds
+*              the latency between cores by the quantum, and only the level
+*              of a line at the end of a quantum is seen by the other core.
+*              Since a core only depends on its own state and on what was
+*              exchanged at the barriers, the result of a run is the same
+*              for a given quantum, however the threads are scheduled.
+*              Everything exchanged is written as external input through
+*              the input log, so the input of every core can be recorded
+*              and the run of a core started from reset can be replayed
+*              on a single system.
+********************************************************************************/
+#ifndef MULTICORE_H_
+#define MULTICORE_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "control_unit.h"
+#include "context.h"
+
+#define MULTICORE_MAX_CORES       64         /* Maximum number of cores. */
+#define MULTICORE_DEFAULT_CORES   4          /* Cores run from the menu. */
+#define MULTICORE_DEFAULT_QUANTUM 1000       /* Clock cycles per quantum from the menu. */
+#define MULTICORE_DEFAULT_CYCLES  3000000    /* Clock cycles run by every core from the menu. */
+#define MULTICORE_SPIN_LIMIT      1000       /* Spins at the barrier before yielding the host core. */
+#define MULTICORE_NUM_PORTS       (PIND + 1) /* I/O port registers DDRB - PIND. */
+
+/********************************************************************************
+* multicore_link: GPIO line from an output pin of one core to an input pin
+*                 of another core.
+********************************************************************************/
+struct multicore_link
+{
+   uint8_t source_core; /* Index of the core driving the line. */
+   uint8_t source_port; /* Data register driving the line (PORTB, PORTC or PORTD). */
+   uint8_t source_pin;  /* Pin of the data register. */
+   uint8_t target_core; /* Index of the core reading the line. */
+   uint8_t target_port; /* Pin input register reading the line (PINB, PINC or PIND). */
+   uint8_t target_pin;  /* Pin of the pin input register. */
+};
+
+/********************************************************************************
+* multicore_config: Parameters of a multi-core run.
+********************************************************************************/
+struct multicore_config
+{
+   uint32_t num_cores;                 /* Number of cores. */
+   uint64_t quantum;                   /* Clock cycles run between the barriers. */
+   uint16_t shared_address;            /* First data memory address of the shared SRAM. */
+   uint16_t shared_size;               /* Number of shared addresses, or 0. */
+   const struct multicore_link* links; /* The GPIO lines between the cores. */
+   uint32_t num_links;                 /* Number of GPIO lines. */
+   const char* record_prefix;          /* Records core n to <prefix>n.log, or 0. */
+};
+
+/********************************************************************************
+* multicore_report: Result of a multi-core run.
+********************************************************************************/
+struct multicore_report
+{
+   uint32_t num_cores;                      /* Number of cores run. */
+   uint64_t num_quanta;                     /* Number of quanta run. */
+   uint64_t num_cycles;                     /* Clock cycles run by every core. */
+   uint64_t shared_writes;                  /* Writes to shared SRAM applied to other cores. */
+   uint64_t pin_changes;                    /* Changes of input pins by GPIO lines. */
+   uint64_t hashes[MULTICORE_MAX_CORES];    /* Hash of the end state of every core. */
+   uint8_t portb[MULTICORE_MAX_CORES];      /* Content of PORTB of every core at the end. */
+   double seconds;                          /* Duration of the run. */
+};
+
+/********************************************************************************
+* multicore_run: Runs referenced contexts as the cores of a board for
+*                specified number of clock cycles each, counted from the
+*                cycle every core starts at, and stores the end state of
+*                every core in its context. A context must not be entered
+*                elsewhere during the run. Returns 0 after success or error
+*                code 1 if the parameters are invalid, a thread couldn't be
+*                started, memory ran out or a core was stopped in advance,
+*                for instance by a breakpoint, after which it's halted.
+*
+*                - config    : Reference to the parameters.
+*                - cores     : Reference to the contexts, one per core.
+*                - num_cycles: The number of clock cycles to run.
+*                - report    : Reference to the report of the run.
+********************************************************************************/
+int multicore_run(const struct multicore_config* config,
+                  struct context* const* cores,
+                  const uint64_t num_cycles,
+                  struct multicore_report* report);
+
+/********************************************************************************
+* multicore_print_report: Prints specified report.
+*
+*                         - report: Reference to the report.
+********************************************************************************/
+void multicore_print_report(const struct multicore_report* report);
+
+#endif /* MULTICORE_H_ */
\ No newline at end of file
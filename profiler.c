@@ -0,0 +1,381 @@
+/********************************************************************************
+* profiler.c: Contains functionality for profiling where the program spends
+*             its clock cycles.
+********************************************************************************/
+#include <string.h>
+#include "profiler.h"
+
+#define MAX_FUNCTIONS 256 /* Distinct subroutines in the flat table. */
+#define NAME_SIZE     24  /* Capacity of the name of a subroutine. */
+
+/********************************************************************************
+* frame: Frame of the shadow call stack.
+********************************************************************************/
+struct frame
+{
+   uint8_t entry;  /* Address the subroutine or interrupt was entered at. */
+   uint8_t caller; /* Address of the instruction that entered it. */
+};
+
+/********************************************************************************
+* folded_stack: Distinct stack recorded by the profiler.
+********************************************************************************/
+struct folded_stack
+{
+   char text[PROFILER_STACK_SIZE]; /* Names of the frames separated by ';'. */
+   uint64_t cycles;                /* Cycles attributed to the stack. */
+};
+
+/********************************************************************************
+* function_cycles: Row of the flat table.
+********************************************************************************/
+struct function_cycles
+{
+   char name[NAME_SIZE]; /* Name of the subroutine. */
+   uint64_t self;        /* Cycles spent in the subroutine itself. */
+   uint64_t total;       /* Cycles spent in and below the subroutine. */
+};
+
+static CPU_THREAD_LOCAL struct frame frames[PROFILER_MAX_DEPTH];
+static CPU_THREAD_LOCAL uint8_t depth = 0;
+static CPU_THREAD_LOCAL uint32_t excess = 0;           /* Frames entered beyond PROFILER_MAX_DEPTH. */
+static CPU_THREAD_LOCAL struct folded_stack* stacks = 0;
+static CPU_THREAD_LOCAL uint32_t num_stacks = 0;
+static CPU_THREAD_LOCAL uint64_t last_sample = 0;      /* Cycle of the last sample. */
+static CPU_THREAD_LOCAL uint64_t dropped_cycles = 0;   /* Cycles of stacks that didn't fit. */
+static CPU_THREAD_LOCAL bool profiling = false;
+
+static void follow_transfer(const enum control_unit_transfer transfer,
+                            const uint8_t from,
+                            const uint8_t to);
+static void take_sample(void);
+static void restart_stack(const uint8_t address);
+static void format_stack(char* text);
+static void append_name(char* text,
+                        const uint8_t address);
+static inline const char* symbol(const uint8_t address);
+static uint64_t string_hash(const char* s);
+static int compare_self(const void* first,
+                        const void* second);
+
+/********************************************************************************
+* profiler_start: Clears previous results and starts profiling the calling
+*                 thread with a sample every specified number of clock cycles.
+*                 The shadow call stack starts with the subroutine of the
+*                 current instruction. Returns 0 after success or error code 1
+*                 if the interval is 0 or memory couldn't be allocated.
+*
+*                 - interval: Clock cycles between samples.
+********************************************************************************/
+int profiler_start(const uint64_t interval)
+{
+   if (!interval) return 1;
+   profiler_stop();
+
+   if (!stacks)
+   {
+      stacks = (struct folded_stack*)malloc(sizeof(struct folded_stack) * PROFILER_MAX_STACKS);
+      if (!stacks) return 1;
+   }
+
+   memset(stacks, 0, sizeof(struct folded_stack) * PROFILER_MAX_STACKS);
+   num_stacks = 0;
+   dropped_cycles = 0;
+   last_sample = control_unit_cycles();
+   restart_stack(control_unit_current_address());
+
+   profiling = true;
+   control_unit_set_transfer_hook(follow_transfer);
+   control_unit_set_periodic_hook(CONTROL_UNIT_HOOK_PROFILE, take_sample, interval);
+   return 0;
+}
+
+/********************************************************************************
+* profiler_stop: Takes a last sample and stops profiling. The results are
+*                kept until profiling is started again.
+********************************************************************************/
+void profiler_stop(void)
+{
+   if (!profiling) return;
+   take_sample();
+   control_unit_set_transfer_hook(0);
+   control_unit_set_periodic_hook(CONTROL_UNIT_HOOK_PROFILE, 0, 0);
+   profiling = false;
+   return;
+}
+
+/********************************************************************************
+* profiler_write_folded: Writes the recorded stacks in folded format to a file
+*                        with specified path, which is replaced if it exists.
+*                        Returns 0 after success or error code 1 if the file
+*                        couldn't be written.
+*
+*                        - filepath: Path to the file.
+********************************************************************************/
+int profiler_write_folded(const char* filepath)
+{
+   FILE* file = fopen(filepath, "w");
+   if (!file) return 1;
+
+   for (uint32_t i = 0; stacks && i < PROFILER_MAX_STACKS; ++i)
+   {
+      if (stacks[i].cycles)
+      {
+         fprintf(file, "%s %llu\n", stacks[i].text, (unsigned long long)stacks[i].cycles);
+      }
+   }
+   return fclose(file);
+}
+
+/********************************************************************************
+* profiler_print: Prints the cycles spent in every subroutine itself and in
+*                 total including the subroutines it called, sorted by the
+*                 cycles spent in the subroutine itself.
+*
+*                 - ostream: Reference to the stream, for instance stdout.
+********************************************************************************/
+void profiler_print(FILE* ostream)
+{
+   static struct function_cycles functions[MAX_FUNCTIONS];
+   uint32_t num_functions = 0;
+   uint64_t sum = 0;
+
+   for (uint32_t i = 0; stacks && i < PROFILER_MAX_STACKS; ++i)
+   {
+      char names[PROFILER_MAX_DEPTH * 2 + 1][NAME_SIZE];
+      uint32_t num_names = 0;
+      const char* start = stacks[i].text;
+      if (!stacks[i].cycles) continue;
+
+      while (*start && num_names < sizeof(names) / sizeof(names[0]))
+      {
+         const size_t length = strcspn(start, ";");
+         snprintf(names[num_names++], NAME_SIZE, "%.*s", (int)length, start);
+         start += length + (start[length] == ';');
+      }
+
+      for (uint32_t j = 0; j < num_names; ++j)
+      {
+         bool repeated = false;
+         uint32_t k = 0;
+
+         for (uint32_t n = 0; n < j; ++n)
+         {
+            if (!strcmp(names[n], names[j])) repeated = true;
+         }
+
+         while (k < num_functions && strcmp(functions[k].name, names[j])) k++;
+
+         if (k == num_functions)
+         {
+            if (num_functions == MAX_FUNCTIONS) continue;
+            memset(&functions[k], 0, sizeof(functions[k]));
+            strcpy(functions[k].name, names[j]);
+            num_functions++;
+         }
+
+         if (!repeated) functions[k].total += stacks[i].cycles; /* Recursion is only counted once. */
+         if (j == num_names - 1) functions[k].self += stacks[i].cycles;
+      }
+      sum += stacks[i].cycles;
+   }
+
+   qsort(functions, num_functions, sizeof(functions[0]), compare_self);
+   fprintf(ostream, "%-24s%16s%9s%16s%9s\n", "Subroutine", "Self cycles", "Self", "Total cycles", "Total");
+
+   for (uint32_t i = 0; i < num_functions; ++i)
+   {
+      fprintf(ostream, "%-24s%16llu%8.1f%%%16llu%8.1f%%\n", functions[i].name,
+              (unsigned long long)functions[i].self, sum ? 100.0 * functions[i].self / sum : 0.0,
+              (unsigned long long)functions[i].total, sum ? 100.0 * functions[i].total / sum : 0.0);
+   }
+
+   fprintf(ostream, "\nProfiled %llu cycles in %u distinct stacks.\n", (unsigned long long)sum, num_stacks);
+
+   if (dropped_cycles)
+   {
+      fprintf(ostream, "%llu cycles were dropped since more than %d distinct stacks were seen!\n",
+              (unsigned long long)dropped_cycles, PROFILER_MAX_STACKS);
+   }
+
+   fprintf(ostream, "\n");
+   return;
+}
+
+/********************************************************************************
+* follow_transfer: Updates the shadow call stack at a transfer of control. A
+*                  return from the outermost frame replaces it with the
+*                  subroutine returned to, since profiling may start below
+*                  the subroutine that was called first. The stack is
+*                  restarted if the system has been reset since the last
+*                  sample, so that it doesn't keep frames of the old run.
+********************************************************************************/
+static void follow_transfer(const enum control_unit_transfer transfer,
+                            const uint8_t from,
+                            const uint8_t to)
+{
+   if (control_unit_cycles() < last_sample)
+   {
+      last_sample = 0;
+      restart_stack(from);
+   }
+
+   if (transfer == CONTROL_UNIT_TRANSFER_CALL || transfer == CONTROL_UNIT_TRANSFER_INTERRUPT)
+   {
+      if (depth < PROFILER_MAX_DEPTH)
+      {
+         frames[depth].entry = to;
+         frames[depth].caller = from;
+         depth++;
+      }
+      else
+      {
+         excess++;
+      }
+   }
+   else if (excess)
+   {
+      excess--;
+   }
+   else if (depth > 1)
+   {
+      depth--;
+   }
+   else
+   {
+      frames[0].entry = to;
+      frames[0].caller = to;
+   }
+   return;
+}
+
+/********************************************************************************
+* take_sample: Attributes the cycles run since the last sample to the current
+*              stack. If the cycle counter has been reset, the cycles since
+*              the reset are attributed to a restarted shadow call stack.
+********************************************************************************/
+static void take_sample(void)
+{
+   const uint64_t cycles = control_unit_cycles();
+   char text[PROFILER_STACK_SIZE];
+
+   if (cycles < last_sample)
+   {
+      last_sample = 0;
+      restart_stack(control_unit_current_address());
+   }
+
+   if (cycles == last_sample) return;
+   format_stack(text);
+
+   const uint64_t hash = string_hash(text);
+   uint32_t index = (uint32_t)(hash % PROFILER_MAX_STACKS);
+
+   for (uint32_t i = 0; i < PROFILER_MAX_STACKS; ++i)
+   {
+      struct folded_stack* self = &stacks[(index + i) % PROFILER_MAX_STACKS];
+
+      if (!self->cycles)
+      {
+         strcpy(self->text, text);
+         self->cycles = cycles - last_sample;
+         num_stacks++;
+         last_sample = cycles;
+         return;
+      }
+      else if (!strcmp(self->text, text))
+      {
+         self->cycles += cycles - last_sample;
+         last_sample = cycles;
+         return;
+      }
+   }
+
+   dropped_cycles += cycles - last_sample;
+   last_sample = cycles;
+   return;
+}
+
+static void restart_stack(const uint8_t address)
+{
+   frames[0].entry = address;
+   frames[0].caller = address;
+   depth = 1;
+   excess = 0;
+   return;
+}
+
+/********************************************************************************
+* format_stack: Writes the names of the current stack, outermost first and
+*               separated by ';', to specified text. The subroutine a frame
+*               was entered from and the subroutine of the current instruction
+*               are added whenever they differ from the subroutine of the
+*               enclosing frame, which happens after a JMP to another
+*               subroutine.
+********************************************************************************/
+static void format_stack(char* text)
+{
+   const uint8_t address = control_unit_current_address();
+   text[0] = '\0';
+
+   for (uint8_t i = 0; i < depth; ++i)
+   {
+      if (i > 0)
+      {
+         const char* caller = symbol(frames[i].caller);
+         const char* parent = symbol(frames[i - 1].entry);
+         if (caller && parent && strcmp(caller, parent)) append_name(text, frames[i].caller);
+      }
+      append_name(text, frames[i].entry);
+   }
+
+   const char* current = symbol(address);
+   const char* innermost = symbol(frames[depth - 1].entry);
+   if (current && innermost && strcmp(current, innermost)) append_name(text, address);
+   return;
+}
+
+static void append_name(char* text,
+                        const uint8_t address)
+{
+   const size_t length = strlen(text);
+   const char* name = symbol(address);
+
+   if (name)
+   {
+      snprintf(text + length, PROFILER_STACK_SIZE - length, "%s%s", length ? ";" : "", name);
+   }
+   else
+   {
+      snprintf(text + length, PROFILER_STACK_SIZE - length, "%s0x%02X", length ? ";" : "", address);
+   }
+   return;
+}
+
+/********************************************************************************
+* symbol: Returns the name of the subroutine at specified address, or 0 if
+*         the program has no subroutine names.
+********************************************************************************/
+static inline const char* symbol(const uint8_t address)
+{
+   return program_memory_builtin() ? program_memory_subroutine_name(address) : 0;
+}
+
+static uint64_t string_hash(const char* s)
+{
+   uint64_t hash = 14695981039346656037ULL; /* FNV-1a. */
+
+   while (*s)
+   {
+      hash = (hash ^ (uint8_t)*s++) * 1099511628211ULL;
+   }
+   return hash;
+}
+
+static int compare_self(const void* first,
+                        const void* second)
+{
+   const struct function_cycles* a = (const struct function_cycles*)first;
+   const struct function_cycles* b = (const struct function_cycles*)second;
+   return a->self < b->self ? 1 : a->self > b->self ? -1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+/********************************************************************************
+* profiler.h: Contains functionality for profiling where the program spends
+*             its clock cycles, with call stacks for flame graphs.
+*
+*             The profiler keeps a shadow call stack, updated by the
+*             transfer hook of the control unit at every CALL, RET,
+*             generated interrupt and RETI. A periodic hook samples the
+*             stack every configurable number of clock cycles and
+*             attributes the cycles run since the previous sample to it, so
+*             the overhead is tuned by the interval.
+*
+*             Each frame is named after the subroutine it was entered at,
+*             using the subroutine names of program_memory for the built-in
+*             program and addresses otherwise. Control may leave a
+*             subroutine by JMP without a call, like the built-in program
+*             does when led_on and led_off jump back to the end of
+*             led_toggle instead of returning. The subroutine of the current
+*             instruction is therefore added as a leaf whenever it differs
+*             from the subroutine of the innermost frame, and the subroutine
+*             a CALL or an interrupt was made from is added in the same way.
+*             The shadow stack itself only follows calls and returns, so it
+*             stays in step with the real stack.
+*
+*             The result is written as folded stacks, one line per distinct
+*             stack followed by its number of cycles, which is the input of
+*             flamegraph.pl and similar tools, and printed as a flat table
+*             of the cycles spent in and below every subroutine.
+********************************************************************************/
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "control_unit.h"
+
+#define PROFILER_DEFAULT_INTERVAL 100  /* Default clock cycles between samples. */
+#define PROFILER_MAX_DEPTH        32   /* Frames kept in the shadow call stack. */
+#define PROFILER_MAX_STACKS       1024 /* Distinct stacks that can be recorded. */
+#define PROFILER_STACK_SIZE       192  /* Capacity of the text of a folded stack. */
+
+/********************************************************************************
+* profiler_start: Clears previous results and starts profiling the calling
+*                 thread with a sample every specified number of clock cycles.
+*                 The shadow call stack starts with the subroutine of the
+*                 current instruction. Returns 0 after success or error code 1
+*                 if the interval is 0 or memory couldn't be allocated.
+*
+*                 - interval: Clock cycles between samples.
+********************************************************************************/
+int profiler_start(const uint64_t interval);
+
+/********************************************************************************
+* profiler_stop: Takes a last sample and stops profiling. The results are
+*                kept until profiling is started again.
+********************************************************************************/
+void profiler_stop(void);
+
+/********************************************************************************
+* profiler_write_folded: Writes the recorded stacks in folded format to a file
+*                        with specified path, which is replaced if it exists.
+*                        Returns 0 after success or error code 1 if the file
+*                        couldn't be written.
+*
+*                        - filepath: Path to the file.
+********************************************************************************/
+int profiler_write_folded(const char* filepath);
+
+/********************************************************************************
+* profiler_print: Prints the cycles spent in every subroutine itself and in
+*                 total including the subroutines it called, sorted by the
+*                 cycles spent in the subroutine itself.
+*
+*                 - ostream: Reference to the stream, for instance stdout.
+********************************************************************************/
+void profiler_print(FILE* ostream);
+
+#endif /* PROFILER_H_ */
\ No newline at end of file
@@ -0,0 +1,801 @@
+/********************************************************************************
+* program_analysis.c: Contains functionality for static control flow analysis
+*                     of the program stored in program memory.
+********************************************************************************/
+#include <string.h>
+#include "program_analysis.h"
+#include "data_memory.h"
+
+#define ALL_REGISTERS 0xFFFFFFFF /* Mask for CPU registers R0 - R31. */
+
+/********************************************************************************
+* instruction_effects: CPU registers and flags read and written by an
+*                      instruction.
+********************************************************************************/
+struct instruction_effects
+{
+   uint32_t registers_read;    /* CPU registers read. */
+   uint32_t registers_written; /* CPU registers written. */
+   uint8_t flags_read;         /* Flags read. */
+   uint8_t flags_written;      /* Flags written. */
+};
+
+static CPU_THREAD_LOCAL struct program_analysis analysis;
+static CPU_THREAD_LOCAL bool analysis_valid = false;
+static CPU_THREAD_LOCAL uint32_t instructions[PROGRAM_MEMORY_ADDRESS_WIDTH];
+
+static void analyse(struct program_analysis* self);
+static void find_reachable(struct program_analysis* self,
+                           uint8_t* entries);
+static bool find_vectors(const struct program_analysis* self,
+                         uint8_t* vectors);
+static void find_blocks(struct program_analysis* self,
+                        const uint8_t* entries);
+static void find_functions(struct program_analysis* self,
+                           const uint8_t* entries,
+                           const uint8_t* vectors);
+static void find_successors(struct program_analysis* self);
+static void compute_effects(struct program_analysis* self);
+static void compute_flag_liveness(struct program_analysis* self);
+static uint8_t successors(const uint8_t address,
+                          uint8_t* next);
+static struct instruction_effects effects(const uint32_t instruction);
+static bool is_leader_after(const uint8_t op_code);
+static inline uint8_t fall_through(const uint8_t address);
+static inline bool valid_op_code(const uint8_t op_code);
+static inline bool is_branch(const uint8_t op_code);
+static inline void add(uint8_t* addresses,
+                       const uint8_t address);
+static inline uint32_t registers(const uint8_t first,
+                                 const uint8_t count);
+static void write_label(FILE* file,
+                        const struct program_analysis* self,
+                        const struct program_analysis_block* block);
+static const char* entry_name(const enum program_analysis_entry kind);
+
+/********************************************************************************
+* program_analysis_get: Returns the analysis of the program currently stored
+*                       in program memory. The analysis is only performed
+*                       again when the program memory has been changed.
+*                       Breakpoints are ignored, i.e. the original
+*                       instructions are analysed.
+********************************************************************************/
+const struct program_analysis* program_analysis_get(void)
+{
+   if (!analysis_valid || analysis.generation != program_memory_generation())
+   {
+      analyse(&analysis);
+      analysis_valid = true;
+   }
+   return &analysis;
+}
+
+/********************************************************************************
+* program_analysis_write_dot: Writes referenced analysis as a graph in the
+*                             DOT language to specified file, which can be
+*                             rendered by Graphviz. Returns 0 after
+*                             successful write or error code 1 if the file
+*                             couldn't be written.
+*
+*                             - self    : Reference to the analysis.
+*                             - filepath: Path to the file.
+********************************************************************************/
+int program_analysis_write_dot(const struct program_analysis* self,
+                               const char* filepath)
+{
+   FILE* file = fopen(filepath, "w");
+   if (!file) return 1;
+
+   fprintf(file, "digraph program\n{\n");
+   fprintf(file, "   node [shape=box, fontname=\"Courier\"];\n");
+
+   for (uint16_t i = 0; i < self->num_blocks; ++i)
+   {
+      const struct program_analysis_block* block = &self->blocks[i];
+      fprintf(file, "   b%02X [label=\"", block->start);
+      write_label(file, self, block);
+      fprintf(file, "\"];\n");
+   }
+
+   for (uint16_t i = 0; i < self->num_blocks; ++i)
+   {
+      const struct program_analysis_block* block = &self->blocks[i];
+
+      const bool returns = (instructions[(uint8_t)(block->start + block->length - 1)] >> 16) == RET;
+
+      for (uint16_t j = 0; j < PROGRAM_MEMORY_ADDRESS_WIDTH; ++j)
+      {
+         if (!program_analysis_contains(block->successors, (uint8_t)j)) continue;
+         if (block->calls && j == block->callee && j != (uint8_t)(block->start + block->length)) continue;
+         fprintf(file, "   b%02X -> b%02X%s;\n", block->start, j, returns ? " [style=dotted]" : "");
+      }
+
+      if (block->calls)
+      {
+         fprintf(file, "   b%02X -> b%02X [style=dashed, label=\"CALL\"];\n", block->start, block->callee);
+      }
+   }
+
+   if (self->num_unreachable)
+   {
+      fprintf(file, "   unreachable [style=filled, fillcolor=lightgrey, label=\"Unreachable:\\l");
+
+      for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+      {
+         if (program_analysis_contains(self->reachable, (uint8_t)i)) continue;
+         uint16_t end = i;
+         while (end + 1 < PROGRAM_MEMORY_ADDRESS_WIDTH && !program_analysis_contains(self->reachable, (uint8_t)(end + 1))) end++;
+         fprintf(file, "0x%02X - 0x%02X\\l", i, end);
+         i = end;
+      }
+      fprintf(file, "\"];\n");
+   }
+
+   fprintf(file, "}\n");
+   return fclose(file) ? 1 : 0;
+}
+
+static void analyse(struct program_analysis* self)
+{
+   uint8_t entries[PROGRAM_ANALYSIS_SET_SIZE] = { 0 };
+   uint8_t vectors[PROGRAM_ANALYSIS_SET_SIZE] = { 0 };
+
+   memset(self, 0, sizeof(*self));
+   self->generation = program_memory_generation();
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      instructions[i] = breakpoint_instruction((uint8_t)i);
+      self->block_index[i] = PROGRAM_ANALYSIS_NONE;
+   }
+
+   add(entries, RESET_vect);
+   find_reachable(self, entries);
+
+   while (find_vectors(self, vectors))
+   {
+      for (uint8_t i = 0; i < PROGRAM_ANALYSIS_SET_SIZE; ++i)
+      {
+         entries[i] |= vectors[i];
+      }
+      find_reachable(self, entries);
+   }
+
+   find_blocks(self, entries);
+   find_functions(self, entries, vectors);
+   find_successors(self);
+   compute_effects(self);
+   compute_flag_liveness(self);
+   return;
+}
+
+static void find_reachable(struct program_analysis* self,
+                           uint8_t* entries)
+{
+   uint8_t stack[PROGRAM_MEMORY_ADDRESS_WIDTH];
+   uint16_t num_pending = 0;
+
+   memset(self->reachable, 0, sizeof(self->reachable));
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      if (program_analysis_contains(entries, (uint8_t)i))
+      {
+         add(self->reachable, (uint8_t)i);
+         stack[num_pending++] = (uint8_t)i;
+      }
+   }
+
+   while (num_pending)
+   {
+      const uint8_t address = stack[--num_pending];
+      uint8_t next[2] = { 0 };
+      const uint8_t num_next = successors(address, next);
+
+      if ((instructions[address] >> 16) == CALL)
+      {
+         add(entries, (uint8_t)(instructions[address] >> 8));
+      }
+
+      for (uint8_t i = 0; i < num_next; ++i)
+      {
+         if (!program_analysis_contains(self->reachable, next[i]))
+         {
+            add(self->reachable, next[i]);
+            stack[num_pending++] = next[i];
+         }
+      }
+   }
+
+   self->num_unreachable = 0;
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      if (!program_analysis_contains(self->reachable, (uint8_t)i)) self->num_unreachable++;
+   }
+   return;
+}
+
+/********************************************************************************
+* find_vectors: Pin change interrupts require the interrupt flag, which is
+*               only set by SEI or OUTSR, and a pin change interrupt mask register,
+*               which is written by OUT, STS or STSX (STS also writes the next
+*               address), or possibly by stores through the pointer registers.
+*               Returns true if any vector was added.
+********************************************************************************/
+static bool find_vectors(const struct program_analysis* self,
+                         uint8_t* vectors)
+{
+   const uint8_t vector_addresses[] = { PCINT0_vect, PCINT1_vect, PCINT2_vect };
+   bool interrupts_enabled = false;
+   uint8_t masks_written = 0x00;
+   bool added = false;
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      if (!program_analysis_contains(self->reachable, (uint8_t)i)) continue;
+
+      const uint8_t op_code = instructions[i] >> 16;
+      const uint8_t op1 = instructions[i] >> 8;
+      const uint8_t op2 = instructions[i];
+
+      if (op_code == SEI || op_code == OUTSR)
+      {
+         interrupts_enabled = true;
+      }
+      else if ((op_code == OUT || op_code == STS || (op_code == STSX && op2 < CPU_REGISTER_ADDRESS_WIDTH)) &&
+               op1 >= PCMSK0 && op1 <= PCMSK2)
+      {
+         set(masks_written, (op1 - PCMSK0));
+      }
+      else if (op_code == STS && op1 == PCMSK0 - 1 && op2 < DATA_MEMORY_DATA_WIDTH - 1)
+      {
+         set(masks_written, 0);
+      }
+      else if (op_code == STS && op1 >= PCMSK0 && op1 < PCMSK2 && op2 < DATA_MEMORY_DATA_WIDTH - 1)
+      {
+         set(masks_written, (op1 - PCMSK0 + 1));
+      }
+      else if (op_code == ST || op_code == STP || op_code == STM || op_code == STDY || op_code == STDZ)
+      {
+         masks_written = 0x07;
+      }
+   }
+
+   for (uint8_t i = 0; i < 3 && interrupts_enabled; ++i)
+   {
+      if (read(masks_written, i) && !program_analysis_contains(vectors, vector_addresses[i]))
+      {
+         add(vectors, vector_addresses[i]);
+         added = true;
+      }
+   }
+   return added;
+}
+
+static void find_blocks(struct program_analysis* self,
+                        const uint8_t* entries)
+{
+   uint8_t leaders[PROGRAM_ANALYSIS_SET_SIZE] = { 0 };
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      const uint8_t op_code = instructions[i] >> 16;
+      if (!program_analysis_contains(self->reachable, (uint8_t)i)) continue;
+
+      if (program_analysis_contains(entries, (uint8_t)i)) add(leaders, (uint8_t)i);
+      if (is_branch(op_code) || op_code == CALL) add(leaders, (uint8_t)(instructions[i] >> 8));
+      if (is_leader_after(op_code)) add(leaders, fall_through((uint8_t)i));
+   }
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      if (!program_analysis_contains(self->reachable, (uint8_t)i) ||
+          !program_analysis_contains(leaders, (uint8_t)i)) continue;
+
+      struct program_analysis_block* block = &self->blocks[self->num_blocks];
+      uint16_t address = i;
+      block->start = (uint8_t)i;
+
+      while (1)
+      {
+         const uint8_t op_code = instructions[(uint8_t)address] >> 16;
+         self->block_index[(uint8_t)address] = self->num_blocks;
+         block->length++;
+
+         if (is_leader_after(op_code) || block->length >= PROGRAM_MEMORY_ADDRESS_WIDTH) break;
+         address++;
+         if (program_analysis_contains(leaders, (uint8_t)address)) break;
+      }
+
+      self->num_blocks++;
+   }
+   return;
+}
+
+static void find_functions(struct program_analysis* self,
+                           const uint8_t* entries,
+                           const uint8_t* vectors)
+{
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      if (!program_analysis_contains(entries, (uint8_t)i)) continue;
+
+      struct program_analysis_function* function = &self->functions[self->num_functions++];
+      uint8_t stack[PROGRAM_MEMORY_ADDRESS_WIDTH];
+      uint16_t num_pending = 0;
+
+      function->entry = (uint8_t)i;
+      if (i == RESET_vect)                                       function->kind = PROGRAM_ANALYSIS_ENTRY_RESET;
+      else if (program_analysis_contains(vectors, (uint8_t)i)) function->kind = PROGRAM_ANALYSIS_ENTRY_INTERRUPT;
+      else                                                      function->kind = PROGRAM_ANALYSIS_ENTRY_CALL;
+
+      add(function->blocks, (uint8_t)i);
+      stack[num_pending++] = (uint8_t)i;
+
+      while (num_pending)
+      {
+         const struct program_analysis_block* block = &self->blocks[self->block_index[stack[--num_pending]]];
+         const uint8_t last = (uint8_t)(block->start + block->length - 1);
+         uint8_t next[2] = { 0 };
+         const uint8_t num_next = successors(last, next);
+
+         if (block->length && (instructions[last] >> 16) == CALL)
+         {
+            add(function->callees, (uint8_t)(instructions[last] >> 8));
+         }
+
+         for (uint8_t j = 0; j < num_next; ++j)
+         {
+            const uint8_t start = self->blocks[self->block_index[next[j]]].start;
+            if ((instructions[last] >> 16) == CALL && next[j] == (uint8_t)(instructions[last] >> 8)) continue;
+
+            if (!program_analysis_contains(function->blocks, start))
+            {
+               add(function->blocks, start);
+               stack[num_pending++] = start;
+            }
+         }
+      }
+   }
+   return;
+}
+
+/********************************************************************************
+* find_successors: CALL continues at the called subroutine, whose RET
+*                  instructions continue after every CALL to the
+*                  subroutine. RET in the reset or an interrupt routine, RETI
+*                  and invalid instructions have no known successors.
+********************************************************************************/
+static void find_successors(struct program_analysis* self)
+{
+   for (uint16_t i = 0; i < self->num_blocks; ++i)
+   {
+      struct program_analysis_block* block = &self->blocks[i];
+      const uint8_t last = (uint8_t)(block->start + block->length - 1);
+      uint8_t next[2] = { 0 };
+      const uint8_t num_next = successors(last, next);
+
+      for (uint8_t j = 0; j < num_next; ++j)
+      {
+         add(block->successors, next[j]);
+      }
+
+      if ((instructions[last] >> 16) == CALL)
+      {
+         block->calls = true;
+         block->callee = (uint8_t)(instructions[last] >> 8);
+      }
+   }
+
+   for (uint16_t i = 0; i < self->num_functions; ++i)
+   {
+      const struct program_analysis_function* function = &self->functions[i];
+      if (function->kind != PROGRAM_ANALYSIS_ENTRY_CALL) continue;
+
+      for (uint16_t j = 0; j < self->num_blocks; ++j)
+      {
+         struct program_analysis_block* block = &self->blocks[j];
+         const uint8_t last = (uint8_t)(block->start + block->length - 1);
+         if (!program_analysis_contains(function->blocks, block->start) || (instructions[last] >> 16) != RET) continue;
+
+         for (uint16_t k = 0; k < self->num_blocks; ++k)
+         {
+            const struct program_analysis_block* caller = &self->blocks[k];
+            if (caller->calls && caller->callee == function->entry)
+            {
+               add(block->successors, fall_through((uint8_t)(caller->start + caller->length - 1)));
+            }
+         }
+      }
+   }
+   return;
+}
+
+static void compute_effects(struct program_analysis* self)
+{
+   for (uint16_t i = 0; i < self->num_blocks; ++i)
+   {
+      struct program_analysis_block* block = &self->blocks[i];
+
+      for (uint16_t j = 0; j < block->length; ++j)
+      {
+         const struct instruction_effects e = effects(instructions[(uint8_t)(block->start + j)]);
+         block->registers_read |= e.registers_read & ~block->registers_written;
+         block->registers_written |= e.registers_written;
+         block->flags_read |= e.flags_read & ~block->flags_written;
+         block->flags_written |= e.flags_written;
+      }
+   }
+   return;
+}
+
+/********************************************************************************
+* compute_flag_liveness: Computes the flags live at block entry and exit by
+*                        iterating until no set changes. Blocks without
+*                        known successors, except blocks resetting the
+*                        system, keep all flags live, since they return to
+*                        unknown code. Flags read by interrupt routines
+*                        before written are live everywhere.
+********************************************************************************/
+static void compute_flag_liveness(struct program_analysis* self)
+{
+   bool changed = true;
+   uint8_t interrupt_live_in = 0x00;
+
+   while (changed)
+   {
+      changed = false;
+
+      for (uint16_t i = self->num_blocks; i > 0; --i)
+      {
+         struct program_analysis_block* block = &self->blocks[i - 1];
+         const uint8_t last_op_code = instructions[(uint8_t)(block->start + block->length - 1)] >> 16;
+         uint8_t live_out = 0x00;
+         bool has_successors = false;
+
+         for (uint16_t j = 0; j < PROGRAM_MEMORY_ADDRESS_WIDTH; ++j)
+         {
+            if (program_analysis_contains(block->successors, (uint8_t)j))
+            {
+               live_out |= self->blocks[self->block_index[j]].flags_live_in;
+               has_successors = true;
+            }
+         }
+
+         if (!has_successors && valid_op_code(last_op_code)) live_out = PROGRAM_ANALYSIS_FLAGS;
+         live_out |= interrupt_live_in;
+
+         const uint8_t live_in = (block->flags_read | (live_out & ~block->flags_written)) & PROGRAM_ANALYSIS_FLAGS;
+
+         if (live_in != block->flags_live_in || live_out != block->flags_live_out)
+         {
+            block->flags_live_in = live_in;
+            block->flags_live_out = live_out;
+            changed = true;
+         }
+      }
+
+      for (uint16_t i = 0; i < self->num_functions; ++i)
+      {
+         const struct program_analysis_function* function = &self->functions[i];
+         if (function->kind != PROGRAM_ANALYSIS_ENTRY_INTERRUPT) continue;
+         const uint8_t live_in = self->blocks[self->block_index[function->entry]].flags_live_in;
+
+         if ((interrupt_live_in | live_in) != interrupt_live_in)
+         {
+            interrupt_live_in |= live_in;
+            changed = true;
+         }
+      }
+   }
+
+   for (uint16_t i = 0; i < self->num_blocks; ++i)
+   {
+      const struct program_analysis_block* block = &self->blocks[i];
+      uint8_t live = block->flags_live_out;
+
+      for (uint16_t j = block->length; j > 0; --j)
+      {
+         const uint8_t address = (uint8_t)(block->start + j - 1);
+         const struct instruction_effects e = effects(instructions[address]);
+         self->flags_live_after[address] = live;
+         live = ((live & ~e.flags_written) | e.flags_read | interrupt_live_in) & PROGRAM_ANALYSIS_FLAGS;
+      }
+   }
+   return;
+}
+
+static uint8_t successors(const uint8_t address,
+                          uint8_t* next)
+{
+   const uint8_t op_code = instructions[address] >> 16;
+   const uint8_t target = instructions[address] >> 8;
+
+   if (op_code == JMP)
+   {
+      next[0] = target;
+      return 1;
+   }
+   else if (is_branch(op_code) || op_code == CALL)
+   {
+      next[0] = target;
+      next[1] = fall_through(address);
+      return 2;
+   }
+   else if (op_code == RET || op_code == RETI || !valid_op_code(op_code))
+   {
+      return 0;
+   }
+   else
+   {
+      next[0] = fall_through(address);
+      return 1;
+   }
+}
+
+static struct instruction_effects effects(const uint32_t instruction)
+{
+   const uint8_t op_code = instruction >> 16;
+   const uint8_t op1 = instruction >> 8;
+   const uint8_t op2 = instruction;
+   const uint8_t nzvc = PROGRAM_ANALYSIS_FLAGS;
+   struct instruction_effects e = { 0 };
+
+   switch (op_code)
+   {
+      case LDI: case CLR: case IN: case POP:
+      {
+         e.registers_written = registers(op1, 1);
+         break;
+      }
+      case MOV:
+      {
+         e.registers_read = registers(op2, 1);
+         e.registers_written = registers(op1, 1);
+         break;
+      }
+      case OUT: case PUSH:
+      {
+         e.registers_read = registers(op_code == OUT ? op2 : op1, 1);
+         break;
+      }
+      case STS:
+      {
+         e.registers_read = registers(op2, op2 < DATA_MEMORY_DATA_WIDTH - 1 ? 2 : 1);
+         break;
+      }
+      case LDS:
+      {
+         e.registers_written = registers(op1, 2);
+         break;
+      }
+      case ADDI: case SUBI: case LSL: case LSR:
+      {
+         e.registers_read = e.registers_written = registers(op1, 1);
+         e.flags_written = nzvc;
+         break;
+      }
+      case ORI: case ANDI: case XORI: case INC: case DEC:
+      {
+         e.registers_read = e.registers_written = registers(op1, 1);
+         e.flags_written = nzvc & ~(1 << C);
+         break;
+      }
+      case OR: case AND: case XOR: case ADD: case SUB: case ADC: case SBC:
+      {
+         e.registers_read = registers(op1, 1) | registers(op2, 1);
+         e.registers_written = registers(op1, 1);
+         e.flags_read = op_code == ADC ? (1 << C) : op_code == SBC ? (1 << C) | (1 << Z) : 0x00;
+         e.flags_written = op_code == OR || op_code == AND || op_code == XOR ? nzvc & ~(1 << C) : nzvc;
+         break;
+      }
+      case CPI: case CP:
+      {
+         e.registers_read = registers(op1, 1) | (op_code == CP ? registers(op2, 1) : 0);
+         e.flags_written = nzvc;
+         break;
+      }
+      case BREQ: case BRNE:
+      {
+         e.flags_read = (1 << Z);
+         break;
+      }
+      case BRGE: case BRGT: case BRLE:
+      {
+         e.flags_read = (1 << N) | (1 << Z);
+         break;
+      }
+      case BRLT:
+      {
+         e.flags_read = (1 << N);
+         break;
+      }
+      case BRGES: case BRLTS:
+      {
+         e.flags_read = (1 << N) | (1 << V);
+         break;
+      }
+      case RETI:
+      {
+         e.registers_written = registers(R0, CPU_REGISTER_DATA_WIDTH);
+         e.flags_written = nzvc;
+         break;
+      }
+      case LD: case LDP: case LDM:
+      {
+         e.registers_read = registers(op2, 2);
+         e.registers_written = registers(op1, 1) | (op_code != LD ? registers(op2, 2) : 0);
+         break;
+      }
+      case ST: case STP: case STM:
+      {
+         e.registers_read = registers(op1, 2) | registers(op2, 1);
+         e.registers_written = op_code != ST ? registers(op1, 2) : 0;
+         break;
+      }
+      case LDDY: case LDDZ:
+      {
+         e.registers_read = registers(op_code == LDDY ? YL : ZL, 2);
+         e.registers_written = registers(op1, 1);
+         break;
+      }
+      case STDY: case STDZ:
+      {
+         e.registers_read = registers(op_code == STDY ? YL : ZL, 2) | registers(op2, 1);
+         break;
+      }
+      case LPM: case LPMP:
+      {
+         e.registers_read = registers(ZL, 2);
+         e.registers_written = registers(op1, 1) | (op_code == LPMP ? registers(ZL, 2) : 0);
+         break;
+      }
+      case MOVW:
+      {
+         e.registers_read = registers(op2, 2);
+         e.registers_written = registers(op1, 2);
+         break;
+      }
+      case ADIW: case SBIW:
+      {
+         e.registers_read = e.registers_written = registers(op1, 2);
+         e.flags_written = nzvc;
+         break;
+      }
+      case MUL: case MULS: case MULSU:
+      {
+         e.registers_read = registers(op1, 1) | registers(op2, 1);
+         e.registers_written = registers(R0, 2);
+         e.flags_written = (1 << Z) | (1 << C);
+         break;
+      }
+      case LDSX:
+      {
+         e.registers_written = registers(CPU_WIDE_REGISTER(op1), 1);
+         break;
+      }
+      case STSX:
+      {
+         e.registers_read = registers(CPU_WIDE_REGISTER(op2), 1);
+         break;
+      }
+      case INSR:
+      {
+         e.registers_written = registers(op1, 1);
+         e.flags_read = nzvc;
+         break;
+      }
+      case OUTSR:
+      {
+         e.registers_read = registers(op1, 1);
+         e.flags_written = nzvc;
+         break;
+      }
+      case INSP:
+      {
+         e.registers_written = registers(op1, 1);
+         break;
+      }
+      case OUTSP:
+      {
+         e.registers_read = registers(op1, 1);
+         break;
+      }
+      default:
+      {
+         if (!valid_op_code(op_code))
+         {
+            e.registers_written = ALL_REGISTERS;
+            e.flags_written = nzvc;
+         }
+         break;
+      }
+   }
+   return e;
+}
+
+static bool is_leader_after(const uint8_t op_code)
+{
+   return is_branch(op_code) || op_code == CALL || op_code == RET ||
+          op_code == RETI || op_code == LDSX || op_code == STSX || !valid_op_code(op_code);
+}
+
+/********************************************************************************
+* fall_through: Returns the address following the instruction at specified
+*               address. LDSX, STSX and a CALL occupying two words skip the
+*               word holding the rest of the instruction.
+*
+*               - address: The address of the instruction.
+********************************************************************************/
+static inline uint8_t fall_through(const uint8_t address)
+{
+   const uint8_t op_code = instructions[address] >> 16;
+   const uint8_t op2 = instructions[address];
+   const bool two_words = op_code == LDSX || op_code == STSX || (op_code == CALL && op2);
+   return (uint8_t)(address + (two_words ? 2 : 1));
+}
+
+static inline bool valid_op_code(const uint8_t op_code)
+{
+   return op_code <= MULSU || (op_code >= LDSX && op_code <= BRLTS);
+}
+
+static inline bool is_branch(const uint8_t op_code)
+{
+   return (op_code >= JMP && op_code <= BRLT) || op_code == BRGES || op_code == BRLTS;
+}
+
+static inline void add(uint8_t* addresses,
+                       const uint8_t address)
+{
+   set(addresses[address / 8], address % 8);
+   return;
+}
+
+static inline uint32_t registers(const uint8_t first,
+                                 const uint8_t count)
+{
+   uint32_t mask = 0;
+
+   for (uint8_t i = first; i < first + count && i < CPU_REGISTER_ADDRESS_WIDTH; ++i)
+   {
+      mask |= (uint32_t)1 << i;
+   }
+   return mask;
+}
+
+static void write_label(FILE* file,
+                        const struct program_analysis* self,
+                        const struct program_analysis_block* block)
+{
+   char binary[CPU_BINARY_BUFFER_SIZE];
+
+   for (uint16_t i = 0; i < self->num_functions; ++i)
+   {
+      if (self->functions[i].entry == block->start)
+      {
+         fprintf(file, "%s 0x%02X\\l", entry_name(self->functions[i].kind), block->start);
+      }
+   }
+
+   for (uint16_t i = 0; i < block->length; ++i)
+   {
+      const uint8_t address = (uint8_t)(block->start + i);
+      const uint32_t instruction = instructions[address];
+      fprintf(file, "0x%02X: %-6s 0x%02X, 0x%02X\\l", address, cpu_instruction_name((uint8_t)(instruction >> 16)),
+              (instruction >> 8) & 0xFF, instruction & 0xFF);
+   }
+
+   fprintf(file, "reads 0x%08X, writes 0x%08X\\l", block->registers_read, block->registers_written);
+   fprintf(file, "NZVC live in %s", cpu_format_binary(block->flags_live_in, 4, binary));
+   fprintf(file, ", out %s\\l", cpu_format_binary(block->flags_live_out, 4, binary));
+   return;
+}
+
+static const char* entry_name(const enum program_analysis_entry kind)
+{
+   if (kind == PROGRAM_ANALYSIS_ENTRY_RESET)          return "Reset";
+   else if (kind == PROGRAM_ANALYSIS_ENTRY_INTERRUPT) return "Interrupt";
+   else                                               return "Subroutine";
+}
@@ -0,0 +1,125 @@
+/********************************************************************************
+* program_analysis.h: Contains functionality for static control flow analysis
+*                     of the program stored in program memory. The analysis
+*                     finds basic blocks, subroutines and the CALL graph,
+*                     interrupt routines entered through the pin change
+*                     interrupt vectors and unreachable code. For every
+*                     block, the CPU registers read and written are
+*                     computed, as well as the liveness of the NZVC flags
+*                     of the status register.
+*
+*                     The result is cached until the program memory is
+*                     changed, so that faster execution modes can use it,
+*                     for instance to skip flag updates that are never read.
+*                     The flags pushed to the stack at interrupts are not
+*                     counted as reads, since interrupt entry depends on
+*                     input at runtime. Execution modes that skip flag
+*                     updates must handle interrupt entry themselves.
+********************************************************************************/
+#ifndef PROGRAM_ANALYSIS_H_
+#define PROGRAM_ANALYSIS_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "program_memory.h"
+#include "breakpoint.h"
+
+#define PROGRAM_ANALYSIS_NONE     0xFFFF                                /* No block at the address. */
+#define PROGRAM_ANALYSIS_SET_SIZE (PROGRAM_MEMORY_ADDRESS_WIDTH / 8)    /* Bytes per address set. */
+#define PROGRAM_ANALYSIS_FLAGS    ((1 << N) | (1 << Z) | (1 << V) | (1 << C)) /* Analysed flags. */
+
+/********************************************************************************
+* program_analysis_entry: Enumeration for the kinds of code entry points.
+********************************************************************************/
+enum program_analysis_entry
+{
+   PROGRAM_ANALYSIS_ENTRY_RESET,     /* Entered at system reset. */
+   PROGRAM_ANALYSIS_ENTRY_INTERRUPT, /* Entered through a pin change interrupt vector. */
+   PROGRAM_ANALYSIS_ENTRY_CALL       /* Entered by the CALL instruction. */
+};
+
+/********************************************************************************
+* program_analysis_block: Basic block, i.e. a sequence of instructions only
+*                         entered at the first instruction and only left
+*                         after the last instruction.
+********************************************************************************/
+struct program_analysis_block
+{
+   uint8_t start;                                 /* Address of the first instruction. */
+   uint16_t length;                               /* Number of instructions. */
+   uint8_t successors[PROGRAM_ANALYSIS_SET_SIZE]; /* Start addresses of succeeding blocks. */
+   bool calls;                                    /* Indicates if the block ends with CALL. */
+   uint8_t callee;                                /* Address called at the end of the block. */
+   uint32_t registers_read;                       /* CPU registers read before written. */
+   uint32_t registers_written;                    /* CPU registers written. */
+   uint8_t flags_read;                            /* Flags read before written. */
+   uint8_t flags_written;                         /* Flags written. */
+   uint8_t flags_live_in;                         /* Flags that may be read after block entry. */
+   uint8_t flags_live_out;                        /* Flags that may be read after block exit. */
+};
+
+/********************************************************************************
+* program_analysis_function: Reset routine, interrupt routine or subroutine,
+*                            i.e. the code reached from an entry point
+*                            without following CALL instructions.
+********************************************************************************/
+struct program_analysis_function
+{
+   uint8_t entry;                              /* Address of the entry point. */
+   enum program_analysis_entry kind;           /* Kind of entry point. */
+   uint8_t blocks[PROGRAM_ANALYSIS_SET_SIZE];  /* Start addresses of the blocks. */
+   uint8_t callees[PROGRAM_ANALYSIS_SET_SIZE]; /* Entry addresses of called subroutines. */
+};
+
+/********************************************************************************
+* program_analysis: Result of the analysis of the program memory.
+********************************************************************************/
+struct program_analysis
+{
+   uint32_t generation;                      /* Analysed generation of the program memory. */
+   uint16_t num_blocks;                      /* Number of basic blocks. */
+   uint16_t num_functions;                   /* Number of functions. */
+   uint16_t num_unreachable;                 /* Number of unreachable addresses. */
+   uint8_t reachable[PROGRAM_ANALYSIS_SET_SIZE];                /* Reachable addresses. */
+   uint16_t block_index[PROGRAM_MEMORY_ADDRESS_WIDTH];          /* Block containing each address. */
+   uint8_t flags_live_after[PROGRAM_MEMORY_ADDRESS_WIDTH];      /* Flags that may be read after each instruction. */
+   struct program_analysis_block blocks[PROGRAM_MEMORY_ADDRESS_WIDTH];       /* Blocks sorted by address. */
+   struct program_analysis_function functions[PROGRAM_MEMORY_ADDRESS_WIDTH]; /* Functions sorted by entry. */
+};
+
+/********************************************************************************
+* program_analysis_get: Returns the analysis of the program currently stored
+*                       in program memory. The analysis is only performed
+*                       again when the program memory has been changed.
+*                       Breakpoints are ignored, i.e. the original
+*                       instructions are analysed.
+********************************************************************************/
+const struct program_analysis* program_analysis_get(void);
+
+/********************************************************************************
+* program_analysis_contains: Indicates if specified address is included in
+*                            referenced address set.
+*
+*                            - addresses: Reference to the address set.
+*                            - address  : The address.
+********************************************************************************/
+static inline bool program_analysis_contains(const uint8_t* addresses,
+                                             const uint8_t address)
+{
+   return read(addresses[address / 8], address % 8);
+}
+
+/********************************************************************************
+* program_analysis_write_dot: Writes referenced analysis as a graph in the
+*                             DOT language to specified file, which can be
+*                             rendered by Graphviz. Returns 0 after
+*                             successful write or error code 1 if the file
+*                             couldn't be written.
+*
+*                             - self    : Reference to the analysis.
+*                             - filepath: Path to the file.
+********************************************************************************/
+int program_analysis_write_dot(const struct program_analysis* self,
+                               const char* filepath);
+
+#endif /* PROGRAM_ANALYSIS_H_ */
\ No newline at end of file
@@ -1,162 +1,593 @@
-#include "program_memory.h"
-
-#define ISR_PCINT0     0x04
-#define ISR_PCINT0_end ISR_PCINT0 + 4
-
-#define main ISR_PCINT0 + 5
-#define main_loop main + 1
-#define setup main + 2
-#define led_toggle setup + 10
-#define led_toggle_end led_toggle + 4
-#define led_on led_toggle + 5
-#define led_off led_on + 6
-#define end led_off + 6
-
-#define LED1    0
-#define BUTTON1 5
-
-#define led_enabled 100
-
-static uint32_t data[PROGRAM_MEMORY_ADDRESS_WIDTH];
-static bool program_memory_initialized = false;
-
-static inline uint32_t assemble(const uint8_t op_code,
-                                const uint8_t op1,
-                                const uint8_t op2);
-
-/********************************************************************************
-* program_memory_writes: Writes instructions to program memory. This function
-*                        should be called once when the program starts.
-********************************************************************************/
-void program_memory_write(void)
-{
-   if (program_memory_initialized) return;
-
-   /********************************************************************************
-   * RESET_vect: Reset vector and start address for the program. A jump is made 
-   *             to the main subroutine in order to start the program.
-   ********************************************************************************/
-   data[RESET_vect]     = assemble(JMP, main, 0x00);    /* JMP main */
-   data[RESET_vect + 1] = assemble(NOP, 0x00, 0x00);    /* NOP */
-
-   /********************************************************************************
-   * PCINT0_vect: Interrupt vector for pin change interrupt at I/O-port B.
-   *              Corresponding interrupt routine is executed to handle 
-   *              the interrupt.
-   ********************************************************************************/
-   data[PCINT0_vect]     = assemble(JMP, ISR_PCINT0, 0x00); /* JMP ISR_PCINT0 */
-   data[PCINT0_vect + 1] = assemble(NOP, 0x00, 0x00);       /* NOP */
-
-   /********************************************************************************
-   * ISR_PCINT0: Interrupt routine for pin change interrupt at I/O-port B.
-   *             LED1 is toggled if BUTTON1 is pressed.
-   ********************************************************************************/
-   data[ISR_PCINT0]     = assemble(IN, R24, PINB);              /* IN R24, PINB */
-   data[ISR_PCINT0 + 1] = assemble(ANDI, R24, (1 << BUTTON1));  /* CPI R24, 0x00 */
-   data[ISR_PCINT0 + 2] = assemble(BREQ, ISR_PCINT0_end, 0x00); /* BREQ ISR_PCINT0_end */
-   data[ISR_PCINT0 + 3] = assemble(CALL, led_toggle, 0x00);     /* CALL led_toggle */
-   data[ISR_PCINT0_end] = assemble(RETI, 0x00, 0x00);           /* RETI */
-
-   /********************************************************************************
-   * main: Initiates the system at start. A loop is then generated to keep the
-   *       program running continuously.
-   ********************************************************************************/
-   data[main]      = assemble(CALL, setup, 0x00); /* CALL setup */
-   data[main_loop] = assemble(JMP, main_loop, 0); /* JMP main_loop */
-
-   /********************************************************************************
-   * setup: Initiates I/O-ports (sets LED1 to output, enables the internal pull-up
-   *        resistor for BUTTON1) and enables pin change interrupt at BUTTON1. 
-   ********************************************************************************/
-   data[setup]     = assemble(LDI, R16, (1 << LED1));    /* LDI, R16, (1 << LED1) */
-   data[setup + 1] = assemble(OUT, DDRB, R16);           /* OUT DDRB, R16 */
-   data[setup + 2] = assemble(LDI, R16, (1 << BUTTON1)); /* LDI R16, (1 << BUTTON1) */
-   data[setup + 3] = assemble(OUT, PORTB, R16);          /* OUT PORTB, R16 */
-   data[setup + 4] = assemble(SEI, 0x00, 0x00);          /* SEI */
-   data[setup + 5] = assemble(LDI, R16, (1 << PCIE0));   /* LDI R16, (1 << PCIE0) */
-   data[setup + 6] = assemble(STS, PCICR, R16);          /* STS PCICR, R16 */
-   data[setup + 7] = assemble(LDI, R16, (1 << BUTTON1)); /* LDI R16, (1 << BUTTON1) */
-   data[setup + 8] = assemble(STS, PCMSK0, R16);         /* STS PCMSK0, R16 */
-   data[setup + 9] = assemble(RET, 0x00, 0x00);          /* RET */
-
-   /********************************************************************************
-   * led_toggle: Toggles LED1.
-   ********************************************************************************/
-   data[led_toggle]     = assemble(LDS, R16, led_enabled); /* LDS R16, led_enabled */
-   data[led_toggle + 1] = assemble(CPI, R16, 0x00);        /* CPI R16, 0x00 */
-   data[led_toggle + 2] = assemble(BREQ, led_on, 0x00);    /* BREQ led_on */
-   data[led_toggle + 3] = assemble(JMP, led_off, 0x00);    /* JMP led_off */
-   data[led_toggle + 4] = assemble(RET, 0x00, 0x00);       /* RET */
-
-   /********************************************************************************
-   * led_on: Enables LED1 and stores current state in data memory.
-   ********************************************************************************/
-   data[led_on]     = assemble(IN, R16, PORTB);            /* IN R16, PORTB */
-   data[led_on + 1] = assemble(ORI, R16, (1 << LED1));     /* ORI R16, (1 << LED1) */
-   data[led_on + 2] = assemble(OUT, PORTB, R16);           /* OUT PORTB, R16 */
-   data[led_on + 3] = assemble(LDI, R16, 0x01);            /* LDI R16, 0x01 */
-   data[led_on + 4] = assemble(STS, led_enabled, R16);     /* STS led_enabled, R16 */
-   data[led_on + 5] = assemble(JMP, led_toggle_end, 0x00); /* JMP led_toggle_end */
-
-   /********************************************************************************
-   * led_off: Disables LED1 and stores current state in data memory.
-   ********************************************************************************/
-   data[led_off]     = assemble(IN, R16, PORTB);            /* IN R16, PORTB */
-   data[led_off + 1] = assemble(ANDI, R16, ~(1 << LED1));   /* ANDI R16, ~(1 << LED1) */
-   data[led_off + 2] = assemble(OUT, PORTB, R16);           /* OUT PORTB, R16 */
-   data[led_off + 3] = assemble(LDI, R16, 0x00);            /* LDI R16, 0x01 */
-   data[led_off + 4] = assemble(STS, led_enabled, R16);     /* STS led_enabled, R16 */
-   data[led_off + 5] = assemble(JMP, led_toggle_end, 0x00); /* JMP led_toggle_end */
-
-   program_memory_initialized = true;
-   return;
-}
-
-/********************************************************************************
-* program_memory_read: Returns the instruction at specified address. If an
-*                      invalid address is specified (should be impossible as
-*                      long as the program memory address width isn't increased)
-*                      no operation (0x00) is returned.
-*
-*                      - address: Address to instruction in program memory.
-********************************************************************************/
-uint32_t program_memory_read(const uint8_t address)
-{
-   if (address < PROGRAM_MEMORY_ADDRESS_WIDTH)
-   {
-      return data[address];
-   }
-   else
-   {
-      return 0x00;
-   }
-}
-
-/********************************************************************************
-* program_memory_subroutine_name: Returns the name of the subroutine at
-*                                 specified address.
-*
-*                                 - address: Address within the subroutine.
-********************************************************************************/
-const char* program_memory_subroutine_name(const uint8_t address)
-{
-   if (address >= RESET_vect && address < PCINT0_vect) return "RESET_vect";
-   else if (address >= PCINT0_vect && address < ISR_PCINT0) return "PCINT0_vect";
-   else if (address >= ISR_PCINT0 && address < main) return "ISR_PCINT0";
-   else if (address >= main && address < setup) return "main";
-   else if (address >= setup && address < led_toggle) return "setup";
-   else if (address >= led_toggle && address < led_on) return "led_toggle";
-   else if (address >= led_on && address < led_off) return "led_on";
-   else if (address >= led_off && address < end) return "led_off";
-   else return "Unknown";
-}
-
-static inline uint32_t assemble(const uint8_t op_code,
-                                const uint8_t op1,
-                                const uint8_t op2)
-{
-   uint32_t instruction = op_code << 16;
-   instruction |= op1 << 8;
-   instruction |= op2;
-   return instruction;
-}
+#include <threads.h>
+#include "program_memory.h"
+#include "breakpoint.h"
+
+#define ISR_PCINT0     0x04
+#define ISR_PCINT0_end ISR_PCINT0 + 4
+
+#define main ISR_PCINT0 + 5
+#define main_loop main + 1
+#define setup main + 2
+#define led_toggle setup + 10
+#define led_toggle_end led_toggle + 4
+#define led_on led_toggle + 5
+#define led_off led_on + 6
+#define end led_off + 6
+
+static CPU_THREAD_LOCAL const struct program_image* image = 0; /* Image stored in program memory. */
+static CPU_THREAD_LOCAL uint32_t generation = 0; /* Incremented when instructions are changed. */
+static CPU_THREAD_LOCAL uint8_t changed_first = 0;  /* First address changed by the last change. */
+static CPU_THREAD_LOCAL uint16_t changed_count = 0; /* Addresses changed by the last change, 0 for all. */
+
+static struct program_image builtin_image = { .references = 1 }; /* Holds a reference that is never released. */
+static once_flag builtin_once = ONCE_FLAG_INIT;
+
+static void write_builtin_image(void);
+static struct program_image* copy_image(void);
+static void set_image(const struct program_image* self);
+static inline uint64_t fnv1a(uint64_t hash,
+                             const uint8_t byte);
+static inline uint32_t assemble(const uint8_t op_code,
+                                const uint8_t op1,
+                                const uint8_t op2);
+
+/********************************************************************************
+* program_memory_writes: Writes instructions to program memory. This function
+*                        should be called once when the program starts.
+********************************************************************************/
+void program_memory_write(void)
+{
+   if (image) return;
+   call_once(&builtin_once, write_builtin_image);
+   set_image(program_image_retain(&builtin_image));
+   return;
+}
+
+/********************************************************************************
+* program_memory_read: Returns the instruction at specified address. If an
+*                      invalid address is specified (should be impossible as
+*                      long as the program memory address width isn't increased)
+*                      no operation (0x00) is returned.
+*
+*                      - address: Address to instruction in program memory.
+********************************************************************************/
+uint32_t program_memory_read(const uint8_t address)
+{
+   if (address < PROGRAM_MEMORY_ADDRESS_WIDTH && image)
+   {
+      return image->instructions[address];
+   }
+   else
+   {
+      return 0x00;
+   }
+}
+
+/********************************************************************************
+* program_memory_replace: Replaces the instruction at specified address and
+*                         returns the previous instruction. The bytes read
+*                         by the LPM instruction are not affected. Since the
+*                         image may be shared, the instruction is replaced
+*                         in a copy of it. If an invalid address is
+*                         specified or memory ran out, nothing is replaced
+*                         and NOP (0x00) is returned.
+*
+*                         - address    : Address to instruction in program memory.
+*                         - instruction: The new instruction.
+********************************************************************************/
+uint32_t program_memory_replace(const uint8_t address,
+                                const uint32_t instruction)
+{
+   struct program_image* copy = address < PROGRAM_MEMORY_ADDRESS_WIDTH ? copy_image() : 0;
+
+   if (copy)
+   {
+      const uint32_t previous = copy->instructions[address];
+      copy->instructions[address] = instruction;
+      atomic_init(&copy->hash, atomic_load_explicit(&image->hash, memory_order_relaxed)); /* Breakpoints don't change the program. */
+      set_image(copy);
+      changed_first = address;
+      changed_count = 1;
+      return previous;
+   }
+   else
+   {
+      return 0x00;
+   }
+}
+
+/********************************************************************************
+* program_memory_patch: Replaces specified number of instructions from
+*                       specified address and onwards in a single change of
+*                       the program memory, without resetting the system.
+*                       Since the image may be shared, the instructions are
+*                       replaced in a copy of it. Returns 0 after success or
+*                       error code 1 if the instructions don't fit in the
+*                       program memory or memory ran out.
+*
+*                       - address         : Address of the first instruction.
+*                       - instructions    : Reference to the new instructions.
+*                       - raw             : Reference to the new words read by
+*                                           the LPM instruction, or 0 to read
+*                                           the operands of the instructions.
+*                       - num_instructions: The number of instructions.
+********************************************************************************/
+int program_memory_patch(const uint8_t address,
+                         const uint32_t* instructions,
+                         const uint16_t* raw,
+                         const size_t num_instructions)
+{
+   struct program_image* copy = 0;
+   if (!num_instructions) return 0;
+   if ((size_t)address + num_instructions > PROGRAM_MEMORY_ADDRESS_WIDTH) return 1;
+
+   copy = copy_image();
+   if (!copy) return 1;
+
+   for (size_t i = 0; i < num_instructions; ++i)
+   {
+      copy->instructions[address + i] = instructions[i];
+      copy->raw[address + i] = raw ? raw[i] : (uint16_t)instructions[i];
+   }
+
+   set_image(copy);
+   changed_first = address;
+   changed_count = (uint16_t)num_instructions;
+   return 0;
+}
+
+/********************************************************************************
+* program_memory_read_byte: Returns the byte at specified byte address, as read
+*                           by the LPM instruction. Each program memory address
+*                           holds two bytes, where the low byte is stored at
+*                           the even byte address. For programs assembled in
+*                           the simulator's own format, these are the two
+*                           operands of the instruction (op2 and op1). If an
+*                           invalid address is specified, 0x00 is returned.
+*
+*                           - address: Byte address in program memory.
+********************************************************************************/
+uint8_t program_memory_read_byte(const uint16_t address)
+{
+   if (address < PROGRAM_MEMORY_ADDRESS_WIDTH * 2 && image)
+   {
+      return (uint8_t)(image->raw[address >> 1] >> (8 * (address & 0x01)));
+   }
+   else
+   {
+      return 0x00;
+   }
+}
+
+/********************************************************************************
+* program_memory_load: Replaces the content of the program memory with the
+*                      specified instructions, which are stored from address 0
+*                      and onwards. Remaining addresses are filled with NOP.
+*                      The loaded program is kept at system reset, while all
+*                      breakpoints and watchpoints are removed, since they
+*                      refer to the previous program. Returns 0 after
+*                      successful load or error code 1 if the program doesn't
+*                      fit in the program memory or memory ran out.
+*
+*                      - instructions    : Reference to the instructions.
+*                      - num_instructions: The number of instructions to load.
+********************************************************************************/
+int program_memory_load(const uint32_t* instructions,
+                        const size_t num_instructions)
+{
+   uint32_t padded[PROGRAM_MEMORY_ADDRESS_WIDTH];
+   struct program_image* loaded = 0;
+   if (num_instructions > PROGRAM_MEMORY_ADDRESS_WIDTH) return 1;
+
+   for (size_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      padded[i] = i < num_instructions ? instructions[i] : assemble(NOP, 0x00, 0x00);
+   }
+
+   loaded = program_image_create(padded, 0);
+   if (!loaded) return 1;
+
+   breakpoint_clear_all();
+   set_image(loaded);
+   return 0;
+}
+
+/********************************************************************************
+* program_memory_load_raw: Replaces the bytes read by the LPM instruction with
+*                          specified instruction words, for instance the
+*                          original image of a decoded AVR program. Returns 0
+*                          after successful load or error code 1 if the words
+*                          don't fit in the program memory or memory ran out.
+*
+*                          - words    : Reference to the instruction words.
+*                          - num_words: The number of instruction words.
+********************************************************************************/
+int program_memory_load_raw(const uint16_t* words,
+                            const size_t num_words)
+{
+   struct program_image* copy = 0;
+   if (num_words > PROGRAM_MEMORY_ADDRESS_WIDTH) return 1;
+
+   program_memory_write();
+   copy = copy_image();
+   if (!copy) return 1;
+
+   for (size_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      copy->raw[i] = i < num_words ? words[i] : 0x0000;
+   }
+
+   set_image(copy);
+   return 0;
+}
+
+/********************************************************************************
+* program_memory_changed_range: Stores the addresses changed by the last
+*                               change of the program memory, if it only
+*                               replaced instructions of the previous image,
+*                               like program_memory_replace and
+*                               program_memory_patch. Returns false if a
+*                               whole program was stored instead, in which
+*                               case nothing is stored.
+*
+*                               - first: Reference to the first changed address.
+*                               - count: Reference to the number of changed addresses.
+********************************************************************************/
+bool program_memory_changed_range(uint8_t* first,
+                                  uint16_t* count)
+{
+   if (!changed_count) return false;
+   *first = changed_first;
+   *count = changed_count;
+   return true;
+}
+
+/********************************************************************************
+* program_memory_builtin: Indicates if the built-in program is stored in
+*                         program memory, i.e. if no program has been loaded.
+********************************************************************************/
+bool program_memory_builtin(void)
+{
+   return !image || image->builtin;
+}
+
+/********************************************************************************
+* program_memory_hash: Returns a 32-bit hash of the program stored in program
+*                      memory, computed from the instructions as they were
+*                      before any breakpoint was inserted and from the bytes
+*                      read by LPM, which together decide how the program
+*                      runs. The hash is computed once per image and cached
+*                      on it, and an image that only differs by inserted
+*                      breakpoints keeps the hash of the image it was copied
+*                      from.
+********************************************************************************/
+uint32_t program_memory_hash(void)
+{
+   struct program_image* self = (struct program_image*)program_memory_image();
+   uint32_t result = atomic_load_explicit(&self->hash, memory_order_relaxed);
+   uint64_t hash = 0xCBF29CE484222325ull;
+   if (result) return result;
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      const uint32_t instruction = breakpoint_instruction((uint8_t)i);
+      hash = fnv1a(hash, (uint8_t)(instruction >> 16));
+      hash = fnv1a(hash, (uint8_t)(instruction >> 8));
+      hash = fnv1a(hash, (uint8_t)instruction);
+   }
+
+   for (uint16_t i = 0; i < 2 * PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      hash = fnv1a(hash, program_memory_read_byte(i));
+   }
+
+   result = (uint32_t)(hash ^ (hash >> 32));
+   if (!result) result = 1; /* 0 marks a hash that isn't computed. */
+   atomic_store_explicit(&self->hash, result, memory_order_relaxed);
+   return result;
+}
+
+/********************************************************************************
+* program_memory_generation: Returns a counter which is incremented every time
+*                            instructions in program memory are changed. Used
+*                            to detect when instructions cached elsewhere,
+*                            for instance in decoded form, are outdated.
+********************************************************************************/
+uint32_t program_memory_generation(void)
+{
+   return generation;
+}
+
+/********************************************************************************
+* program_memory_subroutine_name: Returns the name of the subroutine at
+*                                 specified address.
+*
+*                                 - address: Address within the subroutine.
+********************************************************************************/
+const char* program_memory_subroutine_name(const uint8_t address)
+{
+   if (!program_memory_builtin()) return "Unknown";
+   else if (address < PCINT0_vect) return "RESET_vect";
+   else if (address >= PCINT0_vect && address < ISR_PCINT0) return "PCINT0_vect";
+   else if (address >= ISR_PCINT0 && address < main) return "ISR_PCINT0";
+   else if (address >= main && address < setup) return "main";
+   else if (address >= setup && address < led_toggle) return "setup";
+   else if (address >= led_toggle && address < led_on) return "led_toggle";
+   else if (address >= led_on && address < led_off) return "led_on";
+   else if (address >= led_off && address < end) return "led_off";
+   else return "Unknown";
+}
+
+/********************************************************************************
+* program_memory_image: Returns the image stored in program memory, after
+*                       writing the built-in program if no program has been
+*                       stored. The image stays valid until program memory
+*                       is changed, unless a reference is retained by
+*                       program_image_retain, for instance to run the same
+*                       program on other threads.
+********************************************************************************/
+const struct program_image* program_memory_image(void)
+{
+   program_memory_write();
+   return image;
+}
+
+/********************************************************************************
+* program_memory_set_image: Stores referenced image in program memory, where
+*                           it's shared with every other holder of the image.
+*                           A reference to the image is retained until
+*                           program memory is changed again.
+*
+*                           - self: Reference to the image.
+********************************************************************************/
+void program_memory_set_image(const struct program_image* self)
+{
+   set_image(program_image_retain(self));
+   return;
+}
+
+/********************************************************************************
+* program_memory_release: Releases the image stored in program memory. The
+*                         program memory is empty until a program is stored
+*                         again, or the built-in program is written.
+********************************************************************************/
+void program_memory_release(void)
+{
+   program_image_release(image);
+   image = 0;
+   generation++;
+   changed_count = 0;
+   return;
+}
+
+/********************************************************************************
+* program_image_builtin: Returns the image of the built-in program, which is
+*                        never freed and doesn't need to be retained.
+********************************************************************************/
+const struct program_image* program_image_builtin(void)
+{
+   call_once(&builtin_once, write_builtin_image);
+   return &builtin_image;
+}
+
+/********************************************************************************
+* program_image_create: Creates an image of specified instructions with a
+*                       single reference. Returns a reference to the image or
+*                       0 if memory ran out.
+*
+*                       - instructions: Reference to the instructions, one
+*                                       per program memory address.
+*                       - raw         : Reference to the words read by the
+*                                       LPM instruction, or 0 to read the
+*                                       operands of the instructions.
+********************************************************************************/
+struct program_image* program_image_create(const uint32_t* instructions,
+                                           const uint16_t* raw)
+{
+   struct program_image* self = (struct program_image*)malloc(sizeof(struct program_image));
+   if (!self) return 0;
+
+   atomic_init(&self->references, 1);
+   atomic_init(&self->decoded, 0);
+   atomic_init(&self->hash, 0);
+   self->builtin = false;
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      self->instructions[i] = instructions[i];
+      self->raw[i] = raw ? raw[i] : (uint16_t)instructions[i];
+   }
+   return self;
+}
+
+/********************************************************************************
+* program_image_retain: Adds a reference to referenced image and returns it.
+*
+*                       - self: Reference to the image.
+********************************************************************************/
+const struct program_image* program_image_retain(const struct program_image* self)
+{
+   atomic_fetch_add_explicit(&((struct program_image*)self)->references, 1, memory_order_relaxed);
+   return self;
+}
+
+/********************************************************************************
+* program_image_release: Releases a reference to referenced image, which is
+*                        freed together with its decoded instructions when
+*                        the last reference is released.
+*
+*                        - self: Reference to the image, or 0.
+********************************************************************************/
+void program_image_release(const struct program_image* self)
+{
+   struct program_image* image = (struct program_image*)self;
+   if (!image || atomic_fetch_sub_explicit(&image->references, 1, memory_order_acq_rel) != 1) return;
+
+   free(atomic_load_explicit(&image->decoded, memory_order_acquire));
+   free(image);
+   return;
+}
+
+/********************************************************************************
+* program_image_decoded: Returns the decoded instructions attached to
+*                        referenced image, or 0 if none are attached yet.
+*
+*                        - self: Reference to the image.
+********************************************************************************/
+void* program_image_decoded(const struct program_image* self)
+{
+   return atomic_load_explicit(&((struct program_image*)self)->decoded, memory_order_acquire);
+}
+
+/********************************************************************************
+* program_image_attach_decoded: Attaches decoded instructions, allocated by
+*                               malloc, to referenced image, which frees them
+*                               with the image. If another thread attached
+*                               its decoded instructions first, specified
+*                               instructions are freed instead. Returns the
+*                               decoded instructions attached to the image.
+*
+*                               - self   : Reference to the image.
+*                               - decoded: The decoded instructions.
+********************************************************************************/
+void* program_image_attach_decoded(const struct program_image* self,
+                                   void* decoded)
+{
+   void* attached = 0;
+
+   if (atomic_compare_exchange_strong_explicit(&((struct program_image*)self)->decoded, &attached, decoded,
+                                               memory_order_acq_rel, memory_order_acquire))
+   {
+      return decoded;
+   }
+
+   free(decoded);
+   return attached;
+}
+
+/********************************************************************************
+* write_builtin_image: Writes the built-in program to its image, which is
+*                      shared by every thread that doesn't load a program.
+********************************************************************************/
+static void write_builtin_image(void)
+{
+   uint32_t* data = builtin_image.instructions;
+
+   /********************************************************************************
+   * RESET_vect: Reset vector and start address for the program. A jump is made 
+   *             to the main subroutine in order to start the program.
+   ********************************************************************************/
+   data[RESET_vect]     = assemble(JMP, main, 0x00);    /* JMP main */
+   data[RESET_vect + 1] = assemble(NOP, 0x00, 0x00);    /* NOP */
+
+   /********************************************************************************
+   * PCINT0_vect: Interrupt vector for pin change interrupt at I/O-port B.
+   *              Corresponding interrupt routine is executed to handle 
+   *              the interrupt.
+   ********************************************************************************/
+   data[PCINT0_vect]     = assemble(JMP, ISR_PCINT0, 0x00); /* JMP ISR_PCINT0 */
+   data[PCINT0_vect + 1] = assemble(NOP, 0x00, 0x00);       /* NOP */
+
+   /********************************************************************************
+   * ISR_PCINT0: Interrupt routine for pin change interrupt at I/O-port B.
+   *             LED1 is toggled if BUTTON1 is pressed.
+   ********************************************************************************/
+   data[ISR_PCINT0]     = assemble(IN, R24, PINB);              /* IN R24, PINB */
+   data[ISR_PCINT0 + 1] = assemble(ANDI, R24, (1 << BUTTON1));  /* CPI R24, 0x00 */
+   data[ISR_PCINT0 + 2] = assemble(BREQ, ISR_PCINT0_end, 0x00); /* BREQ ISR_PCINT0_end */
+   data[ISR_PCINT0 + 3] = assemble(CALL, led_toggle, 0x00);     /* CALL led_toggle */
+   data[ISR_PCINT0_end] = assemble(RETI, 0x00, 0x00);           /* RETI */
+
+   /********************************************************************************
+   * main: Initiates the system at start. A loop is then generated to keep the
+   *       program running continuously.
+   ********************************************************************************/
+   data[main]      = assemble(CALL, setup, 0x00); /* CALL setup */
+   data[main_loop] = assemble(JMP, main_loop, 0); /* JMP main_loop */
+
+   /********************************************************************************
+   * setup: Initiates I/O-ports (sets LED1 to output, enables the internal pull-up
+   *        resistor for BUTTON1) and enables pin change interrupt at BUTTON1. 
+   ********************************************************************************/
+   data[setup]     = assemble(LDI, R16, (1 << LED1));    /* LDI, R16, (1 << LED1) */
+   data[setup + 1] = assemble(OUT, DDRB, R16);           /* OUT DDRB, R16 */
+   data[setup + 2] = assemble(LDI, R16, (1 << BUTTON1)); /* LDI R16, (1 << BUTTON1) */
+   data[setup + 3] = assemble(OUT, PORTB, R16);          /* OUT PORTB, R16 */
+   data[setup + 4] = assemble(SEI, 0x00, 0x00);          /* SEI */
+   data[setup + 5] = assemble(LDI, R16, (1 << PCIE0));   /* LDI R16, (1 << PCIE0) */
+   data[setup + 6] = assemble(STS, PCICR, R16);          /* STS PCICR, R16 */
+   data[setup + 7] = assemble(LDI, R16, (1 << BUTTON1)); /* LDI R16, (1 << BUTTON1) */
+   data[setup + 8] = assemble(STS, PCMSK0, R16);         /* STS PCMSK0, R16 */
+   data[setup + 9] = assemble(RET, 0x00, 0x00);          /* RET */
+
+   /********************************************************************************
+   * led_toggle: Toggles LED1.
+   ********************************************************************************/
+   data[led_toggle]     = assemble(LDS, R16, led_enabled); /* LDS R16, led_enabled */
+   data[led_toggle + 1] = assemble(CPI, R16, 0x00);        /* CPI R16, 0x00 */
+   data[led_toggle + 2] = assemble(BREQ, led_on, 0x00);    /* BREQ led_on */
+   data[led_toggle + 3] = assemble(JMP, led_off, 0x00);    /* JMP led_off */
+   data[led_toggle + 4] = assemble(RET, 0x00, 0x00);       /* RET */
+
+   /********************************************************************************
+   * led_on: Enables LED1 and stores current state in data memory.
+   ********************************************************************************/
+   data[led_on]     = assemble(IN, R16, PORTB);            /* IN R16, PORTB */
+   data[led_on + 1] = assemble(ORI, R16, (1 << LED1));     /* ORI R16, (1 << LED1) */
+   data[led_on + 2] = assemble(OUT, PORTB, R16);           /* OUT PORTB, R16 */
+   data[led_on + 3] = assemble(LDI, R16, 0x01);            /* LDI R16, 0x01 */
+   data[led_on + 4] = assemble(STS, led_enabled, R16);     /* STS led_enabled, R16 */
+   data[led_on + 5] = assemble(JMP, led_toggle_end, 0x00); /* JMP led_toggle_end */
+
+   /********************************************************************************
+   * led_off: Disables LED1 and stores current state in data memory.
+   ********************************************************************************/
+   data[led_off]     = assemble(IN, R16, PORTB);            /* IN R16, PORTB */
+   data[led_off + 1] = assemble(ANDI, R16, ~(1 << LED1));   /* ANDI R16, ~(1 << LED1) */
+   data[led_off + 2] = assemble(OUT, PORTB, R16);           /* OUT PORTB, R16 */
+   data[led_off + 3] = assemble(LDI, R16, 0x00);            /* LDI R16, 0x01 */
+   data[led_off + 4] = assemble(STS, led_enabled, R16);     /* STS led_enabled, R16 */
+   data[led_off + 5] = assemble(JMP, led_toggle_end, 0x00); /* JMP led_toggle_end */
+
+   for (size_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      builtin_image.raw[i] = (uint16_t)data[i];
+   }
+
+   builtin_image.builtin = true;
+   return;
+}
+
+static struct program_image* copy_image(void)
+{
+   const struct program_image* source = program_memory_image();
+   struct program_image* copy = program_image_create(source->instructions, source->raw);
+   if (copy) copy->builtin = source->builtin;
+   return copy;
+}
+
+static void set_image(const struct program_image* self)
+{
+   const struct program_image* previous = image;
+   image = self;
+   program_image_release(previous);
+   generation++;
+   changed_count = 0;
+   return;
+}
+
+static inline uint32_t assemble(const uint8_t op_code,
+                                const uint8_t op1,
+                                const uint8_t op2)
+{
+   uint32_t instruction = op_code << 16;
+   instruction |= op1 << 8;
+   instruction |= op2;
+   return instruction;
+}
+
+static inline uint64_t fnv1a(uint64_t hash,
+                             const uint8_t byte)
+{
+   return (hash ^ byte) * 0x100000001B3ull;
+}
\ No newline at end of file
@@ -1,33 +1,264 @@
-#ifndef PROGRAM_MEMORY_H_
-#define PROGRAM_MEMORY_
-
-#include "cpu.h"
-
-#define PROGRAM_MEMORY_ADDRESS_WIDTH 256
-#define PROGRAM_MEMORY_DATA_WIDTH    32
-
-/********************************************************************************
-* program_memory_writes: Writes instructions to program memory. This function
-*                        should be called once when the program starts.
-********************************************************************************/
-void program_memory_write(void);
-
-/********************************************************************************
-* program_memory_read: Returns the instruction at specified address. If an
-*                      invalid address is specified (should be impossible as
-*                      long as the program memory address width isn't increased)
-*                      no operation (0x00) is returned.
-* 
-*                      - address: Address to instruction in program memory.
-********************************************************************************/
-uint32_t program_memory_read(const uint8_t address);
-
-/********************************************************************************
-* program_memory_subroutine_name: Returns the name of the subroutine at
-*                                 specified address.
-* 
-*                                 - address: Address within the subroutine.
-********************************************************************************/
-const char* program_memory_subroutine_name(const uint8_t address);
-
-#endif /* PROGRAM_MEMORY_ */
\ No newline at end of file
+#ifndef PROGRAM_MEMORY_H_
+#define PROGRAM_MEMORY_H_
+
+#include <stdatomic.h>
+#include "cpu.h"
+
+#define PROGRAM_MEMORY_ADDRESS_WIDTH 256
+#define PROGRAM_MEMORY_DATA_WIDTH    32
+
+#define LED1    0   /* Pin of the led at PORTB in the built-in program. */
+#define BUTTON1 5   /* Pin of the button at PORTB in the built-in program. */
+
+#define led_enabled 100 /* Data memory address of the led state in the built-in program. */
+
+/********************************************************************************
+* program_image: Immutable content of the program memory, which is shared by
+*                every instance of the system that runs the same program, so
+*                that a program is stored once however many instances run it.
+*                The image is reference counted and freed when the last
+*                reference is released. Program memory is never changed in
+*                place; a change, for instance an inserted breakpoint, stores
+*                a changed copy of the image. The decoded instructions of the
+*                fast engine are attached to the image by the first control
+*                unit that runs it and shared with every other.
+********************************************************************************/
+struct program_image
+{
+   atomic_uint references;                              /* Number of references to the image. */
+   bool builtin;                                        /* Indicates if the image is the built-in program. */
+   uint32_t instructions[PROGRAM_MEMORY_ADDRESS_WIDTH]; /* The instructions. */
+   uint16_t raw[PROGRAM_MEMORY_ADDRESS_WIDTH];          /* Words read by the LPM instruction. */
+   _Atomic(void*) decoded;                              /* Decoded instructions, or 0. */
+   atomic_uint hash;                                    /* Hash of the program, or 0 if not computed yet. */
+};
+
+/********************************************************************************
+* program_memory_writes: Writes instructions to program memory. This function
+*                        should be called once when the program starts.
+********************************************************************************/
+void program_memory_write(void);
+
+/********************************************************************************
+* program_memory_read: Returns the instruction at specified address. If an
+*                      invalid address is specified (should be impossible as
+*                      long as the program memory address width isn't increased)
+*                      no operation (0x00) is returned.
+* 
+*                      - address: Address to instruction in program memory.
+********************************************************************************/
+uint32_t program_memory_read(const uint8_t address);
+
+/********************************************************************************
+* program_memory_replace: Replaces the instruction at specified address and
+*                         returns the previous instruction. The bytes read
+*                         by the LPM instruction are not affected. Since the
+*                         image may be shared, the instruction is replaced
+*                         in a copy of it. If an invalid address is
+*                         specified or memory ran out, nothing is replaced
+*                         and NOP (0x00) is returned.
+*
+*                         - address    : Address to instruction in program memory.
+*                         - instruction: The new instruction.
+********************************************************************************/
+uint32_t program_memory_replace(const uint8_t address,
+                                const uint32_t instruction);
+
+/********************************************************************************
+* program_memory_patch: Replaces specified number of instructions from
+*                       specified address and onwards in a single change of
+*                       the program memory, without resetting the system.
+*                       Since the image may be shared, the instructions are
+*                       replaced in a copy of it. Returns 0 after success or
+*                       error code 1 if the instructions don't fit in the
+*                       program memory or memory ran out.
+*
+*                       - address         : Address of the first instruction.
+*                       - instructions    : Reference to the new instructions.
+*                       - raw             : Reference to the new words read by
+*                                           the LPM instruction, or 0 to read
+*                                           the operands of the instructions.
+*                       - num_instructions: The number of instructions.
+********************************************************************************/
+int program_memory_patch(const uint8_t address,
+                         const uint32_t* instructions,
+                         const uint16_t* raw,
+                         const size_t num_instructions);
+
+/********************************************************************************
+* program_memory_read_byte: Returns the byte at specified byte address, as read
+*                           by the LPM instruction. Each program memory address
+*                           holds two bytes, where the low byte is stored at
+*                           the even byte address. For programs assembled in
+*                           the simulator's own format, these are the two
+*                           operands of the instruction (op2 and op1). If an
+*                           invalid address is specified, 0x00 is returned.
+*
+*                           - address: Byte address in program memory.
+********************************************************************************/
+uint8_t program_memory_read_byte(const uint16_t address);
+
+/********************************************************************************
+* program_memory_load: Replaces the content of the program memory with the
+*                      specified instructions, which are stored from address 0
+*                      and onwards. Remaining addresses are filled with NOP.
+*                      The loaded program is kept at system reset, while all
+*                      breakpoints and watchpoints are removed, since they
+*                      refer to the previous program. Returns 0 after
+*                      successful load or error code 1 if the program doesn't
+*                      fit in the program memory or memory ran out.
+*
+*                      - instructions    : Reference to the instructions.
+*                      - num_instructions: The number of instructions to load.
+********************************************************************************/
+int program_memory_load(const uint32_t* instructions,
+                        const size_t num_instructions);
+
+/********************************************************************************
+* program_memory_load_raw: Replaces the bytes read by the LPM instruction with
+*                          specified instruction words, for instance the
+*                          original image of a decoded AVR program. Returns 0
+*                          after successful load or error code 1 if the words
+*                          don't fit in the program memory or memory ran out.
+*
+*                          - words    : Reference to the instruction words.
+*                          - num_words: The number of instruction words.
+********************************************************************************/
+int program_memory_load_raw(const uint16_t* words,
+                            const size_t num_words);
+
+/********************************************************************************
+* program_memory_generation: Returns a counter which is incremented every time
+*                            instructions in program memory are changed. Used
+*                            to detect when instructions cached elsewhere,
+*                            for instance in decoded form, are outdated.
+********************************************************************************/
+uint32_t program_memory_generation(void);
+
+/********************************************************************************
+* program_memory_changed_range: Stores the addresses changed by the last
+*                               change of the program memory, if it only
+*                               replaced instructions of the previous image,
+*                               like program_memory_replace and
+*                               program_memory_patch. Returns false if a
+*                               whole program was stored instead, in which
+*                               case nothing is stored.
+*
+*                               - first: Reference to the first changed address.
+*                               - count: Reference to the number of changed addresses.
+********************************************************************************/
+bool program_memory_changed_range(uint8_t* first,
+                                  uint16_t* count);
+
+/********************************************************************************
+* program_memory_builtin: Indicates if the built-in program is stored in
+*                         program memory, i.e. if no program has been loaded.
+********************************************************************************/
+bool program_memory_builtin(void);
+
+/********************************************************************************
+* program_memory_hash: Returns a 32-bit hash of the program stored in program
+*                      memory, computed from the instructions as they were
+*                      before any breakpoint was inserted and from the bytes
+*                      read by LPM, which together decide how the program
+*                      runs. The hash is computed once per image and cached
+*                      on it, and an image that only differs by inserted
+*                      breakpoints keeps the hash of the image it was copied
+*                      from.
+********************************************************************************/
+uint32_t program_memory_hash(void);
+
+/********************************************************************************
+* program_memory_subroutine_name: Returns the name of the subroutine at
+*                                 specified address.
+* 
+*                                 - address: Address within the subroutine.
+********************************************************************************/
+const char* program_memory_subroutine_name(const uint8_t address);
+
+/********************************************************************************
+* program_memory_image: Returns the image stored in program memory, after
+*                       writing the built-in program if no program has been
+*                       stored. The image stays valid until program memory
+*                       is changed, unless a reference is retained by
+*                       program_image_retain, for instance to run the same
+*                       program on other threads.
+********************************************************************************/
+const struct program_image* program_memory_image(void);
+
+/********************************************************************************
+* program_memory_set_image: Stores referenced image in program memory, where
+*                           it's shared with every other holder of the image.
+*                           A reference to the image is retained until
+*                           program memory is changed again.
+*
+*                           - self: Reference to the image.
+********************************************************************************/
+void program_memory_set_image(const struct program_image* self);
+
+/********************************************************************************
+* program_memory_release: Releases the image stored in program memory. The
+*                         program memory is empty until a program is stored
+*                         again, or the built-in program is written.
+********************************************************************************/
+void program_memory_release(void);
+
+/********************************************************************************
+* program_image_builtin: Returns the image of the built-in program, which is
+*                        never freed and doesn't need to be retained.
+********************************************************************************/
+const struct program_image* program_image_builtin(void);
+
+/********************************************************************************
+* program_image_create: Creates an image of specified instructions with a
+*                       single reference. Returns a reference to the image or
+*                       0 if memory ran out.
+*
+*                       - instructions: Reference to the instructions, one
+*                                       per program memory address.
+*                       - raw         : Reference to the words read by the
+*                                       LPM instruction, or 0 to read the
+*                                       operands of the instructions.
+********************************************************************************/
+struct program_image* program_image_create(const uint32_t* instructions,
+                                           const uint16_t* raw);
+
+/********************************************************************************
+* program_image_retain: Adds a reference to referenced image and returns it.
+*
+*                       - self: Reference to the image.
+********************************************************************************/
+const struct program_image* program_image_retain(const struct program_image* self);
+
+/********************************************************************************
+* program_image_release: Releases a reference to referenced image, which is
+*                        freed together with its decoded instructions when
+*                        the last reference is released.
+*
+*                        - self: Reference to the image, or 0.
+********************************************************************************/
+void program_image_release(const struct program_image* self);
+
+/********************************************************************************
+* program_image_decoded: Returns the decoded instructions attached to
+*                        referenced image, or 0 if none are attached yet.
+*
+*                        - self: Reference to the image.
+********************************************************************************/
+void* program_image_decoded(const struct program_image* self);
+
+/********************************************************************************
+* program_image_attach_decoded: Attaches decoded instructions, allocated by
+*                               malloc, to referenced image, which frees them
+*                               with the image. If another thread attached
+*                               its decoded instructions first, specified
+*                               instructions are freed instead. Returns the
+*                               decoded instructions attached to the image.
+*
+*                               - self   : Reference to the image.
+*                               - decoded: The decoded instructions.
+********************************************************************************/
+void* program_image_attach_decoded(const struct program_image* self,
+                                   void* decoded);
+
+#endif /* PROGRAM_MEMORY_H_ */
\ No newline at end of file
@@ -0,0 +1,203 @@
+/********************************************************************************
+* realtime.c: Contains functionality for running the simulation paced to a
+*             real clock rate in wall-clock time.
+********************************************************************************/
+#include <string.h>
+#include <time.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+#include "realtime.h"
+
+/********************************************************************************
+* pin_input: Pin input passed through the queue.
+********************************************************************************/
+struct pin_input
+{
+   uint8_t address; /* Address of the pin input register. */
+   uint8_t value;   /* The value to write. */
+};
+
+static struct pin_input queue[REALTIME_QUEUE_SIZE];
+static atomic_uint queue_head; /* Next index to write, only changed by the producer. */
+static atomic_uint queue_tail; /* Next index to read, only changed by the consumer. */
+static atomic_bool stop_requested;
+static atomic_llong lag_ns;    /* Lag before the last batch in nanoseconds. */
+
+static uint32_t apply_inputs(void);
+static void wait_until(const double time);
+
+/********************************************************************************
+* realtime_queue_push: Queues a write of specified value to specified pin
+*                      input register, applied before the next batch. Must
+*                      only be called from one thread at a time. Returns 0
+*                      after success or error code 1 if the queue is full or
+*                      the address doesn't belong to a pin input register.
+*
+*                      - address: Address of PINB, PINC or PIND.
+*                      - value  : The value to write.
+********************************************************************************/
+int realtime_queue_push(const uint8_t address,
+                        const uint8_t value)
+{
+   const unsigned int head = atomic_load_explicit(&queue_head, memory_order_relaxed);
+   const unsigned int tail = atomic_load_explicit(&queue_tail, memory_order_acquire);
+
+   if (address != PINB && address != PINC && address != PIND) return 1;
+   if (head - tail >= REALTIME_QUEUE_SIZE) return 1;
+
+   queue[head & (REALTIME_QUEUE_SIZE - 1)].address = address;
+   queue[head & (REALTIME_QUEUE_SIZE - 1)].value = value;
+   atomic_store_explicit(&queue_head, head + 1, memory_order_release);
+   return 0;
+}
+
+/********************************************************************************
+* realtime_request_stop: Stops a paced run after the current batch. Can be
+*                        called from any thread.
+********************************************************************************/
+void realtime_request_stop(void)
+{
+   atomic_store(&stop_requested, true);
+   return;
+}
+
+/********************************************************************************
+* realtime_lag: Returns how many seconds the simulation was behind the clock
+*               before the last batch, or a negative number if it was ahead.
+*               Can be called from any thread.
+********************************************************************************/
+double realtime_lag(void)
+{
+   return atomic_load(&lag_ns) / 1e9;
+}
+
+/********************************************************************************
+* realtime_run: Runs the system paced to the clock rate of specified
+*               parameters until the duration has passed or a stop is
+*               requested, and stores the result at referenced location.
+*               Queued pin inputs are written by input_log_write_pin, so
+*               they are recorded if recording. Returns 0 after success
+*               or error code 1 if the parameters are invalid.
+*
+*               - config: Reference to the parameters.
+*               - report: Reference to the report of the run.
+********************************************************************************/
+int realtime_run(const struct realtime_config* config,
+                 struct realtime_report* report)
+{
+   const double start = cpu_seconds_now();
+   const uint64_t start_cycles = control_unit_cycles();
+   double base_time = start;
+   uint64_t base_cycles = start_cycles;
+   double busy = 0.0;
+   double waited = 0.0;
+   uint64_t num_batches = 0;
+
+   memset(report, 0, sizeof(*report));
+   if (!config->rate || !config->batch_cycles) return 1;
+   atomic_store(&lag_ns, 0);
+
+   while (!atomic_load(&stop_requested))
+   {
+      const double due = base_time + (double)(control_unit_cycles() - base_cycles) / config->rate;
+      const double now = cpu_seconds_now();
+      const double lag = now - due;
+      atomic_store(&lag_ns, (long long)(lag * 1e9));
+
+      if (config->duration > 0 && now - start >= config->duration) break;
+
+      if (lag > REALTIME_MAX_LAG)
+      {
+         base_time = now; /* Restarts the pacing instead of catching up. */
+         base_cycles = control_unit_cycles();
+         report->num_resyncs++;
+      }
+      else if (lag < 0)
+      {
+         wait_until(due);
+         waited -= lag;
+      }
+
+      if (lag > report->max_lag) report->max_lag = lag;
+      report->num_inputs += apply_inputs();
+
+      const double batch_start = cpu_seconds_now();
+      const bool reached = control_unit_run_until(control_unit_cycles() + config->batch_cycles);
+      busy += cpu_seconds_now() - batch_start;
+      num_batches++;
+      if (!reached) break; /* Stopped, for instance by a breakpoint. */
+   }
+
+   report->num_inputs += apply_inputs();
+   atomic_store(&stop_requested, false);
+   report->cycles = control_unit_cycles() - start_cycles;
+   report->seconds = cpu_seconds_now() - start;
+   report->mean_lead = num_batches ? waited / num_batches : 0.0;
+   report->load = report->seconds > 0 ? busy / report->seconds : 0.0;
+   return 0;
+}
+
+/********************************************************************************
+* realtime_print_report: Prints specified report.
+*
+*                        - report: Reference to the report.
+********************************************************************************/
+void realtime_print_report(const struct realtime_report* report)
+{
+   printf("Ran %llu cycles in %.2f seconds (%.3f MHz).\n", (unsigned long long)report->cycles,
+          report->seconds, report->seconds > 0 ? report->cycles / report->seconds / 1e6 : 0.0);
+   printf("Applied %u pin inputs.\n", report->num_inputs);
+   printf("Largest lag %.3f ms, mean lead %.3f ms, simulating %.1f %% of the time.\n",
+          report->max_lag * 1e3, report->mean_lead * 1e3, report->load * 100.0);
+
+   if (report->num_resyncs)
+   {
+      printf("Fell behind the clock %u times!\n", report->num_resyncs);
+   }
+
+   printf("\n");
+   return;
+}
+
+/********************************************************************************
+* apply_inputs: Writes all queued pin inputs and returns their number.
+********************************************************************************/
+static uint32_t apply_inputs(void)
+{
+   const unsigned int head = atomic_load_explicit(&queue_head, memory_order_acquire);
+   unsigned int tail = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+   uint32_t num_inputs = 0;
+
+   while (tail != head)
+   {
+      const struct pin_input* input = &queue[tail & (REALTIME_QUEUE_SIZE - 1)];
+      input_log_write_pin(input->address, input->value);
+      tail++;
+      num_inputs++;
+   }
+
+   atomic_store_explicit(&queue_tail, tail, memory_order_release);
+   return num_inputs;
+}
+
+/********************************************************************************
+* wait_until: Sleeps until shortly before specified time and spins for the
+*             rest of the wait, since sleeps are only accurate to a fraction
+*             of a millisecond.
+*
+*             - time: The time to wait for, see cpu_seconds_now.
+********************************************************************************/
+static void wait_until(const double time)
+{
+   const double sleep_time = time - cpu_seconds_now() - REALTIME_SPIN_TIME;
+
+   if (sleep_time > 0)
+   {
+      const struct timespec duration = { (time_t)sleep_time, (long)((sleep_time - (time_t)sleep_time) * 1e9) };
+      thrd_sleep(&duration, 0);
+   }
+
+   while (cpu_seconds_now() < time);
+   return;
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+/********************************************************************************
+* realtime.h: Contains functionality for running the simulation paced to a
+*             real clock rate in wall-clock time, for instance 16 MHz, so
+*             that it can interact with external stand-ins for hardware.
+*
+*             The simulation runs in batches of clock cycles on the thread
+*             owning the system. After each batch, the thread sleeps, and
+*             spins for the last part of the wait, until the wall-clock time
+*             of the next batch. If the simulation falls behind, it runs the
+*             next batch at once, and if it falls further behind than a
+*             limit, the pacing is restarted instead of catching up in a
+*             burst. The current lag can be read from any thread.
+*
+*             Pin inputs from other threads are passed through a lock-free
+*             single producer, single consumer queue and applied between
+*             batches, so the simulation never waits for input.
+********************************************************************************/
+#ifndef REALTIME_H_
+#define REALTIME_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "control_unit.h"
+#include "input_log.h"
+
+#define REALTIME_DEFAULT_RATE  16000000 /* Default clock rate in Hz. */
+#define REALTIME_DEFAULT_BATCH 16000    /* Default clock cycles per batch (1 ms at 16 MHz). */
+#define REALTIME_QUEUE_SIZE    256      /* Capacity of the input queue, a power of two. */
+#define REALTIME_MAX_LAG       0.1      /* Seconds behind before the pacing is restarted. */
+#define REALTIME_SPIN_TIME     0.0002   /* Seconds spun at the end of every wait. */
+
+/********************************************************************************
+* realtime_config: Parameters of a paced run.
+********************************************************************************/
+struct realtime_config
+{
+   uint64_t rate;         /* Clock rate in Hz. */
+   uint32_t batch_cycles; /* Clock cycles per batch. */
+   double duration;       /* Seconds to run, or 0 to run until stopped. */
+};
+
+/********************************************************************************
+* realtime_report: Result of a paced run.
+********************************************************************************/
+struct realtime_report
+{
+   uint64_t cycles;      /* Clock cycles run. */
+   double seconds;       /* Wall-clock duration. */
+   uint32_t num_inputs;  /* Number of pin inputs applied. */
+   uint32_t num_resyncs; /* Number of times the pacing was restarted. */
+   double max_lag;       /* Largest lag in seconds behind the clock. */
+   double mean_lead;     /* Mean time in seconds waited before a batch. */
+   double load;          /* Fraction of the time spent simulating. */
+};
+
+/********************************************************************************
+* realtime_queue_push: Queues a write of specified value to specified pin
+*                      input register, applied before the next batch. Must
+*                      only be called from one thread at a time. Returns 0
+*                      after success or error code 1 if the queue is full or
+*                      the address doesn't belong to a pin input register.
+*
+*                      - address: Address of PINB, PINC or PIND.
+*                      - value  : The value to write.
+********************************************************************************/
+int realtime_queue_push(const uint8_t address,
+                        const uint8_t value);
+
+/********************************************************************************
+* realtime_request_stop: Stops a paced run after the current batch. Can be
+*                        called from any thread.
+********************************************************************************/
+void realtime_request_stop(void);
+
+/********************************************************************************
+* realtime_lag: Returns how many seconds the simulation was behind the clock
+*               before the last batch, or a negative number if it was ahead.
+*               Can be called from any thread.
+********************************************************************************/
+double realtime_lag(void);
+
+/********************************************************************************
+* realtime_run: Runs the system paced to the clock rate of specified
+*               parameters until the duration has passed or a stop is
+*               requested, and stores the result at referenced location.
+*               Queued pin inputs are written by input_log_write_pin, so
+*               they are recorded if recording. Returns 0 after success
+*               or error code 1 if the parameters are invalid.
+*
+*               - config: Reference to the parameters.
+*               - report: Reference to the report of the run.
+********************************************************************************/
+int realtime_run(const struct realtime_config* config,
+                 struct realtime_report* report);
+
+/********************************************************************************
+* realtime_print_report: Prints specified report.
+*
+*                        - report: Reference to the report.
+********************************************************************************/
+void realtime_print_report(const struct realtime_report* report);
+
+#endif /* REALTIME_H_ */
\ No newline at end of file
@@ -0,0 +1,303 @@
+/********************************************************************************
+* shared_state.c: Contains functionality for publishing the state of the
+*                 system to a shared memory segment.
+********************************************************************************/
+#include <string.h>
+#include <time.h>
+#include <threads.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "shared_state.h"
+
+#define MONITOR_PERIOD_NS 100000000 /* Time between reads by the monitor. */
+
+static struct shared_state_block* block = 0;
+static char segment_name[256];
+static uint64_t num_publications = 0;
+static uint64_t publish_interval = 0;
+
+#ifdef _WIN32
+static HANDLE mapping = 0;
+#endif
+
+static void* map_segment(const char* name,
+                         const bool create);
+static void unmap_segment(const void* address);
+static void print_data(const struct shared_state_data* data);
+
+/********************************************************************************
+* shared_state_open: Creates a shared memory segment with specified name and
+*                    starts publishing the state of the system every time
+*                    specified number of clock cycles have been run. If no
+*                    name is specified, the block is only shared with other
+*                    threads, see shared_state_current. Returns 0 after
+*                    success or error code 1 if the segment couldn't be
+*                    created.
+*
+*                    - name    : Name of the segment, for instance
+*                                SHARED_STATE_DEFAULT_NAME, or 0.
+*                    - interval: Clock cycles between publications.
+********************************************************************************/
+int shared_state_open(const char* name,
+                      const uint64_t interval)
+{
+   shared_state_close();
+   if (!interval || (name && strlen(name) >= sizeof(segment_name))) return 1;
+
+   block = name ? (struct shared_state_block*)map_segment(name, true) :
+                  (struct shared_state_block*)calloc(1, sizeof(struct shared_state_block));
+   if (!block) return 1;
+
+   strcpy(segment_name, name ? name : "");
+   memset(&block->data, 0, sizeof(block->data));
+   block->magic = SHARED_STATE_MAGIC;
+   block->version = SHARED_STATE_VERSION;
+   atomic_store(&block->sequence, 0);
+   atomic_store(&block->attached, true);
+
+   num_publications = 0;
+   publish_interval = interval;
+   control_unit_set_periodic_hook(CONTROL_UNIT_HOOK_PUBLISH, shared_state_publish, interval);
+   shared_state_publish();
+   return 0;
+}
+
+/********************************************************************************
+* shared_state_close: Publishes the state a last time, marks the writer as
+*                     detached and removes the shared memory segment.
+********************************************************************************/
+void shared_state_close(void)
+{
+   if (!block) return;
+
+   control_unit_set_periodic_hook(CONTROL_UNIT_HOOK_PUBLISH, 0, 0);
+   shared_state_publish();
+   atomic_store(&block->attached, false);
+
+   if (!segment_name[0])
+   {
+      free(block);
+      block = 0;
+      return;
+   }
+
+   unmap_segment(block);
+   block = 0;
+
+#ifndef _WIN32
+   shm_unlink(segment_name);
+#endif
+   return;
+}
+
+/********************************************************************************
+* shared_state_publish: Publishes the current state of the system, if a
+*                       segment is open.
+********************************************************************************/
+void shared_state_publish(void)
+{
+   static struct control_unit_snapshot snapshot;
+   struct shared_state_data data;
+   if (!block) return;
+
+   control_unit_snapshot(&snapshot);
+   memset(&data, 0, sizeof(data));
+   data.cycles = snapshot.cycles;
+   data.publications = ++num_publications;
+   data.interval = publish_interval;
+   data.ir = snapshot.ir;
+   data.pc = snapshot.pc;
+   data.mar = snapshot.mar;
+   data.sr = snapshot.sr;
+   data.op_code = snapshot.op_code;
+   data.state = (uint8_t)snapshot.state;
+   data.stack_pointer = snapshot.stack_pointer;
+   memcpy(data.reg, snapshot.reg, sizeof(data.reg));
+   memcpy(data.ports, snapshot.data, sizeof(data.ports));
+   strncpy(data.symbol, program_memory_subroutine_name(snapshot.mar), sizeof(data.symbol) - 1);
+
+   const unsigned int sequence = atomic_load_explicit(&block->sequence, memory_order_relaxed);
+   atomic_store_explicit(&block->sequence, sequence + 1, memory_order_relaxed);
+   atomic_thread_fence(memory_order_release);
+   memcpy(&block->data, &data, sizeof(data));
+   atomic_store_explicit(&block->sequence, sequence + 2, memory_order_release);
+   return;
+}
+
+/********************************************************************************
+* shared_state_current: Returns a reference to the block published by this
+*                       process, or 0 if no block is open. The block can be
+*                       read by other threads with shared_state_read.
+********************************************************************************/
+const struct shared_state_block* shared_state_current(void)
+{
+   return block;
+}
+
+/********************************************************************************
+* shared_state_attach: Attaches to the shared memory segment with specified
+*                      name for reading. Returns a reference to the block or
+*                      0 if no valid segment exists.
+*
+*                      - name: Name of the segment.
+********************************************************************************/
+const struct shared_state_block* shared_state_attach(const char* name)
+{
+   const struct shared_state_block* self = (const struct shared_state_block*)map_segment(name, false);
+   if (!self) return 0;
+
+   if (self->magic != SHARED_STATE_MAGIC || self->version != SHARED_STATE_VERSION)
+   {
+      unmap_segment(self);
+      return 0;
+   }
+   return self;
+}
+
+/********************************************************************************
+* shared_state_detach: Detaches from referenced block.
+*
+*                      - self: Reference to the block.
+********************************************************************************/
+void shared_state_detach(const struct shared_state_block* self)
+{
+   if (self) unmap_segment(self);
+   return;
+}
+
+/********************************************************************************
+* shared_state_read: Copies a consistent version of the published state from
+*                    referenced block to referenced location without blocking
+*                    the writer. Returns 0 after success or error code 1 if
+*                    the state was updated during every retry.
+*
+*                    - self: Reference to the block.
+*                    - data: Reference to the copy.
+********************************************************************************/
+int shared_state_read(const struct shared_state_block* self,
+                      struct shared_state_data* data)
+{
+   atomic_uint* sequence = (atomic_uint*)&self->sequence;
+
+   for (uint32_t i = 0; i < SHARED_STATE_MAX_RETRIES; ++i)
+   {
+      const unsigned int before = atomic_load_explicit(sequence, memory_order_acquire);
+      if (before & 1) continue;
+
+      memcpy(data, &self->data, sizeof(*data));
+      atomic_thread_fence(memory_order_acquire);
+
+      if (atomic_load_explicit(sequence, memory_order_relaxed) == before) return 0;
+   }
+   return 1;
+}
+
+/********************************************************************************
+* shared_state_monitor: Attaches to the segment with specified name and prints
+*                       the published state ten times per second whenever it
+*                       has changed, until the writer detaches. Returns 0
+*                       when the writer has detached or error code 1 if no
+*                       segment could be attached.
+*
+*                       - name: Name of the segment.
+********************************************************************************/
+int shared_state_monitor(const char* name)
+{
+   const struct shared_state_block* self = shared_state_attach(name);
+   const struct timespec period = { 0, MONITOR_PERIOD_NS };
+   struct shared_state_data data;
+   uint64_t last_publication = 0;
+
+   if (!self)
+   {
+      fprintf(stderr, "Could not attach to shared state %s!\n", name);
+      return 1;
+   }
+
+   printf("Attached to shared state %s.\n", name);
+
+   while (1)
+   {
+      const bool attached = atomic_load((atomic_bool*)&self->attached);
+
+      if (!shared_state_read(self, &data) && data.publications != last_publication)
+      {
+         print_data(&data);
+         last_publication = data.publications;
+      }
+
+      if (!attached) break;
+      thrd_sleep(&period, 0);
+   }
+
+   printf("The simulation has detached from %s.\n", name);
+   shared_state_detach(self);
+   return 0;
+}
+
+static void* map_segment(const char* name,
+                         const bool create)
+{
+   const size_t size = sizeof(struct shared_state_block);
+#ifdef _WIN32
+   if (create)
+   {
+      mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, 0, (DWORD)size, name);
+      return mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : 0;
+   }
+   else
+   {
+      HANDLE handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+      void* address = handle ? MapViewOfFile(handle, FILE_MAP_READ, 0, 0, size) : 0;
+      if (handle) CloseHandle(handle); /* The view keeps the mapping. */
+      return address;
+   }
+#else
+   const int fd = shm_open(name, create ? O_CREAT | O_RDWR : O_RDONLY, 0644);
+   void* address = 0;
+   if (fd < 0) return 0;
+
+   if (!create || !ftruncate(fd, (off_t)size))
+   {
+      address = mmap(0, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+      if (address == MAP_FAILED) address = 0;
+   }
+
+   close(fd);
+   return address;
+#endif
+}
+
+static void unmap_segment(const void* address)
+{
+#ifdef _WIN32
+   UnmapViewOfFile(address);
+   if (address == block && mapping)
+   {
+      CloseHandle(mapping);
+      mapping = 0;
+   }
+#else
+   munmap((void*)address, sizeof(struct shared_state_block));
+#endif
+   return;
+}
+
+static void print_data(const struct shared_state_data* data)
+{
+   char binary[CPU_BINARY_BUFFER_SIZE];
+   printf("Cycle %llu: %s, %s at %hu (%s), SR %s, R16 0x%02X, R24 0x%02X, ",
+          (unsigned long long)data->cycles, data->symbol, cpu_instruction_name(data->op_code),
+          data->mar, cpu_state_name((enum cpu_state)data->state), cpu_format_binary(data->sr, 5, binary),
+          data->reg[R16], data->reg[R24]);
+   printf("DDRB 0x%02X, PORTB 0x%02X, PINB 0x%02X\n",
+          data->ports[DDRB], data->ports[PORTB], data->ports[PINB]);
+   return;
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+/********************************************************************************
+* shared_state.h: Contains functionality for publishing the state of the
+*                 system to a shared memory segment, where it can be read by
+*                 separate monitor processes without slowing down the
+*                 simulation. The state is published by a periodic hook of
+*                 the control unit every time a configurable number of clock
+*                 cycles have been run.
+*
+*                 The segment holds a compact state block protected by a
+*                 sequence lock. The writer makes the sequence number odd
+*                 before updating the block and even afterwards, so a reader
+*                 copies the block and retries if the sequence number was odd
+*                 or changed during the copy. Readers never block the writer
+*                 and monitors can attach and detach at any time.
+********************************************************************************/
+#ifndef SHARED_STATE_H_
+#define SHARED_STATE_H_
+
+/* Include directives: */
+#include <stdatomic.h>
+#include "cpu.h"
+#include "control_unit.h"
+
+#define SHARED_STATE_DEFAULT_NAME     "/cpu_demo_state" /* Default name of the segment. */
+#define SHARED_STATE_DEFAULT_INTERVAL 100000            /* Default clock cycles between publications. */
+#define SHARED_STATE_MAGIC            0x55504353        /* Identifies the segment ("SCPU"). */
+#define SHARED_STATE_VERSION          1                 /* Version of the state block. */
+#define SHARED_STATE_SYMBOL_SIZE      24                /* Capacity of the current symbol. */
+#define SHARED_STATE_NUM_PORTS        (PIND + 1)        /* Registers DDRB - PIND. */
+#define SHARED_STATE_MAX_RETRIES      1000              /* Retries of a read before giving up. */
+
+/********************************************************************************
+* shared_state_data: Published state of the system.
+********************************************************************************/
+struct shared_state_data
+{
+   uint64_t cycles;                                 /* Clock cycles run since reset. */
+   uint64_t publications;                           /* Number of publications since start. */
+   uint64_t interval;                               /* Clock cycles between publications. */
+   uint32_t ir;                                     /* Instruction register. */
+   uint8_t pc;                                      /* Program counter. */
+   uint8_t mar;                                     /* Address of the current instruction. */
+   uint8_t sr;                                      /* Status register (bits INZVC). */
+   uint8_t op_code;                                 /* Decoded OP code. */
+   uint8_t state;                                   /* Next state in the instruction cycle. */
+   uint8_t stack_pointer;                           /* Stack pointer. */
+   uint8_t reg[CPU_REGISTER_ADDRESS_WIDTH];         /* CPU registers R0 - R31. */
+   uint8_t ports[SHARED_STATE_NUM_PORTS];           /* I/O registers DDRB - PIND. */
+   char symbol[SHARED_STATE_SYMBOL_SIZE];           /* Name of the current subroutine. */
+};
+
+/********************************************************************************
+* shared_state_block: Layout of the shared memory segment.
+********************************************************************************/
+struct shared_state_block
+{
+   uint32_t magic;                /* SHARED_STATE_MAGIC. */
+   uint32_t version;              /* SHARED_STATE_VERSION. */
+   atomic_uint sequence;          /* Sequence number, odd while the data is written. */
+   atomic_bool attached;          /* Indicates if the writer is attached. */
+   struct shared_state_data data; /* The published state. */
+};
+
+/********************************************************************************
+* shared_state_open: Creates a shared memory segment with specified name and
+*                    starts publishing the state of the system every time
+*                    specified number of clock cycles have been run. If no
+*                    name is specified, the block is only shared with other
+*                    threads, see shared_state_current. Returns 0 after
+*                    success or error code 1 if the segment couldn't be
+*                    created.
+*
+*                    - name    : Name of the segment, for instance
+*                                SHARED_STATE_DEFAULT_NAME, or 0.
+*                    - interval: Clock cycles between publications.
+********************************************************************************/
+int shared_state_open(const char* name,
+                      const uint64_t interval);
+
+/********************************************************************************
+* shared_state_close: Publishes the state a last time, marks the writer as
+*                     detached and removes the shared memory segment.
+********************************************************************************/
+void shared_state_close(void);
+
+/********************************************************************************
+* shared_state_publish: Publishes the current state of the system, if a
+*                       segment is open.
+********************************************************************************/
+void shared_state_publish(void);
+
+/********************************************************************************
+* shared_state_current: Returns a reference to the block published by this
+*                       process, or 0 if no block is open. The block can be
+*                       read by other threads with shared_state_read.
+********************************************************************************/
+const struct shared_state_block* shared_state_current(void);
+
+/********************************************************************************
+* shared_state_attach: Attaches to the shared memory segment with specified
+*                      name for reading. Returns a reference to the block or
+*                      0 if no valid segment exists.
+*
+*                      - name: Name of the segment.
+********************************************************************************/
+const struct shared_state_block* shared_state_attach(const char* name);
+
+/********************************************************************************
+* shared_state_detach: Detaches from referenced block.
+*
+*                      - self: Reference to the block.
+********************************************************************************/
+void shared_state_detach(const struct shared_state_block* self);
+
+/********************************************************************************
+* shared_state_read: Copies a consistent version of the published state from
+*                    referenced block to referenced location without blocking
+*                    the writer. Returns 0 after success or error code 1 if
+*                    the state was updated during every retry.
+*
+*                    - self: Reference to the block.
+*                    - data: Reference to the copy.
+********************************************************************************/
+int shared_state_read(const struct shared_state_block* self,
+                      struct shared_state_data* data);
+
+/********************************************************************************
+* shared_state_monitor: Attaches to the segment with specified name and prints
+*                       the published state ten times per second whenever it
+*                       has changed, until the writer detaches. Returns 0
+*                       when the writer has detached or error code 1 if no
+*                       segment could be attached.
+*
+*                       - name: Name of the segment.
+********************************************************************************/
+int shared_state_monitor(const char* name);
+
+#endif /* SHARED_STATE_H_ */
\ No newline at end of file
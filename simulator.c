@@ -0,0 +1,525 @@
+/********************************************************************************
+* simulator.c: Contains the C API of the simulator library, implemented on
+*              top of the contexts of the system.
+********************************************************************************/
+#include "simulator.h"
+#include "context.h"
+#include "avr_decoder.h"
+
+/********************************************************************************
+* simulator: Instance of the system and the hooks set by the client.
+********************************************************************************/
+struct simulator
+{
+   struct context* context;          /* Stored state and program image. */
+   simulator_hook periodic_hook;     /* Periodic hook, or 0. */
+   void* periodic_data;              /* Pointer passed to the periodic hook. */
+   uint64_t periodic_interval;       /* Clock cycles between calls of the periodic hook. */
+   simulator_port_hook port_hook;    /* Port hook, or 0. */
+   void* port_data;                  /* Pointer passed to the port hook. */
+   bool stopped;                     /* Set by simulator_stop during a run. */
+};
+
+static CPU_THREAD_LOCAL struct simulator* resident = 0; /* Simulator run by the system of the thread. */
+
+static void activate(struct simulator* self);
+static void install_hooks(const struct simulator* self);
+static void run_periodic_hook(void);
+static void run_port_hook(const uint16_t address,
+                          const enum data_memory_access access,
+                          const uint8_t old_value,
+                          uint8_t* value);
+
+/********************************************************************************
+* simulator_api_version: Returns the SIMULATOR_API_VERSION the library was
+*                        built with, which should equal the version of the
+*                        header used by the client.
+********************************************************************************/
+uint32_t simulator_api_version(void)
+{
+   return SIMULATOR_API_VERSION;
+}
+
+/********************************************************************************
+* simulator_create: Creates a simulator running the built-in program, in the
+*                   state after a reset. Returns a reference to the simulator
+*                   or 0 if memory ran out.
+********************************************************************************/
+struct simulator* simulator_create(void)
+{
+   struct simulator* self = (struct simulator*)calloc(1, sizeof(struct simulator));
+   if (!self) return 0;
+
+   self->context = context_create(program_image_builtin());
+
+   if (!self->context)
+   {
+      free(self);
+      return 0;
+   }
+   return self;
+}
+
+/********************************************************************************
+* simulator_clone: Creates a copy of referenced simulator, with the same
+*                  program, state and hooks. Returns a reference to the copy
+*                  or 0 if memory ran out.
+*
+*                  - self: Reference to the simulator to copy.
+********************************************************************************/
+struct simulator* simulator_clone(struct simulator* self)
+{
+   struct simulator* copy = (struct simulator*)malloc(sizeof(struct simulator));
+   if (!copy) return 0;
+
+   if (resident == self) context_leave(self->context);
+   *copy = *self;
+   copy->context = context_create(self->context->image);
+
+   if (!copy->context)
+   {
+      free(copy);
+      return 0;
+   }
+
+   copy->context->state = self->context->state;
+   return copy;
+}
+
+/********************************************************************************
+* simulator_destroy: Destroys referenced simulator.
+*
+*                    - self: Reference to the simulator, or 0.
+********************************************************************************/
+void simulator_destroy(struct simulator* self)
+{
+   if (!self) return;
+
+   if (resident == self)
+   {
+      resident = 0;
+      install_hooks(0);
+   }
+
+   context_destroy(self->context);
+   free(self);
+   return;
+}
+
+/********************************************************************************
+* simulator_load_program: Loads specified instructions, in the instruction
+*                         format of the simulator, from address 0 and onwards
+*                         and resets the simulator. Returns 0 after success or
+*                         error code 1 if the program doesn't fit in program
+*                         memory or memory ran out.
+*
+*                         - self            : Reference to the simulator.
+*                         - instructions    : Reference to the instructions.
+*                         - num_instructions: The number of instructions.
+********************************************************************************/
+int simulator_load_program(struct simulator* self,
+                           const uint32_t* instructions,
+                           const size_t num_instructions)
+{
+   activate(self);
+   if (program_memory_load(instructions, num_instructions)) return 1;
+   control_unit_reset();
+   return 0;
+}
+
+/********************************************************************************
+* simulator_load_hex: Loads the AVR program in the Intel HEX file at specified
+*                     path and resets the simulator. Returns 0 after success
+*                     or error code 1 if the file couldn't be loaded, in which
+*                     case the simulator is unchanged.
+*
+*                     - self    : Reference to the simulator.
+*                     - filepath: Path to the Intel HEX file.
+********************************************************************************/
+int simulator_load_hex(struct simulator* self,
+                       const char* filepath)
+{
+   activate(self);
+   if (avr_decoder_load_hex(filepath)) return 1;
+   control_unit_reset();
+   return 0;
+}
+
+/********************************************************************************
+* simulator_patch: Replaces specified number of instructions, in the
+*                  instruction format of the simulator, from specified
+*                  address and onwards without resetting the simulator. The
+*                  patch can also be applied by hooks while the simulator
+*                  runs, and takes effect at the next instruction boundary.
+*                  Returns 0 after success or error code 1 if the
+*                  instructions don't fit in program memory or memory ran
+*                  out.
+*
+*                  - self            : Reference to the simulator.
+*                  - address         : Address of the first instruction.
+*                  - instructions    : Reference to the new instructions.
+*                  - num_instructions: The number of instructions.
+********************************************************************************/
+int simulator_patch(struct simulator* self,
+                    const uint8_t address,
+                    const uint32_t* instructions,
+                    const size_t num_instructions)
+{
+   activate(self);
+   return control_unit_patch(address, instructions, num_instructions);
+}
+
+/********************************************************************************
+* simulator_reset: Resets referenced simulator. The program is kept.
+*
+*                  - self: Reference to the simulator.
+********************************************************************************/
+void simulator_reset(struct simulator* self)
+{
+   activate(self);
+   control_unit_reset();
+   return;
+}
+
+/********************************************************************************
+* simulator_step_state: Runs the next state of the instruction cycle, i.e.
+*                       one clock cycle.
+*
+*                       - self: Reference to the simulator.
+********************************************************************************/
+void simulator_step_state(struct simulator* self)
+{
+   activate(self);
+   control_unit_run_next_state();
+   return;
+}
+
+/********************************************************************************
+* simulator_step_instruction_cycle: Runs the remaining states of the current
+*                                   instruction cycle.
+*
+*                                   - self: Reference to the simulator.
+********************************************************************************/
+void simulator_step_instruction_cycle(struct simulator* self)
+{
+   activate(self);
+   control_unit_run_next_instruction_cycle();
+   return;
+}
+
+/********************************************************************************
+* simulator_run_instructions: Runs specified number of whole instructions, or
+*                             until simulator_stop is called by a hook.
+*                             Returns the number of instructions run.
+*
+*                             - self            : Reference to the simulator.
+*                             - num_instructions: The number of instructions.
+********************************************************************************/
+uint32_t simulator_run_instructions(struct simulator* self,
+                                    const uint32_t num_instructions)
+{
+   activate(self);
+   self->stopped = false;
+   return control_unit_run_fast(num_instructions);
+}
+
+/********************************************************************************
+* simulator_run_for: Runs specified number of clock cycles, or until the
+*                    run is stopped like by simulator_run_until. Returns the
+*                    number of clock cycles run since reset.
+*
+*                    - self      : Reference to the simulator.
+*                    - num_cycles: The number of clock cycles to run.
+********************************************************************************/
+uint64_t simulator_run_for(struct simulator* self,
+                           const uint64_t num_cycles)
+{
+   activate(self);
+   return simulator_run_until(self, control_unit_cycles() + num_cycles);
+}
+
+/********************************************************************************
+* simulator_run_until: Runs until specified number of clock cycles have been
+*                      run since reset, or until the run is stopped by
+*                      simulator_stop from a hook or by a breakpoint.
+*                      Returns the number of clock cycles run since reset. Like control_unit_run_until, whole instructions
+*                      are run in batches by the fast engine.
+*
+*                      - self : Reference to the simulator.
+*                      - cycle: The clock cycle to stop at.
+********************************************************************************/
+uint64_t simulator_run_until(struct simulator* self,
+                             const uint64_t cycle)
+{
+   activate(self);
+   self->stopped = false;
+   if (!control_unit_run_until(cycle)) self->stopped = true;
+   return control_unit_cycles();
+}
+
+/********************************************************************************
+* simulator_run_to_address: Runs whole instructions until the next instruction
+*                           to run is at specified address, so that the
+*                           simulator can be stepped state by state from
+*                           there, or until specified number of instructions
+*                           has been run or simulator_stop is called by a
+*                           hook. Returns true if the address was reached.
+*
+*                           - self            : Reference to the simulator.
+*                           - address         : The address to stop at.
+*                           - num_instructions: The maximum number of instructions.
+********************************************************************************/
+bool simulator_run_to_address(struct simulator* self,
+                              const uint8_t address,
+                              const uint32_t num_instructions)
+{
+   const struct control_unit_switch at = { UINT64_MAX, address, 0 };
+   activate(self);
+   self->stopped = false;
+   return control_unit_run_functional(&at, num_instructions);
+}
+
+/********************************************************************************
+* simulator_stop: Stops the run of referenced simulator after the current
+*                 instruction. Called by hooks.
+*
+*                 - self: Reference to the simulator.
+********************************************************************************/
+void simulator_stop(struct simulator* self)
+{
+   self->stopped = true;
+   if (resident == self) control_unit_request_stop();
+   return;
+}
+
+/********************************************************************************
+* simulator_cycles: Returns the number of clock cycles run since reset.
+*
+*                   - self: Reference to the simulator.
+********************************************************************************/
+uint64_t simulator_cycles(struct simulator* self)
+{
+   activate(self);
+   return control_unit_cycles();
+}
+
+/********************************************************************************
+* simulator_program_counter: Returns the program counter.
+*
+*                            - self: Reference to the simulator.
+********************************************************************************/
+uint8_t simulator_program_counter(struct simulator* self)
+{
+   activate(self);
+   return control_unit_read_program_counter();
+}
+
+/********************************************************************************
+* simulator_read_register: Returns the content of specified CPU register, or
+*                          0 if the address is invalid.
+*
+*                          - self   : Reference to the simulator.
+*                          - address: The register, 0 - 31.
+********************************************************************************/
+uint8_t simulator_read_register(struct simulator* self,
+                                const uint8_t address)
+{
+   activate(self);
+   return control_unit_read_register(address);
+}
+
+/********************************************************************************
+* simulator_write_register: Writes to specified CPU register. Returns 0 after
+*                           success or error code 1 if the address is invalid.
+*
+*                           - self   : Reference to the simulator.
+*                           - address: The register, 0 - 31.
+*                           - value  : The value to write.
+********************************************************************************/
+int simulator_write_register(struct simulator* self,
+                             const uint8_t address,
+                             const uint8_t value)
+{
+   activate(self);
+   return control_unit_write_register(address, value);
+}
+
+/********************************************************************************
+* simulator_read_status: Returns the content of the status register.
+*
+*                        - self: Reference to the simulator.
+********************************************************************************/
+uint8_t simulator_read_status(struct simulator* self)
+{
+   activate(self);
+   return control_unit_read_status_register();
+}
+
+/********************************************************************************
+* simulator_write_status: Writes to the status register.
+*
+*                         - self : Reference to the simulator.
+*                         - value: The value to write.
+********************************************************************************/
+void simulator_write_status(struct simulator* self,
+                            const uint8_t value)
+{
+   activate(self);
+   control_unit_write_status_register(value);
+   return;
+}
+
+/********************************************************************************
+* simulator_read_data: Returns the content at specified data memory address,
+*                      or 0 if the address is invalid. Peripherals and hooks
+*                      don't see the access.
+*
+*                      - self   : Reference to the simulator.
+*                      - address: The data memory address.
+********************************************************************************/
+uint8_t simulator_read_data(struct simulator* self,
+                            const uint16_t address)
+{
+   activate(self);
+   return data_memory_peek(address);
+}
+
+/********************************************************************************
+* simulator_write_data: Writes to specified data memory address. Peripherals
+*                       and hooks don't see the access, but a changed pin
+*                       input register generates a pin change interrupt when
+*                       the simulator runs, if enabled. Returns 0 after
+*                       success or error code 1 if the address is invalid.
+*
+*                       - self   : Reference to the simulator.
+*                       - address: The data memory address.
+*                       - value  : The value to write.
+********************************************************************************/
+int simulator_write_data(struct simulator* self,
+                         const uint16_t address,
+                         const uint8_t value)
+{
+   activate(self);
+   return data_memory_poke(address, value);
+}
+
+/********************************************************************************
+* simulator_set_periodic_hook: Sets a hook called every specified number of
+*                              clock cycles while the simulator runs, counted
+*                              from when the hook is set or the simulator was
+*                              last switched to on its thread.
+*
+*                              - self     : Reference to the simulator.
+*                              - hook     : The hook, or 0 to remove it.
+*                              - user_data: Pointer passed to the hook.
+*                              - interval : Clock cycles between calls.
+********************************************************************************/
+void simulator_set_periodic_hook(struct simulator* self,
+                                 const simulator_hook hook,
+                                 void* user_data,
+                                 const uint64_t interval)
+{
+   self->periodic_hook = interval ? hook : 0;
+   self->periodic_data = user_data;
+   self->periodic_interval = self->periodic_hook ? interval : 0;
+   if (resident == self) install_hooks(self);
+   return;
+}
+
+/********************************************************************************
+* simulator_set_port_hook: Sets a hook called when the program writes to one
+*                          of the I/O port registers.
+*
+*                          - self     : Reference to the simulator.
+*                          - hook     : The hook, or 0 to remove it.
+*                          - user_data: Pointer passed to the hook.
+********************************************************************************/
+void simulator_set_port_hook(struct simulator* self,
+                             const simulator_port_hook hook,
+                             void* user_data)
+{
+   self->port_hook = hook;
+   self->port_data = user_data;
+   if (resident == self) install_hooks(self);
+   return;
+}
+
+/********************************************************************************
+* simulator_enter: Makes referenced simulator the resident simulator of the
+*                  calling thread, so that in-process tools working on the
+*                  system of the thread, like the debugger, work on it.
+*
+*                  - self: Reference to the simulator.
+********************************************************************************/
+void simulator_enter(struct simulator* self)
+{
+   activate(self);
+   return;
+}
+
+/********************************************************************************
+* simulator_leave: Stores the state of referenced simulator, if it's the
+*                  resident simulator of the calling thread, after which it
+*                  can be used by another thread.
+*
+*                  - self: Reference to the simulator.
+********************************************************************************/
+void simulator_leave(struct simulator* self)
+{
+   if (resident != self) return;
+   context_leave(self->context);
+   install_hooks(0);
+   resident = 0;
+   return;
+}
+
+/********************************************************************************
+* activate: Makes referenced simulator the resident simulator of the calling
+*           thread, after storing the state of the previous one, if any. The
+*           state stays in the system of the thread until another simulator
+*           is activated, so consecutive calls for the same simulator don't
+*           copy any state.
+*
+*           - self: Reference to the simulator.
+********************************************************************************/
+static void activate(struct simulator* self)
+{
+   if (resident == self) return;
+   if (resident) context_leave(resident->context);
+
+   context_enter(self->context);
+   resident = self;
+   install_hooks(self);
+   return;
+}
+
+static void install_hooks(const struct simulator* self)
+{
+   const bool port_hook = self && self->port_hook;
+
+   control_unit_set_periodic_hook(CONTROL_UNIT_HOOK_CLIENT, self && self->periodic_hook ? run_periodic_hook : 0,
+                                  self ? self->periodic_interval : 0);
+   data_memory_set_hook(DATA_MEMORY_HOOK_CLIENT, port_hook ? run_port_hook : 0);
+
+   for (uint16_t i = DDRB; i <= PIND; ++i)
+   {
+      data_memory_monitor(DATA_MEMORY_HOOK_CLIENT, i, port_hook);
+   }
+   return;
+}
+
+static void run_periodic_hook(void)
+{
+   resident->periodic_hook(resident, resident->periodic_data);
+   return;
+}
+
+static void run_port_hook(const uint16_t address,
+                          const enum data_memory_access access,
+                          const uint8_t old_value,
+                          uint8_t* value)
+{
+   (void)old_value;
+   if (access == DATA_MEMORY_ACCESS_WRITE) resident->port_hook(resident, address, *value, resident->port_data);
+   return;
+}
\ No newline at end of file
@@ -0,0 +1,368 @@
+/********************************************************************************
+* simulator.h: Contains the C API of the simulator library, for embedding the
+*              system in other programs, such as test infrastructure running
+*              millions of short simulations in-process. The header only
+*              includes headers of the C standard library and is stable
+*              between versions of the library with the same
+*              SIMULATOR_API_VERSION. The library itself also uses C11
+*              threads and, on POSIX systems, dlopen for the translator,
+*              so its clients link it with -lpthread -ldl.
+*
+*              Every simulator is an instance of the system with its own
+*              registers, data memory, stack and program. Any number of
+*              simulators can be created. They are run on the thread that
+*              calls them, which holds one resident simulator at a time, so
+*              switching between simulators on a thread stores the state of
+*              the resident one and restores the other. A simulator must
+*              only be used by one thread at a time and is moved to another
+*              thread by calling simulator_leave first.
+*
+*              The library is built as a static library, or as a shared
+*              library with SIMULATOR_SHARED defined both when building and
+*              using it on Windows.
+********************************************************************************/
+#ifndef SIMULATOR_H_
+#define SIMULATOR_H_
+
+/* Include directives: */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined(_WIN32) && defined(SIMULATOR_SHARED)
+#ifdef SIMULATOR_EXPORTS
+#define SIMULATOR_API __declspec(dllexport)
+#else
+#define SIMULATOR_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__)
+#define SIMULATOR_API __attribute__((visibility("default")))
+#else
+#define SIMULATOR_API
+#endif
+
+#define SIMULATOR_API_VERSION   1    /* Incremented at incompatible changes of the API. */
+#define SIMULATOR_NUM_REGISTERS 32   /* CPU registers R0 - R31. */
+#define SIMULATOR_DATA_SIZE     2000 /* Addresses in data memory. */
+#define SIMULATOR_PROGRAM_SIZE  256  /* Instructions in program memory. */
+#define SIMULATOR_NUM_PORTS     9    /* I/O port registers DDRB - PIND at addresses 0 - 8. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/********************************************************************************
+* simulator: Opaque handle of a simulator.
+********************************************************************************/
+struct simulator;
+
+/********************************************************************************
+* simulator_hook: Function called periodically while a simulator runs.
+*
+*                 - self     : Reference to the running simulator.
+*                 - user_data: The pointer passed when the hook was set.
+********************************************************************************/
+typedef void (*simulator_hook)(struct simulator* self,
+                               void* user_data);
+
+/********************************************************************************
+* simulator_port_hook: Function called when the program writes to one of the
+*                      I/O port registers.
+*
+*                      - self     : Reference to the running simulator.
+*                      - address  : The address of the port register.
+*                      - value    : The value written.
+*                      - user_data: The pointer passed when the hook was set.
+********************************************************************************/
+typedef void (*simulator_port_hook)(struct simulator* self,
+                                    const uint16_t address,
+                                    const uint8_t value,
+                                    void* user_data);
+
+/********************************************************************************
+* simulator_api_version: Returns the SIMULATOR_API_VERSION the library was
+*                        built with, which should equal the version of the
+*                        header used by the client.
+********************************************************************************/
+SIMULATOR_API uint32_t simulator_api_version(void);
+
+/********************************************************************************
+* simulator_create: Creates a simulator running the built-in program, in the
+*                   state after a reset. Returns a reference to the simulator
+*                   or 0 if memory ran out.
+********************************************************************************/
+SIMULATOR_API struct simulator* simulator_create(void);
+
+/********************************************************************************
+* simulator_clone: Creates a copy of referenced simulator, with the same
+*                  program, state and hooks. Returns a reference to the copy
+*                  or 0 if memory ran out.
+*
+*                  - self: Reference to the simulator to copy.
+********************************************************************************/
+SIMULATOR_API struct simulator* simulator_clone(struct simulator* self);
+
+/********************************************************************************
+* simulator_destroy: Destroys referenced simulator.
+*
+*                    - self: Reference to the simulator, or 0.
+********************************************************************************/
+SIMULATOR_API void simulator_destroy(struct simulator* self);
+
+/********************************************************************************
+* simulator_load_program: Loads specified instructions, in the instruction
+*                         format of the simulator, from address 0 and onwards
+*                         and resets the simulator. Returns 0 after success or
+*                         error code 1 if the program doesn't fit in program
+*                         memory or memory ran out.
+*
+*                         - self            : Reference to the simulator.
+*                         - instructions    : Reference to the instructions.
+*                         - num_instructions: The number of instructions.
+********************************************************************************/
+SIMULATOR_API int simulator_load_program(struct simulator* self,
+                                         const uint32_t* instructions,
+                                         const size_t num_instructions);
+
+/********************************************************************************
+* simulator_load_hex: Loads the AVR program in the Intel HEX file at specified
+*                     path and resets the simulator. Returns 0 after success
+*                     or error code 1 if the file couldn't be loaded, in which
+*                     case the simulator is unchanged.
+*
+*                     - self    : Reference to the simulator.
+*                     - filepath: Path to the Intel HEX file.
+********************************************************************************/
+SIMULATOR_API int simulator_load_hex(struct simulator* self,
+                                     const char* filepath);
+
+/********************************************************************************
+* simulator_patch: Replaces specified number of instructions, in the
+*                  instruction format of the simulator, from specified
+*                  address and onwards without resetting the simulator. The
+*                  patch can also be applied by hooks while the simulator
+*                  runs, and takes effect at the next instruction boundary.
+*                  Returns 0 after success or error code 1 if the
+*                  instructions don't fit in program memory or memory ran
+*                  out.
+*
+*                  - self            : Reference to the simulator.
+*                  - address         : Address of the first instruction.
+*                  - instructions    : Reference to the new instructions.
+*                  - num_instructions: The number of instructions.
+********************************************************************************/
+SIMULATOR_API int simulator_patch(struct simulator* self,
+                                  const uint8_t address,
+                                  const uint32_t* instructions,
+                                  const size_t num_instructions);
+
+/********************************************************************************
+* simulator_reset: Resets referenced simulator. The program is kept.
+*
+*                  - self: Reference to the simulator.
+********************************************************************************/
+SIMULATOR_API void simulator_reset(struct simulator* self);
+
+/********************************************************************************
+* simulator_step_state: Runs the next state of the instruction cycle, i.e.
+*                       one clock cycle.
+*
+*                       - self: Reference to the simulator.
+********************************************************************************/
+SIMULATOR_API void simulator_step_state(struct simulator* self);
+
+/********************************************************************************
+* simulator_step_instruction_cycle: Runs the remaining states of the current
+*                                   instruction cycle.
+*
+*                                   - self: Reference to the simulator.
+********************************************************************************/
+SIMULATOR_API void simulator_step_instruction_cycle(struct simulator* self);
+
+/********************************************************************************
+* simulator_run_instructions: Runs specified number of whole instructions, or
+*                             until simulator_stop is called by a hook.
+*                             Returns the number of instructions run.
+*
+*                             - self            : Reference to the simulator.
+*                             - num_instructions: The number of instructions.
+********************************************************************************/
+SIMULATOR_API uint32_t simulator_run_instructions(struct simulator* self,
+                                                  const uint32_t num_instructions);
+
+/********************************************************************************
+* simulator_run_for: Runs specified number of clock cycles, or until the
+*                    run is stopped like by simulator_run_until. Returns the
+*                    number of clock cycles run since reset.
+*
+*                    - self      : Reference to the simulator.
+*                    - num_cycles: The number of clock cycles to run.
+********************************************************************************/
+SIMULATOR_API uint64_t simulator_run_for(struct simulator* self,
+                                         const uint64_t num_cycles);
+
+/********************************************************************************
+* simulator_run_until: Runs until specified number of clock cycles have been
+*                      run since reset, or until the run is stopped by
+*                      simulator_stop from a hook or by a breakpoint.
+*                      Returns the number of clock cycles run since reset.
+*
+*                      - self : Reference to the simulator.
+*                      - cycle: The clock cycle to stop at.
+********************************************************************************/
+SIMULATOR_API uint64_t simulator_run_until(struct simulator* self,
+                                           const uint64_t cycle);
+
+/********************************************************************************
+* simulator_run_to_address: Runs whole instructions until the next instruction
+*                           to run is at specified address, so that the
+*                           simulator can be stepped state by state from
+*                           there, or until specified number of instructions
+*                           has been run or simulator_stop is called by a
+*                           hook. Returns true if the address was reached.
+*
+*                           - self            : Reference to the simulator.
+*                           - address         : The address to stop at.
+*                           - num_instructions: The maximum number of instructions.
+********************************************************************************/
+SIMULATOR_API bool simulator_run_to_address(struct simulator* self,
+                                            const uint8_t address,
+                                            const uint32_t num_instructions);
+
+/********************************************************************************
+* simulator_stop: Stops the run of referenced simulator after the current
+*                 instruction. Called by hooks.
+*
+*                 - self: Reference to the simulator.
+********************************************************************************/
+SIMULATOR_API void simulator_stop(struct simulator* self);
+
+/********************************************************************************
+* simulator_cycles: Returns the number of clock cycles run since reset.
+*
+*                   - self: Reference to the simulator.
+********************************************************************************/
+SIMULATOR_API uint64_t simulator_cycles(struct simulator* self);
+
+/********************************************************************************
+* simulator_program_counter: Returns the program counter.
+*
+*                            - self: Reference to the simulator.
+********************************************************************************/
+SIMULATOR_API uint8_t simulator_program_counter(struct simulator* self);
+
+/********************************************************************************
+* simulator_read_register: Returns the content of specified CPU register, or
+*                          0 if the address is invalid.
+*
+*                          - self   : Reference to the simulator.
+*                          - address: The register, 0 - 31.
+********************************************************************************/
+SIMULATOR_API uint8_t simulator_read_register(struct simulator* self,
+                                              const uint8_t address);
+
+/********************************************************************************
+* simulator_write_register: Writes to specified CPU register. Returns 0 after
+*                           success or error code 1 if the address is invalid.
+*
+*                           - self   : Reference to the simulator.
+*                           - address: The register, 0 - 31.
+*                           - value  : The value to write.
+********************************************************************************/
+SIMULATOR_API int simulator_write_register(struct simulator* self,
+                                           const uint8_t address,
+                                           const uint8_t value);
+
+/********************************************************************************
+* simulator_read_status: Returns the content of the status register.
+*
+*                        - self: Reference to the simulator.
+********************************************************************************/
+SIMULATOR_API uint8_t simulator_read_status(struct simulator* self);
+
+/********************************************************************************
+* simulator_write_status: Writes to the status register.
+*
+*                         - self : Reference to the simulator.
+*                         - value: The value to write.
+********************************************************************************/
+SIMULATOR_API void simulator_write_status(struct simulator* self,
+                                          const uint8_t value);
+
+/********************************************************************************
+* simulator_read_data: Returns the content at specified data memory address,
+*                      or 0 if the address is invalid. Peripherals and hooks
+*                      don't see the access.
+*
+*                      - self   : Reference to the simulator.
+*                      - address: The data memory address.
+********************************************************************************/
+SIMULATOR_API uint8_t simulator_read_data(struct simulator* self,
+                                          const uint16_t address);
+
+/********************************************************************************
+* simulator_write_data: Writes to specified data memory address. Peripherals
+*                       and hooks don't see the access, but a changed pin
+*                       input register generates a pin change interrupt when
+*                       the simulator runs, if enabled. Returns 0 after
+*                       success or error code 1 if the address is invalid.
+*
+*                       - self   : Reference to the simulator.
+*                       - address: The data memory address.
+*                       - value  : The value to write.
+********************************************************************************/
+SIMULATOR_API int simulator_write_data(struct simulator* self,
+                                       const uint16_t address,
+                                       const uint8_t value);
+
+/********************************************************************************
+* simulator_set_periodic_hook: Sets a hook called every specified number of
+*                              clock cycles while the simulator runs, counted
+*                              from when the hook is set or the simulator was
+*                              last switched to on its thread.
+*
+*                              - self     : Reference to the simulator.
+*                              - hook     : The hook, or 0 to remove it.
+*                              - user_data: Pointer passed to the hook.
+*                              - interval : Clock cycles between calls.
+********************************************************************************/
+SIMULATOR_API void simulator_set_periodic_hook(struct simulator* self,
+                                               const simulator_hook hook,
+                                               void* user_data,
+                                               const uint64_t interval);
+
+/********************************************************************************
+* simulator_set_port_hook: Sets a hook called when the program writes to one
+*                          of the I/O port registers.
+*
+*                          - self     : Reference to the simulator.
+*                          - hook     : The hook, or 0 to remove it.
+*                          - user_data: Pointer passed to the hook.
+********************************************************************************/
+SIMULATOR_API void simulator_set_port_hook(struct simulator* self,
+                                           const simulator_port_hook hook,
+                                           void* user_data);
+
+/********************************************************************************
+* simulator_enter: Makes referenced simulator the resident simulator of the
+*                  calling thread, so that in-process tools working on the
+*                  system of the thread, like the debugger, work on it.
+*
+*                  - self: Reference to the simulator.
+********************************************************************************/
+SIMULATOR_API void simulator_enter(struct simulator* self);
+
+/********************************************************************************
+* simulator_leave: Stores the state of referenced simulator, if it's the
+*                  resident simulator of the calling thread, after which it
+*                  can be used by another thread.
+*
+*                  - self: Reference to the simulator.
+********************************************************************************/
+SIMULATOR_API void simulator_leave(struct simulator* self);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIMULATOR_H_ */
\ No newline at end of file
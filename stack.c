@@ -1,77 +1,157 @@
-#include "stack.h"
-
-static uint8_t data[STACK_ADDRESS_WIDTH];
-static uint8_t sp = STACK_ADDRESS_WIDTH - 1;
-static bool stack_empty = true;
-
-/********************************************************************************
-* stack_reset: Clears content of the stack.
-********************************************************************************/
-void stack_reset(void)
-{
-   for (uint8_t* i = data; i < data + STACK_ADDRESS_WIDTH; ++i)
-   {
-      *i = 0x00;
-   }
-
-   sp = STACK_ADDRESS_WIDTH - 1;
-   stack_empty = true;
-   return;
-}
-
-/********************************************************************************
-* stack_push: Pushes 8-bit value to the stack and returns 0 after successful
-*             execution. If the stack is full, the value isn't pushed to the
-*             stack and error code 1 is returned.
-*
-*             - value: The value to push to the stack.
-********************************************************************************/
-int stack_push(const uint8_t value)
-{
-   if (sp > 0)
-   {
-      if (stack_empty)
-      {
-         data[sp] = value;
-         stack_empty = false;
-      }
-      else
-      {
-         data[--sp] = value;
-      }
-      return 0;
-   }
-   else
-   {
-      return 1;
-   }
-}
-
-/********************************************************************************
-* stack_pop: Pops 8-bit value from the stack, stores at designated address and
-*            returns 0 after successful execution. If the stack is empty, no
-*            value is stored at designated address and error code 1 is returned.
-*
-*            - destination: Address to store the value popped from the stack.
-********************************************************************************/
-int stack_pop(uint8_t* destination)
-{
-   if (stack_empty)
-   {
-      return 1;
-   }
-   else
-   {
-      *destination = data[sp];
-
-      if (sp < STACK_ADDRESS_WIDTH - 1)
-      {
-         sp++;
-      }
-      else
-      {
-         stack_empty = true;
-      }
-      return 0;
-   }
+#include "stack.h"
+
+static CPU_THREAD_LOCAL uint8_t data[STACK_ADDRESS_WIDTH];
+static CPU_THREAD_LOCAL uint8_t sp = STACK_ADDRESS_WIDTH - 1;
+static CPU_THREAD_LOCAL bool stack_empty = true;
+
+/********************************************************************************
+* stack_reset: Clears content of the stack.
+********************************************************************************/
+void stack_reset(void)
+{
+   for (uint8_t* i = data; i < data + STACK_ADDRESS_WIDTH; ++i)
+   {
+      *i = 0x00;
+   }
+
+   sp = STACK_ADDRESS_WIDTH - 1;
+   stack_empty = true;
+   return;
+}
+
+/********************************************************************************
+* stack_push: Pushes 8-bit value to the stack and returns 0 after successful
+*             execution. If the stack is full, the value isn't pushed to the
+*             stack and error code 1 is returned.
+*
+*             - value: The value to push to the stack.
+********************************************************************************/
+int stack_push(const uint8_t value)
+{
+   if (sp > 0)
+   {
+      if (stack_empty)
+      {
+         data[sp] = value;
+         stack_empty = false;
+      }
+      else
+      {
+         data[--sp] = value;
+      }
+      return 0;
+   }
+   else
+   {
+      return 1;
+   }
+}
+
+/********************************************************************************
+* stack_pop: Pops 8-bit value from the stack, stores at designated address and
+*            returns 0 after successful execution. If the stack is empty, no
+*            value is stored at designated address and error code 1 is returned.
+*
+*            - destination: Address to store the value popped from the stack.
+********************************************************************************/
+int stack_pop(uint8_t* destination)
+{
+   if (stack_empty)
+   {
+      return 1;
+   }
+   else
+   {
+      *destination = data[sp];
+
+      if (sp < STACK_ADDRESS_WIDTH - 1)
+      {
+         sp++;
+      }
+      else
+      {
+         stack_empty = true;
+      }
+      return 0;
+   }
+}
+
+/********************************************************************************
+* stack_pointer: Returns the stack pointer, i.e. the address of the last
+*                value pushed to the stack.
+********************************************************************************/
+uint8_t stack_pointer(void)
+{
+   return sp;
+}
+
+/********************************************************************************
+* stack_is_empty: Indicates if the stack is empty.
+********************************************************************************/
+bool stack_is_empty(void)
+{
+   return stack_empty;
+}
+
+/********************************************************************************
+* stack_address: Returns the stack pointer as seen by a program through INSP,
+*                which counts down from STACK_TOP_ADDRESS by one per value
+*                on the stack, like the stack pointer of the ATmega328P.
+********************************************************************************/
+uint16_t stack_address(void)
+{
+   return STACK_TOP_ADDRESS - (stack_empty ? 0 : STACK_ADDRESS_WIDTH - sp);
+}
+
+/********************************************************************************
+* stack_set_address: Sets the stack pointer as seen by a program through
+*                    OUTSP, so that the stack holds STACK_TOP_ADDRESS minus
+*                    specified address values. Values added to the stack keep
+*                    their content. Returns 0 after success or error code 1
+*                    if the address is outside the stack, in which case the
+*                    stack is unchanged.
+*
+*                    - address: The new stack pointer.
+********************************************************************************/
+int stack_set_address(const uint16_t address)
+{
+   if (address > STACK_TOP_ADDRESS || STACK_TOP_ADDRESS - address > STACK_ADDRESS_WIDTH) return 1;
+
+   const uint16_t depth = STACK_TOP_ADDRESS - address;
+   sp = depth ? (uint8_t)(STACK_ADDRESS_WIDTH - depth) : STACK_ADDRESS_WIDTH - 1;
+   stack_empty = depth == 0;
+   return 0;
+}
+
+/********************************************************************************
+* stack_read: Returns the value at specified stack address without popping
+*             it from the stack.
+*
+*             - address: The stack address to read from.
+********************************************************************************/
+uint8_t stack_read(const uint8_t address)
+{
+   return data[address];
+}
+
+/********************************************************************************
+* stack_restore: Replaces the content of the stack, for instance with the
+*                content stored in a snapshot.
+*
+*                - content: Reference to the new content of the stack.
+*                - pointer: The new stack pointer.
+*                - empty  : Indicates if the stack is empty.
+********************************************************************************/
+void stack_restore(const uint8_t* content,
+                   const uint8_t pointer,
+                   const bool empty)
+{
+   for (uint16_t i = 0; i < STACK_ADDRESS_WIDTH; ++i)
+   {
+      data[i] = content[i];
+   }
+
+   sp = pointer;
+   stack_empty = empty;
+   return;
 }
\ No newline at end of file
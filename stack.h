@@ -1,32 +1,83 @@
-#ifndef STACK_H_
-#define STACK_H_
-
-#include "cpu.h"
-
-#define STACK_ADDRESS_WIDTH 256
-#define STACK_DATA_WIDTH    8
-
-/********************************************************************************
-* stack_reset: Clears content of the stack.
-********************************************************************************/
-void stack_reset(void);
-
-/********************************************************************************
-* stack_push: Pushes 8-bit value to the stack and returns 0 after successful
-*             execution. If the stack is full, the value isn't pushed to the 
-*             stack and error code 1 is returned. 
-* 
-*             - value: The value to push to the stack.
-********************************************************************************/
-int stack_push(const uint8_t value);
-
-/********************************************************************************
-* stack_pop: Pops 8-bit value from the stack, stores at designated address and 
-*            returns 0 after successful execution. If the stack is empty, no
-*            value is stored at designated address and error code 1 is returned.
-* 
-*            - destination: Address to store the value popped from the stack.
-********************************************************************************/
-int stack_pop(uint8_t* destination);
-
+#ifndef STACK_H_
+#define STACK_H_
+
+#include "cpu.h"
+
+#define STACK_ADDRESS_WIDTH 256
+#define STACK_DATA_WIDTH    8
+#define STACK_TOP_ADDRESS   0x08FF /* Stack pointer of the empty stack, RAMEND of the ATmega328P. */
+
+/********************************************************************************
+* stack_reset: Clears content of the stack.
+********************************************************************************/
+void stack_reset(void);
+
+/********************************************************************************
+* stack_push: Pushes 8-bit value to the stack and returns 0 after successful
+*             execution. If the stack is full, the value isn't pushed to the 
+*             stack and error code 1 is returned. 
+* 
+*             - value: The value to push to the stack.
+********************************************************************************/
+int stack_push(const uint8_t value);
+
+/********************************************************************************
+* stack_pop: Pops 8-bit value from the stack, stores at designated address and 
+*            returns 0 after successful execution. If the stack is empty, no
+*            value is stored at designated address and error code 1 is returned.
+* 
+*            - destination: Address to store the value popped from the stack.
+********************************************************************************/
+int stack_pop(uint8_t* destination);
+
+/********************************************************************************
+* stack_pointer: Returns the stack pointer, i.e. the address of the last
+*                value pushed to the stack.
+********************************************************************************/
+uint8_t stack_pointer(void);
+
+/********************************************************************************
+* stack_is_empty: Indicates if the stack is empty.
+********************************************************************************/
+bool stack_is_empty(void);
+
+/********************************************************************************
+* stack_address: Returns the stack pointer as seen by a program through INSP,
+*                which counts down from STACK_TOP_ADDRESS by one per value
+*                on the stack, like the stack pointer of the ATmega328P.
+********************************************************************************/
+uint16_t stack_address(void);
+
+/********************************************************************************
+* stack_set_address: Sets the stack pointer as seen by a program through
+*                    OUTSP, so that the stack holds STACK_TOP_ADDRESS minus
+*                    specified address values. Values added to the stack keep
+*                    their content. Returns 0 after success or error code 1
+*                    if the address is outside the stack, in which case the
+*                    stack is unchanged.
+*
+*                    - address: The new stack pointer.
+********************************************************************************/
+int stack_set_address(const uint16_t address);
+
+/********************************************************************************
+* stack_read: Returns the value at specified stack address without popping
+*             it from the stack.
+*
+*             - address: The stack address to read from.
+********************************************************************************/
+uint8_t stack_read(const uint8_t address);
+
+/********************************************************************************
+* stack_restore: Replaces the content of the stack, for instance with the
+*                content stored in a snapshot.
+*
+*                - content: Reference to the new content of the stack.
+*                - pointer: The new stack pointer.
+*                - empty  : Indicates if the stack is empty.
+********************************************************************************/
+void stack_restore(const uint8_t* content,
+                   const uint8_t pointer,
+                   const bool empty);
+
 #endif /* STACK_H_ */
\ No newline at end of file
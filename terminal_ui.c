@@ -0,0 +1,226 @@
+/********************************************************************************
+* terminal_ui.c: Contains functionality for displaying the state of the
+*                system on its own thread.
+********************************************************************************/
+#include <string.h>
+#include <time.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "terminal_ui.h"
+
+#define FIELD_SIZE   32 /* Capacity of the text of a field. */
+#define VALUE_COLUMN 49 /* Terminal column where the values start. */
+
+/********************************************************************************
+* field: Enumeration for the fields displayed by the terminal UI.
+********************************************************************************/
+enum field
+{
+   FIELD_SUBROUTINE,  /* Current subroutine. */
+   FIELD_INSTRUCTION, /* Current instruction. */
+   FIELD_STATE,       /* Next state in the instruction cycle. */
+   FIELD_PC,          /* Program counter. */
+   FIELD_IR,          /* Instruction register. */
+   FIELD_SR,          /* Status register. */
+   FIELD_R16,         /* CPU register R16. */
+   FIELD_R24,         /* CPU register R24. */
+   FIELD_DDRB,        /* Data direction register DDRB. */
+   FIELD_PORTB,       /* Data register PORTB. */
+   FIELD_PINB,        /* Pin input register PINB. */
+   FIELD_CYCLES,      /* Clock cycles since reset. */
+   FIELD_CLOCK,       /* Simulated clock frequency. */
+   NUM_FIELDS         /* Number of fields. */
+};
+
+/********************************************************************************
+* layout: Label and terminal row of a field.
+********************************************************************************/
+struct layout
+{
+   const char* label; /* The label. */
+   uint8_t row;       /* The row, counted from 1. */
+};
+
+static const struct layout layouts[NUM_FIELDS] =
+{
+   { "Current subroutine:", 2 }, { "Current instruction:", 3 }, { "Current state:", 4 },
+   { "Program counter:", 5 }, { "Instruction register:", 6 }, { "Status register (INZVC):", 7 },
+   { "Content in CPU register R16:", 9 }, { "Content in CPU register R24:", 10 },
+   { "Content in data direction register DDRB:", 12 }, { "Content in data register PORTB:", 13 },
+   { "Content in pin input register PINB:", 14 }, { "Clock cycles since reset:", 16 },
+   { "Simulated clock frequency:", 17 }
+};
+
+#define LAST_ROW 19 /* Row of the bottom line. */
+
+static const struct shared_state_block* state_block = 0;
+static uint32_t frame_rate = TERMINAL_UI_FRAME_RATE;
+static thrd_t ui_thread;
+static atomic_bool running;
+static char shown[NUM_FIELDS][FIELD_SIZE]; /* Text currently displayed in each field. */
+static uint64_t last_cycles = 0;
+static double last_time = 0.0;
+
+static int run_ui(void* arg);
+static void draw_frame(void);
+static void format_fields(const struct shared_state_data* data,
+                          char fields[NUM_FIELDS][FIELD_SIZE]);
+static void enable_escape_sequences(void);
+
+/********************************************************************************
+* terminal_ui_start: Clears the terminal, draws the labels of all fields and
+*                    starts rendering the state published in referenced
+*                    block on a new thread at specified frame rate. Returns
+*                    0 after success or error code 1 if the thread couldn't
+*                    be started.
+*
+*                    - source           : Reference to the published state.
+*                    - frames_per_second: The frame rate.
+********************************************************************************/
+int terminal_ui_start(const struct shared_state_block* source,
+                      const uint32_t frames_per_second)
+{
+   if (!source || !frames_per_second) return 1;
+
+   state_block = source;
+   frame_rate = frames_per_second;
+   last_cycles = 0;
+   last_time = cpu_seconds_now();
+   memset(shown, 0, sizeof(shown));
+   enable_escape_sequences();
+
+   printf("\x1b[2J\x1b[1;1H");
+   printf("--------------------------------------------------------------------------------\n");
+
+   for (uint8_t i = 0; i < NUM_FIELDS; ++i)
+   {
+      printf("\x1b[%hu;1H%s", layouts[i].row, layouts[i].label);
+   }
+
+   printf("\x1b[%hu;1H", LAST_ROW - 1);
+   printf("--------------------------------------------------------------------------------\n");
+   printf("Running, press Enter to stop...");
+   fflush(stdout);
+
+   atomic_store(&running, true);
+
+   if (thrd_create(&ui_thread, run_ui, 0) != thrd_success)
+   {
+      atomic_store(&running, false);
+      return 1;
+   }
+   return 0;
+}
+
+/********************************************************************************
+* terminal_ui_stop: Renders a last frame, stops the thread and moves the
+*                   cursor below the displayed fields.
+********************************************************************************/
+void terminal_ui_stop(void)
+{
+   if (!atomic_exchange(&running, false)) return;
+   thrd_join(ui_thread, 0);
+   draw_frame();
+   printf("\x1b[%hu;1H\n", LAST_ROW + 1);
+   fflush(stdout);
+   return;
+}
+
+static int run_ui(void* arg)
+{
+   const long period_ns = 1000000000L / (long)frame_rate;
+   (void)arg;
+
+   while (atomic_load(&running))
+   {
+      const struct timespec period = { period_ns / 1000000000L, period_ns % 1000000000L };
+      draw_frame();
+      thrd_sleep(&period, 0);
+   }
+   return 0;
+}
+
+/********************************************************************************
+* draw_frame: Reads the published state and redraws every field whose text
+*             differs from the text currently displayed, followed by a single
+*             flush of the terminal.
+********************************************************************************/
+static void draw_frame(void)
+{
+   struct shared_state_data data;
+   char fields[NUM_FIELDS][FIELD_SIZE];
+   bool changed = false;
+
+   if (shared_state_read(state_block, &data)) return;
+   format_fields(&data, fields);
+
+   for (uint8_t i = 0; i < NUM_FIELDS; ++i)
+   {
+      if (strcmp(fields[i], shown[i]))
+      {
+         printf("\x1b[%hu;%dH%-*s", layouts[i].row, VALUE_COLUMN, FIELD_SIZE - 1, fields[i]);
+         strcpy(shown[i], fields[i]);
+         changed = true;
+      }
+   }
+
+   if (changed)
+   {
+      printf("\x1b[%hu;32H", LAST_ROW);
+      fflush(stdout);
+   }
+   return;
+}
+
+static void format_fields(const struct shared_state_data* data,
+                          char fields[NUM_FIELDS][FIELD_SIZE])
+{
+   char binary[3][CPU_BINARY_BUFFER_SIZE];
+   const double now = cpu_seconds_now();
+   const double elapsed = now - last_time;
+
+   snprintf(fields[FIELD_SUBROUTINE], FIELD_SIZE, "%s", data->symbol);
+   snprintf(fields[FIELD_INSTRUCTION], FIELD_SIZE, "%s", cpu_instruction_name(data->op_code));
+   snprintf(fields[FIELD_STATE], FIELD_SIZE, "%s", cpu_state_name((enum cpu_state)data->state));
+   snprintf(fields[FIELD_PC], FIELD_SIZE, "%hu", data->pc);
+   snprintf(fields[FIELD_IR], FIELD_SIZE, "%s %s %s", cpu_format_binary((data->ir >> 16) & 0xFF, 8, binary[0]),
+            cpu_format_binary((data->ir >> 8) & 0xFF, 8, binary[1]), cpu_format_binary(data->ir & 0xFF, 8, binary[2]));
+   snprintf(fields[FIELD_SR], FIELD_SIZE, "%s", cpu_format_binary(data->sr, 5, binary[0]));
+   snprintf(fields[FIELD_R16], FIELD_SIZE, "%s", cpu_format_binary(data->reg[R16], 8, binary[0]));
+   snprintf(fields[FIELD_R24], FIELD_SIZE, "%s", cpu_format_binary(data->reg[R24], 8, binary[0]));
+   snprintf(fields[FIELD_DDRB], FIELD_SIZE, "%s", cpu_format_binary(data->ports[DDRB], 8, binary[0]));
+   snprintf(fields[FIELD_PORTB], FIELD_SIZE, "%s", cpu_format_binary(data->ports[PORTB], 8, binary[0]));
+   snprintf(fields[FIELD_PINB], FIELD_SIZE, "%s", cpu_format_binary(data->ports[PINB], 8, binary[0]));
+   snprintf(fields[FIELD_CYCLES], FIELD_SIZE, "%llu", (unsigned long long)data->cycles);
+
+   if (elapsed >= 1.0 || !shown[FIELD_CLOCK][0])
+   {
+      const double hertz = data->cycles >= last_cycles && elapsed > 0 ? (data->cycles - last_cycles) / elapsed : 0.0;
+      snprintf(fields[FIELD_CLOCK], FIELD_SIZE, "%.1f MHz", hertz / 1e6);
+      last_cycles = data->cycles;
+      last_time = now;
+   }
+   else
+   {
+      strcpy(fields[FIELD_CLOCK], shown[FIELD_CLOCK]);
+   }
+   return;
+}
+
+static void enable_escape_sequences(void)
+{
+#ifdef _WIN32
+   HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+   DWORD mode = 0;
+   if (GetConsoleMode(console, &mode))
+   {
+      SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+   }
+#endif
+   return;
+}
\ No newline at end of file
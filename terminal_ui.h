@@ -0,0 +1,40 @@
+/********************************************************************************
+* terminal_ui.h: Contains functionality for displaying the state of the system
+*                on its own thread while the simulation runs at full speed.
+*                The thread reads the state published by shared_state at a
+*                fixed frame rate and only redraws the fields that changed
+*                since the previous frame, by moving the cursor with ANSI
+*                escape sequences. All text is formatted into buffers owned
+*                by the thread, so nothing is shared with the simulation
+*                except the published state block.
+********************************************************************************/
+#ifndef TERMINAL_UI_H_
+#define TERMINAL_UI_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "shared_state.h"
+
+#define TERMINAL_UI_FRAME_RATE       25    /* Frames rendered per second. */
+#define TERMINAL_UI_PUBLISH_INTERVAL 50000 /* Clock cycles between publications while running. */
+
+/********************************************************************************
+* terminal_ui_start: Clears the terminal, draws the labels of all fields and
+*                    starts rendering the state published in referenced
+*                    block on a new thread at specified frame rate. Returns
+*                    0 after success or error code 1 if the thread couldn't
+*                    be started.
+*
+*                    - source           : Reference to the published state.
+*                    - frames_per_second: The frame rate.
+********************************************************************************/
+int terminal_ui_start(const struct shared_state_block* source,
+                      const uint32_t frames_per_second);
+
+/********************************************************************************
+* terminal_ui_stop: Renders a last frame, stops the thread and moves the
+*                   cursor below the displayed fields.
+********************************************************************************/
+void terminal_ui_stop(void);
+
+#endif /* TERMINAL_UI_H_ */
\ No newline at end of file
@@ -0,0 +1,520 @@
+/********************************************************************************
+* translator.c: Contains functionality for ahead-of-time translation of the
+*               program in program memory to C.
+********************************************************************************/
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "translator.h"
+#include "control_unit.h"
+
+/********************************************************************************
+* instruction_kind: Enumeration for how an instruction is translated.
+********************************************************************************/
+enum instruction_kind
+{
+   KIND_NONE,     /* Not translated, run by the fast engine. */
+   KIND_REGISTER, /* Only uses the registers and the status register. */
+   KIND_ACCESS,   /* Accesses data memory, the block may be left afterwards. */
+   KIND_JUMP,     /* Unconditional jump, ends the block. */
+   KIND_BRANCH    /* Conditional branch, ends the block. */
+};
+
+#ifdef _WIN32
+static HMODULE library = 0;
+#else
+static void* library = 0;
+#endif
+
+static enum instruction_kind instruction_kind(const uint32_t instruction);
+static void find_blocks(const uint32_t* program,
+                        uint8_t* block_length);
+static void write_block(FILE* file,
+                        const uint32_t* program,
+                        const uint8_t* block_length,
+                        const uint8_t start);
+static void write_statement(FILE* file,
+                            const uint32_t instruction);
+static void write_transfer(FILE* file,
+                           const uint8_t* block_length,
+                           const uint8_t address);
+static inline bool pair_valid(const uint8_t low);
+
+/********************************************************************************
+* translator_write: Translates the program in program memory, without
+*                   inserted breakpoints, to a C source file with specified
+*                   path, which is replaced if it exists. Returns 0 after
+*                   success or error code 1 if the file couldn't be written.
+*
+*                   - filepath: Path to the C source file.
+********************************************************************************/
+int translator_write(const char* filepath)
+{
+   uint32_t program[PROGRAM_MEMORY_ADDRESS_WIDTH];
+   uint8_t block_length[PROGRAM_MEMORY_ADDRESS_WIDTH];
+   FILE* file = fopen(filepath, "w");
+   if (!file) return 1;
+
+   program_memory_write();
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      program[i] = breakpoint_instruction((uint8_t)i);
+   }
+
+   find_blocks(program, block_length);
+
+   fprintf(file, "/* Translated by translator_write, compile with alu.c to a shared object. */\n");
+   fprintf(file, "#include \"translator.h\"\n#include \"alu.h\"\n\n");
+   fprintf(file, "#define PAIR(low) ((uint16_t)(reg[(low)] | (reg[(low) + 1] << 8)))\n");
+   fprintf(file, "#define SET_PAIR(low, value) do { const uint16_t v = (value); "
+                 "reg[(low)] = (uint8_t)v; reg[(low) + 1] = (uint8_t)(v >> 8); } while (0)\n");
+   fprintf(file, "#define EQUAL   ((*sr & (1 << Z)) != 0)\n");
+   fprintf(file, "#define LOWER   ((*sr & (1 << N)) != 0)\n");
+   fprintf(file, "#define GREATER (!EQUAL && !LOWER)\n");
+   fprintf(file, "#define SIGNED_LOWER (((*sr >> N) & 1) != ((*sr >> V) & 1))\n");
+   fprintf(file, "#define LEAVE(address) do { *pc = (address); *c->mar = last; return n; } while (0)\n\n");
+
+   fprintf(file, "static uint32_t run(const struct translator_context* c,\n");
+   fprintf(file, "                    const uint32_t num_instructions)\n{\n");
+   fprintf(file, "   uint8_t* const reg = c->reg;\n");
+   fprintf(file, "   uint8_t* const sr = c->sr;\n");
+   fprintf(file, "   uint8_t* const pc = c->pc;\n");
+   fprintf(file, "   uint64_t* const cycles = c->cycles;\n");
+   fprintf(file, "   uint8_t* const executed = c->executed;\n");
+   fprintf(file, "   uint8_t (*const branches)[2] = c->branches;\n");
+   fprintf(file, "   uint8_t last = *c->mar;\n");
+   fprintf(file, "   uint32_t n = 0;\n\n");
+
+   fprintf(file, "   switch (*pc)\n   {\n");
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      if (block_length[i]) fprintf(file, "      case 0x%02X: goto block_%02X;\n", i, i);
+   }
+
+   fprintf(file, "      default: return 0;\n   }\n");
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      if (block_length[i]) write_block(file, program, block_length, (uint8_t)i);
+   }
+
+   fprintf(file, "}\n\n#ifdef _WIN32\n__declspec(dllexport)\n#endif\n");
+   fprintf(file, "const struct translator_module %s =\n{\n   %d,\n   run,\n   {", TRANSLATOR_MODULE_NAME,
+           TRANSLATOR_VERSION);
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      fprintf(file, "%s0x%06X%s", i % 8 ? " " : "\n      ", program[i], i < PROGRAM_MEMORY_ADDRESS_WIDTH - 1 ? "," : "");
+   }
+
+   fprintf(file, "\n   },\n   {");
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      fprintf(file, "%s%3u%s", i % 16 ? " " : "\n      ", block_length[i], i < PROGRAM_MEMORY_ADDRESS_WIDTH - 1 ? "," : "");
+   }
+
+   fprintf(file, "\n   }\n};\n");
+   return fclose(file);
+}
+
+/********************************************************************************
+* translator_load: Loads a translated program from the shared object with
+*                  specified path and lets the fast engine of the calling
+*                  thread run it. Blocks are only run where they match the
+*                  program memory. Returns 0 after success or error code 1 if
+*                  the shared object couldn't be loaded or wasn't made by a
+*                  compatible translator.
+*
+*                  - filepath: Path to the shared object.
+********************************************************************************/
+int translator_load(const char* filepath)
+{
+   const struct translator_module* module = 0;
+   translator_unload();
+
+#ifdef _WIN32
+   library = LoadLibraryA(filepath);
+   if (library) module = (const struct translator_module*)GetProcAddress(library, TRANSLATOR_MODULE_NAME);
+#else
+   library = dlopen(filepath, RTLD_NOW | RTLD_LOCAL);
+   if (library) module = (const struct translator_module*)dlsym(library, TRANSLATOR_MODULE_NAME);
+#endif
+
+   if (!module || module->version != TRANSLATOR_VERSION)
+   {
+      translator_unload();
+      return 1;
+   }
+
+   control_unit_set_translation(module);
+   return 0;
+}
+
+/********************************************************************************
+* translator_unload: Stops running the translated program and unloads the
+*                    shared object, if any.
+********************************************************************************/
+void translator_unload(void)
+{
+   control_unit_set_translation(0);
+   if (!library) return;
+
+#ifdef _WIN32
+   FreeLibrary(library);
+#else
+   dlclose(library);
+#endif
+   library = 0;
+   return;
+}
+
+/********************************************************************************
+* instruction_kind: Returns how specified instruction is translated. Register
+*                   operands out of range aren't translated, so that the
+*                   fast engine runs them exactly as before.
+********************************************************************************/
+static enum instruction_kind instruction_kind(const uint32_t instruction)
+{
+   const uint8_t op_code = (uint8_t)(instruction >> 16);
+   const uint8_t op1 = (uint8_t)(instruction >> 8);
+   const uint8_t op2 = (uint8_t)instruction;
+
+   switch (op_code)
+   {
+      case NOP:
+      {
+         return KIND_REGISTER;
+      }
+      case LDI: case CLR: case ORI: case ANDI: case XORI: case ADDI: case SUBI:
+      case INC: case DEC: case LSL: case LSR: case CPI:
+      {
+         return op1 < CPU_REGISTER_ADDRESS_WIDTH ? KIND_REGISTER : KIND_NONE;
+      }
+      case MOV: case OR: case AND: case XOR: case ADD: case SUB: case ADC: case SBC:
+      case CP: case MUL: case MULS: case MULSU:
+      {
+         return op1 < CPU_REGISTER_ADDRESS_WIDTH && op2 < CPU_REGISTER_ADDRESS_WIDTH ? KIND_REGISTER : KIND_NONE;
+      }
+      case MOVW:
+      {
+         return pair_valid(op1) && pair_valid(op2) ? KIND_REGISTER : KIND_NONE;
+      }
+      case ADIW: case SBIW:
+      {
+         return pair_valid(op1) ? KIND_REGISTER : KIND_NONE;
+      }
+      case IN: case LDS: case LDDY: case LDDZ:
+      {
+         return op1 < CPU_REGISTER_ADDRESS_WIDTH ? KIND_ACCESS : KIND_NONE;
+      }
+      case OUT: case STS: case STDY: case STDZ:
+      {
+         return op2 < CPU_REGISTER_ADDRESS_WIDTH ? KIND_ACCESS : KIND_NONE;
+      }
+      case LD: case LDP: case LDM:
+      {
+         return op1 < CPU_REGISTER_ADDRESS_WIDTH && pair_valid(op2) ? KIND_ACCESS : KIND_NONE;
+      }
+      case ST: case STP: case STM:
+      {
+         return pair_valid(op1) && op2 < CPU_REGISTER_ADDRESS_WIDTH ? KIND_ACCESS : KIND_NONE;
+      }
+      case JMP:
+      {
+         return KIND_JUMP;
+      }
+      case BREQ: case BRNE: case BRGE: case BRGT: case BRLE: case BRLT: case BRGES: case BRLTS:
+      {
+         return KIND_BRANCH;
+      }
+      default:
+      {
+         return KIND_NONE;
+      }
+   }
+}
+
+/********************************************************************************
+* find_blocks: Finds the basic blocks of the program and stores the number of
+*              instructions of the block starting at each address, or 0 if
+*              no block starts there. Blocks start at the reset and interrupt
+*              vectors, at jump targets and after instructions that end a
+*              block, and end at jumps, branches, instructions that aren't
+*              translated and the start of the next block.
+********************************************************************************/
+static void find_blocks(const uint32_t* program,
+                        uint8_t* block_length)
+{
+   bool leader[PROGRAM_MEMORY_ADDRESS_WIDTH] = { false };
+
+   for (uint8_t vector = RESET_vect; vector <= USART_UDRE_vect; vector += 2)
+   {
+      leader[vector] = true;
+   }
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      const enum instruction_kind kind = instruction_kind(program[i]);
+
+      if (kind == KIND_JUMP || kind == KIND_BRANCH)
+      {
+         leader[(uint8_t)(program[i] >> 8)] = true;
+      }
+
+      if (kind == KIND_JUMP || kind == KIND_BRANCH || kind == KIND_NONE)
+      {
+         leader[(uint8_t)(i + 1)] = true;
+      }
+   }
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      uint16_t length = 0;
+      block_length[i] = 0;
+      if (!leader[i]) continue;
+
+      while (length < UINT8_MAX)
+      {
+         const uint8_t address = (uint8_t)(i + length);
+         const enum instruction_kind kind = instruction_kind(program[address]);
+         if (kind == KIND_NONE) break;
+
+         length++;
+         if (kind == KIND_JUMP || kind == KIND_BRANCH || leader[(uint8_t)(address + 1)]) break;
+      }
+      block_length[i] = (uint8_t)length;
+   }
+   return;
+}
+
+/********************************************************************************
+* write_block: Writes the label of the block starting at specified address,
+*              the check whether the block can be entered and the statements
+*              of its instructions.
+********************************************************************************/
+static void write_block(FILE* file,
+                        const uint32_t* program,
+                        const uint8_t* block_length,
+                        const uint8_t start)
+{
+   const uint8_t length = block_length[start];
+
+   fprintf(file, "\nblock_%02X:", start);
+   if (program_memory_builtin()) fprintf(file, " /* %s */", program_memory_subroutine_name(start));
+   fprintf(file, "\n   if (num_instructions - n < %u || *cycles + %u >= *c->next_event || !c->valid[0x%02X]) LEAVE(0x%02X);\n",
+           length, 3 * length, start, start);
+
+   for (uint8_t i = 0; i < length; ++i)
+   {
+      const uint8_t address = (uint8_t)(start + i);
+      const uint32_t instruction = program[address];
+      const uint8_t op_code = (uint8_t)(instruction >> 16);
+      const uint8_t target = (uint8_t)(instruction >> 8);
+      const enum instruction_kind kind = instruction_kind(instruction);
+
+      fprintf(file, "\n   /* 0x%02X: %s 0x%02X, 0x%02X */\n", address, cpu_instruction_name(op_code),
+              target, instruction & 0xFF);
+      fprintf(file, "   executed[0x%02X] = 1;\n   *cycles += 3;\n   last = 0x%02X;\n   n++;\n", address, address);
+
+      if (kind == KIND_JUMP)
+      {
+         write_transfer(file, block_length, target);
+         return;
+      }
+      else if (kind == KIND_BRANCH)
+      {
+         const char* condition = op_code == BREQ ? "EQUAL" : op_code == BRNE ? "!EQUAL" :
+                                 op_code == BRGE ? "GREATER || EQUAL" : op_code == BRGT ? "GREATER" :
+                                 op_code == BRLE ? "LOWER || EQUAL" : op_code == BRLT ? "LOWER" :
+                                 op_code == BRGES ? "!SIGNED_LOWER" : "SIGNED_LOWER";
+         fprintf(file, "   if (%s)\n   {\n      branches[0x%02X][1] = 1;\n   ", condition, address);
+         write_transfer(file, block_length, target);
+         fprintf(file, "   }\n   branches[0x%02X][0] = 1;\n", address);
+         write_transfer(file, block_length, (uint8_t)(address + 1));
+         return;
+      }
+
+      write_statement(file, instruction);
+
+      if (kind == KIND_ACCESS)
+      {
+         fprintf(file, "   if (c->boundary()) LEAVE(0x%02X);\n", (uint8_t)(address + 1));
+      }
+   }
+
+   write_transfer(file, block_length, (uint8_t)(start + length));
+   return;
+}
+
+/********************************************************************************
+* write_statement: Writes the C statement of an instruction that neither
+*                  jumps nor branches. The statements do the same as the
+*                  corresponding cases of the control unit.
+********************************************************************************/
+static void write_statement(FILE* file,
+                            const uint32_t instruction)
+{
+   const uint8_t op_code = (uint8_t)(instruction >> 16);
+   const uint8_t op1 = (uint8_t)(instruction >> 8);
+   const uint8_t op2 = (uint8_t)instruction;
+
+   switch (op_code)
+   {
+      case NOP:
+      {
+         break;
+      }
+      case LDI:
+      {
+         fprintf(file, "   reg[%u] = 0x%02X;\n", op1, op2);
+         break;
+      }
+      case MOV:
+      {
+         fprintf(file, "   reg[%u] = reg[%u];\n", op1, op2);
+         break;
+      }
+      case CLR:
+      {
+         fprintf(file, "   reg[%u] = 0x00;\n", op1);
+         break;
+      }
+      case ORI: case ANDI: case XORI: case ADDI: case SUBI:
+      {
+         fprintf(file, "   reg[%u] = alu(0x%02X, reg[%u], 0x%02X, sr);\n", op1, op_code, op1, op2);
+         break;
+      }
+      case OR: case AND: case XOR: case ADD: case SUB: case ADC: case SBC:
+      {
+         fprintf(file, "   reg[%u] = alu(0x%02X, reg[%u], reg[%u], sr);\n", op1, op_code, op1, op2);
+         break;
+      }
+      case INC: case DEC: case LSL: case LSR:
+      {
+         fprintf(file, "   reg[%u] = alu(0x%02X, reg[%u], 0x00, sr);\n", op1, op_code, op1);
+         break;
+      }
+      case CPI:
+      {
+         fprintf(file, "   alu_compare(reg[%u], 0x%02X, sr);\n", op1, op2);
+         break;
+      }
+      case CP:
+      {
+         fprintf(file, "   alu_compare(reg[%u], reg[%u], sr);\n", op1, op2);
+         break;
+      }
+      case MOVW:
+      {
+         fprintf(file, "   SET_PAIR(%u, PAIR(%u));\n", op1, op2);
+         break;
+      }
+      case ADIW: case SBIW:
+      {
+         fprintf(file, "   SET_PAIR(%u, alu_word(0x%02X, PAIR(%u), 0x%02X, sr));\n", op1, op_code, op1, op2);
+         break;
+      }
+      case MUL: case MULS: case MULSU:
+      {
+         fprintf(file, "   SET_PAIR(%u, alu_multiply(0x%02X, reg[%u], reg[%u], sr));\n", R0, op_code, op1, op2);
+         break;
+      }
+      case IN:
+      {
+         fprintf(file, "   reg[%u] = c->data_read(0x%02X);\n", op1, op2);
+         break;
+      }
+      case OUT:
+      {
+         fprintf(file, "   c->data_write(0x%02X, reg[%u]);\n", op1, op2);
+         break;
+      }
+      case LDS:
+      {
+         fprintf(file, "   reg[%u] = c->data_read(0x%02X);\n", op1, op2);
+         if (op1 < CPU_REGISTER_ADDRESS_WIDTH - 1) fprintf(file, "   reg[%u] = c->data_read(0x%02X);\n", op1 + 1, op2 + 1);
+         break;
+      }
+      case STS:
+      {
+         fprintf(file, "   c->data_write(0x%02X, reg[%u]);\n", op1, op2);
+         if (op2 < DATA_MEMORY_DATA_WIDTH - 1) fprintf(file, "   c->data_write(0x%02X, reg[%u]);\n", op1 + 1, op2 + 1);
+         break;
+      }
+      case LD:
+      {
+         fprintf(file, "   reg[%u] = c->data_read(PAIR(%u));\n", op1, op2);
+         break;
+      }
+      case LDP:
+      {
+         fprintf(file, "   { const uint16_t address = PAIR(%u); SET_PAIR(%u, address + 1); reg[%u] = c->data_read(address); }\n",
+                 op2, op2, op1);
+         break;
+      }
+      case LDM:
+      {
+         fprintf(file, "   { const uint16_t address = PAIR(%u) - 1; SET_PAIR(%u, address); reg[%u] = c->data_read(address); }\n",
+                 op2, op2, op1);
+         break;
+      }
+      case ST:
+      {
+         fprintf(file, "   c->data_write(PAIR(%u), reg[%u]);\n", op1, op2);
+         break;
+      }
+      case STP:
+      {
+         fprintf(file, "   { const uint16_t address = PAIR(%u); c->data_write(address, reg[%u]); SET_PAIR(%u, address + 1); }\n",
+                 op1, op2, op1);
+         break;
+      }
+      case STM:
+      {
+         fprintf(file, "   { const uint16_t address = PAIR(%u) - 1; c->data_write(address, reg[%u]); SET_PAIR(%u, address); }\n",
+                 op1, op2, op1);
+         break;
+      }
+      case LDDY: case LDDZ:
+      {
+         fprintf(file, "   reg[%u] = c->data_read((uint16_t)(PAIR(%u) + 0x%02X));\n", op1, op_code == LDDY ? YL : ZL, op2);
+         break;
+      }
+      case STDY: case STDZ:
+      {
+         fprintf(file, "   c->data_write((uint16_t)(PAIR(%u) + 0x%02X), reg[%u]);\n", op_code == STDY ? YL : ZL, op1, op2);
+         break;
+      }
+   }
+   return;
+}
+
+/********************************************************************************
+* write_transfer: Writes a jump to the block at specified address, or leaves
+*                 the translated code if no block starts there.
+********************************************************************************/
+static void write_transfer(FILE* file,
+                           const uint8_t* block_length,
+                           const uint8_t address)
+{
+   if (block_length[address])
+   {
+      fprintf(file, "   goto block_%02X;\n", address);
+   }
+   else
+   {
+      fprintf(file, "   LEAVE(0x%02X);\n", address);
+   }
+   return;
+}
+
+static inline bool pair_valid(const uint8_t low)
+{
+   return low < CPU_REGISTER_ADDRESS_WIDTH - 1;
+}
\ No newline at end of file
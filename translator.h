@@ -0,0 +1,112 @@
+/********************************************************************************
+* translator.h: Contains functionality for ahead-of-time translation of the
+*               program in program memory to C, for regression runs of fixed
+*               firmware at close to native speed.
+*
+*               translator_write emits one C function for the whole program,
+*               with a label per basic block and the instructions of the
+*               block as plain C statements on the registers, calls of the
+*               ALU and calls of the data memory through the context below.
+*               The function starts with a switch on the program counter,
+*               which is the dispatch table for indirect control flow. The
+*               source is compiled to a shared object, for instance by
+*
+*                  cc -O2 -shared -fPIC -I<repo> program.c <repo>/alu.c -o program.so
+*
+*               and loaded by translator_load, after which the fast engine
+*               of the control unit runs translated blocks whenever it can.
+*
+*               The translated code only covers what the fast engine does
+*               between instruction boundaries without side effects on the
+*               control flow. CALL, RET, RETI, PUSH, POP, SEI, CLI, LPM and
+*               breakpoints end a block and are run by the fast engine, which
+*               then dispatches to the block at the new program counter. A
+*               block is only entered if no event of the control unit is due
+*               before it ends, and a block leaves after a data memory access
+*               that may have changed a pin, requested an interrupt or hit a
+*               watchpoint, so interrupts are still taken at the same
+*               instruction boundaries as in the other engines. Blocks whose
+*               instructions no longer match the program memory, for instance
+*               after a breakpoint has been inserted, are never entered.
+********************************************************************************/
+#ifndef TRANSLATOR_H_
+#define TRANSLATOR_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "program_memory.h"
+
+#define TRANSLATOR_VERSION     1                    /* Version of the interface of translated modules. */
+#define TRANSLATOR_MODULE_NAME "translator_module"  /* Symbol of the module in the shared object. */
+
+/********************************************************************************
+* translator_context: State of the control unit passed to translated code.
+********************************************************************************/
+struct translator_context
+{
+   uint8_t* reg;                                    /* CPU registers R0 - R31. */
+   uint8_t* sr;                                     /* Status register. */
+   uint8_t* pc;                                     /* Program counter. */
+   uint8_t* mar;                                    /* Address of the last instruction run. */
+   uint64_t* cycles;                                /* Clock cycles run since reset. */
+   const uint64_t* next_event;                      /* Cycle of the next event of the control unit. */
+   const bool* valid;                               /* Set for blocks that match program memory. */
+   uint8_t* executed;                               /* Instruction coverage. */
+   uint8_t (*branches)[2];                          /* Branch coverage. */
+   uint8_t (*data_read)(const uint16_t address);    /* Reads from data memory. */
+   int (*data_write)(const uint16_t address,
+                     const uint8_t value);          /* Writes to data memory. */
+   bool (*boundary)(void);                          /* Checks if a block must be left after an access. */
+};
+
+/********************************************************************************
+* translator_function: Runs translated blocks from the program counter until
+*                      a block ends at an instruction that isn't translated,
+*                      an event is due or specified number of instructions
+*                      would be exceeded. Returns the number of instructions
+*                      run, which is 0 if no block starts at the program
+*                      counter.
+********************************************************************************/
+typedef uint32_t (*translator_function)(const struct translator_context* context,
+                                        const uint32_t num_instructions);
+
+/********************************************************************************
+* translator_module: Translated program exported by the shared object.
+********************************************************************************/
+struct translator_module
+{
+   uint32_t version;                                     /* TRANSLATOR_VERSION. */
+   translator_function run;                              /* Runs translated blocks. */
+   uint32_t program[PROGRAM_MEMORY_ADDRESS_WIDTH];       /* Instructions that were translated. */
+   uint8_t block_length[PROGRAM_MEMORY_ADDRESS_WIDTH];   /* Length of the block at each address, or 0. */
+};
+
+/********************************************************************************
+* translator_write: Translates the program in program memory, without
+*                   inserted breakpoints, to a C source file with specified
+*                   path, which is replaced if it exists. Returns 0 after
+*                   success or error code 1 if the file couldn't be written.
+*
+*                   - filepath: Path to the C source file.
+********************************************************************************/
+int translator_write(const char* filepath);
+
+/********************************************************************************
+* translator_load: Loads a translated program from the shared object with
+*                  specified path and lets the fast engine of the calling
+*                  thread run it. Blocks are only run where they match the
+*                  program memory. Returns 0 after success or error code 1 if
+*                  the shared object couldn't be loaded or wasn't made by a
+*                  compatible translator.
+*
+*                  - filepath: Path to the shared object.
+********************************************************************************/
+int translator_load(const char* filepath);
+
+/********************************************************************************
+* translator_unload: Stops running the translated program and unloads the
+*                    shared object, if any.
+********************************************************************************/
+void translator_unload(void);
+
+#endif /* TRANSLATOR_H_ */
\ No newline at end of file
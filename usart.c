@@ -0,0 +1,548 @@
+/********************************************************************************
+* usart.c: Contains functionality for the USART0 peripheral of the system,
+*          bridged to a host endpoint.
+********************************************************************************/
+#include <string.h>
+#include <time.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#endif
+
+#include "usart.h"
+#include "input_log.h"
+
+#define CYCLES_PER_BIT 16 /* Clock cycles per bit and unit of UBRR0 in normal speed mode. */
+#define BITS_PER_FRAME 10 /* Start bit, 8 data bits and stop bit. */
+
+#ifdef _WIN32
+typedef HANDLE endpoint;
+#define NO_ENDPOINT INVALID_HANDLE_VALUE
+#else
+typedef int endpoint;
+#define NO_ENDPOINT -1
+#endif
+
+/********************************************************************************
+* ring: Lock-free single producer, single consumer ring buffer of bytes.
+********************************************************************************/
+struct ring
+{
+   uint8_t data[USART_RING_SIZE]; /* The buffered bytes. */
+   atomic_uint head;              /* Next index to write, only changed by the producer. */
+   atomic_uint tail;              /* Next index to read, only changed by the consumer. */
+};
+
+static struct ring rx_ring; /* Bytes from the host, produced by the bridge thread. */
+static struct ring tx_ring; /* Bytes to the host, produced by the simulation. */
+
+static endpoint rx_endpoint = NO_ENDPOINT;
+static endpoint tx_endpoint = NO_ENDPOINT;
+static bool shared_endpoint = false; /* Indicates if both endpoints are the same. */
+static thrd_t bridge_thread;
+static atomic_bool bridge_running;
+
+#ifndef _WIN32
+static int pty_slave = -1; /* Kept open so the pseudo terminal stays usable. */
+#endif
+
+static bool rx_full = false;       /* Indicates if UDR0 holds an unread byte. */
+static bool tx_busy = false;       /* Indicates if a written byte is being transmitted. */
+static bool tx_complete = false;   /* Transmit complete flag TXC0. */
+static uint8_t rx_data = 0x00;     /* Last received byte. */
+static uint8_t tx_data = 0x00;     /* Byte being transmitted. */
+static uint64_t frame_cycles = 0;  /* Clock cycles per frame at the current baud rate. */
+
+static void access_register(const uint16_t address,
+                            const enum data_memory_access access,
+                            const uint8_t old_value,
+                            uint8_t* value);
+static void update_usart(void);
+static bool receive(uint8_t* value);
+static inline uint8_t status(void);
+static void request_interrupts(const uint8_t control);
+static int run_bridge(void* arg);
+static size_t flush_tx(uint8_t* buffer);
+static size_t fill_rx(uint8_t* buffer);
+static inline bool ring_push(struct ring* self,
+                             const uint8_t value);
+static inline bool ring_pop(struct ring* self,
+                            uint8_t* value);
+static size_t ring_take(struct ring* self,
+                        uint8_t* buffer);
+static void ring_put(struct ring* self,
+                     const uint8_t* buffer,
+                     const size_t size);
+static endpoint open_endpoint(const char* path,
+                              const bool reading,
+                              const bool writing);
+static endpoint open_pty(void);
+static size_t read_endpoint(const endpoint self,
+                            uint8_t* buffer,
+                            const size_t size);
+static void write_endpoint(const endpoint self,
+                           const uint8_t* buffer,
+                           size_t size);
+static void close_endpoint(const endpoint self);
+static void sleep_idle(void);
+
+/********************************************************************************
+* usart_open: Opens the host endpoints of the USART and starts the bridge
+*             thread. Received bytes are read from the first endpoint and
+*             transmitted bytes are written to the second one. If the same
+*             path is passed for both, it's opened once for reading and
+*             writing, and if USART_PTY is passed, a new pseudo terminal is
+*             created and the name of its terminal device is printed. Must
+*             be called from the thread that runs the system. Returns 0
+*             after success or error code 1 if an endpoint couldn't be
+*             opened.
+*
+*             - rx_path: Path of the endpoint to receive from, or 0.
+*             - tx_path: Path of the endpoint to transmit to, or 0.
+********************************************************************************/
+int usart_open(const char* rx_path,
+               const char* tx_path)
+{
+   usart_close();
+   shared_endpoint = rx_path && tx_path && !strcmp(rx_path, tx_path);
+
+   if (shared_endpoint)
+   {
+      rx_endpoint = !strcmp(rx_path, USART_PTY) ? open_pty() : open_endpoint(rx_path, true, true);
+      tx_endpoint = rx_endpoint;
+      if (rx_endpoint == NO_ENDPOINT) return 1;
+   }
+   else
+   {
+      if (rx_path && (rx_endpoint = open_endpoint(rx_path, true, false)) == NO_ENDPOINT) return 1;
+
+      if (tx_path && (tx_endpoint = open_endpoint(tx_path, false, true)) == NO_ENDPOINT)
+      {
+         close_endpoint(rx_endpoint);
+         rx_endpoint = NO_ENDPOINT;
+         return 1;
+      }
+   }
+
+   atomic_store(&rx_ring.head, 0);
+   atomic_store(&rx_ring.tail, 0);
+   atomic_store(&tx_ring.head, 0);
+   atomic_store(&tx_ring.tail, 0);
+   rx_full = false;
+   tx_busy = false;
+   tx_complete = false;
+   frame_cycles = 0;
+   atomic_store(&bridge_running, true);
+
+   if (thrd_create(&bridge_thread, run_bridge, 0) != thrd_success)
+   {
+      atomic_store(&bridge_running, false);
+      usart_close();
+      return 1;
+   }
+
+   data_memory_set_hook(DATA_MEMORY_HOOK_PERIPHERAL, access_register);
+   data_memory_monitor(DATA_MEMORY_HOOK_PERIPHERAL, UCSR0A, true);
+   data_memory_monitor(DATA_MEMORY_HOOK_PERIPHERAL, UCSR0B, true);
+   data_memory_monitor(DATA_MEMORY_HOOK_PERIPHERAL, UDR0, true);
+   update_usart();
+   return 0;
+}
+
+/********************************************************************************
+* usart_close: Stops the bridge thread after every transmitted byte has been
+*              written to the host, closes the endpoints and removes the
+*              hooks of the USART.
+********************************************************************************/
+void usart_close(void)
+{
+   if (atomic_exchange(&bridge_running, false))
+   {
+      if (tx_busy && ring_push(&tx_ring, tx_data)) tx_busy = false;
+      thrd_join(bridge_thread, 0);
+   }
+
+   data_memory_set_hook(DATA_MEMORY_HOOK_PERIPHERAL, 0);
+   data_memory_monitor(DATA_MEMORY_HOOK_PERIPHERAL, UCSR0A, false);
+   data_memory_monitor(DATA_MEMORY_HOOK_PERIPHERAL, UCSR0B, false);
+   data_memory_monitor(DATA_MEMORY_HOOK_PERIPHERAL, UDR0, false);
+   control_unit_set_periodic_hook(CONTROL_UNIT_HOOK_PERIPHERAL, 0, 0);
+   control_unit_request_interrupt(USART_RX_vect, false);
+   control_unit_request_interrupt(USART_UDRE_vect, false);
+
+   close_endpoint(rx_endpoint);
+   if (!shared_endpoint) close_endpoint(tx_endpoint);
+   rx_endpoint = NO_ENDPOINT;
+   tx_endpoint = NO_ENDPOINT;
+   shared_endpoint = false;
+
+#ifndef _WIN32
+   if (pty_slave >= 0) close(pty_slave);
+   pty_slave = -1;
+#endif
+   return;
+}
+
+/********************************************************************************
+* access_register: Handles accesses to the registers of the USART. Reading
+*                  UDR0 returns the received byte and clears RXC0, while
+*                  writing UDR0 starts a transmission if the transmitter is
+*                  enabled and idle. Writing a one to TXC0 clears the flag,
+*                  the other bits of UCSR0A are read only.
+********************************************************************************/
+static void access_register(const uint16_t address,
+                            const enum data_memory_access access,
+                            const uint8_t old_value,
+                            uint8_t* value)
+{
+   uint8_t control = data_memory_peek(UCSR0B);
+
+   if (address == UDR0 && access == DATA_MEMORY_ACCESS_READ)
+   {
+      *value = rx_data;
+      rx_full = false;
+   }
+   else if (address == UDR0)
+   {
+      if (read(control, TXEN0) && !tx_busy)
+      {
+         tx_data = *value;
+         tx_busy = true;
+         tx_complete = false;
+      }
+      *value = old_value; /* UDR0 keeps the received byte. */
+   }
+   else if (address == UCSR0A && access == DATA_MEMORY_ACCESS_WRITE)
+   {
+      if (read(*value, TXC0)) tx_complete = false;
+   }
+   else if (address == UCSR0B && access == DATA_MEMORY_ACCESS_WRITE)
+   {
+      control = *value;
+   }
+
+   data_memory_poke(UCSR0A, status());
+   if (address == UCSR0A) *value = status();
+   request_interrupts(control);
+   return;
+}
+
+/********************************************************************************
+* update_usart: Called once per frame by the control unit. Completes the
+*               ongoing transmission if there's room in the ring buffer
+*               towards the host, loads the next received byte into UDR0 if
+*               the previous byte has been read and follows changes of the
+*               baud rate.
+********************************************************************************/
+static void update_usart(void)
+{
+   const uint8_t control = data_memory_peek(UCSR0B);
+   const uint16_t ubrr = data_memory_peek(UBRR0L) | ((data_memory_peek(UBRR0H) & 0x0F) << 8);
+   const uint64_t cycles = (uint64_t)CYCLES_PER_BIT * (ubrr + 1) * BITS_PER_FRAME;
+
+   if (tx_busy && ring_push(&tx_ring, tx_data))
+   {
+      tx_busy = false;
+      tx_complete = true;
+   }
+
+   if (!rx_full && read(control, RXEN0) && receive(&rx_data))
+   {
+      rx_full = true;
+      data_memory_poke(UDR0, rx_data);
+   }
+
+   if (cycles != frame_cycles)
+   {
+      frame_cycles = cycles;
+      control_unit_set_periodic_hook(CONTROL_UNIT_HOOK_PERIPHERAL, update_usart, frame_cycles);
+   }
+
+   data_memory_poke(UCSR0A, status());
+   request_interrupts(control);
+   return;
+}
+
+/********************************************************************************
+* receive: Receives the next byte from the host through the input log, so
+*          that it's recorded while recording. While a log is replayed, the
+*          recorded bytes are received instead of the bytes from the host.
+*          Returns true if a byte was received, else false.
+*
+*          - value: Reference to the received byte.
+********************************************************************************/
+static bool receive(uint8_t* value)
+{
+   if (!input_log_replaying() && !ring_pop(&rx_ring, value)) return false;
+   return input_log_receive(value);
+}
+
+static inline uint8_t status(void)
+{
+   return (uint8_t)((rx_full << RXC0) | (tx_complete << TXC0) | (!tx_busy << UDRE0));
+}
+
+/********************************************************************************
+* request_interrupts: Requests the receive complete and data register empty
+*                     interrupts for as long as their flags and enable bits
+*                     are set, and withdraws the requests otherwise.
+*
+*                     - control: Content of UCSR0B.
+********************************************************************************/
+static void request_interrupts(const uint8_t control)
+{
+   control_unit_request_interrupt(USART_RX_vect, rx_full && read(control, RXCIE0));
+   control_unit_request_interrupt(USART_UDRE_vect, !tx_busy && read(control, UDRIE0));
+   return;
+}
+
+/********************************************************************************
+* run_bridge: Moves bytes between the ring buffers and the host endpoints in
+*             batches until the USART is closed, and sleeps while there's
+*             nothing to move. Every byte transmitted before the USART was
+*             closed is written before the thread finishes.
+********************************************************************************/
+static int run_bridge(void* arg)
+{
+   static uint8_t buffer[USART_RING_SIZE];
+   (void)arg;
+
+   while (atomic_load(&bridge_running))
+   {
+      const size_t num_moved = flush_tx(buffer) + fill_rx(buffer);
+      if (!num_moved) sleep_idle();
+   }
+
+   while (flush_tx(buffer));
+   return 0;
+}
+
+static size_t flush_tx(uint8_t* buffer)
+{
+   const size_t size = ring_take(&tx_ring, buffer);
+   if (size && tx_endpoint != NO_ENDPOINT) write_endpoint(tx_endpoint, buffer, size);
+   return size;
+}
+
+static size_t fill_rx(uint8_t* buffer)
+{
+   const unsigned int head = atomic_load_explicit(&rx_ring.head, memory_order_relaxed);
+   const unsigned int tail = atomic_load_explicit(&rx_ring.tail, memory_order_acquire);
+   const size_t space = USART_RING_SIZE - (head - tail);
+
+   if (!space || rx_endpoint == NO_ENDPOINT) return 0;
+   const size_t size = read_endpoint(rx_endpoint, buffer, space);
+   ring_put(&rx_ring, buffer, size);
+   return size;
+}
+
+static inline bool ring_push(struct ring* self,
+                             const uint8_t value)
+{
+   const unsigned int head = atomic_load_explicit(&self->head, memory_order_relaxed);
+   const unsigned int tail = atomic_load_explicit(&self->tail, memory_order_acquire);
+
+   if (head - tail >= USART_RING_SIZE) return false;
+   self->data[head & (USART_RING_SIZE - 1)] = value;
+   atomic_store_explicit(&self->head, head + 1, memory_order_release);
+   return true;
+}
+
+static inline bool ring_pop(struct ring* self,
+                            uint8_t* value)
+{
+   const unsigned int head = atomic_load_explicit(&self->head, memory_order_acquire);
+   const unsigned int tail = atomic_load_explicit(&self->tail, memory_order_relaxed);
+
+   if (head == tail) return false;
+   *value = self->data[tail & (USART_RING_SIZE - 1)];
+   atomic_store_explicit(&self->tail, tail + 1, memory_order_release);
+   return true;
+}
+
+/********************************************************************************
+* ring_take: Moves every byte of referenced ring buffer to specified buffer,
+*            which must hold USART_RING_SIZE bytes, and returns their number.
+********************************************************************************/
+static size_t ring_take(struct ring* self,
+                        uint8_t* buffer)
+{
+   const unsigned int head = atomic_load_explicit(&self->head, memory_order_acquire);
+   const unsigned int tail = atomic_load_explicit(&self->tail, memory_order_relaxed);
+   const size_t size = head - tail;
+   const size_t start = tail & (USART_RING_SIZE - 1);
+   const size_t first = size < USART_RING_SIZE - start ? size : USART_RING_SIZE - start;
+
+   memcpy(buffer, self->data + start, first);
+   memcpy(buffer + first, self->data, size - first);
+   atomic_store_explicit(&self->tail, tail + (unsigned int)size, memory_order_release);
+   return size;
+}
+
+/********************************************************************************
+* ring_put: Copies specified number of bytes to referenced ring buffer, which
+*           must have room for them.
+********************************************************************************/
+static void ring_put(struct ring* self,
+                     const uint8_t* buffer,
+                     const size_t size)
+{
+   const unsigned int head = atomic_load_explicit(&self->head, memory_order_relaxed);
+   const size_t start = head & (USART_RING_SIZE - 1);
+   const size_t first = size < USART_RING_SIZE - start ? size : USART_RING_SIZE - start;
+
+   memcpy(self->data + start, buffer, first);
+   memcpy(self->data, buffer + first, size - first);
+   atomic_store_explicit(&self->head, head + (unsigned int)size, memory_order_release);
+   return;
+}
+
+#ifdef _WIN32
+
+static endpoint open_endpoint(const char* path,
+                              const bool reading,
+                              const bool writing)
+{
+   const DWORD access = (reading ? GENERIC_READ : 0) | (writing ? GENERIC_WRITE : 0);
+   const HANDLE self = CreateFileA(path, access, FILE_SHARE_READ | FILE_SHARE_WRITE, 0,
+                                   writing ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+   COMMTIMEOUTS timeouts = { MAXDWORD, 0, 0, 0, 0 }; /* Reads from serial ports return at once. */
+
+   if (self == INVALID_HANDLE_VALUE) return NO_ENDPOINT;
+   if (writing && !reading && GetFileType(self) == FILE_TYPE_DISK) SetEndOfFile(self);
+   SetCommTimeouts(self, &timeouts);
+   return self;
+}
+
+static endpoint open_pty(void)
+{
+   fprintf(stderr, "Pseudo terminals aren't supported on this platform!\n");
+   return NO_ENDPOINT;
+}
+
+static size_t read_endpoint(const endpoint self,
+                            uint8_t* buffer,
+                            const size_t size)
+{
+   DWORD available = (DWORD)size;
+   DWORD num_read = 0;
+
+   if (GetFileType(self) == FILE_TYPE_PIPE &&
+       (!PeekNamedPipe(self, 0, 0, 0, &available, 0) || !available)) return 0;
+   if (!ReadFile(self, buffer, available < size ? available : (DWORD)size, &num_read, 0)) return 0;
+   return num_read;
+}
+
+static void write_endpoint(const endpoint self,
+                           const uint8_t* buffer,
+                           size_t size)
+{
+   DWORD num_written = 0;
+
+   while (size && WriteFile(self, buffer, (DWORD)size, &num_written, 0))
+   {
+      buffer += num_written;
+      size -= num_written;
+   }
+   return;
+}
+
+static void close_endpoint(const endpoint self)
+{
+   if (self != NO_ENDPOINT) CloseHandle(self);
+   return;
+}
+
+#else
+
+static endpoint open_endpoint(const char* path,
+                              const bool reading,
+                              const bool writing)
+{
+   const int access = reading && writing ? O_RDWR | O_CREAT : reading ? O_RDONLY : O_WRONLY | O_CREAT | O_TRUNC;
+   const int self = open(path, access | O_NOCTTY | O_NONBLOCK, 0644);
+   return self >= 0 ? self : NO_ENDPOINT;
+}
+
+static endpoint open_pty(void)
+{
+   const int self = posix_openpt(O_RDWR | O_NOCTTY);
+   struct termios settings;
+
+   if (self < 0) return NO_ENDPOINT;
+
+   if (grantpt(self) || unlockpt(self) || (pty_slave = open(ptsname(self), O_RDWR | O_NOCTTY)) < 0)
+   {
+      close(self);
+      return NO_ENDPOINT;
+   }
+
+   if (!tcgetattr(pty_slave, &settings))
+   {
+      cfmakeraw(&settings);
+      tcsetattr(pty_slave, TCSANOW, &settings);
+   }
+
+   fcntl(self, F_SETFL, fcntl(self, F_GETFL) | O_NONBLOCK);
+   printf("USART connected to %s.\n", ptsname(self));
+   return self;
+}
+
+static size_t read_endpoint(const endpoint self,
+                            uint8_t* buffer,
+                            const size_t size)
+{
+   const ssize_t num_read = (read)(self, buffer, size); /* Not the bit macro of cpu.h. */
+   return num_read > 0 ? (size_t)num_read : 0;
+}
+
+/********************************************************************************
+* write_endpoint: Writes specified bytes to the endpoint. A full pipe or
+*                 terminal is waited for, unless the USART is being closed.
+********************************************************************************/
+static void write_endpoint(const endpoint self,
+                           const uint8_t* buffer,
+                           size_t size)
+{
+   while (size)
+   {
+      const ssize_t num_written = write(self, buffer, size);
+
+      if (num_written > 0)
+      {
+         buffer += num_written;
+         size -= (size_t)num_written;
+      }
+      else if (num_written < 0 && (errno == EAGAIN || errno == EINTR) && atomic_load(&bridge_running))
+      {
+         sleep_idle();
+      }
+      else
+      {
+         break;
+      }
+   }
+   return;
+}
+
+static void close_endpoint(const endpoint self)
+{
+   if (self != NO_ENDPOINT) close(self);
+   return;
+}
+
+#endif
+
+static void sleep_idle(void)
+{
+   const struct timespec duration = { 0, USART_BRIDGE_IDLE * 1000L };
+   thrd_sleep(&duration, 0);
+   return;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+/********************************************************************************
+* usart.h: Contains functionality for the USART0 peripheral of the system,
+*          bridged to a host endpoint such as a pipe, a pseudo terminal, a
+*          serial port or a file.
+*
+*          The registers UCSR0A, UCSR0B, UCSR0C, UBRR0L, UBRR0H and UDR0 are
+*          monitored by the peripheral hook of the data memory. A frame
+*          takes 16 * (UBRR0 + 1) * 10 clock cycles, after which a written
+*          byte has been transmitted and the next received byte is loaded
+*          into UDR0. The receive complete and data register empty
+*          interrupts are requested from the control unit for as long as
+*          their flags and enable bits are set, like on the ATmega328P.
+*
+*          Bytes pass between the simulation and the host through two
+*          lock-free single producer, single consumer ring buffers. A
+*          bridge thread moves them to and from the host endpoint in
+*          batches, so the simulation never makes a system call and a guest
+*          sending kilobytes of output costs a few writes on the host.
+*          If the ring buffer towards the host is full, the transmitter
+*          stays busy until the bridge has caught up. Received bytes pass
+*          through the input log, so a run bridged to the host can be
+*          recorded and replayed like other external input.
+********************************************************************************/
+#ifndef USART_H_
+#define USART_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "control_unit.h"
+#include "data_memory.h"
+
+#define USART_RING_SIZE  4096   /* Capacity of each ring buffer, a power of two. */
+#define USART_BRIDGE_IDLE 1000  /* Microseconds the bridge thread sleeps when idle. */
+#define USART_PTY         "pty" /* Endpoint name that creates a new pseudo terminal. */
+
+/********************************************************************************
+* usart_open: Opens the host endpoints of the USART and starts the bridge
+*             thread. Received bytes are read from the first endpoint and
+*             transmitted bytes are written to the second one. If the same
+*             path is passed for both, it's opened once for reading and
+*             writing, and if USART_PTY is passed, a new pseudo terminal is
+*             created and the name of its terminal device is printed. Must
+*             be called from the thread that runs the system. Returns 0
+*             after success or error code 1 if an endpoint couldn't be
+*             opened.
+*
+*             - rx_path: Path of the endpoint to receive from, or 0.
+*             - tx_path: Path of the endpoint to transmit to, or 0.
+********************************************************************************/
+int usart_open(const char* rx_path,
+               const char* tx_path);
+
+/********************************************************************************
+* usart_close: Stops the bridge thread after every transmitted byte has been
+*              written to the host, closes the endpoints and removes the
+*              hooks of the USART.
+********************************************************************************/
+void usart_close(void);
+
+#endif /* USART_H_ */
\ No newline at end of file
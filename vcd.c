@@ -0,0 +1,197 @@
+/********************************************************************************
+* vcd.c: Contains functionality for dumping the I/O ports of the system to a
+*        Value Change Dump file.
+********************************************************************************/
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include "vcd.h"
+
+#define RECORD_SIZE 64 /* Room left in the buffer for one more record. */
+
+static const char* const port_names[VCD_NUM_PORTS] =
+{
+   "DDRB", "PORTB", "PINB", "DDRC", "PORTC", "PINC", "DDRD", "PORTD", "PIND"
+};
+
+static CPU_THREAD_LOCAL FILE* dump = 0;
+static CPU_THREAD_LOCAL char* buffer = 0;
+static CPU_THREAD_LOCAL size_t buffer_length = 0;
+static CPU_THREAD_LOCAL uint8_t dumped[VCD_NUM_PORTS]; /* Last dumped value of each register. */
+static CPU_THREAD_LOCAL uint64_t last_time = 0;        /* Time of the last record. */
+static CPU_THREAD_LOCAL uint64_t time_offset = 0;      /* Added to the cycle counter after resets. */
+
+static void trace_port(const uint16_t address,
+                       const enum data_memory_access access,
+                       const uint8_t old_value,
+                       uint8_t* value);
+static void dump_value(const uint8_t address,
+                       const uint8_t value);
+static void append(const char* format, ...);
+static void flush_buffer(void);
+
+/********************************************************************************
+* vcd_open: Creates a dump with specified path, which is replaced if it
+*           exists, writes the header and the current value of every port
+*           register and starts dumping changes. Must be called from the
+*           thread that runs the system. Returns 0 after success or error
+*           code 1 if the file couldn't be created.
+*
+*           - path: Path to the dump.
+********************************************************************************/
+int vcd_open(const char* path)
+{
+   const time_t now = time(0);
+   char date[64];
+
+   vcd_close();
+   buffer = (char*)malloc(VCD_BUFFER_SIZE);
+   if (!buffer) return 1;
+
+   dump = fopen(path, "wb");
+
+   if (!dump)
+   {
+      free(buffer);
+      buffer = 0;
+      return 1;
+   }
+
+   buffer_length = 0;
+   time_offset = 0;
+   last_time = control_unit_cycles();
+   strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+
+   append("$date %s $end\n", date);
+   append("$version CPU demo in C $end\n");
+   append("$comment One time unit is one clock cycle $end\n");
+   append("$timescale 1 ns $end\n");
+   append("$scope module cpu $end\n");
+
+   for (uint8_t i = 0; i < VCD_NUM_PORTS; ++i)
+   {
+      append("$var wire 8 %c %s [7:0] $end\n", 'A' + i, port_names[i]);
+   }
+
+   append("$upscope $end\n$enddefinitions $end\n#%llu\n$dumpvars\n", (unsigned long long)last_time);
+
+   for (uint8_t i = 0; i < VCD_NUM_PORTS; ++i)
+   {
+      dumped[i] = data_memory_peek(i);
+      dump_value(i, dumped[i]);
+   }
+
+   append("$end\n");
+   data_memory_set_hook(DATA_MEMORY_HOOK_TRACE, trace_port);
+
+   for (uint8_t i = 0; i < VCD_NUM_PORTS; ++i)
+   {
+      data_memory_monitor(DATA_MEMORY_HOOK_TRACE, i, true);
+   }
+   return 0;
+}
+
+/********************************************************************************
+* vcd_close: Stops dumping, writes the remaining buffered records and closes
+*            the dump.
+********************************************************************************/
+void vcd_close(void)
+{
+   if (!dump) return;
+
+   data_memory_set_hook(DATA_MEMORY_HOOK_TRACE, 0);
+
+   for (uint8_t i = 0; i < VCD_NUM_PORTS; ++i)
+   {
+      data_memory_monitor(DATA_MEMORY_HOOK_TRACE, i, false);
+   }
+
+   vcd_update();
+   flush_buffer();
+   fclose(dump);
+   free(buffer);
+   dump = 0;
+   buffer = 0;
+   return;
+}
+
+/********************************************************************************
+* vcd_update: Dumps every port register that has changed since it was last
+*             dumped. Called after external writes that bypass the hooks of
+*             the data memory, such as pin inputs and system resets.
+********************************************************************************/
+void vcd_update(void)
+{
+   if (!dump) return;
+
+   for (uint8_t i = 0; i < VCD_NUM_PORTS; ++i)
+   {
+      const uint8_t value = data_memory_peek(i);
+      if (value != dumped[i]) dump_value(i, value);
+   }
+   return;
+}
+
+/********************************************************************************
+* trace_port: Dumps writes that change a port register.
+********************************************************************************/
+static void trace_port(const uint16_t address,
+                       const enum data_memory_access access,
+                       const uint8_t old_value,
+                       uint8_t* value)
+{
+   (void)old_value;
+   if (access == DATA_MEMORY_ACCESS_WRITE && *value != dumped[address])
+   {
+      dump_value((uint8_t)address, *value);
+   }
+   return;
+}
+
+/********************************************************************************
+* dump_value: Appends a change record of specified register, preceded by the
+*             current time if it differs from the time of the last record.
+********************************************************************************/
+static void dump_value(const uint8_t address,
+                       const uint8_t value)
+{
+   char binary[CPU_BINARY_BUFFER_SIZE];
+   uint64_t time = control_unit_cycles() + time_offset;
+
+   if (time < last_time)
+   {
+      time_offset += last_time - time;
+      time = last_time;
+   }
+
+   if (time != last_time)
+   {
+      append("#%llu\n", (unsigned long long)time);
+      last_time = time;
+   }
+
+   append("b%s %c\n", cpu_format_binary(value, 1, binary), 'A' + address);
+   dumped[address] = value;
+   return;
+}
+
+static void append(const char* format, ...)
+{
+   va_list args;
+   if (buffer_length > VCD_BUFFER_SIZE - RECORD_SIZE) flush_buffer();
+
+   va_start(args, format);
+   const int length = vsnprintf(buffer + buffer_length, VCD_BUFFER_SIZE - buffer_length, format, args);
+   va_end(args);
+
+   if (length > 0) buffer_length += (size_t)length;
+   if (buffer_length > VCD_BUFFER_SIZE) buffer_length = VCD_BUFFER_SIZE;
+   return;
+}
+
+static void flush_buffer(void)
+{
+   fwrite(buffer, 1, buffer_length, dump);
+   buffer_length = 0;
+   return;
+}
\ No newline at end of file
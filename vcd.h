@@ -0,0 +1,56 @@
+/********************************************************************************
+* vcd.h: Contains functionality for dumping the I/O ports of the system to a
+*        Value Change Dump file, which can be opened in GTKWave to look at
+*        the timing of the pins, for instance the led at PORTB versus the
+*        button at PINB.
+*
+*        The registers DDRx, PORTx and PINx are monitored by the trace hook
+*        of the data memory, and a change record is emitted only when a
+*        write actually changes a register. External writes to the pin
+*        input registers aren't passed to the hooks and are dumped by
+*        vcd_update instead. One time unit in the file is one clock cycle.
+*        If the cycle counter is reset, the time continues from where it
+*        was, since the time in a dump must never decrease.
+*
+*        Records are formatted into a large buffer that is written to the
+*        file when it's full, so the simulation only makes a system call
+*        every VCD_BUFFER_SIZE bytes of output. Accesses to other addresses
+*        than the I/O registers cost nothing, and reads of the registers
+*        only cost a call of the hook.
+********************************************************************************/
+#ifndef VCD_H_
+#define VCD_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "control_unit.h"
+#include "data_memory.h"
+
+#define VCD_BUFFER_SIZE (1 << 20) /* Bytes buffered before they are written to the file. */
+#define VCD_NUM_PORTS   (PIND + 1) /* Registers DDRB - PIND. */
+
+/********************************************************************************
+* vcd_open: Creates a dump with specified path, which is replaced if it
+*           exists, writes the header and the current value of every port
+*           register and starts dumping changes. Must be called from the
+*           thread that runs the system. Returns 0 after success or error
+*           code 1 if the file couldn't be created.
+*
+*           - path: Path to the dump.
+********************************************************************************/
+int vcd_open(const char* path);
+
+/********************************************************************************
+* vcd_close: Stops dumping, writes the remaining buffered records and closes
+*            the dump.
+********************************************************************************/
+void vcd_close(void);
+
+/********************************************************************************
+* vcd_update: Dumps every port register that has changed since it was last
+*             dumped. Called after external writes that bypass the hooks of
+*             the data memory, such as pin inputs and system resets.
+********************************************************************************/
+void vcd_update(void);
+
+#endif /* VCD_H_ */
\ No newline at end of file